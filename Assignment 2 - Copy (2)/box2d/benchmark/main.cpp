@@ -0,0 +1,1356 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Runs fixed scenes with each broad-phase type and prints the average time per step.
+// Then compares the iterative solver with the soft step solver on stacking scenes,
+// the default and wide narrow phase, serial and batched continuous collision with many
+// bullets, the regular and compact tree layouts with 100k proxies and times world
+// snapshots.
+// Usage: box2d_benchmark [stepCount] [threadCount]
+//
+// With --json or --baseline it instead runs the regression suite: the testbed
+// performance scenes, an asteroid field and many bullets. It reports steps per second,
+// the phase times of b2Profile and the memory of each scene as JSON, and returns 1 if
+// any scene is slower than the baseline by more than the threshold percentage.
+// With --json - the JSON goes to stdout and the baseline comparison to stderr.
+// Usage: box2d_benchmark [stepCount] [threadCount] [--json file|-] [--baseline file] [--threshold percent]
+
+#include "box2d/box2d.h"
+#include "sajson/sajson.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Benchmark
+{
+	const char* name;
+	b2Vec2 gravity;
+	void (*create)(b2World* world);
+};
+
+struct SolverResult
+{
+	float step;
+	float drift;
+};
+
+struct BenchmarkResult
+{
+	float step;
+	float broadphase;
+	float collide;
+	int32 contactCount;
+};
+
+// Deterministic random numbers so every run builds the same scene.
+static uint32 s_seed;
+
+static float RandomFloat(float low, float high)
+{
+	s_seed = 1664525u * s_seed + 1013904223u;
+	float t = float(s_seed >> 8) / float(1 << 24);
+	return low + t * (high - low);
+}
+
+// Thousands of equal circles drifting to the right at slightly different speeds.
+// Proxies move steadily every step, which forces many tree reinsertions.
+static void CreateDrift(b2World* world)
+{
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+
+	b2FixtureDef fd;
+	fd.shape = &circle;
+	fd.density = 1.0f;
+	fd.friction = 0.2f;
+
+	const int32 rowCount = 60;
+	const int32 columnCount = 80;
+	for (int32 i = 0; i < rowCount; ++i)
+	{
+		for (int32 j = 0; j < columnCount; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(1.5f * j + RandomFloat(-0.2f, 0.2f), 1.5f * i + RandomFloat(-0.2f, 0.2f));
+			bd.linearVelocity.Set(RandomFloat(3.0f, 5.0f), RandomFloat(-0.5f, 0.5f));
+			bd.allowSleep = false;
+
+			b2Body* body = world->CreateBody(&bd);
+			body->CreateFixture(&fd);
+		}
+	}
+}
+
+// Equal boxes falling into a container and settling into a pile.
+static void CreatePile(b2World* world)
+{
+	{
+		b2BodyDef bd;
+		b2Body* ground = world->CreateBody(&bd);
+
+		b2PolygonShape box;
+		box.SetAsBox(40.0f, 1.0f, b2Vec2(0.0f, -1.0f), 0.0f);
+		ground->CreateFixture(&box, 0.0f);
+		box.SetAsBox(1.0f, 50.0f, b2Vec2(-41.0f, 50.0f), 0.0f);
+		ground->CreateFixture(&box, 0.0f);
+		box.SetAsBox(1.0f, 50.0f, b2Vec2(41.0f, 50.0f), 0.0f);
+		ground->CreateFixture(&box, 0.0f);
+	}
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2FixtureDef fd;
+	fd.shape = &box;
+	fd.density = 1.0f;
+	fd.friction = 0.6f;
+
+	const int32 rowCount = 40;
+	const int32 columnCount = 50;
+	for (int32 i = 0; i < rowCount; ++i)
+	{
+		for (int32 j = 0; j < columnCount; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-37.5f + 1.5f * j + RandomFloat(-0.1f, 0.1f), 2.0f + 1.5f * i);
+
+			b2Body* body = world->CreateBody(&bd);
+			body->CreateFixture(&fd);
+		}
+	}
+}
+
+// Sensor circles and boxes flying through each other, like bullets and asteroids
+// that only report overlaps. No contact reaches the solver.
+static void CreateSensors(b2World* world)
+{
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2FixtureDef fd;
+	fd.density = 1.0f;
+	fd.isSensor = true;
+
+	const int32 rowCount = 60;
+	const int32 columnCount = 80;
+	for (int32 i = 0; i < rowCount; ++i)
+	{
+		for (int32 j = 0; j < columnCount; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(1.2f * j + RandomFloat(-0.2f, 0.2f), 1.2f * i + RandomFloat(-0.2f, 0.2f));
+			bd.linearVelocity.Set(RandomFloat(-4.0f, 4.0f), RandomFloat(-4.0f, 4.0f));
+			bd.allowSleep = false;
+
+			b2Body* body = world->CreateBody(&bd);
+			fd.shape = (i + j) % 3 == 0 ? (const b2Shape*)&box : (const b2Shape*)&circle;
+			body->CreateFixture(&fd);
+		}
+	}
+}
+
+// The box pyramid used by the pyramid and tiles testbed scenes.
+static void CreateBoxPyramid(b2World* world)
+{
+	const int32 count = 20;
+
+	b2PolygonShape shape;
+	shape.SetAsBox(0.5f, 0.5f);
+
+	b2Vec2 x(-7.0f, 0.75f);
+	b2Vec2 deltaX(0.5625f, 1.25f);
+	b2Vec2 deltaY(1.125f, 0.0f);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Vec2 y = x;
+
+		for (int32 j = i; j < count; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position = y;
+
+			b2Body* body = world->CreateBody(&bd);
+			body->CreateFixture(&shape, 5.0f);
+			y += deltaY;
+		}
+
+		x += deltaX;
+	}
+}
+
+// Testbed pyramid: 210 boxes on an edge.
+static void CreatePyramid(b2World* world)
+{
+	b2BodyDef bd;
+	b2Body* ground = world->CreateBody(&bd);
+
+	b2EdgeShape shape;
+	shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&shape, 0.0f);
+
+	CreateBoxPyramid(world);
+}
+
+// Testbed tiles: the pyramid on a ground made of 2000 box tiles.
+static void CreateTiles(b2World* world)
+{
+	float a = 0.5f;
+	b2BodyDef bd;
+	bd.position.y = -a;
+	b2Body* ground = world->CreateBody(&bd);
+
+	const int32 N = 200;
+	const int32 M = 10;
+	b2Vec2 position;
+	position.y = 0.0f;
+	for (int32 j = 0; j < M; ++j)
+	{
+		position.x = -N * a;
+		for (int32 i = 0; i < N; ++i)
+		{
+			b2PolygonShape shape;
+			shape.SetAsBox(a, a, position, 0.0f);
+			ground->CreateFixture(&shape, 0.0f);
+			position.x += 2.0f * a;
+		}
+		position.y -= 2.0f * a;
+	}
+
+	CreateBoxPyramid(world);
+}
+
+// Testbed heavy2 with the heavy circle dropped on a stack of two light circles.
+static void CreateHeavy2(b2World* world)
+{
+	{
+		b2BodyDef bd;
+		b2Body* ground = world->CreateBody(&bd);
+
+		b2EdgeShape shape;
+		shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+		ground->CreateFixture(&shape, 0.0f);
+	}
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+
+	b2CircleShape shape;
+	shape.m_radius = 0.5f;
+
+	bd.position.Set(0.0f, 2.5f);
+	world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+
+	bd.position.Set(0.0f, 3.5f);
+	world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+
+	shape.m_radius = 5.0f;
+	bd.position.Set(0.0f, 9.0f);
+	world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+}
+
+// Testbed heavy1: a heavy circle resting on a light circle.
+static void CreateHeavy1(b2World* world)
+{
+	{
+		b2BodyDef bd;
+		b2Body* ground = world->CreateBody(&bd);
+
+		b2EdgeShape shape;
+		shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+		ground->CreateFixture(&shape, 0.0f);
+	}
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+
+	b2CircleShape shape;
+	shape.m_radius = 0.5f;
+
+	bd.position.Set(0.0f, 0.5f);
+	world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+
+	shape.m_radius = 5.0f;
+	bd.position.Set(0.0f, 6.0f);
+	world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+}
+
+// Testbed dominos: a row of dominos, a see-saw, a swinging box and a basket on joints.
+static void CreateDominos(b2World* world)
+{
+	b2Body* b1;
+	{
+		b2EdgeShape shape;
+		shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+
+		b2BodyDef bd;
+		b1 = world->CreateBody(&bd);
+		b1->CreateFixture(&shape, 0.0f);
+	}
+
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(6.0f, 0.25f);
+
+		b2BodyDef bd;
+		bd.position.Set(-1.5f, 10.0f);
+		world->CreateBody(&bd)->CreateFixture(&shape, 0.0f);
+	}
+
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(0.1f, 1.0f);
+
+		b2FixtureDef fd;
+		fd.shape = &shape;
+		fd.density = 20.0f;
+		fd.friction = 0.1f;
+
+		for (int32 i = 0; i < 10; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-6.0f + 1.0f * i, 11.25f);
+			world->CreateBody(&bd)->CreateFixture(&fd);
+		}
+	}
+
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(7.0f, 0.25f, b2Vec2_zero, 0.3f);
+
+		b2BodyDef bd;
+		bd.position.Set(1.0f, 6.0f);
+		world->CreateBody(&bd)->CreateFixture(&shape, 0.0f);
+	}
+
+	b2Body* b2;
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(0.25f, 1.5f);
+
+		b2BodyDef bd;
+		bd.position.Set(-7.0f, 4.0f);
+		b2 = world->CreateBody(&bd);
+		b2->CreateFixture(&shape, 0.0f);
+	}
+
+	b2Body* b3;
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(6.0f, 0.125f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-0.9f, 1.0f);
+		bd.angle = -0.15f;
+
+		b3 = world->CreateBody(&bd);
+		b3->CreateFixture(&shape, 10.0f);
+	}
+
+	b2RevoluteJointDef jd;
+	b2Vec2 anchor;
+
+	anchor.Set(-2.0f, 1.0f);
+	jd.Initialize(b1, b3, anchor);
+	jd.collideConnected = true;
+	world->CreateJoint(&jd);
+
+	b2Body* b4;
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(0.25f, 0.25f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-10.0f, 15.0f);
+		b4 = world->CreateBody(&bd);
+		b4->CreateFixture(&shape, 10.0f);
+	}
+
+	anchor.Set(-7.0f, 15.0f);
+	jd.Initialize(b2, b4, anchor);
+	world->CreateJoint(&jd);
+
+	b2Body* b5;
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(6.5f, 3.0f);
+		b5 = world->CreateBody(&bd);
+
+		b2PolygonShape shape;
+		b2FixtureDef fd;
+
+		fd.shape = &shape;
+		fd.density = 10.0f;
+		fd.friction = 0.1f;
+
+		shape.SetAsBox(1.0f, 0.1f, b2Vec2(0.0f, -0.9f), 0.0f);
+		b5->CreateFixture(&fd);
+
+		shape.SetAsBox(0.1f, 1.0f, b2Vec2(-0.9f, 0.0f), 0.0f);
+		b5->CreateFixture(&fd);
+
+		shape.SetAsBox(0.1f, 1.0f, b2Vec2(0.9f, 0.0f), 0.0f);
+		b5->CreateFixture(&fd);
+	}
+
+	anchor.Set(6.0f, 2.0f);
+	jd.Initialize(b1, b5, anchor);
+	world->CreateJoint(&jd);
+
+	b2Body* b6;
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(1.0f, 0.1f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(6.5f, 4.1f);
+		b6 = world->CreateBody(&bd);
+		b6->CreateFixture(&shape, 30.0f);
+	}
+
+	anchor.Set(7.5f, 4.0f);
+	jd.Initialize(b5, b6, anchor);
+	world->CreateJoint(&jd);
+
+	b2Body* b7;
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(0.1f, 1.0f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(7.4f, 1.0f);
+
+		b7 = world->CreateBody(&bd);
+		b7->CreateFixture(&shape, 10.0f);
+	}
+
+	b2DistanceJointDef djd;
+	djd.bodyA = b3;
+	djd.bodyB = b7;
+	djd.localAnchorA.Set(6.0f, 0.0f);
+	djd.localAnchorB.Set(0.0f, -1.0f);
+	b2Vec2 d = djd.bodyB->GetWorldPoint(djd.localAnchorB) - djd.bodyA->GetWorldPoint(djd.localAnchorA);
+	djd.length = d.Length();
+
+	b2LinearStiffness(djd.stiffness, djd.damping, 1.0f, 1.0f, djd.bodyA, djd.bodyB);
+	world->CreateJoint(&djd);
+
+	{
+		float radius = 0.2f;
+
+		b2CircleShape shape;
+		shape.m_radius = radius;
+
+		for (int32 i = 0; i < 4; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(5.9f + 2.0f * radius * i, 2.4f);
+			world->CreateBody(&bd)->CreateFixture(&shape, 10.0f);
+		}
+	}
+}
+
+// Rocks of many sizes and shapes tumbling through space without gravity. They collide
+// and bounce but never settle, so every body stays awake.
+static void CreateAsteroids(b2World* world)
+{
+	b2FixtureDef fd;
+	fd.density = 1.0f;
+	fd.friction = 0.3f;
+	fd.restitution = 0.4f;
+
+	const int32 rowCount = 50;
+	const int32 columnCount = 60;
+	for (int32 i = 0; i < rowCount; ++i)
+	{
+		for (int32 j = 0; j < columnCount; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(3.0f * j + RandomFloat(-0.5f, 0.5f), 3.0f * i + RandomFloat(-0.5f, 0.5f));
+			bd.angle = RandomFloat(-b2_pi, b2_pi);
+			bd.linearVelocity.Set(RandomFloat(-3.0f, 3.0f), RandomFloat(-3.0f, 3.0f));
+			bd.angularVelocity = RandomFloat(-1.0f, 1.0f);
+			b2Body* body = world->CreateBody(&bd);
+
+			float size = RandomFloat(0.3f, 1.2f);
+			if ((i + j) % 4 == 0)
+			{
+				b2CircleShape circle;
+				circle.m_radius = size;
+				fd.shape = &circle;
+				body->CreateFixture(&fd);
+				continue;
+			}
+
+			// A random convex polygon around the center.
+			b2Vec2 vertices[b2_maxPolygonVertices];
+			int32 count = 5 + (i + 2 * j) % (b2_maxPolygonVertices - 4);
+			for (int32 k = 0; k < count; ++k)
+			{
+				float angle = 2.0f * b2_pi * (k + RandomFloat(-0.3f, 0.3f)) / count;
+				float radius = size * RandomFloat(0.7f, 1.0f);
+				vertices[k].Set(radius * cosf(angle), radius * sinf(angle));
+			}
+
+			b2PolygonShape polygon;
+			polygon.Set(vertices, count);
+			fd.shape = &polygon;
+			body->CreateFixture(&fd);
+		}
+	}
+}
+
+// Hundreds of fast bullets fired into a closed box holding a field of small boxes.
+// Every bullet has TOI events against the walls and the boxes each step.
+static void CreateBullets(b2World* world)
+{
+	{
+		b2BodyDef bd;
+		b2Body* ground = world->CreateBody(&bd);
+
+		b2EdgeShape shape;
+		shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+		ground->CreateFixture(&shape, 0.0f);
+		shape.SetTwoSided(b2Vec2(-40.0f, 60.0f), b2Vec2(40.0f, 60.0f));
+		ground->CreateFixture(&shape, 0.0f);
+		shape.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(-40.0f, 60.0f));
+		ground->CreateFixture(&shape, 0.0f);
+		shape.SetTwoSided(b2Vec2(40.0f, 0.0f), b2Vec2(40.0f, 60.0f));
+		ground->CreateFixture(&shape, 0.0f);
+	}
+
+	b2PolygonShape box;
+	box.SetAsBox(0.25f, 0.25f);
+
+	for (int32 i = 0; i < 10; ++i)
+	{
+		for (int32 j = 0; j < 20; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(10.0f + 1.5f * i, 2.0f + 2.5f * j);
+			world->CreateBody(&bd)->CreateFixture(&box, 1.0f);
+		}
+	}
+
+	b2CircleShape circle;
+	circle.m_radius = 0.1f;
+
+	b2FixtureDef fd;
+	fd.shape = &circle;
+	fd.density = 5.0f;
+	fd.restitution = 0.5f;
+
+	for (int32 i = 0; i < 400; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.bullet = true;
+		bd.position.Set(RandomFloat(-38.0f, 0.0f), RandomFloat(1.0f, 59.0f));
+		bd.linearVelocity.Set(RandomFloat(200.0f, 400.0f), RandomFloat(-50.0f, 50.0f));
+		world->CreateBody(&bd)->CreateFixture(&fd);
+	}
+}
+
+struct TOIResult
+{
+	float step;
+	float solveTOI;
+	int32 escapedCount;
+};
+
+// Steps the bullet scene and counts the bullets that tunneled out of the box.
+static TOIResult RunTOIBenchmark(bool batched, int32 stepCount, b2ThreadPool* threadPool)
+{
+	s_seed = 12345;
+
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetThreadPool(threadPool);
+	world.SetBatchedTOI(batched);
+	CreateBullets(&world);
+
+	TOIResult result;
+	result.step = 0.0f;
+	result.solveTOI = 0.0f;
+	result.escapedCount = 0;
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		result.step += world.GetProfile().step;
+		result.solveTOI += world.GetProfile().solveTOI;
+	}
+
+	for (b2Body* b = world.GetBodyList(); b; b = b->GetNext())
+	{
+		b2Vec2 p = b->GetPosition();
+		if (b->GetType() == b2_dynamicBody && (p.x < -40.0f || 40.0f < p.x || p.y < 0.0f || 60.0f < p.y))
+		{
+			++result.escapedCount;
+		}
+	}
+
+	result.step /= float(stepCount);
+	result.solveTOI /= float(stepCount);
+
+	world.SetThreadPool(nullptr);
+	return result;
+}
+
+// Steps a stacking scene with sleep disabled. The drift is the mean distance moved by
+// the dynamic bodies over the second half of the run, which is zero for a resting stack.
+static SolverResult RunSolverBenchmark(const Benchmark& benchmark, bool softStep, int32 stepCount)
+{
+	b2World world(benchmark.gravity);
+	world.SetAllowSleeping(false);
+	world.SetSoftStep(softStep);
+	benchmark.create(&world);
+
+	int32 bodyCount = world.GetBodyCount();
+	b2Vec2* settled = (b2Vec2*)malloc(bodyCount * sizeof(b2Vec2));
+	const int32 settleStepCount = stepCount / 2;
+
+	SolverResult result;
+	result.step = 0.0f;
+	result.drift = 0.0f;
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		result.step += world.GetProfile().step;
+
+		if (i == settleStepCount)
+		{
+			int32 index = 0;
+			for (b2Body* b = world.GetBodyList(); b; b = b->GetNext())
+			{
+				settled[index++] = b->GetPosition();
+			}
+		}
+	}
+
+	int32 index = 0;
+	int32 dynamicCount = 0;
+	for (b2Body* b = world.GetBodyList(); b; b = b->GetNext(), ++index)
+	{
+		if (b->GetType() == b2_dynamicBody)
+		{
+			result.drift += b2Distance(b->GetPosition(), settled[index]);
+			++dynamicCount;
+		}
+	}
+
+	result.step /= float(stepCount);
+	result.drift /= float(b2Max(dynamicCount, 1));
+
+	free(settled);
+	return result;
+}
+
+// Steps a scene with the default or the wide narrow phase. Sleep is disabled so the
+// contacts are updated every step.
+static BenchmarkResult RunNarrowPhaseBenchmark(const Benchmark& benchmark, bool wide, int32 stepCount)
+{
+	s_seed = 12345;
+
+	b2World world(benchmark.gravity);
+	world.SetAllowSleeping(false);
+	world.SetWideNarrowPhase(wide);
+	benchmark.create(&world);
+
+	BenchmarkResult result;
+	result.step = 0.0f;
+	result.broadphase = 0.0f;
+	result.collide = 0.0f;
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		result.step += world.GetProfile().step;
+		result.broadphase += world.GetProfile().broadphase;
+		result.collide += world.GetProfile().collide;
+	}
+
+	result.step /= float(stepCount);
+	result.broadphase /= float(stepCount);
+	result.collide /= float(stepCount);
+	result.contactCount = world.GetContactCount();
+	return result;
+}
+
+// Counts the pairs reported by b2BroadPhase::UpdatePairs and the proxies found by the
+// tree queries and ray casts.
+struct TreeCounter
+{
+	void AddPair(void* userDataA, void* userDataB)
+	{
+		B2_NOT_USED(userDataA);
+		B2_NOT_USED(userDataB);
+		++count;
+	}
+
+	bool QueryCallback(int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++count;
+		return true;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++count;
+		return input.maxFraction;
+	}
+
+	int32 count;
+};
+
+struct TreeResult
+{
+	float nodeKB;
+	float compactKB;
+	float build;
+	float query;
+	float rayCast;
+	float updatePairs;
+	int32 count;
+};
+
+static b2AABB RandomTreeAABB(float extent)
+{
+	b2Vec2 c(RandomFloat(-extent, extent), RandomFloat(-extent, extent));
+	b2Vec2 h(RandomFloat(0.25f, 0.75f), RandomFloat(0.25f, 0.75f));
+
+	b2AABB aabb;
+	aabb.lowerBound = c - h;
+	aabb.upperBound = c + h;
+	return aabb;
+}
+
+// Times a tree of many proxies with the regular or the compact node layout. The query
+// and ray cast times are for a batch of queries on a static tree. The pair update time
+// is the average of UpdatePairs on a broad-phase after a fraction of the proxies moved,
+// including the rebuild of the compact layout.
+static TreeResult RunTreeBenchmark(int32 proxyCount, bool compact, float moveFraction, int32 roundCount)
+{
+	const float extent = 320.0f;
+	const int32 queryCount = 100000;
+	const int32 rayCount = 20000;
+
+	TreeResult result;
+
+	s_seed = 12345;
+	b2DynamicTree tree;
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		tree.CreateProxy(RandomTreeAABB(extent), nullptr);
+	}
+
+	tree.Rebuild();
+	tree.SetCompactMode(compact);
+
+	b2Timer timer;
+	tree.UpdateCompact();
+	result.build = timer.GetMilliseconds();
+	result.nodeKB = tree.GetNodeBytes() / 1024.0f;
+	result.compactKB = tree.GetCompactBytes() / 1024.0f;
+
+	TreeCounter counter;
+	counter.count = 0;
+
+	timer.Reset();
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		tree.Query(&counter, RandomTreeAABB(extent));
+	}
+	result.query = timer.GetMilliseconds();
+
+	timer.Reset();
+	for (int32 i = 0; i < rayCount; ++i)
+	{
+		b2RayCastInput input;
+		input.p1.Set(RandomFloat(-extent, extent), RandomFloat(-extent, extent));
+		input.p2 = input.p1 + b2Vec2(RandomFloat(-20.0f, 20.0f), RandomFloat(-20.0f, 20.0f));
+		input.maxFraction = 1.0f;
+		tree.RayCast(&counter, input);
+	}
+	result.rayCast = timer.GetMilliseconds();
+
+	s_seed = 12345;
+	b2BroadPhase broadPhase;
+	broadPhase.SetTreeCompactMode(compact);
+
+	b2AABB* aabbs = (b2AABB*)malloc(proxyCount * sizeof(b2AABB));
+	int32* proxyIds = (int32*)malloc(proxyCount * sizeof(int32));
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		aabbs[i] = RandomTreeAABB(extent);
+		proxyIds[i] = broadPhase.CreateProxy(aabbs[i], nullptr);
+	}
+
+	broadPhase.RebuildTree();
+	broadPhase.UpdatePairs(&counter);
+
+	int32 moveCount = int32(moveFraction * proxyCount);
+	result.updatePairs = 0.0f;
+	for (int32 round = 0; round < roundCount; ++round)
+	{
+		for (int32 i = 0; i < moveCount; ++i)
+		{
+			int32 index = int32(RandomFloat(0.0f, float(proxyCount - 1)));
+			b2Vec2 d(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+			aabbs[index].lowerBound += d;
+			aabbs[index].upperBound += d;
+			broadPhase.MoveProxy(proxyIds[index], aabbs[index], d);
+		}
+
+		timer.Reset();
+		broadPhase.UpdatePairs(&counter);
+		result.updatePairs += timer.GetMilliseconds();
+	}
+	result.updatePairs /= float(roundCount);
+	result.count = counter.count;
+
+	free(aabbs);
+	free(proxyIds);
+	return result;
+}
+
+struct SnapshotResult
+{
+	int32 bodyCount;
+	int32 contactCount;
+	int32 size;
+	float save;
+	float restore;
+};
+
+// Settles a scene, then times saving and restoring a snapshot of it as a rollback would.
+static SnapshotResult RunSnapshotBenchmark(const Benchmark& benchmark, int32 stepCount)
+{
+	s_seed = 12345;
+
+	b2World world(benchmark.gravity);
+	benchmark.create(&world);
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	SnapshotResult result;
+	result.bodyCount = world.GetBodyCount();
+	result.contactCount = world.GetContactCount();
+	result.size = world.SaveSnapshot(nullptr, 0);
+
+	void* buffer = malloc(result.size);
+	const int32 repeatCount = 100;
+
+	b2Timer timer;
+	for (int32 i = 0; i < repeatCount; ++i)
+	{
+		world.SaveSnapshot(buffer, result.size);
+	}
+	result.save = timer.GetMilliseconds() / float(repeatCount);
+
+	timer.Reset();
+	for (int32 i = 0; i < repeatCount; ++i)
+	{
+		world.RestoreSnapshot(buffer, result.size);
+	}
+	result.restore = timer.GetMilliseconds() / float(repeatCount);
+
+	free(buffer);
+	return result;
+}
+
+static BenchmarkResult RunBenchmark(const Benchmark& benchmark, b2BroadPhaseType type, int32 stepCount, b2ThreadPool* threadPool)
+{
+	s_seed = 12345;
+
+	// The cell size is about the size of the shapes including the AABB margin.
+	b2World world(benchmark.gravity, type, 1.5f);
+	world.SetThreadPool(threadPool);
+	benchmark.create(&world);
+
+	BenchmarkResult result;
+	result.step = 0.0f;
+	result.broadphase = 0.0f;
+	result.collide = 0.0f;
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		const b2Profile& profile = world.GetProfile();
+		result.step += profile.step;
+		result.broadphase += profile.broadphase;
+		result.collide += profile.collide;
+	}
+
+	result.step /= float(stepCount);
+	result.broadphase /= float(stepCount);
+	result.collide /= float(stepCount);
+	result.contactCount = world.GetContactCount();
+
+	world.SetThreadPool(nullptr);
+	return result;
+}
+
+struct SuiteResult
+{
+	const char* name;
+	int32 bodyCount;
+	int32 contactCount;
+	float stepsPerSecond;
+	float maxStep;
+	b2Profile average;
+	int32 heapBytes;
+	int32 blockBytes;
+	int32 stackBytes;
+};
+
+// Steps a scene of the regression suite. The phase times are averaged over the steps.
+// The memory is what the world holds at the end of the run.
+static SuiteResult RunSuiteBenchmark(const Benchmark& benchmark, int32 stepCount, b2ThreadPool* threadPool)
+{
+	s_seed = 12345;
+
+	int32 baseBytes = b2GetAllocStats().liveBytes;
+
+	b2World world(benchmark.gravity);
+	world.SetThreadPool(threadPool);
+	benchmark.create(&world);
+
+	SuiteResult result;
+	memset(&result, 0, sizeof(SuiteResult));
+	result.name = benchmark.name;
+
+	b2Profile& sum = result.average;
+
+	b2Timer timer;
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		const b2Profile& p = world.GetProfile();
+		result.maxStep = b2Max(result.maxStep, p.step);
+		sum.step += p.step;
+		sum.collide += p.collide;
+		sum.solve += p.solve;
+		sum.solveInit += p.solveInit;
+		sum.solveVelocity += p.solveVelocity;
+		sum.solvePosition += p.solvePosition;
+		sum.broadphase += p.broadphase;
+		sum.updatePairs += p.updatePairs;
+		sum.solveTOI += p.solveTOI;
+	}
+	float elapsed = timer.GetMilliseconds();
+
+	float scale = 1.0f / float(stepCount);
+	sum.step *= scale;
+	sum.collide *= scale;
+	sum.solve *= scale;
+	sum.solveInit *= scale;
+	sum.solveVelocity *= scale;
+	sum.solvePosition *= scale;
+	sum.broadphase *= scale;
+	sum.updatePairs *= scale;
+	sum.solveTOI *= scale;
+
+	result.stepsPerSecond = 1000.0f * stepCount / b2Max(elapsed, FLT_EPSILON);
+	result.bodyCount = world.GetBodyCount();
+	result.contactCount = world.GetContactCount();
+	result.heapBytes = b2GetAllocStats().liveBytes - baseBytes;
+	result.blockBytes = world.GetBlockAllocator().GetChunkBytes();
+	result.stackBytes = world.GetStackAllocator().GetCapacity();
+
+	world.SetThreadPool(nullptr);
+	return result;
+}
+
+static void WriteSuiteJSON(FILE* file, const SuiteResult* results, int32 count, int32 stepCount, int32 threadCount)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"stepCount\": %d,\n", stepCount);
+	fprintf(file, "\t\"threadCount\": %d,\n", threadCount);
+	fprintf(file, "\t\"scenes\": [\n");
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		const SuiteResult& r = results[i];
+		const b2Profile& p = r.average;
+		fprintf(file, "\t\t{\n");
+		fprintf(file, "\t\t\t\"name\": \"%s\",\n", r.name);
+		fprintf(file, "\t\t\t\"bodies\": %d,\n", r.bodyCount);
+		fprintf(file, "\t\t\t\"contacts\": %d,\n", r.contactCount);
+		fprintf(file, "\t\t\t\"stepsPerSecond\": %.1f,\n", r.stepsPerSecond);
+		fprintf(file, "\t\t\t\"stepMs\": %.4f,\n", p.step);
+		fprintf(file, "\t\t\t\"maxStepMs\": %.4f,\n", r.maxStep);
+		fprintf(file, "\t\t\t\"collideMs\": %.4f,\n", p.collide);
+		fprintf(file, "\t\t\t\"solveMs\": %.4f,\n", p.solve);
+		fprintf(file, "\t\t\t\"solveInitMs\": %.4f,\n", p.solveInit);
+		fprintf(file, "\t\t\t\"solveVelocityMs\": %.4f,\n", p.solveVelocity);
+		fprintf(file, "\t\t\t\"solvePositionMs\": %.4f,\n", p.solvePosition);
+		fprintf(file, "\t\t\t\"broadphaseMs\": %.4f,\n", p.broadphase);
+		fprintf(file, "\t\t\t\"updatePairsMs\": %.4f,\n", p.updatePairs);
+		fprintf(file, "\t\t\t\"solveTOIMs\": %.4f,\n", p.solveTOI);
+		fprintf(file, "\t\t\t\"heapBytes\": %d,\n", r.heapBytes);
+		fprintf(file, "\t\t\t\"blockBytes\": %d,\n", r.blockBytes);
+		fprintf(file, "\t\t\t\"stackBytes\": %d\n", r.stackBytes);
+		fprintf(file, "\t\t}%s\n", i + 1 < count ? "," : "");
+	}
+
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+}
+
+static bool ReadFile(const char* fileName, char** data, int32* size)
+{
+	FILE* file = fopen(fileName, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	*size = int32(ftell(file));
+	fseek(file, 0, SEEK_SET);
+
+	*data = (char*)malloc(*size + 1);
+	int32 readCount = int32(fread(*data, 1, *size, file));
+	fclose(file);
+
+	if (readCount != *size)
+	{
+		free(*data);
+		return false;
+	}
+
+	(*data)[*size] = 0;
+	return true;
+}
+
+// Compares the average step time of each scene with a baseline written by an earlier run
+// and prints the comparison to the report file.
+// Returns the number of scenes that got slower by more than the threshold percentage.
+static int32 CheckBaseline(FILE* report, const char* fileName, const SuiteResult* results, int32 count, float threshold)
+{
+	char* data = nullptr;
+	int32 size = 0;
+	if (ReadFile(fileName, &data, &size) == false)
+	{
+		fprintf(stderr, "cannot read baseline %s\n", fileName);
+		return count;
+	}
+
+	const sajson::document& document = sajson::parse(sajson::dynamic_allocation(), sajson::mutable_string_view(size, data));
+	if (document.is_valid() == false)
+	{
+		fprintf(stderr, "invalid baseline %s: %s\n", fileName, document.get_error_message_as_cstring());
+		free(data);
+		return count;
+	}
+
+	sajson::value scenes = document.get_root().get_value_of_key(sajson::literal("scenes"));
+	if (scenes.get_type() != sajson::TYPE_ARRAY)
+	{
+		fprintf(stderr, "baseline %s has no scenes\n", fileName);
+		free(data);
+		return count;
+	}
+
+	fprintf(report, "%-10s %10s %10s %8s\n", "scene", "base ms", "step ms", "change");
+
+	int32 regressionCount = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const SuiteResult& r = results[i];
+
+		float baseStep = -1.0f;
+		for (size_t j = 0; j < scenes.get_length(); ++j)
+		{
+			sajson::value scene = scenes.get_array_element(j);
+			sajson::value name = scene.get_value_of_key(sajson::literal("name"));
+			sajson::value step = scene.get_value_of_key(sajson::literal("stepMs"));
+			if (name.get_type() == sajson::TYPE_STRING && strcmp(name.as_cstring(), r.name) == 0 &&
+				(step.get_type() == sajson::TYPE_DOUBLE || step.get_type() == sajson::TYPE_INTEGER))
+			{
+				baseStep = float(step.get_number_value());
+				break;
+			}
+		}
+
+		if (baseStep <= 0.0f)
+		{
+			fprintf(report, "%-10s %10s %10.4f %8s\n", r.name, "-", r.average.step, "new");
+			continue;
+		}
+
+		float change = 100.0f * (r.average.step - baseStep) / baseStep;
+		bool regressed = change > threshold;
+		fprintf(report, "%-10s %10.4f %10.4f %+7.1f%%%s\n", r.name, baseStep, r.average.step, change, regressed ? "  REGRESSION" : "");
+		if (regressed)
+		{
+			++regressionCount;
+		}
+	}
+
+	free(data);
+	return regressionCount;
+}
+
+// The regression suite: the testbed performance scenes, an asteroid field and many bullets.
+// Writes the results as JSON and optionally fails against a baseline.
+static int RunSuite(int32 stepCount, int32 threadCount, b2ThreadPool* threadPool,
+	const char* jsonFileName, const char* baselineFileName, float threshold)
+{
+	const Benchmark suite[] =
+	{
+		{ "pyramid", b2Vec2(0.0f, -10.0f), CreatePyramid },
+		{ "tiles", b2Vec2(0.0f, -10.0f), CreateTiles },
+		{ "heavy1", b2Vec2(0.0f, -10.0f), CreateHeavy1 },
+		{ "heavy2", b2Vec2(0.0f, -10.0f), CreateHeavy2 },
+		{ "dominos", b2Vec2(0.0f, -10.0f), CreateDominos },
+		{ "asteroids", b2Vec2(0.0f, 0.0f), CreateAsteroids },
+		{ "bullets", b2Vec2(0.0f, -10.0f), CreateBullets },
+	};
+	const int32 sceneCount = sizeof(suite) / sizeof(suite[0]);
+
+	// Small scenes take microseconds per step and are noisy. They are run again until
+	// they stepped for a while, and the fastest run is kept.
+	const float minTime = 250.0f;
+	const int32 maxRunCount = 100;
+
+	SuiteResult results[sceneCount];
+	for (int32 i = 0; i < sceneCount; ++i)
+	{
+		SuiteResult best = RunSuiteBenchmark(suite[i], stepCount, threadPool);
+		float time = best.average.step * stepCount;
+		for (int32 j = 1; j < maxRunCount && time < minTime; ++j)
+		{
+			SuiteResult result = RunSuiteBenchmark(suite[i], stepCount, threadPool);
+			time += result.average.step * stepCount;
+			if (result.average.step < best.average.step)
+			{
+				best = result;
+			}
+		}
+
+		results[i] = best;
+	}
+
+	// Keep stdout clean for the JSON when it is written there.
+	bool jsonToStdout = jsonFileName != nullptr && strcmp(jsonFileName, "-") == 0;
+	FILE* report = jsonToStdout ? stderr : stdout;
+
+	if (jsonFileName != nullptr)
+	{
+		FILE* file = jsonToStdout ? stdout : fopen(jsonFileName, "w");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "cannot write %s\n", jsonFileName);
+			return 1;
+		}
+
+		WriteSuiteJSON(file, results, sceneCount, stepCount, threadCount);
+
+		if (file != stdout)
+		{
+			fclose(file);
+		}
+	}
+
+	if (baselineFileName != nullptr)
+	{
+		int32 regressionCount = CheckBaseline(report, baselineFileName, results, sceneCount, threshold);
+		if (regressionCount > 0)
+		{
+			fprintf(report, "%d scenes regressed by more than %g%%\n", regressionCount, threshold);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int32 stepCount = 300;
+	int32 threadCount = 1;
+	const char* jsonFileName = nullptr;
+	const char* baselineFileName = nullptr;
+	float threshold = 10.0f;
+
+	int32 positionalCount = 0;
+	for (int32 i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			jsonFileName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+		{
+			baselineFileName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+		{
+			threshold = float(atof(argv[++i]));
+		}
+		else if (positionalCount == 0)
+		{
+			stepCount = b2Max(atoi(argv[i]), 1);
+			++positionalCount;
+		}
+		else if (positionalCount == 1)
+		{
+			threadCount = b2Max(atoi(argv[i]), 1);
+			++positionalCount;
+		}
+	}
+
+	b2ThreadPool threadPool(threadCount);
+
+	if (jsonFileName != nullptr || baselineFileName != nullptr)
+	{
+		return RunSuite(stepCount, threadCount, threadCount > 1 ? &threadPool : nullptr,
+			jsonFileName, baselineFileName, threshold);
+	}
+
+	const Benchmark benchmarks[] =
+	{
+		{ "drift", b2Vec2(0.0f, 0.0f), CreateDrift },
+		{ "pile", b2Vec2(0.0f, -10.0f), CreatePile },
+		{ "sensors", b2Vec2(0.0f, 0.0f), CreateSensors },
+	};
+
+	const b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+	const char* typeNames[] = { "tree", "sort-and-sweep", "grid" };
+
+	printf("%d steps, %d threads\n", stepCount, threadCount);
+	printf("%-8s %-16s %10s %10s %10s %10s\n", "scene", "broad-phase", "step ms", "broad ms", "collide ms", "contacts");
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		for (int32 i = 0; i < 3; ++i)
+		{
+			BenchmarkResult result = RunBenchmark(benchmark, types[i], stepCount, threadCount > 1 ? &threadPool : nullptr);
+			printf("%-8s %-16s %10.3f %10.3f %10.3f %10d\n", benchmark.name, typeNames[i],
+				result.step, result.broadphase, result.collide, result.contactCount);
+		}
+	}
+
+	const Benchmark solverBenchmarks[] =
+	{
+		{ "pyramid", b2Vec2(0.0f, -10.0f), CreatePyramid },
+		{ "tiles", b2Vec2(0.0f, -10.0f), CreateTiles },
+		{ "heavy2", b2Vec2(0.0f, -10.0f), CreateHeavy2 },
+	};
+
+	printf("\n");
+	printf("%-8s %-16s %10s %10s\n", "scene", "solver", "step ms", "drift m");
+
+	for (const Benchmark& benchmark : solverBenchmarks)
+	{
+		SolverResult iterative = RunSolverBenchmark(benchmark, false, stepCount);
+		printf("%-8s %-16s %10.3f %10.4f\n", benchmark.name, "iterations 8/3", iterative.step, iterative.drift);
+
+		SolverResult soft = RunSolverBenchmark(benchmark, true, stepCount);
+		printf("%-8s %-16s %10.3f %10.4f\n", benchmark.name, "soft step", soft.step, soft.drift);
+	}
+
+	const Benchmark narrowPhaseBenchmarks[] =
+	{
+		{ "pile", b2Vec2(0.0f, -10.0f), CreatePile },
+		{ "pyramid", b2Vec2(0.0f, -10.0f), CreatePyramid },
+		{ "tiles", b2Vec2(0.0f, -10.0f), CreateTiles },
+	};
+
+	printf("\n");
+	printf("%-8s %-16s %10s %10s %10s\n", "scene", "narrow phase", "step ms", "collide ms", "contacts");
+
+	for (const Benchmark& benchmark : narrowPhaseBenchmarks)
+	{
+		for (int32 i = 0; i < 2; ++i)
+		{
+			bool wide = i == 1;
+			BenchmarkResult result = RunNarrowPhaseBenchmark(benchmark, wide, stepCount);
+			printf("%-8s %-16s %10.3f %10.3f %10d\n", benchmark.name, wide ? "wide" : "default",
+				result.step, result.collide, result.contactCount);
+		}
+	}
+
+	printf("\n");
+	printf("%-8s %-16s %10s %10s %10s\n", "scene", "continuous", "step ms", "TOI ms", "escaped");
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		bool batched = i == 1;
+		TOIResult result = RunTOIBenchmark(batched, stepCount, threadCount > 1 ? &threadPool : nullptr);
+		printf("%-8s %-16s %10.3f %10.3f %10d\n", "bullets", batched ? "batched" : "serial",
+			result.step, result.solveTOI, result.escapedCount);
+	}
+
+	printf("\n");
+	printf("%-8s %-16s %10s %10s %10s %10s %10s %10s %10s\n", "proxies", "tree nodes", "node KB", "compact KB",
+		"build ms", "query ms", "ray ms", "pairs 1%", "pairs 25%");
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		bool compact = i == 1;
+		TreeResult few = RunTreeBenchmark(100000, compact, 0.01f, 10);
+		TreeResult many = RunTreeBenchmark(100000, compact, 0.25f, 10);
+		printf("%-8d %-16s %10.1f %10.1f %10.3f %10.3f %10.3f %10.3f %10.3f\n", 100000, compact ? "compact" : "regular",
+			few.nodeKB, few.compactKB, few.build, few.query, few.rayCast, few.updatePairs, many.updatePairs);
+	}
+
+	printf("\n");
+	printf("%-8s %10s %10s %12s %10s %10s\n", "scene", "bodies", "contacts", "snapshot KB", "save ms", "restore ms");
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		SnapshotResult result = RunSnapshotBenchmark(benchmark, stepCount);
+		printf("%-8s %10d %10d %12.1f %10.3f %10.3f\n", benchmark.name, result.bodyCount, result.contactCount,
+			result.size / 1024.0f, result.save, result.restore);
+	}
+
+	return 0;
+}
@@ -31,8 +31,30 @@ const int32 b2_blockSizeCount = 14;
 struct b2Block;
 struct b2Chunk;
 
+/// Usage of one block size class.
+struct B2_API b2BlockStats
+{
+	/// The size of the blocks in this class.
+	int32 blockSize;
+
+	/// The number of blocks handed out and not yet freed.
+	int32 liveCount;
+
+	/// The largest live count seen.
+	int32 peakCount;
+
+	/// The number of chunks holding blocks of this size.
+	int32 chunkCount;
+
+	/// Bytes lost to rounding the live allocations up to the block size, plus the
+	/// tail of each chunk that does not fit a whole block.
+	int32 wastedBytes;
+};
+
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
+/// It is not thread safe. Contacts are created and destroyed on the thread that
+/// calls b2World::Step, worker threads only update them.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
 class B2_API b2BlockAllocator
 {
@@ -48,6 +70,18 @@ public:
 
 	void Clear();
 
+	/// Give the chunks that have no live blocks back to b2Free. Chunks are never
+	/// released otherwise, so call this after destroying many objects.
+	/// @return the number of bytes released.
+	int32 Trim();
+
+	/// Get the usage of a block size class.
+	/// @param index the size class, in [0, b2_blockSizeCount).
+	b2BlockStats GetStats(int32 index) const;
+
+	/// Get the total number of bytes held in chunks.
+	int32 GetChunkBytes() const;
+
 private:
 
 	b2Chunk* m_chunks;
@@ -55,6 +89,12 @@ private:
 	int32 m_chunkSpace;
 
 	b2Block* m_freeLists[b2_blockSizeCount];
+
+	// Per size class counters, see b2BlockStats.
+	int32 m_liveCounts[b2_blockSizeCount];
+	int32 m_peakCounts[b2_blockSizeCount];
+	int32 m_chunkCounts[b2_blockSizeCount];
+	int32 m_roundingBytes[b2_blockSizeCount];
 };
 
 #endif
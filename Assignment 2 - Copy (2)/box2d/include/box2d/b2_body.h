@@ -27,6 +27,7 @@
 #include "b2_math.h"
 #include "b2_shape.h"
 
+class b2Body;
 class b2Fixture;
 class b2Joint;
 class b2Contact;
@@ -36,6 +37,37 @@ struct b2FixtureDef;
 struct b2JointEdge;
 struct b2ContactEdge;
 
+/// Hot simulation state of every body in a world, stored as parallel arrays indexed
+/// by body slot. The world owns one of these and b2Body reads its state through it.
+/// Slots are dense: destroying a body moves the last body into its slot.
+/// This is an internal structure.
+struct B2_API b2BodyStates
+{
+	b2BodyStates();
+	~b2BodyStates();
+
+	/// Give the body a slot and return its index. The state is left uninitialized.
+	int32 Add(b2Body* body);
+
+	/// Release a slot. The body in the last slot is moved into it.
+	void Remove(int32 index);
+
+	/// Exchange the state of two slots and the bodies that own them.
+	void Swap(int32 indexA, int32 indexB);
+
+	b2Vec2* centers;
+	float* angles;
+	b2Vec2* linearVelocities;
+	float* angularVelocities;
+	b2Vec2* forces;
+	float* torques;
+	float* invMasses;
+	float* invInertias;
+	b2Body** bodies;
+	int32 count;
+	int32 capacity;
+};
+
 /// The body type.
 /// static: zero mass, zero velocity, may be manually moved
 /// kinematic: zero mass, non-zero velocity set by user, moved by solver
@@ -174,8 +206,9 @@ public:
 	/// @return the current world rotation angle in radians.
 	float GetAngle() const;
 
-	/// Get the world position of the center of mass.
-	const b2Vec2& GetWorldCenter() const;
+	/// Get the world position of the center of mass. Returned by value because the
+	/// state arrays move when bodies are created, destroyed or reordered.
+	b2Vec2 GetWorldCenter() const;
 
 	/// Get the local position of the center of mass.
 	const b2Vec2& GetLocalCenter() const;
@@ -185,8 +218,8 @@ public:
 	void SetLinearVelocity(const b2Vec2& v);
 
 	/// Get the linear velocity of the center of mass.
-	/// @return the linear velocity of the center of mass.
-	const b2Vec2& GetLinearVelocity() const;
+	/// @return the linear velocity of the center of mass, by value like GetWorldCenter.
+	b2Vec2 GetLinearVelocity() const;
 
 	/// Set the angular velocity.
 	/// @param omega the new angular velocity in radians/second.
@@ -388,10 +421,14 @@ public:
 private:
 
 	friend class b2World;
+	friend struct b2BodyStates;
 	friend class b2Island;
+	friend class b2IslandManager;
 	friend class b2ContactManager;
 	friend class b2ContactSolver;
+	friend class b2ConstraintGraph;
 	friend class b2Contact;
+	friend class b2ComputeTOITask;
 
 	friend class b2DistanceJoint;
 	friend class b2FrictionJoint;
@@ -423,26 +460,47 @@ private:
 	void SynchronizeFixtures();
 	void SynchronizeTransform();
 
+	// Put the body and its joints back into islands after the type or the enabled
+	// state changed. The contacts must be destroyed first.
+	void ResetIsland();
+
 	// This is used to prevent connected bodies from colliding.
 	// It may lie, depending on the collideConnected flag.
 	bool ShouldCollide(const b2Body* other) const;
 
 	void Advance(float t);
 
+	// The swept motion for CCD. The current center and angle live in m_states.
+	b2Sweep GetSweep() const;
+	void SetSweep(const b2Sweep& sweep);
+	void AdvanceSweep(float alpha);
+
+	float GetInverseMass() const;
+	float GetInverseInertia() const;
+
 	b2BodyType m_type;
 
 	uint16 m_flags;
 
+	// Unique within the world. Snapshots use it to tell bodies apart.
+	uint32 m_creationId;
+
 	int32 m_islandIndex;
 
-	b2Transform m_xf;		// the body origin transform
-	b2Sweep m_sweep;		// the swept motion for CCD
+	// Persistent island, see b2IslandManager.
+	int32 m_islandId;
+	b2Body* m_islandPrev;
+	b2Body* m_islandNext;
 
-	b2Vec2 m_linearVelocity;
-	float m_angularVelocity;
+	// Slot of this body in m_states. This changes when other bodies are destroyed.
+	int32 m_stateIndex;
+	b2BodyStates* m_states;
 
-	b2Vec2 m_force;
-	float m_torque;
+	b2Transform m_xf;		// the body origin transform
+	b2Vec2 m_localCenter;	// center of mass in body coordinates
+	b2Vec2 m_center0;		// center of mass at the start of the CCD sweep
+	float m_angle0;			// angle at the start of the CCD sweep
+	float m_alpha0;			// fraction of the current time step in the range [0,1]
 
 	b2World* m_world;
 	b2Body* m_prev;
@@ -454,10 +512,10 @@ private:
 	b2JointEdge* m_jointList;
 	b2ContactEdge* m_contactList;
 
-	float m_mass, m_invMass;
+	float m_mass;
 
 	// Rotational inertia about the center of mass.
-	float m_I, m_invI;
+	float m_I;
 
 	float m_linearDamping;
 	float m_angularDamping;
@@ -485,17 +543,17 @@ inline const b2Vec2& b2Body::GetPosition() const
 
 inline float b2Body::GetAngle() const
 {
-	return m_sweep.a;
+	return m_states->angles[m_stateIndex];
 }
 
-inline const b2Vec2& b2Body::GetWorldCenter() const
+inline b2Vec2 b2Body::GetWorldCenter() const
 {
-	return m_sweep.c;
+	return m_states->centers[m_stateIndex];
 }
 
 inline const b2Vec2& b2Body::GetLocalCenter() const
 {
-	return m_sweep.localCenter;
+	return m_localCenter;
 }
 
 inline void b2Body::SetLinearVelocity(const b2Vec2& v)
@@ -510,12 +568,12 @@ inline void b2Body::SetLinearVelocity(const b2Vec2& v)
 		SetAwake(true);
 	}
 
-	m_linearVelocity = v;
+	m_states->linearVelocities[m_stateIndex] = v;
 }
 
-inline const b2Vec2& b2Body::GetLinearVelocity() const
+inline b2Vec2 b2Body::GetLinearVelocity() const
 {
-	return m_linearVelocity;
+	return m_states->linearVelocities[m_stateIndex];
 }
 
 inline void b2Body::SetAngularVelocity(float w)
@@ -530,12 +588,12 @@ inline void b2Body::SetAngularVelocity(float w)
 		SetAwake(true);
 	}
 
-	m_angularVelocity = w;
+	m_states->angularVelocities[m_stateIndex] = w;
 }
 
 inline float b2Body::GetAngularVelocity() const
 {
-	return m_angularVelocity;
+	return m_states->angularVelocities[m_stateIndex];
 }
 
 inline float b2Body::GetMass() const
@@ -545,14 +603,14 @@ inline float b2Body::GetMass() const
 
 inline float b2Body::GetInertia() const
 {
-	return m_I + m_mass * b2Dot(m_sweep.localCenter, m_sweep.localCenter);
+	return m_I + m_mass * b2Dot(m_localCenter, m_localCenter);
 }
 
 inline void b2Body::GetMassData(b2MassData* data) const
 {
 	data->mass = m_mass;
-	data->I = m_I + m_mass * b2Dot(m_sweep.localCenter, m_sweep.localCenter);
-	data->center = m_sweep.localCenter;
+	data->I = m_I + m_mass * b2Dot(m_localCenter, m_localCenter);
+	data->center = m_localCenter;
 }
 
 inline b2Vec2 b2Body::GetWorldPoint(const b2Vec2& localPoint) const
@@ -577,7 +635,9 @@ inline b2Vec2 b2Body::GetLocalVector(const b2Vec2& worldVector) const
 
 inline b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
 {
-	return m_linearVelocity + b2Cross(m_angularVelocity, worldPoint - m_sweep.c);
+	const b2BodyStates* s = m_states;
+	int32 i = m_stateIndex;
+	return s->linearVelocities[i] + b2Cross(s->angularVelocities[i], worldPoint - s->centers[i]);
 }
 
 inline b2Vec2 b2Body::GetLinearVelocityFromLocalPoint(const b2Vec2& localPoint) const
@@ -632,29 +692,6 @@ inline bool b2Body::IsBullet() const
 	return (m_flags & e_bulletFlag) == e_bulletFlag;
 }
 
-inline void b2Body::SetAwake(bool flag)
-{
-	if (m_type == b2_staticBody)
-	{
-		return;
-	}
-
-	if (flag)
-	{
-		m_flags |= e_awakeFlag;
-		m_sleepTime = 0.0f;
-	}
-	else
-	{
-		m_flags &= ~e_awakeFlag;
-		m_sleepTime = 0.0f;
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
-		m_force.SetZero();
-		m_torque = 0.0f;
-	}
-}
-
 inline bool b2Body::IsAwake() const
 {
 	return (m_flags & e_awakeFlag) == e_awakeFlag;
@@ -748,8 +785,8 @@ inline void b2Body::ApplyForce(const b2Vec2& force, const b2Vec2& point, bool wa
 	// Don't accumulate a force if the body is sleeping.
 	if (m_flags & e_awakeFlag)
 	{
-		m_force += force;
-		m_torque += b2Cross(point - m_sweep.c, force);
+		m_states->forces[m_stateIndex] += force;
+		m_states->torques[m_stateIndex] += b2Cross(point - m_states->centers[m_stateIndex], force);
 	}
 }
 
@@ -768,7 +805,7 @@ inline void b2Body::ApplyForceToCenter(const b2Vec2& force, bool wake)
 	// Don't accumulate a force if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_force += force;
+		m_states->forces[m_stateIndex] += force;
 	}
 }
 
@@ -787,7 +824,7 @@ inline void b2Body::ApplyTorque(float torque, bool wake)
 	// Don't accumulate a force if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_torque += torque;
+		m_states->torques[m_stateIndex] += torque;
 	}
 }
 
@@ -806,8 +843,10 @@ inline void b2Body::ApplyLinearImpulse(const b2Vec2& impulse, const b2Vec2& poin
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_linearVelocity += m_invMass * impulse;
-		m_angularVelocity += m_invI * b2Cross(point - m_sweep.c, impulse);
+		b2BodyStates* s = m_states;
+		int32 i = m_stateIndex;
+		s->linearVelocities[i] += s->invMasses[i] * impulse;
+		s->angularVelocities[i] += s->invInertias[i] * b2Cross(point - s->centers[i], impulse);
 	}
 }
 
@@ -826,7 +865,7 @@ inline void b2Body::ApplyLinearImpulseToCenter(const b2Vec2& impulse, bool wake)
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_linearVelocity += m_invMass * impulse;
+		m_states->linearVelocities[m_stateIndex] += m_states->invMasses[m_stateIndex] * impulse;
 	}
 }
 
@@ -845,24 +884,65 @@ inline void b2Body::ApplyAngularImpulse(float impulse, bool wake)
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_angularVelocity += m_invI * impulse;
+		m_states->angularVelocities[m_stateIndex] += m_states->invInertias[m_stateIndex] * impulse;
 	}
 }
 
 inline void b2Body::SynchronizeTransform()
 {
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	m_xf.q.Set(m_states->angles[m_stateIndex]);
+	m_xf.p = m_states->centers[m_stateIndex] - b2Mul(m_xf.q, m_localCenter);
 }
 
 inline void b2Body::Advance(float alpha)
 {
 	// Advance to the new safe time. This doesn't sync the broad-phase.
-	m_sweep.Advance(alpha);
-	m_sweep.c = m_sweep.c0;
-	m_sweep.a = m_sweep.a0;
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	AdvanceSweep(alpha);
+	m_states->centers[m_stateIndex] = m_center0;
+	m_states->angles[m_stateIndex] = m_angle0;
+	m_xf.q.Set(m_angle0);
+	m_xf.p = m_center0 - b2Mul(m_xf.q, m_localCenter);
+}
+
+inline float b2Body::GetInverseMass() const
+{
+	return m_states->invMasses[m_stateIndex];
+}
+
+inline float b2Body::GetInverseInertia() const
+{
+	return m_states->invInertias[m_stateIndex];
+}
+
+inline b2Sweep b2Body::GetSweep() const
+{
+	b2Sweep sweep;
+	sweep.localCenter = m_localCenter;
+	sweep.c0 = m_center0;
+	sweep.c = m_states->centers[m_stateIndex];
+	sweep.a0 = m_angle0;
+	sweep.a = m_states->angles[m_stateIndex];
+	sweep.alpha0 = m_alpha0;
+	return sweep;
+}
+
+inline void b2Body::SetSweep(const b2Sweep& sweep)
+{
+	m_localCenter = sweep.localCenter;
+	m_center0 = sweep.c0;
+	m_states->centers[m_stateIndex] = sweep.c;
+	m_angle0 = sweep.a0;
+	m_states->angles[m_stateIndex] = sweep.a;
+	m_alpha0 = sweep.alpha0;
+}
+
+inline void b2Body::AdvanceSweep(float alpha)
+{
+	b2Sweep sweep = GetSweep();
+	sweep.Advance(alpha);
+	m_center0 = sweep.c0;
+	m_angle0 = sweep.a0;
+	m_alpha0 = sweep.alpha0;
 }
 
 inline b2World* b2Body::GetWorld()
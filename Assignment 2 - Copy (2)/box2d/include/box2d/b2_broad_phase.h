@@ -27,6 +27,12 @@
 #include "b2_settings.h"
 #include "b2_collision.h"
 #include "b2_dynamic_tree.h"
+#include "b2_sort_and_sweep.h"
+#include "b2_uniform_grid.h"
+
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
+struct b2ThreadPairBuffer;
 
 struct B2_API b2Pair
 {
@@ -34,6 +40,21 @@ struct B2_API b2Pair
 	int32 proxyIdB;
 };
 
+/// The data structure used by the broad-phase.
+enum b2BroadPhaseType
+{
+	/// A dynamic AABB tree. Good for most scenes.
+	b2_treeBroadPhase = 0,
+
+	/// Incremental sort-and-sweep on the x-axis. Good for many similar sized
+	/// proxies moving steadily.
+	b2_sortAndSweepBroadPhase,
+
+	/// A hashed uniform grid. Good for many similar sized proxies when the cell
+	/// size matches the proxy size.
+	b2_gridBroadPhase
+};
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
@@ -49,6 +70,12 @@ public:
 	b2BroadPhase();
 	~b2BroadPhase();
 
+	/// Select the data structure. This must be called before any proxy is created.
+	/// @param type the data structure
+	/// @param gridCellSize the cell size used by b2_gridBroadPhase
+	void SetType(b2BroadPhaseType type, float gridCellSize = b2_gridCellSize);
+	b2BroadPhaseType GetType() const { return m_type; }
+
 	/// Create a proxy with an initial AABB. Pairs are not reported until
 	/// UpdatePairs is called.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
@@ -69,21 +96,40 @@ public:
 	/// Get user data from a proxy. Returns nullptr if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
 
+	/// Set the user data of a proxy. A restored snapshot does not keep the user data,
+	/// so the owner relinks every proxy.
+	void SetUserData(int32 proxyId, void* userData);
+
 	/// Test overlap of fat AABBs.
 	bool TestOverlap(int32 proxyIdA, int32 proxyIdB) const;
 
 	/// Get the number of proxies.
 	int32 GetProxyCount() const;
 
+	/// Get the number of proxies moved since the last call to UpdatePairs.
+	int32 GetMoveCount() const;
+
 	/// Update the pairs. This results in pair callbacks. This can only add pairs.
+	/// @param threadPool optional pool used to query the moved proxies in parallel.
+	/// The pairs are reported in the same order with or without the pool.
 	template <typename T>
-	void UpdatePairs(T* callback);
+	void UpdatePairs(T* callback, b2ThreadPool* threadPool = nullptr);
 
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query many AABBs at once. See b2DynamicTree::QueryBatch. Only the tree
+	/// uses SIMD and threads, the other types run the queries one by one.
+	int32 QueryBatch(const b2AABB* aabbs, int32 count, b2TreeQueryHit* hits, int32 hitCapacity,
+					 b2ThreadPool* threadPool = nullptr) const;
+
+	/// Ray-cast many rays at once. See b2DynamicTree::RayCastBatch. Only the tree
+	/// uses SIMD and threads, the other types cast the rays one by one.
+	void RayCastBatch(b2TreeRayCastBatchCallback* callback, const b2RayCastInput* inputs, int32 count,
+					  b2ThreadPool* threadPool = nullptr) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -94,30 +140,66 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
-	/// Get the height of the embedded tree.
+	/// Get the height of the embedded tree. Zero for the other types.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the balance of the embedded tree. Zero for the other types.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the quality metric of the embedded tree. Zero for the other types.
 	float GetTreeQuality() const;
 
+	/// Rebuild the embedded tree. See b2DynamicTree::Rebuild. Only used by b2_treeBroadPhase.
+	void RebuildTree(b2TreeQuality* before = nullptr, b2TreeQuality* after = nullptr) { m_tree.Rebuild(before, after); }
+
+	/// Enable/disable refit mode of the embedded tree. See b2DynamicTree::SetRefitMode.
+	void SetTreeRefitMode(bool flag) { m_tree.SetRefitMode(flag); }
+	bool GetTreeRefitMode() const { return m_tree.GetRefitMode(); }
+
+	/// Enable/disable the compact layout of the embedded tree. See b2DynamicTree::SetCompactMode.
+	/// UpdatePairs rebuilds the layout before querying the moved proxies when enough of
+	/// them moved, see b2_compactTreeMoveRatio.
+	void SetTreeCompactMode(bool flag) { m_tree.SetCompactMode(flag); }
+	bool GetTreeCompactMode() const { return m_tree.GetCompactMode(); }
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Write the broad-phase to a world snapshot, see b2World::SaveSnapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Restore the broad-phase from a world snapshot.
+	void Restore(b2SnapshotReader* reader);
+
+	/// Read past the broad-phase in a world snapshot without changing anything and check
+	/// that the indices are in range. Returns the range of the saved proxy ids.
+	int32 Check(b2SnapshotReader* reader) const;
+
 private:
 
 	friend class b2DynamicTree;
+	friend class b2SortAndSweep;
+	friend class b2UniformGrid;
+	friend struct b2PairQueryCallback;
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
 
 	bool QueryCallback(int32 proxyId);
+	void PairCallback(int32 proxyIdA, int32 proxyIdB);
+	void FindPairsParallel(b2ThreadPool* threadPool);
+	void SortPairs();
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	b2BroadPhaseType m_type;
 
 	b2DynamicTree m_tree;
+	b2SortAndSweep m_sortAndSweep;
+	b2UniformGrid m_grid;
 
 	int32 m_proxyCount;
 
@@ -130,23 +212,88 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+
+	// Per thread pair buffers used by FindPairsParallel
+	b2ThreadPairBuffer* m_threadPairBuffers;
+	int32 m_threadPairBufferCount;
 };
 
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		return m_sortAndSweep.GetUserData(proxyId);
+	case b2_gridBroadPhase:
+		return m_grid.GetUserData(proxyId);
+	default:
+		return m_tree.GetUserData(proxyId);
+	}
+}
+
+inline void b2BroadPhase::SetUserData(int32 proxyId, void* userData)
+{
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.SetUserData(proxyId, userData);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.SetUserData(proxyId, userData);
+		break;
+	default:
+		m_tree.SetUserData(proxyId, userData);
+		break;
+	}
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		return m_sortAndSweep.GetFatAABB(proxyId);
+	case b2_gridBroadPhase:
+		return m_grid.GetFatAABB(proxyId);
+	default:
+		return m_tree.GetFatAABB(proxyId);
+	}
+}
+
+inline bool b2BroadPhase::WasMoved(int32 proxyId) const
+{
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		return m_sortAndSweep.WasMoved(proxyId);
+	case b2_gridBroadPhase:
+		return m_grid.WasMoved(proxyId);
+	default:
+		return m_tree.WasMoved(proxyId);
+	}
+}
+
+inline void b2BroadPhase::ClearMoved(int32 proxyId)
+{
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.ClearMoved(proxyId);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.ClearMoved(proxyId);
+		break;
+	default:
+		m_tree.ClearMoved(proxyId);
+		break;
+	}
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -154,50 +301,89 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline int32 b2BroadPhase::GetMoveCount() const
+{
+	return m_moveCount;
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
-	return m_tree.GetHeight();
+	return m_type == b2_treeBroadPhase ? m_tree.GetHeight() : 0;
 }
 
 inline int32 b2BroadPhase::GetTreeBalance() const
 {
-	return m_tree.GetMaxBalance();
+	return m_type == b2_treeBroadPhase ? m_tree.GetMaxBalance() : 0;
 }
 
 inline float b2BroadPhase::GetTreeQuality() const
 {
-	return m_tree.GetAreaRatio();
+	return m_type == b2_treeBroadPhase ? m_tree.GetAreaRatio() : 0.0f;
 }
 
 template <typename T>
-void b2BroadPhase::UpdatePairs(T* callback)
+void b2BroadPhase::UpdatePairs(T* callback, b2ThreadPool* threadPool)
 {
 	// Reset pair buffer
 	m_pairCount = 0;
 
-	// Perform tree queries for all moving proxies.
-	for (int32 i = 0; i < m_moveCount; ++i)
+	if (m_type == b2_treeBroadPhase && m_moveCount > 0 && m_moveCount * b2_compactTreeMoveRatio >= m_proxyCount)
+	{
+		// Bring the compact layout up to date before the queries.
+		m_tree.UpdateCompact();
+	}
+
+	if (m_type == b2_sortAndSweepBroadPhase)
 	{
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == e_nullProxy)
+		if (m_moveCount > 0)
 		{
-			continue;
+			// Touched proxies are treated as moved. One sweep finds all the pairs.
+			for (int32 i = 0; i < m_moveCount; ++i)
+			{
+				if (m_moveBuffer[i] != e_nullProxy)
+				{
+					m_sortAndSweep.MarkMoved(m_moveBuffer[i]);
+				}
+			}
+
+			m_sortAndSweep.FindPairs(this);
+		}
+	}
+	else if (threadPool != nullptr && m_moveCount >= b2_parallelPairThreshold)
+	{
+		FindPairsParallel(threadPool);
+	}
+	else
+	{
+		// Perform queries for all moving proxies.
+		for (int32 i = 0; i < m_moveCount; ++i)
+		{
+			m_queryProxyId = m_moveBuffer[i];
+			if (m_queryProxyId == e_nullProxy)
+			{
+				continue;
+			}
+
+			// We have to query the tree with the fat AABB so that
+			// we don't fail to create a pair that may touch later.
+			const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
+
+			// Query tree, create pairs and add them pair buffer.
+			Query(this, fatAABB);
 		}
-
-		// We have to query the tree with the fat AABB so that
-		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
-
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
 	}
 
+#if defined(B2_DETERMINISTIC)
+	// Create the contacts in an order that does not depend on the broad-phase structure.
+	SortPairs();
+#endif
+
 	// Send pairs to caller
 	for (int32 i = 0; i < m_pairCount; ++i)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 	}
@@ -211,7 +397,7 @@ void b2BroadPhase::UpdatePairs(T* callback)
 			continue;
 		}
 
-		m_tree.ClearMoved(proxyId);
+		ClearMoved(proxyId);
 	}
 
 	// Reset move buffer
@@ -221,18 +407,51 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.Query(callback, aabb);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.Query(callback, aabb);
+		break;
+	default:
+		m_tree.Query(callback, aabb);
+		break;
+	}
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.RayCast(callback, input);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.RayCast(callback, input);
+		break;
+	default:
+		m_tree.RayCast(callback, input);
+		break;
+	}
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
-	m_tree.ShiftOrigin(newOrigin);
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.ShiftOrigin(newOrigin);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.ShiftOrigin(newOrigin);
+		break;
+	default:
+		m_tree.ShiftOrigin(newOrigin);
+		break;
+	}
 }
 
 #endif
@@ -36,6 +36,7 @@ class b2Shape;
 class b2CircleShape;
 class b2EdgeShape;
 class b2PolygonShape;
+struct b2SimplexCache;
 
 const uint8 b2_nullFeature = UCHAR_MAX;
 
@@ -255,6 +256,14 @@ B2_API bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB);
 
+/// Determine if two generic shapes overlap, warm starting GJK from a simplex cache.
+/// Keep one cache per pair of shapes across calls, so repeated tests of a slowly moving
+/// pair take one or two GJK iterations. Set the cache count to zero before the first call.
+B2_API bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
+					const b2Shape* shapeB, int32 indexB,
+					const b2Transform& xfA, const b2Transform& xfB,
+					b2SimplexCache* cache);
+
 // ---------------- Inline Functions ------------------------------------------
 
 inline bool b2AABB::IsValid() const
@@ -280,4 +289,64 @@ inline bool b2TestOverlap(const b2AABB& a, const b2AABB& b)
 	return true;
 }
 
+/// Build the fat AABB the broad-phase stores for a proxy. The margin and the predicted
+/// displacement let the proxy move a little before the broad-phase needs an update.
+inline b2AABB b2MakeFatAABB(const b2AABB& aabb, const b2Vec2& displacement)
+{
+	// Extend AABB
+	b2AABB fatAABB;
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	fatAABB.lowerBound = aabb.lowerBound - r;
+	fatAABB.upperBound = aabb.upperBound + r;
+
+	// Predict AABB movement
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		fatAABB.lowerBound.x += d.x;
+	}
+	else
+	{
+		fatAABB.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		fatAABB.lowerBound.y += d.y;
+	}
+	else
+	{
+		fatAABB.upperBound.y += d.y;
+	}
+
+	return fatAABB;
+}
+
+/// Does a stored fat AABB need to be replaced by a new one? This is true when it
+/// no longer contains the object or when it is much larger than the new fat AABB.
+inline bool b2FatAABBNeedsUpdate(const b2AABB& storedAABB, const b2AABB& aabb, const b2AABB& fatAABB)
+{
+	if (storedAABB.Contains(aabb))
+	{
+		// The stored AABB still contains the object, but it might be too large.
+		// Perhaps the object was moving fast but has since gone to sleep.
+		// The huge AABB is larger than the new fat AABB.
+		b2Vec2 r(4.0f * b2_aabbExtension, 4.0f * b2_aabbExtension);
+		b2AABB hugeAABB;
+		hugeAABB.lowerBound = fatAABB.lowerBound - r;
+		hugeAABB.upperBound = fatAABB.upperBound + r;
+
+		if (hugeAABB.Contains(storedAABB))
+		{
+			// The stored AABB contains the object AABB and is not too large.
+			return false;
+		}
+
+		// Otherwise the stored AABB is huge and needs to be shrunk
+	}
+
+	return true;
+}
+
 #endif
@@ -60,6 +60,27 @@
 /// This is a dimensionless multiplier.
 #define b2_aabbMultiplier		4.0f
 
+/// The broad-phase queries the moved proxies on the thread pool when at least
+/// this many proxies moved in a step.
+#define b2_parallelPairThreshold	256
+
+/// In compact mode the broad-phase rebuilds the compact tree layout when at least one in
+/// this many proxies moved in a step. Below that the rebuild costs more than it saves
+/// and the moved proxies query the regular nodes.
+#define b2_compactTreeMoveRatio		8
+
+/// Sort-and-sweep broad-phase proxies wider than this multiple of the average
+/// proxy width are kept in a side list that every query tests.
+#define b2_sweepLargeProxyScale	8.0f
+
+/// The default cell size of the uniform grid broad-phase. A cell should be
+/// about the size of a typical shape. This is in meters.
+#define b2_gridCellSize			(1.0f * b2_lengthUnitsPerMeter)
+
+/// Uniform grid broad-phase proxies that cover more cells than this are kept in
+/// a side list that every query tests.
+#define b2_gridMaxProxyCells	64
+
 /// A small length used as a collision and constraint tolerance. Usually it is
 /// chosen to be numerically significant, but visually insignificant. In meters.
 #define b2_linearSlop			(0.005f * b2_lengthUnitsPerMeter)
@@ -106,6 +127,31 @@
 #define b2_baumgarte				0.2f
 #define b2_toiBaumgarte				0.75f
 
+/// The number of colors used to solve a large island in parallel. Constraints that
+/// do not fit in a color are solved on one thread.
+#define b2_graphColorCount			12
+
+/// Islands with at least this many contacts and joints are graph colored when
+/// graph coloring is enabled on the world.
+#define b2_graphColorThreshold		256
+
+/// The default number of sub-steps of the soft step solver.
+#define b2_softStepCount			4
+
+/// The stiffness of contacts in the soft step solver, in cycles per second. It is
+/// reduced to a quarter of the sub-step rate if that is lower.
+#define b2_contactHertz				30.0f
+
+/// The damping ratio of contacts in the soft step solver. Contacts are over-damped so
+/// they do not bounce.
+#define b2_contactDampingRatio		10.0f
+
+/// The maximum speed at which the soft step solver pushes overlapping bodies apart.
+#define b2_contactPushVelocity		(3.0f * b2_lengthUnitsPerMeter)
+
+/// The default approach speed above which contacts record hit events, in meters per second.
+#define b2_hitEventThreshold		(1.0f * b2_lengthUnitsPerMeter)
+
 
 // Sleep
 
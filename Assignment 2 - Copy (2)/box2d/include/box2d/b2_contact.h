@@ -25,6 +25,7 @@
 
 #include "b2_api.h"
 #include "b2_collision.h"
+#include "b2_distance.h"
 #include "b2_fixture.h"
 #include "b2_math.h"
 #include "b2_shape.h"
@@ -167,10 +168,13 @@ public:
 
 protected:
 	friend class b2ContactManager;
+	friend class b2UpdateContactsTask;
+	friend class b2ComputeTOITask;
 	friend class b2World;
 	friend class b2ContactSolver;
 	friend class b2Body;
 	friend class b2Fixture;
+	friend class b2IslandManager;
 
 	// Flags stored in m_flags
 	enum
@@ -194,6 +198,15 @@ protected:
 		e_toiFlag			= 0x0020
 	};
 
+	// Side effects of UpdateManifold, applied by ReportEvents
+	enum
+	{
+		e_wakeEvent			= 0x0001,
+		e_beginTouchEvent	= 0x0002,
+		e_endTouchEvent		= 0x0004,
+		e_preSolveEvent		= 0x0008
+	};
+
 	/// Flag this contact for filtering. Filtering will occur the next time step.
 	void FlagForFiltering();
 
@@ -208,7 +221,10 @@ protected:
 	b2Contact(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB);
 	virtual ~b2Contact() {}
 
-	void Update(b2ContactListener* listener);
+	// A non-null manifold is the new manifold, already evaluated at the current transforms.
+	void Update(b2ContactListener* listener, const b2Manifold* manifold = nullptr);
+	uint32 UpdateManifold(b2Manifold* oldManifold, const b2Manifold* manifold = nullptr);
+	void ReportEvents(uint32 events, const b2Manifold* oldManifold, b2ContactListener* listener);
 
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
@@ -223,6 +239,11 @@ protected:
 	b2ContactEdge m_nodeA;
 	b2ContactEdge m_nodeB;
 
+	// Persistent island, see b2IslandManager. Only solid touching contacts are linked.
+	int32 m_islandId;
+	b2Contact* m_islandPrev;
+	b2Contact* m_islandNext;
+
 	b2Fixture* m_fixtureA;
 	b2Fixture* m_fixtureB;
 
@@ -231,6 +252,9 @@ protected:
 
 	b2Manifold m_manifold;
 
+	// Warm starts the sensor overlap test from the simplex of the previous step.
+	b2SimplexCache m_simplexCache;
+
 	int32 m_toiCount;
 	float m_toi;
 
@@ -239,6 +263,9 @@ protected:
 	float m_restitutionThreshold;
 
 	float m_tangentSpeed;
+
+	// Position in the world contact list. Only valid while b2World::SaveSnapshot runs.
+	int32 m_index;
 };
 
 inline b2Manifold* b2Contact::GetManifold()
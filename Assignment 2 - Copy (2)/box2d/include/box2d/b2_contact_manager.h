@@ -25,17 +25,21 @@
 
 #include "b2_api.h"
 #include "b2_broad_phase.h"
+#include "b2_world_callbacks.h"
 
 class b2Contact;
 class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2ThreadPool;
+struct b2ContactEventBuffer;
 
 // Delegate of b2World.
 class B2_API b2ContactManager
 {
 public:
 	b2ContactManager();
+	~b2ContactManager();
 
 	// Broad-phase callback.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
@@ -46,12 +50,73 @@ public:
 
 	void Collide();
 
+	void SetThreadPool(b2ThreadPool* threadPool);
+
+	// Record the begin, end and hit events of a contact. See b2World::SetContactEvents.
+	void RecordEvents(b2Contact* c, uint32 events);
+	void ClearEvents();
+
+	// Drop the events of the last step. End events recorded after it, by destroying
+	// fixtures or bodies, are kept for the next step.
+	void ClearStepEvents();
+
+	// Clear the event pointers to a fixture that is being destroyed. The user data stays.
+	void ForgetFixture(const b2Fixture* fixture);
+
+	// Reset the step counters below.
+	void ClearCounters();
+
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
 	int32 m_contactCount;
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+
+	// Multi-threaded narrow phase. The contacts to update this step and one
+	// listener event buffer per thread.
+	b2ThreadPool* m_threadPool;
+	b2Contact** m_updateBuffer;
+	int32 m_updateCapacity;
+	int32 m_updateCount;
+	b2ContactEventBuffer* m_eventBuffers;
+	int32 m_eventBufferCount;
+
+	// Wide narrow phase, see b2World::SetWideNarrowPhase. The new manifold of each
+	// collected contact and the collected contacts sorted by shape pair type.
+	bool m_wideNarrowPhase;
+	b2Manifold* m_manifoldBuffer;
+	int32* m_bucketBuffer;
+	int32 m_wideCapacity;
+
+	// Contact events of the last step.
+	bool m_recordEvents;
+	float m_hitEventThreshold;
+	b2ContactBeginEvent* m_beginEvents;
+	int32 m_beginEventCount;
+	int32 m_beginEventCapacity;
+	b2ContactEndEvent* m_endEvents;
+	int32 m_endEventCount;
+	int32 m_endEventCapacity;
+
+	// The end events up to this count belong to the last step.
+	int32 m_stepEndEventCount;
+	b2ContactHitEvent* m_hitEvents;
+	int32 m_hitEventCount;
+	int32 m_hitEventCapacity;
+
+	// Counters and pair update time since the last ClearCounters. See b2Profile.
+	int32 m_pairCount;
+	int32 m_moveCount;
+	int32 m_collideCount;
+	int32 m_createCount;
+	int32 m_destroyCount;
+	float m_updatePairsTime;
+
+private:
+
+	void UpdateContacts();
+	void CollideWide();
 };
 
 #endif
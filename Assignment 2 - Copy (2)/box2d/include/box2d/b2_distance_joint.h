@@ -141,6 +141,9 @@ protected:
 	void SolveVelocityConstraints(const b2SolverData& data) override;
 	bool SolvePositionConstraints(const b2SolverData& data) override;
 
+	void Save(b2SnapshotWriter* writer) const override;
+	void Restore(b2SnapshotReader* reader) override;
+
 	float m_stiffness;
 	float m_damping;
 	float m_bias;
@@ -29,6 +29,10 @@
 
 #define b2_nullNode (-1)
 
+class b2ThreadPool;
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
+
 /// A node in the dynamic tree. The client does not interact with this directly.
 struct B2_API b2TreeNode
 {
@@ -57,6 +61,76 @@ struct B2_API b2TreeNode
 	bool moved;
 };
 
+/// A hit reported by b2DynamicTree::QueryBatch.
+struct B2_API b2TreeQueryHit
+{
+	/// Index of the query AABB in the batch
+	int32 queryIndex;
+
+	/// Proxy whose fat AABB overlaps the query AABB
+	int32 proxyId;
+};
+
+/// Callback for b2DynamicTree::RayCastBatch.
+class B2_API b2TreeRayCastBatchCallback
+{
+public:
+	virtual ~b2TreeRayCastBatchCallback() {}
+
+	/// Called for each proxy whose fat AABB is crossed by some rays of a group. With a
+	/// thread pool, different groups are reported from several threads at once.
+	/// @param proxyId the proxy crossed by the rays
+	/// @param baseIndex the index of the first ray of the group
+	/// @param laneMask bit i is set if ray baseIndex + i crosses the proxy
+	/// @param maxFractions the current max fraction of each ray of the group. Lower an
+	/// entry to clip that ray, or set it to zero to stop the ray.
+	virtual void RayCastProxy(int32 proxyId, int32 baseIndex, uint32 laneMask, float* maxFractions) = 0;
+};
+
+/// Tree quality metrics, see b2DynamicTree::Rebuild.
+struct B2_API b2TreeQuality
+{
+	int32 height;		///< see b2DynamicTree::GetHeight
+	int32 maxBalance;	///< see b2DynamicTree::GetMaxBalance
+	float areaRatio;	///< see b2DynamicTree::GetAreaRatio
+};
+
+/// A node of the compact tree layout, see b2DynamicTree::SetCompactMode. It holds the
+/// bounds of both children quantized to 16 bits relative to the bounds of the node.
+struct B2_API b2CompactTreeNode
+{
+	/// Lower x, lower y, upper x, upper y of each child
+	uint16 bounds[2][4];
+
+	/// Compact node index of each child, or -2 - proxyId for a leaf. The
+	/// offset keeps a root leaf with proxy 0 apart from b2_nullNode.
+	int32 children[2];
+};
+
+/// An entry of the compact tree traversal stacks.
+struct b2CompactStackEntry
+{
+	int32 child;
+	b2AABB aabb;
+};
+
+/// Decode the bounds of a compact child. The lower bound counts steps up from the lower
+/// bound of the frame and the upper bound counts steps down from its upper bound, so the
+/// end codes are exact. Building and traversal share this so they agree to the bit.
+inline void b2DecodeCompactBounds(b2AABB* aabb, const uint16* bounds, const b2AABB& frame, const b2Vec2& step)
+{
+	aabb->lowerBound.x = frame.lowerBound.x + float(bounds[0]) * step.x;
+	aabb->lowerBound.y = frame.lowerBound.y + float(bounds[1]) * step.y;
+	aabb->upperBound.x = frame.upperBound.x - float(65535 - bounds[2]) * step.x;
+	aabb->upperBound.y = frame.upperBound.y - float(65535 - bounds[3]) * step.y;
+}
+
+/// The quantization step of a compact node frame.
+inline b2Vec2 b2GetCompactStep(const b2AABB& frame)
+{
+	return (1.0f / 65535.0f) * (frame.upperBound - frame.lowerBound);
+}
+
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
 /// A dynamic tree arranges data in a binary tree to accelerate
 /// queries such as volume queries and ray casts. Leafs are proxies
@@ -90,6 +164,9 @@ public:
 	/// @return the proxy user data or 0 if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
 
+	/// Set proxy user data. Used to relink the proxies after a snapshot restore.
+	void SetUserData(int32 proxyId, void* userData);
+
 	bool WasMoved(int32 proxyId) const;
 	void ClearMoved(int32 proxyId);
 
@@ -101,6 +178,29 @@ public:
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query many AABBs at once. Each tree node is tested against several query
+	/// AABBs with SIMD, so a batch of small queries visits the upper nodes only once
+	/// per group. The hits are written to a flat array. Hits for one query are in tree
+	/// order, and the output does not depend on the thread count.
+	/// @param aabbs the query AABBs
+	/// @param count the number of query AABBs
+	/// @param hits receives up to hitCapacity hits
+	/// @param hitCapacity the length of the hits array
+	/// @param threadPool optional pool used to split the batch across threads
+	/// @return the total number of hits. If this exceeds hitCapacity the extra hits are dropped.
+	int32 QueryBatch(const b2AABB* aabbs, int32 count, b2TreeQueryHit* hits, int32 hitCapacity,
+					 b2ThreadPool* threadPool = nullptr) const;
+
+	/// Ray-cast many rays at once. Each node is tested against a group of rays with SIMD
+	/// and the tree is walked without a stack, following the parent links. The callback
+	/// clips the rays of a group as it finds hits, which culls the rest of the walk.
+	/// @param callback called for the proxies crossed by the rays
+	/// @param inputs the rays. Rays of zero length or zero max fraction are skipped.
+	/// @param count the number of rays
+	/// @param threadPool optional pool used to split the batch across threads
+	void RayCastBatch(b2TreeRayCastBatchCallback* callback, const b2RayCastInput* inputs, int32 count,
+					  b2ThreadPool* threadPool = nullptr) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -128,11 +228,63 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Rebuild the tree top down with a binned surface area heuristic in O(n log n).
+	/// Use this after creating many proxies at once, because inserting them one
+	/// at a time gives a poor tree. Proxy ids do not change.
+	/// @param before optional quality before the build
+	/// @param after optional quality after the build
+	void Rebuild(b2TreeQuality* before = nullptr, b2TreeQuality* after = nullptr);
+
+	/// Rebuild the sub-tree rooted at the ancestor a number of levels above a proxy
+	/// with the same builder. The rest of the tree keeps its structure. This repairs
+	/// a region that degraded in refit mode without paying for a full rebuild.
+	/// @param proxyId a proxy in the region
+	/// @param levels how far to go up from the proxy, clamped at the root
+	void RebuildSubtree(int32 proxyId, int32 levels);
+
+	/// Enable/disable refit mode. In refit mode MoveProxy does not restructure the tree.
+	/// It updates the leaf AABB and refits the ancestors bottom up. This is cheaper
+	/// while proxies stay close to their neighbors, but the quality degrades as
+	/// proxies travel. Call Rebuild to restore it.
+	void SetRefitMode(bool flag) { m_refitMode = flag; }
+	bool GetRefitMode() const { return m_refitMode; }
+
+	/// Enable/disable the compact layout. Query and RayCast then walk a second copy of
+	/// the internal nodes in depth first order. Each compact node stores the bounds of
+	/// both children quantized to 16 bits relative to its own bounds, so a node is tested
+	/// without loading its children and the proxy data stays out of the walk. Leaves are
+	/// tested against their float AABB, so the results and their order are the same.
+	/// Changing the tree makes the copy stale, and the queries use the regular nodes until
+	/// UpdateCompact is called.
+	void SetCompactMode(bool flag);
+	bool GetCompactMode() const { return m_compactMode; }
+
+	/// Rebuild the compact layout if compact mode is enabled and the tree changed since the
+	/// last build. This is O(n) and is called by b2BroadPhase::UpdatePairs.
+	void UpdateCompact();
+
+	/// Get the bytes allocated for the regular nodes.
+	int32 GetNodeBytes() const { return m_nodeCapacity * int32(sizeof(b2TreeNode)); }
+
+	/// Get the bytes allocated for the compact layout.
+	int32 GetCompactBytes() const { return m_compactCapacity * int32(sizeof(b2CompactTreeNode)); }
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Write the tree to a world snapshot, see b2World::SaveSnapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Restore the tree from a world snapshot.
+	void Restore(b2SnapshotReader* reader);
+
+	/// Read past the tree in a world snapshot without changing anything and check that
+	/// the node links are in range. Returns the saved node capacity, the range of the
+	/// proxy ids.
+	int32 Check(b2SnapshotReader* reader) const;
+
 private:
 
 	int32 AllocateNode();
@@ -143,9 +295,21 @@ private:
 
 	int32 Balance(int32 index);
 
+	int32 BuildTopDown(int32* leaves, b2Vec2* centers, int32 count);
+	void RebuildNode(int32 nodeId);
+	int32 PartitionSAH(int32* leaves, b2Vec2* centers, int32 count);
+	void RefitAncestors(int32 index);
+	void GetQuality(b2TreeQuality* quality) const;
+
 	int32 ComputeHeight() const;
 	int32 ComputeHeight(int32 nodeId) const;
 
+	template <typename T>
+	void QueryCompact(T* callback, const b2AABB& aabb) const;
+
+	template <typename T>
+	void RayCastCompact(T* callback, const b2RayCastInput& input) const;
+
 	void ValidateStructure(int32 index) const;
 	void ValidateMetrics(int32 index) const;
 
@@ -158,6 +322,18 @@ private:
 	int32 m_freeList;
 
 	int32 m_insertionCount;
+
+	bool m_refitMode;
+
+	b2CompactTreeNode* m_compactNodes;
+	int32 m_compactCount;
+	int32 m_compactCapacity;
+
+	// Root of the compact layout. Same encoding as b2CompactTreeNode::children.
+	int32 m_compactRoot;
+
+	bool m_compactMode;
+	bool m_compactValid;
 };
 
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
@@ -166,6 +342,12 @@ inline void* b2DynamicTree::GetUserData(int32 proxyId) const
 	return m_nodes[proxyId].userData;
 }
 
+inline void b2DynamicTree::SetUserData(int32 proxyId, void* userData)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	m_nodes[proxyId].userData = userData;
+}
+
 inline bool b2DynamicTree::WasMoved(int32 proxyId) const
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -187,6 +369,12 @@ inline const b2AABB& b2DynamicTree::GetFatAABB(int32 proxyId) const
 template <typename T>
 inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 {
+	if (m_compactValid)
+	{
+		QueryCompact(callback, aabb);
+		return;
+	}
+
 	b2GrowableStack<int32, 256> stack;
 	stack.Push(m_root);
 
@@ -222,6 +410,12 @@ inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 template <typename T>
 inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) const
 {
+	if (m_compactValid)
+	{
+		RayCastCompact(callback, input);
+		return;
+	}
+
 	b2Vec2 p1 = input.p1;
 	b2Vec2 p2 = input.p2;
 	b2Vec2 r = p2 - p1;
@@ -305,4 +499,157 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 	}
 }
 
+template <typename T>
+inline void b2DynamicTree::QueryCompact(T* callback, const b2AABB& aabb) const
+{
+	if (m_compactRoot == b2_nullNode)
+	{
+		return;
+	}
+
+	// Children are tested from the parent with their quantized bounds and pushed in
+	// the same order as Query, so the callbacks come in the same order.
+	b2GrowableStack<b2CompactStackEntry, 256> stack;
+	b2CompactStackEntry root;
+	root.child = m_compactRoot;
+	root.aabb = m_nodes[m_root].aabb;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactStackEntry entry = stack.Pop();
+
+		if (entry.child < 0)
+		{
+			int32 proxyId = -2 - entry.child;
+			if (b2TestOverlap(m_nodes[proxyId].aabb, aabb))
+			{
+				bool proceed = callback->QueryCallback(proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+
+			continue;
+		}
+
+		if (b2TestOverlap(entry.aabb, aabb) == false)
+		{
+			continue;
+		}
+
+		const b2CompactTreeNode* node = m_compactNodes + entry.child;
+		b2Vec2 step = b2GetCompactStep(entry.aabb);
+
+		for (int32 i = 0; i < 2; ++i)
+		{
+			b2CompactStackEntry child;
+			child.child = node->children[i];
+			b2DecodeCompactBounds(&child.aabb, node->bounds[i], entry.aabb, step);
+			if (b2TestOverlap(child.aabb, aabb))
+			{
+				stack.Push(child);
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2DynamicTree::RayCastCompact(T* callback, const b2RayCastInput& input) const
+{
+	if (m_compactRoot == b2_nullNode)
+	{
+		return;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	// Entries are tested again when popped because the segment may have been clipped
+	// since they were pushed. Leaves are tested with their float AABB.
+	b2GrowableStack<b2CompactStackEntry, 256> stack;
+	b2CompactStackEntry root;
+	root.child = m_compactRoot;
+	root.aabb = m_nodes[m_root].aabb;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactStackEntry entry = stack.Pop();
+
+		int32 proxyId = -2 - entry.child;
+		const b2AABB& aabb = entry.child < 0 ? m_nodes[proxyId].aabb : entry.aabb;
+
+		if (b2TestOverlap(aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		b2Vec2 c = aabb.GetCenter();
+		b2Vec2 h = aabb.GetExtents();
+		float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		if (entry.child < 0)
+		{
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float value = callback->RayCastCallback(subInput, proxyId);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+
+			continue;
+		}
+
+		const b2CompactTreeNode* node = m_compactNodes + entry.child;
+		b2Vec2 step = b2GetCompactStep(entry.aabb);
+
+		for (int32 i = 0; i < 2; ++i)
+		{
+			b2CompactStackEntry child;
+			child.child = node->children[i];
+			b2DecodeCompactBounds(&child.aabb, node->bounds[i], entry.aabb, step);
+			if (b2TestOverlap(child.aabb, segmentAABB))
+			{
+				stack.Push(child);
+			}
+		}
+	}
+}
+
 #endif
@@ -247,6 +247,9 @@ protected:
 
 	bool m_isSensor;
 
+	// Unique within the world, see b2Body::m_creationId.
+	uint32 m_creationId;
+
 	b2FixtureUserData m_userData;
 };
 
@@ -89,6 +89,9 @@ protected:
 	void SolveVelocityConstraints(const b2SolverData& data) override;
 	bool SolvePositionConstraints(const b2SolverData& data) override;
 
+	void Save(b2SnapshotWriter* writer) const override;
+	void Restore(b2SnapshotReader* reader) override;
+
 	b2Joint* m_joint1;
 	b2Joint* m_joint2;
 
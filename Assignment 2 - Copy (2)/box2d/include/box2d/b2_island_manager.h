@@ -0,0 +1,167 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef B2_ISLAND_MANAGER_H
+#define B2_ISLAND_MANAGER_H
+
+#include "b2_api.h"
+#include "b2_common.h"
+
+class b2Body;
+class b2Contact;
+class b2Joint;
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
+
+#define b2_nullIsland (-1)
+
+/// A persistent island: bodies connected by touching contacts and joints. Static
+/// bodies do not belong to islands. Contacts and joints between a static body
+/// and a non-static body belong to the island of the non-static body.
+struct B2_API b2PersistentIsland
+{
+	b2Body* bodyList;
+	b2Contact* contactList;
+	b2Joint* jointList;
+
+	int32 bodyCount;
+	int32 contactCount;
+	int32 jointCount;
+
+	/// The number of contacts, joints and bodies removed since the island was
+	/// built. If this is positive the island may have come apart.
+	int32 removeCount;
+
+	/// Index in the awake island array or b2_nullIsland if the island sleeps.
+	int32 awakeIndex;
+
+	/// Free list link.
+	int32 next;
+};
+
+/// Keeps the islands up to date as the constraint graph changes, so the step
+/// does not have to search the whole world for them. Islands merge as soon as
+/// a constraint connects them. They are only split when an island is about to
+/// fall asleep. Delegate of b2World.
+class B2_API b2IslandManager
+{
+public:
+	b2IslandManager();
+	~b2IslandManager();
+
+	/// Put a non-static, enabled body into a new island.
+	void AddBody(b2Body* body);
+
+	/// Take a body out of its island. Its contacts and joints must be unlinked first.
+	void RemoveBody(b2Body* body);
+
+	/// Link or unlink a contact to match its touching and sensor state.
+	void UpdateContact(b2Contact* contact);
+
+	/// Unlink a contact that is about to be destroyed.
+	void RemoveContact(b2Contact* contact);
+
+	/// Link a joint if both bodies are enabled and one of them is in an island.
+	void LinkJoint(b2Joint* joint);
+
+	/// Unlink a joint if it is linked.
+	void UnlinkJoint(b2Joint* joint);
+
+	/// Put an island on the awake list.
+	void WakeIsland(int32 islandId);
+
+	/// Take an island off the awake list.
+	void SleepIsland(int32 islandId);
+
+	/// Split an island into its connected components. The new islands are awake.
+	void SplitIsland(int32 islandId);
+
+	/// Get an island by id.
+	const b2PersistentIsland* GetIsland(int32 islandId) const;
+
+	/// The islands that are solved each step.
+	const int32* GetAwakeIslands() const;
+	int32 GetAwakeIslandCount() const;
+
+	/// Get the number of islands.
+	int32 GetIslandCount() const;
+
+	/// Check the island lists against the bodies, contacts and joints.
+	void Validate() const;
+
+	/// Write the islands to a world snapshot. The contacts and joints must be indexed.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Read the islands from a world snapshot. The list heads are looked up in the
+	/// body state slots and the contact and joint arrays. Sets the invalid flag of
+	/// the reader if the islands do not fit these arrays.
+	void Restore(b2SnapshotReader* reader, b2Body* const* bodies, int32 bodyCount,
+				 b2Contact* const* contacts, int32 contactCount, b2Joint* const* joints, int32 jointCount);
+
+	/// Read past the islands in a world snapshot without changing anything and check
+	/// them like Restore does. Returns the saved island capacity, the range of the
+	/// island ids.
+	int32 Check(b2SnapshotReader* reader, int32 bodyCount, int32 contactCount, int32 jointCount) const;
+
+private:
+
+	int32 AllocateIsland();
+	void FreeIsland(int32 islandId);
+	int32 MergeIslands(int32 islandIdA, int32 islandIdB);
+	void LinkContact(b2Contact* contact);
+	void UnlinkContact(b2Contact* contact);
+	void AddToIsland(int32 islandId, b2Contact* contact);
+	void AddToIsland(int32 islandId, b2Joint* joint);
+
+	b2PersistentIsland* m_islands;
+	int32 m_islandCapacity;
+	int32 m_islandCount;
+	int32 m_freeList;
+
+	int32* m_awakeIslands;
+	int32 m_awakeCount;
+	int32 m_awakeCapacity;
+};
+
+inline const b2PersistentIsland* b2IslandManager::GetIsland(int32 islandId) const
+{
+	b2Assert(0 <= islandId && islandId < m_islandCapacity);
+	return m_islands + islandId;
+}
+
+inline const int32* b2IslandManager::GetAwakeIslands() const
+{
+	return m_awakeIslands;
+}
+
+inline int32 b2IslandManager::GetAwakeIslandCount() const
+{
+	return m_awakeCount;
+}
+
+inline int32 b2IslandManager::GetIslandCount() const
+{
+	return m_islandCount;
+}
+
+#endif
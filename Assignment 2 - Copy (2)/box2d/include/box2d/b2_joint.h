@@ -31,6 +31,8 @@ class b2Draw;
 class b2Joint;
 struct b2SolverData;
 class b2BlockAllocator;
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
 
 enum b2JointType
 {
@@ -160,11 +162,16 @@ protected:
 	friend class b2World;
 	friend class b2Body;
 	friend class b2Island;
+	friend class b2IslandManager;
+	friend class b2GraphColorTask;
 	friend class b2GearJoint;
 
 	static b2Joint* Create(const b2JointDef* def, b2BlockAllocator* allocator);
 	static void Destroy(b2Joint* joint, b2BlockAllocator* allocator);
 
+	// The allocation size of a joint type.
+	static int32 GetByteCount(b2JointType type);
+
 	b2Joint(const b2JointDef* def);
 	virtual ~b2Joint() {}
 
@@ -174,6 +181,13 @@ protected:
 	// This returns true if the position errors are within tolerance.
 	virtual bool SolvePositionConstraints(const b2SolverData& data) = 0;
 
+	// Write the state of the joint type to a world snapshot, see b2World::SaveSnapshot.
+	// Bodies and joints are referenced by pointer and are not written.
+	virtual void Save(b2SnapshotWriter* writer) const = 0;
+
+	// Read the state written by Save.
+	virtual void Restore(b2SnapshotReader* reader) = 0;
+
 	b2JointType m_type;
 	b2Joint* m_prev;
 	b2Joint* m_next;
@@ -184,7 +198,14 @@ protected:
 
 	int32 m_index;
 
-	bool m_islandFlag;
+	// Unique within the world, see b2Body::m_creationId.
+	uint32 m_creationId;
+
+	// Persistent island, see b2IslandManager.
+	int32 m_islandId;
+	b2Joint* m_islandPrev;
+	b2Joint* m_islandNext;
+
 	bool m_collideConnected;
 
 	b2JointUserData m_userData;
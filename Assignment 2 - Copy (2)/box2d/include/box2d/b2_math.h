@@ -35,8 +35,27 @@ inline bool b2IsValid(float x)
 }
 
 #define	b2Sqrt(x)	sqrtf(x)
+
+#if defined(B2_DETERMINISTIC)
+
+/// Sine, cosine and arc tangent built from basic float operations only. These give
+/// the same result on every platform, unlike the C library. The error is below 1e-6.
+B2_API float b2ComputeSin(float angle);
+B2_API float b2ComputeCos(float angle);
+B2_API float b2ComputeAtan2(float y, float x);
+
+#define	b2Sin(x)		b2ComputeSin(x)
+#define	b2Cos(x)		b2ComputeCos(x)
+#define	b2Atan2(y, x)	b2ComputeAtan2(y, x)
+
+#else
+
+#define	b2Sin(x)		sinf(x)
+#define	b2Cos(x)		cosf(x)
 #define	b2Atan2(y, x)	atan2f(y, x)
 
+#endif
+
 /// A 2D column vector.
 struct B2_API b2Vec2
 {
@@ -292,16 +311,16 @@ struct B2_API b2Rot
 	explicit b2Rot(float angle)
 	{
 		/// TODO_ERIN optimize
-		s = sinf(angle);
-		c = cosf(angle);
+		s = b2Sin(angle);
+		c = b2Cos(angle);
 	}
 
 	/// Set using an angle in radians.
 	void Set(float angle)
 	{
 		/// TODO_ERIN optimize
-		s = sinf(angle);
-		c = cosf(angle);
+		s = b2Sin(angle);
+		c = b2Cos(angle);
 	}
 
 	/// Set to the identity rotation
@@ -109,6 +109,9 @@ protected:
 	void SolveVelocityConstraints(const b2SolverData& data) override;
 	bool SolvePositionConstraints(const b2SolverData& data) override;
 
+	void Save(b2SnapshotWriter* writer) const override;
+	void Restore(b2SnapshotReader* reader) override;
+
 	// Solver shared
 	b2Vec2 m_linearOffset;
 	float m_angularOffset;
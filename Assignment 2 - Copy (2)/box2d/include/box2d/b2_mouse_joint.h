@@ -109,6 +109,9 @@ protected:
 	void SolveVelocityConstraints(const b2SolverData& data) override;
 	bool SolvePositionConstraints(const b2SolverData& data) override;
 
+	void Save(b2SnapshotWriter* writer) const override;
+	void Restore(b2SnapshotReader* reader) override;
+
 	b2Vec2 m_localAnchorB;
 	b2Vec2 m_targetA;
 	float m_stiffness;
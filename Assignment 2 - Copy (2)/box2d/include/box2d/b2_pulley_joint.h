@@ -126,6 +126,9 @@ protected:
 	void SolveVelocityConstraints(const b2SolverData& data) override;
 	bool SolvePositionConstraints(const b2SolverData& data) override;
 
+	void Save(b2SnapshotWriter* writer) const override;
+	void Restore(b2SnapshotReader* reader) override;
+
 	b2Vec2 m_groundAnchorA;
 	b2Vec2 m_groundAnchorB;
 	float m_lengthA;
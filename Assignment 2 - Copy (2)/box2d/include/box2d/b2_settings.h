@@ -122,6 +122,27 @@ inline void b2Log(const char* string, ...)
 
 #endif // B2_USER_SETTINGS
 
+/// Totals of the default allocation functions. They are updated atomically, so
+/// worker threads may allocate while they are read.
+struct B2_API b2AllocStats
+{
+	/// The number of calls to b2Alloc_Default.
+	int32 allocCount;
+
+	/// The number of allocations not yet freed.
+	int32 liveCount;
+
+	/// The bytes held by the live allocations.
+	int32 liveBytes;
+
+	/// The largest value of liveBytes seen.
+	int32 peakBytes;
+};
+
+/// Get the totals of b2Alloc_Default and b2Free_Default. Use this to size memory
+/// budgets. Allocations made by your own b2Alloc are not counted.
+B2_API b2AllocStats b2GetAllocStats();
+
 #include "b2_common.h"
 
 #endif
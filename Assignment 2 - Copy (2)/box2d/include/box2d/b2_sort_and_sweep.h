@@ -0,0 +1,367 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef B2_SORT_AND_SWEEP_H
+#define B2_SORT_AND_SWEEP_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
+
+/// An entry in the sorted proxy array. The client does not interact with this directly.
+struct B2_API b2SortEntry
+{
+	/// Enlarged AABB
+	b2AABB aabb;
+
+	int32 proxyId;
+
+	/// Kept here rather than in the proxy so the sweep reads one array
+	bool moved;
+};
+
+/// A proxy in the sort-and-sweep broad-phase. The client does not interact with this directly.
+struct B2_API b2SortProxy
+{
+	void* userData;
+
+	/// Index into the sorted array, or -1 for a free proxy
+	int32 entryIndex;
+
+	/// Index into the large proxy list, or -1
+	int32 largeIndex;
+
+	int32 next;
+};
+
+/// An incremental sort-and-sweep broad-phase on the x-axis. The proxies are kept sorted
+/// by the lower x bound of their fat AABB. A moving proxy is shifted into place with
+/// insertion sort, which is cheap when proxies move steadily and only pass a few
+/// neighbors per step. Pairs are found with one sweep over the sorted array.
+/// This works best when proxies have similar sizes. Proxies that are much wider than
+/// average are kept in a side list that every query tests.
+class B2_API b2SortAndSweep
+{
+public:
+
+	b2SortAndSweep();
+	~b2SortAndSweep();
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the proxy is moved in the sorted array and the function returns true.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	/// Set proxy user data. Used to relink the proxies after a snapshot restore.
+	void SetUserData(int32 proxyId, void* userData);
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Mark a proxy as moved so the next FindPairs reports its pairs.
+	void MarkMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies. See b2DynamicTree::RayCast.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Sweep the sorted array and call callback->PairCallback(proxyIdA, proxyIdB) once
+	/// for each overlapping pair where at least one proxy has moved.
+	template <typename T>
+	void FindPairs(T* callback);
+
+	/// Validate the sort order. For testing.
+	void Validate() const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+	/// Write the proxies to a world snapshot, see b2World::SaveSnapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Restore the proxies from a world snapshot.
+	void Restore(b2SnapshotReader* reader);
+
+	/// Read past the proxies in a world snapshot without changing anything and check
+	/// that the indices are in range. Returns the saved proxy capacity.
+	int32 Check(b2SnapshotReader* reader) const;
+
+private:
+
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	void SortEntry(int32 index);
+	void Classify(int32 proxyId);
+	void AddLarge(int32 proxyId);
+	void RemoveLarge(int32 proxyId);
+	void UpdateLargeProxies();
+
+	int32 LowerBound(float x) const;
+
+	b2SortProxy* m_proxies;
+	int32 m_proxyCapacity;
+	int32 m_freeList;
+
+	b2SortEntry* m_entries;
+	int32 m_entryCount;
+	int32 m_entryCapacity;
+
+	// Scratch space for the active list of FindPairs
+	int32* m_active;
+
+	int32* m_large;
+	int32 m_largeCount;
+	int32 m_largeCapacity;
+
+	// Upper bound on the width of proxies that are not large
+	float m_maxWidth;
+
+	// Proxies wider than this are large
+	float m_largeWidth;
+};
+
+inline void* b2SortAndSweep::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline void b2SortAndSweep::SetUserData(int32 proxyId, void* userData)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].userData = userData;
+}
+
+inline bool b2SortAndSweep::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_entries[m_proxies[proxyId].entryIndex].moved;
+}
+
+inline void b2SortAndSweep::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_entries[m_proxies[proxyId].entryIndex].moved = false;
+}
+
+inline void b2SortAndSweep::MarkMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_entries[m_proxies[proxyId].entryIndex].moved = true;
+}
+
+inline const b2AABB& b2SortAndSweep::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].entryIndex != -1);
+	return m_entries[m_proxies[proxyId].entryIndex].aabb;
+}
+
+template <typename T>
+inline void b2SortAndSweep::Query(T* callback, const b2AABB& aabb) const
+{
+	// Only entries whose lower bound is within the maximum width of the query can overlap.
+	for (int32 index = LowerBound(aabb.lowerBound.x - m_maxWidth); index < m_entryCount; ++index)
+	{
+		const b2SortEntry* entry = m_entries + index;
+		if (entry->aabb.lowerBound.x > aabb.upperBound.x)
+		{
+			break;
+		}
+
+		// Large proxies are reported from their own list.
+		if (b2TestOverlap(entry->aabb, aabb) && m_proxies[entry->proxyId].largeIndex == -1)
+		{
+			bool proceed = callback->QueryCallback(entry->proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+
+	for (int32 i = 0; i < m_largeCount; ++i)
+	{
+		int32 proxyId = m_large[i];
+		if (b2TestOverlap(GetFatAABB(proxyId), aabb))
+		{
+			bool proceed = callback->QueryCallback(proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2SortAndSweep::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	int32 index = LowerBound(segmentAABB.lowerBound.x - m_maxWidth);
+	int32 largeIndex = 0;
+	for (;;)
+	{
+		int32 proxyId;
+		if (index < m_entryCount && m_entries[index].aabb.lowerBound.x <= segmentAABB.upperBound.x)
+		{
+			proxyId = m_entries[index].proxyId;
+			++index;
+
+			if (m_proxies[proxyId].largeIndex != -1)
+			{
+				continue;
+			}
+		}
+		else if (largeIndex < m_largeCount)
+		{
+			proxyId = m_large[largeIndex];
+			++largeIndex;
+		}
+		else
+		{
+			break;
+		}
+
+		const b2AABB& aabb = GetFatAABB(proxyId);
+		if (b2TestOverlap(aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = aabb.GetCenter();
+		b2Vec2 h = aabb.GetExtents();
+		float separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		b2RayCastInput subInput;
+		subInput.p1 = input.p1;
+		subInput.p2 = input.p2;
+		subInput.maxFraction = maxFraction;
+
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			// Update segment bounding box.
+			maxFraction = value;
+			b2Vec2 t = p1 + maxFraction * (p2 - p1);
+			segmentAABB.lowerBound = b2Min(p1, t);
+			segmentAABB.upperBound = b2Max(p1, t);
+		}
+	}
+}
+
+template <typename T>
+void b2SortAndSweep::FindPairs(T* callback)
+{
+	// The active list holds the entries whose x-interval contains the current lower bound.
+	int32 activeCount = 0;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		const b2SortEntry* entry = m_entries + i;
+		float lowerX = entry->aabb.lowerBound.x;
+		bool moved = entry->moved;
+
+		int32 j = 0;
+		while (j < activeCount)
+		{
+			const b2SortEntry* other = m_entries + m_active[j];
+			if (other->aabb.upperBound.x < lowerX)
+			{
+				// Passed. Remove it from the active list.
+				m_active[j] = m_active[activeCount - 1];
+				--activeCount;
+				continue;
+			}
+
+			// The x-intervals overlap, so only y is left to test.
+			if ((moved || other->moved) &&
+				other->aabb.lowerBound.y <= entry->aabb.upperBound.y &&
+				entry->aabb.lowerBound.y <= other->aabb.upperBound.y)
+			{
+				callback->PairCallback(other->proxyId, entry->proxyId);
+			}
+
+			++j;
+		}
+
+		m_active[activeCount] = i;
+		++activeCount;
+	}
+
+	UpdateLargeProxies();
+}
+
+#endif
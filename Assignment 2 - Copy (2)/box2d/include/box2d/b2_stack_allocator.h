@@ -27,18 +27,30 @@
 #include "b2_settings.h"
 
 const int32 b2_stackSize = 100 * 1024;	// 100k
-const int32 b2_maxStackEntries = 32;
+const int32 b2_maxStackEntries = 32;	// initial entry capacity, the entries grow like the chunks
 
 struct B2_API b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+
+	// Where the stack was before this entry, restored by Free.
+	int32 chunkIndex;
+	int32 index;
+};
+
+struct B2_API b2StackChunk
+{
+	char* data;
+	int32 size;
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// The memory is a list of chunks. When an allocation does not fit, a chunk is
+// added, and the chunks are kept for later steps. So once a world has reached
+// its largest step, stepping does not touch the heap.
 class B2_API b2StackAllocator
 {
 public:
@@ -48,18 +60,43 @@ public:
 	void* Allocate(int32 size);
 	void Free(void* p);
 
+	// Drop all allocations at once.
+	void Reset();
+
+	// The most memory that was in use at one time.
 	int32 GetMaxAllocation() const;
 
+	// The memory held in chunks.
+	int32 GetCapacity() const;
+
+	// The number of chunks.
+	int32 GetChunkCount() const { return m_chunkCount; }
+
+	// The number of times an allocation did not fit and a chunk was added.
+	int32 GetGrowCount() const { return m_growCount; }
+
+	// The number of allocations that have not been freed.
+	int32 GetEntryCount() const { return m_entryCount; }
+
 private:
 
-	char m_data[b2_stackSize];
+	void AddChunk(int32 size);
+
+	b2StackChunk* m_chunks;
+	int32 m_chunkCount;
+	int32 m_chunkCapacity;
+
+	// The top of the stack: a chunk and the offset in it.
+	int32 m_chunkIndex;
 	int32 m_index;
 
 	int32 m_allocation;
 	int32 m_maxAllocation;
+	int32 m_growCount;
 
-	b2StackEntry m_entries[b2_maxStackEntries];
+	b2StackEntry* m_entries;
 	int32 m_entryCount;
+	int32 m_entryCapacity;
 };
 
 #endif
@@ -0,0 +1,83 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_THREAD_POOL_H
+#define B2_THREAD_POOL_H
+
+#include "b2_api.h"
+#include "b2_settings.h"
+
+struct b2ThreadPoolImpl;
+
+/// A unit of parallel work. The pool splits the item range [0, itemCount) into
+/// contiguous ranges and calls Execute for each range on some thread.
+/// Implementations must only write to memory owned by the items in the range
+/// or to per-thread memory selected with threadIndex.
+class B2_API b2ThreadTask
+{
+public:
+	virtual ~b2ThreadTask() {}
+
+	/// Process the items [begin, end).
+	/// @param threadIndex the executing thread in [0, b2ThreadPool::GetThreadCount()).
+	/// The calling thread is always thread 0.
+	virtual void Execute(int32 begin, int32 end, int32 threadIndex) = 0;
+};
+
+/// A small fixed size pool of worker threads used by b2World to run parts of the
+/// time step in parallel. The pool is owned by you and may be shared by several
+/// worlds as long as they are not stepped at the same time.
+/// @see b2World::SetThreadPool
+class B2_API b2ThreadPool
+{
+public:
+	/// Construct a pool.
+	/// @param threadCount the total number of threads, including the calling thread.
+	/// A count of one creates no workers and runs everything on the calling thread.
+	explicit b2ThreadPool(int32 threadCount);
+
+	/// Joins all worker threads.
+	~b2ThreadPool();
+
+	/// Get the total number of threads, including the calling thread.
+	int32 GetThreadCount() const;
+
+	/// Run the task over [0, itemCount) and block until all items are done. Ranges
+	/// hold at least minRange items. Small batches run inline on the calling thread.
+	/// @warning this is not re-entrant. Do not call it from inside a task.
+	void ParallelFor(b2ThreadTask* task, int32 itemCount, int32 minRange);
+
+private:
+
+	b2ThreadPool(const b2ThreadPool&);
+	b2ThreadPool& operator=(const b2ThreadPool&);
+
+	b2ThreadPoolImpl* m_impl;
+	int32 m_threadCount;
+};
+
+inline int32 b2ThreadPool::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+#endif
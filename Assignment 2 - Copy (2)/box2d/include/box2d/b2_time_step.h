@@ -36,6 +36,21 @@ struct B2_API b2Profile
 	float solvePosition;
 	float broadphase;
 	float solveTOI;
+	float updatePairs;		///< finding new contacts, in collide, broadphase and solveTOI
+	float colorCount;		///< most graph colors used by an island
+	float colorSizes[b2_graphColorCount];	///< constraints per graph color, summed over islands
+	float colorOverflow;	///< graph colored constraints solved on one thread
+	int32 pairCount;		///< pairs reported by the broad-phase
+	int32 proxyMoveCount;	///< proxies moved in the broad-phase
+	int32 contactUpdateCount;	///< contacts updated by the narrow-phase
+	int32 contactCreateCount;	///< contacts created
+	int32 contactDestroyCount;	///< contacts destroyed
+	int32 islandCount;		///< awake islands solved
+	int32 maxIslandSize;	///< bodies in the largest island solved
+	int32 toiEventCount;	///< time of impact events solved
+	int32 treeHeight;		///< height of the broad-phase tree, zero for the other types
+	int32 wideBatchCount;	///< full batches built by the wide contact solver
+	int32 wideRemainderCount;	///< contacts the wide contact solver left to the scalar solver
 };
 
 /// This is an internal structure.
@@ -47,6 +62,8 @@ struct B2_API b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool wideContactSolver;
+	int32 subStepCount;	// soft step solver sub-steps, 0 to solve with iterations
 };
 
 /// This is an internal structure.
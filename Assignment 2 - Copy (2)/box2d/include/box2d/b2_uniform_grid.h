@@ -0,0 +1,380 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef B2_UNIFORM_GRID_H
+#define B2_UNIFORM_GRID_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+
+struct b2SnapshotReader;
+struct b2SnapshotWriter;
+
+/// A proxy in the uniform grid broad-phase. The client does not interact with this directly.
+struct B2_API b2GridProxy
+{
+	/// Enlarged AABB
+	b2AABB aabb;
+
+	void* userData;
+
+	/// The range of cells covered by the AABB
+	int32 lowerX, lowerY;
+	int32 upperX, upperY;
+
+	/// Index into the large proxy list, or -1
+	int32 largeIndex;
+
+	int32 next;
+
+	bool allocated;
+	bool moved;
+};
+
+/// Links a proxy into the hash bucket of one cell. The client does not interact with this directly.
+struct B2_API b2GridEntry
+{
+	int32 proxyId;
+	int32 cellX, cellY;
+	int32 next;
+};
+
+/// A hashed uniform grid broad-phase. Each proxy is linked into every cell its fat AABB
+/// covers. The cells are hashed into buckets, so the grid has no bounds. A proxy that stays
+/// inside the same cells only updates its AABB when it moves. This works best when the cell
+/// size is close to the size of the shapes. Proxies that cover many cells are kept in a side
+/// list that every query tests.
+class B2_API b2UniformGrid
+{
+public:
+
+	enum
+	{
+		/// Cell coordinates are clamped to this range.
+		e_maxCoordinate = 1 << 20
+	};
+
+	b2UniformGrid();
+	~b2UniformGrid();
+
+	/// Set the cell size. The grid must be empty.
+	void SetCellSize(float cellSize);
+	float GetCellSize() const { return m_cellSize; }
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the proxy is relinked into its new cells and the function returns true.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	/// Set proxy user data. Used to relink the proxies after a snapshot restore.
+	void SetUserData(int32 proxyId, void* userData);
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies. See b2DynamicTree::RayCast.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Validate the cell links. For testing.
+	void Validate() const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+	/// Write the grid to a world snapshot, see b2World::SaveSnapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Restore the grid from a world snapshot.
+	void Restore(b2SnapshotReader* reader);
+
+	/// Read past the grid in a world snapshot without changing anything and check that
+	/// the indices are in range. Returns the saved proxy capacity.
+	int32 Check(b2SnapshotReader* reader) const;
+
+private:
+
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	int32 AllocateEntry();
+	void FreeEntry(int32 entryId);
+
+	void InsertCells(int32 proxyId);
+	void RemoveCells(int32 proxyId);
+	void GrowBuckets();
+
+	int32 GetCell(float x) const;
+	int32 GetBucket(int32 cellX, int32 cellY) const;
+
+	template <typename T>
+	bool QueryCell(T* callback, const b2AABB& aabb, int32 cellX, int32 cellY, int32 lowerX, int32 lowerY) const;
+
+	b2GridProxy* m_proxies;
+	int32 m_proxyCapacity;
+	int32 m_freeProxy;
+
+	b2GridEntry* m_entries;
+	int32 m_entryCount;
+	int32 m_entryCapacity;
+	int32 m_freeEntry;
+
+	// Head entry of each bucket. The count is a power of two.
+	int32* m_buckets;
+	int32 m_bucketCount;
+
+	int32* m_large;
+	int32 m_largeCount;
+	int32 m_largeCapacity;
+
+	float m_cellSize;
+	float m_inverseCellSize;
+};
+
+inline void* b2UniformGrid::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline void b2UniformGrid::SetUserData(int32 proxyId, void* userData)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].userData = userData;
+}
+
+inline bool b2UniformGrid::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].moved;
+}
+
+inline void b2UniformGrid::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = false;
+}
+
+inline const b2AABB& b2UniformGrid::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int32 b2UniformGrid::GetCell(float x) const
+{
+	float cell = b2Clamp(floorf(x * m_inverseCellSize), -float(e_maxCoordinate), float(e_maxCoordinate));
+	return int32(cell);
+}
+
+inline int32 b2UniformGrid::GetBucket(int32 cellX, int32 cellY) const
+{
+	uint32 hash = (uint32(cellX) * 73856093u) ^ (uint32(cellY) * 19349663u);
+	return int32(hash & uint32(m_bucketCount - 1));
+}
+
+// Report the proxies linked into one cell. A proxy that covers several cells is only
+// reported from the first cell it shares with the query range.
+template <typename T>
+inline bool b2UniformGrid::QueryCell(T* callback, const b2AABB& aabb, int32 cellX, int32 cellY, int32 lowerX, int32 lowerY) const
+{
+	int32 entryId = m_buckets[GetBucket(cellX, cellY)];
+	while (entryId != -1)
+	{
+		const b2GridEntry* entry = m_entries + entryId;
+		entryId = entry->next;
+
+		if (entry->cellX != cellX || entry->cellY != cellY)
+		{
+			continue;
+		}
+
+		const b2GridProxy* proxy = m_proxies + entry->proxyId;
+		if (b2Max(proxy->lowerX, lowerX) != cellX || b2Max(proxy->lowerY, lowerY) != cellY)
+		{
+			continue;
+		}
+
+		if (b2TestOverlap(proxy->aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(entry->proxyId);
+			if (proceed == false)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+template <typename T>
+inline void b2UniformGrid::Query(T* callback, const b2AABB& aabb) const
+{
+	int32 lowerX = GetCell(aabb.lowerBound.x);
+	int32 lowerY = GetCell(aabb.lowerBound.y);
+	int32 upperX = GetCell(aabb.upperBound.x);
+	int32 upperY = GetCell(aabb.upperBound.y);
+
+	float cellCount = float(upperX - lowerX + 1) * float(upperY - lowerY + 1);
+	if (cellCount > float(m_entryCount))
+	{
+		// A query this large is cheaper as a scan over the proxies.
+		for (int32 proxyId = 0; proxyId < m_proxyCapacity; ++proxyId)
+		{
+			const b2GridProxy* proxy = m_proxies + proxyId;
+			if (proxy->allocated && proxy->largeIndex == -1 && b2TestOverlap(proxy->aabb, aabb))
+			{
+				bool proceed = callback->QueryCallback(proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+	}
+	else
+	{
+		for (int32 y = lowerY; y <= upperY; ++y)
+		{
+			for (int32 x = lowerX; x <= upperX; ++x)
+			{
+				if (QueryCell(callback, aabb, x, y, lowerX, lowerY) == false)
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	for (int32 i = 0; i < m_largeCount; ++i)
+	{
+		int32 proxyId = m_large[i];
+		if (b2TestOverlap(m_proxies[proxyId].aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+// Adapts a ray cast to the cell query. Clips the segment as the client reports hits.
+template <typename T>
+struct b2GridRayCastWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		const b2AABB& aabb = grid->GetFatAABB(proxyId);
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = aabb.GetCenter();
+		b2Vec2 h = aabb.GetExtents();
+		float separation = b2Abs(b2Dot(v, input.p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f || b2TestOverlap(aabb, segmentAABB) == false)
+		{
+			return true;
+		}
+
+		b2RayCastInput subInput = input;
+		subInput.maxFraction = maxFraction;
+
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return false;
+		}
+
+		if (value > 0.0f)
+		{
+			// Update segment bounding box.
+			maxFraction = value;
+			b2Vec2 t = input.p1 + maxFraction * (input.p2 - input.p1);
+			segmentAABB.lowerBound = b2Min(input.p1, t);
+			segmentAABB.upperBound = b2Max(input.p1, t);
+		}
+
+		return true;
+	}
+
+	const b2UniformGrid* grid;
+	T* callback;
+	b2RayCastInput input;
+	b2Vec2 v;
+	b2Vec2 abs_v;
+	b2AABB segmentAABB;
+	float maxFraction;
+};
+
+template <typename T>
+inline void b2UniformGrid::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 r = input.p2 - input.p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	b2GridRayCastWrapper<T> wrapper;
+	wrapper.grid = this;
+	wrapper.callback = callback;
+	wrapper.input = input;
+
+	// v is perpendicular to the segment.
+	wrapper.v = b2Cross(1.0f, r);
+	wrapper.abs_v = b2Abs(wrapper.v);
+	wrapper.maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2Vec2 t = input.p1 + input.maxFraction * (input.p2 - input.p1);
+	wrapper.segmentAABB.lowerBound = b2Min(input.p1, t);
+	wrapper.segmentAABB.upperBound = b2Max(input.p1, t);
+
+	// The clipped segment AABB is used for the proxy tests. The cells are
+	// walked over the original range.
+	b2AABB aabb = wrapper.segmentAABB;
+	Query(&wrapper, aabb);
+}
+
+#endif
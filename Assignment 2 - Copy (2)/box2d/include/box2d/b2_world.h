@@ -25,20 +25,26 @@
 
 #include "b2_api.h"
 #include "b2_block_allocator.h"
+#include "b2_body.h"
 #include "b2_contact_manager.h"
+#include "b2_island_manager.h"
 #include "b2_math.h"
 #include "b2_stack_allocator.h"
 #include "b2_time_step.h"
+#include "b2_timer.h"
 #include "b2_world_callbacks.h"
 
 struct b2AABB;
 struct b2BodyDef;
 struct b2Color;
 struct b2JointDef;
+struct b2ProfileRecord;
 class b2Body;
 class b2Draw;
 class b2Fixture;
+class b2Island;
 class b2Joint;
+class b2ThreadPool;
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -48,7 +54,10 @@ class B2_API b2World
 public:
 	/// Construct a world object.
 	/// @param gravity the world gravity vector.
-	b2World(const b2Vec2& gravity);
+	/// @param broadPhaseType the broad-phase data structure.
+	/// @param gridCellSize the cell size used by b2_gridBroadPhase.
+	b2World(const b2Vec2& gravity, b2BroadPhaseType broadPhaseType = b2_treeBroadPhase,
+			float gridCellSize = b2_gridCellSize);
 
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
@@ -118,6 +127,16 @@ public:
 	/// @param aabb the query box.
 	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const;
 
+	/// Query the world for the fixtures that potentially overlap each AABB in a batch.
+	/// This is cheaper than many QueryAABB calls. The batch is split across the thread
+	/// pool when one is set and the world is not locked.
+	/// @param aabbs the query boxes.
+	/// @param count the number of query boxes.
+	/// @param hits receives up to hitCapacity (query index, fixture) pairs.
+	/// @param hitCapacity the length of the hits array.
+	/// @return the total number of hits. If this exceeds hitCapacity the extra hits are dropped.
+	int32 QueryAABBBatch(const b2AABB* aabbs, int32 count, b2FixtureQueryHit* hits, int32 hitCapacity) const;
+
 	/// Ray-cast the world for all fixtures in the path of the ray. Your callback
 	/// controls whether you get the closest point, any point, or n-points.
 	/// The ray-cast ignores shapes that contain the starting point.
@@ -126,6 +145,25 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Ray-cast many rays at once for the closest hit of each, for example for line of
+	/// sight checks. This is much cheaper than many RayCast calls. Circles and polygons
+	/// are tested against several rays with SIMD. The batch is split across the thread
+	/// pool when one is set and the world is not locked. Sensors are ignored.
+	/// @param inputs the rays. Each ray extends from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param count the number of rays
+	/// @param hits receives the closest hit of each ray
+	void RayCastBatch(const b2RayCastInput* inputs, int32 count, b2RayCastHit* hits) const;
+
+	/// Sweep many shapes through the world for the first hit of each, for example for fast
+	/// projectiles that are not bullet bodies. Each sweep gathers candidates from the broad-phase
+	/// and runs b2ShapeCast against them. The batch is split across the thread pool when one is
+	/// set and the world is not locked. Sensors and fixtures that overlap a shape at the start
+	/// of its sweep are ignored.
+	/// @param queries the swept shapes
+	/// @param count the number of swept shapes
+	/// @param hits receives the first hit of each swept shape
+	void ShapeCastBatch(const b2ShapeCastQuery* queries, int32 count, b2ShapeCastHit* hits) const;
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A nullptr body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -162,6 +200,82 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable the wide contact solver. The wide solver packs contacts into
+	/// batches that share no dynamic body and solves each batch with SIMD instructions
+	/// (4 lanes with SSE2/NEON, 8 lanes with AVX2). Results differ slightly from the
+	/// default solver because the contacts are solved in a different order.
+	void SetWideContactSolver(bool flag) { m_wideContactSolver = flag; }
+	bool GetWideContactSolver() const { return m_wideContactSolver; }
+
+	/// Enable/disable graph coloring of large islands. The contacts and joints of an island
+	/// with at least b2_graphColorThreshold constraints are split into colors that share no
+	/// dynamic body. With a thread pool each color is solved in parallel. The results do not
+	/// depend on the number of threads but differ from the uncolored solver.
+	/// See b2Profile for the color statistics.
+	void SetGraphColoring(bool flag) { m_graphColoring = flag; }
+	bool GetGraphColoring() const { return m_graphColoring; }
+
+	/// Enable/disable the soft step solver. It divides each step into sub-steps with one
+	/// relaxed iteration each and treats contacts as stiff springs. This gives better
+	/// stacking for the same cost than raising the iteration counts, which it ignores.
+	/// Joints are solved with their regular solver once per sub-step. The wide contact
+	/// solver and graph coloring are not used in this mode. Contact impulses reported
+	/// to PostSolve are the impulses of the last sub-step.
+	void SetSoftStep(bool flag) { m_softStep = flag; }
+	bool GetSoftStep() const { return m_softStep; }
+
+	/// Set the number of sub-steps of the soft step solver. The default is b2_softStepCount.
+	void SetSoftStepCount(int32 count) { m_softStepCount = b2Max(count, 1); }
+	int32 GetSoftStepCount() const { return m_softStepCount; }
+
+	/// Enable/disable batched continuous collision. Each pass computes the TOI of all
+	/// candidate contacts, in parallel with a thread pool, and then solves every TOI
+	/// event whose bodies were not moved by an earlier event of the pass. This is
+	/// faster with many bullets. Results differ slightly from the default, which solves
+	/// one event per pass. Ignored when sub-stepping.
+	void SetBatchedTOI(bool flag) { m_batchedTOI = flag; }
+	bool GetBatchedTOI() const { return m_batchedTOI; }
+
+	/// Enable/disable the wide narrow phase. The contacts to update are sorted into
+	/// polygon, polygon and circle, and circle pairs, and each kind is collided several
+	/// pairs at a time with SIMD instructions. The manifolds are the same as with the
+	/// default narrow phase. Contacts are always collected before they are updated, so
+	/// a contact that only becomes active because of a wake up in this step is updated
+	/// in the next step, as with a thread pool.
+	void SetWideNarrowPhase(bool flag) { m_contactManager.m_wideNarrowPhase = flag; }
+	bool GetWideNarrowPhase() const { return m_contactManager.m_wideNarrowPhase; }
+
+	/// Enable/disable recording of contact events. Each step then records the fixture
+	/// pairs that begin and end touching, and the hits of solid fixtures that begin
+	/// touching faster than the hit event threshold. The events are kept until the
+	/// next step. Reading them does not need a contact listener or walking the contact list.
+	/// The fixture pointers of an event are set to null when the fixture is destroyed.
+	void SetContactEvents(bool flag) { m_contactManager.m_recordEvents = flag; }
+	bool GetContactEvents() const { return m_contactManager.m_recordEvents; }
+
+	/// Set the approach speed above which hit events are recorded, in meters per second.
+	/// The default is b2_hitEventThreshold.
+	void SetHitEventThreshold(float speed) { m_contactManager.m_hitEventThreshold = speed; }
+	float GetHitEventThreshold() const { return m_contactManager.m_hitEventThreshold; }
+
+	/// Get the contact events of the last step. See SetContactEvents.
+	const b2ContactBeginEvent* GetContactBeginEvents() const;
+	int32 GetContactBeginEventCount() const;
+	const b2ContactEndEvent* GetContactEndEvents() const;
+	int32 GetContactEndEventCount() const;
+	const b2ContactHitEvent* GetContactHitEvents() const;
+	int32 GetContactHitEventCount() const;
+
+	/// Register a thread pool to update contacts and solve independent islands in
+	/// parallel. The island solver results are identical to the single threaded solver.
+	/// Each worker thread gets its own stack allocator. Contact callbacks are recorded
+	/// by the workers and reported on the calling thread in contact list order.
+	/// The pool is owned by you and must remain in scope.
+	/// Pass nullptr to go back to single threaded stepping.
+	/// @warning This function is locked during callbacks.
+	void SetThreadPool(b2ThreadPool* threadPool);
+	b2ThreadPool* GetThreadPool() const { return m_threadPool; }
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -174,6 +288,12 @@ public:
 	/// Get the number of contacts (each may have 0 or more contact points).
 	int32 GetContactCount() const;
 
+	/// Get the number of islands. Static bodies are not part of any island.
+	int32 GetIslandCount() const;
+
+	/// Get the broad-phase data structure chosen at construction.
+	b2BroadPhaseType GetBroadPhaseType() const;
+
 	/// Get the height of the dynamic tree.
 	int32 GetTreeHeight() const;
 
@@ -184,6 +304,21 @@ public:
 	/// The minimum is 1.
 	float GetTreeQuality() const;
 
+	/// Rebuild the dynamic tree with a surface area heuristic. Call this after creating
+	/// many bodies at once. See b2DynamicTree::Rebuild.
+	/// @warning This function is locked during callbacks.
+	void RebuildTree(b2TreeQuality* before = nullptr, b2TreeQuality* after = nullptr);
+
+	/// Enable/disable refit mode of the dynamic tree. See b2DynamicTree::SetRefitMode.
+	void SetTreeRefitMode(bool flag);
+	bool GetTreeRefitMode() const;
+
+	/// Enable/disable the compact layout of the dynamic tree. See b2DynamicTree::SetCompactMode.
+	/// The layout is rebuilt when the pairs are updated in a step that moved many proxies
+	/// out of their fat AABBs. Queries and ray casts give the same results in the same order.
+	void SetTreeCompactMode(bool flag);
+	bool GetTreeCompactMode() const;
+
 	/// Change the global gravity vector.
 	void SetGravity(const b2Vec2& gravity);
 
@@ -210,6 +345,61 @@ public:
 	/// Get the current profile.
 	const b2Profile& GetProfile() const;
 
+	/// Keep the profiles of the last steps in a ring buffer, so a spike can be
+	/// diagnosed after the fact. Zero turns the history off.
+	void SetProfileHistory(int32 capacity);
+
+	/// Get the number of steps in the profile history.
+	int32 GetProfileHistoryCount() const;
+
+	/// Get a step of the profile history. Index zero is the oldest step.
+	const b2Profile& GetProfileHistory(int32 index) const;
+
+	/// Write the profile history as CSV, one row per step.
+	/// @return false if the file cannot be opened.
+	bool WriteProfileCSV(const char* fileName) const;
+
+	/// Write the profile history as Chrome trace JSON, to view in chrome://tracing
+	/// or Perfetto. Each step shows its collide, solve and TOI phases.
+	/// @return false if the file cannot be opened.
+	bool WriteProfileTrace(const char* fileName) const;
+
+	/// Get the small object allocator that holds the bodies, fixtures, shapes, joints
+	/// and contacts. Use b2BlockAllocator::GetStats to see its memory use.
+	const b2BlockAllocator& GetBlockAllocator() const;
+
+	/// Get the allocator for the temporary memory of a step on the calling thread.
+	/// Use b2StackAllocator::GetMaxAllocation and GetGrowCount to see how much a step needs.
+	const b2StackAllocator& GetStackAllocator() const;
+
+	/// Release the allocator chunks that no longer hold any objects, for example
+	/// after destroying many bodies. Returns the number of bytes released.
+	/// @warning this should be called outside of a time step.
+	int32 TrimMemory();
+
+	/// Hash the body transforms and velocities and the contact impulses. Worlds that
+	/// were built and stepped the same way give the same hash, so comparing hashes
+	/// between machines catches divergence in the step it happens. Across platforms
+	/// this needs a build with BOX2D_DETERMINISTIC.
+	uint64 ComputeStateHash() const;
+
+	/// Save the state of the world into a flat buffer, for rollback. Returns the
+	/// number of bytes the snapshot needs. Nothing is written unless the buffer is
+	/// big enough, so call with a null buffer first to get the size. Returns 0 if
+	/// the world is locked.
+	int32 SaveSnapshot(void* buffer, int32 capacity);
+
+	/// Put the world back into the state saved by SaveSnapshot. The bodies, fixtures
+	/// and joints must be the ones that existed when the snapshot was taken: none
+	/// may have been created or destroyed since. Contacts are rebuilt and user data
+	/// is left as it is. Returns false without touching the world if the snapshot
+	/// belongs to another world or the set of bodies, fixtures or joints changed, or
+	/// if the world is locked. The whole snapshot is checked before anything changes,
+	/// so a truncated or damaged snapshot also returns false and leaves the world as
+	/// it was. The check covers sizes, counts and indices, not values like positions.
+	/// @warning the snapshot is not a file format, it is only valid for this build.
+	bool RestoreSnapshot(const void* buffer, int32 size);
+
 	/// Dump the world into the log file.
 	/// @warning this should be called outside of a time step.
 	void Dump();
@@ -217,26 +407,42 @@ public:
 private:
 
 	friend class b2Body;
+	friend class b2Contact;
 	friend class b2Fixture;
 	friend class b2ContactManager;
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
+	void SolveTOIBatched(const b2TimeStep& step, b2Island* island);
+	bool SolveTOIEvent(const b2TimeStep& step, b2Island* island, b2Contact* minContact, float minAlpha);
+
+	bool CheckSnapshot(const void* buffer, int32 size);
 
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
+	b2ThreadPool* m_threadPool;
+	b2StackAllocator* m_workerStackAllocators;
+	int32 m_workerStackAllocatorCount;
+
 	b2ContactManager m_contactManager;
+	b2IslandManager m_islandManager;
 
 	b2Body* m_bodyList;
 	b2Joint* m_jointList;
 
+	// Hot body state indexed by b2Body::m_stateIndex.
+	b2BodyStates m_bodyStates;
+
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
+	// Source of the creation ids of bodies, fixtures and joints.
+	uint32 m_creationCount;
+
 	b2Vec2 m_gravity;
 	bool m_allowSleep;
 
@@ -255,10 +461,23 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_wideContactSolver;
+	bool m_graphColoring;
+	bool m_softStep;
+	int32 m_softStepCount;
+	bool m_batchedTOI;
 
 	bool m_stepComplete;
 
 	b2Profile m_profile;
+
+	b2ProfileRecord* m_profileHistory;
+	int32 m_profileCapacity;
+	int32 m_profileCount;
+	int32 m_profileNext;
+	double m_profileTime;
+	b2Timer m_profileTimer;
+	int32 m_stepIndex;
 };
 
 inline b2Body* b2World::GetBodyList()
@@ -306,6 +525,41 @@ inline int32 b2World::GetContactCount() const
 	return m_contactManager.m_contactCount;
 }
 
+inline int32 b2World::GetIslandCount() const
+{
+	return m_islandManager.GetIslandCount();
+}
+
+inline const b2ContactBeginEvent* b2World::GetContactBeginEvents() const
+{
+	return m_contactManager.m_beginEvents;
+}
+
+inline int32 b2World::GetContactBeginEventCount() const
+{
+	return m_contactManager.m_beginEventCount;
+}
+
+inline const b2ContactEndEvent* b2World::GetContactEndEvents() const
+{
+	return m_contactManager.m_endEvents;
+}
+
+inline int32 b2World::GetContactEndEventCount() const
+{
+	return m_contactManager.m_endEventCount;
+}
+
+inline const b2ContactHitEvent* b2World::GetContactHitEvents() const
+{
+	return m_contactManager.m_hitEvents;
+}
+
+inline int32 b2World::GetContactHitEventCount() const
+{
+	return m_contactManager.m_hitEventCount;
+}
+
 inline void b2World::SetGravity(const b2Vec2& gravity)
 {
 	m_gravity = gravity;
@@ -337,6 +591,16 @@ inline const b2ContactManager& b2World::GetContactManager() const
 	return m_contactManager;
 }
 
+inline const b2BlockAllocator& b2World::GetBlockAllocator() const
+{
+	return m_blockAllocator;
+}
+
+inline const b2StackAllocator& b2World::GetStackAllocator() const
+{
+	return m_stackAllocator;
+}
+
 inline const b2Profile& b2World::GetProfile() const
 {
 	return m_profile;
@@ -24,11 +24,12 @@
 #define B2_WORLD_CALLBACKS_H
 
 #include "b2_api.h"
+#include "b2_math.h"
 #include "b2_settings.h"
 
-struct b2Vec2;
 struct b2Transform;
 class b2Fixture;
+class b2Shape;
 class b2Body;
 class b2Joint;
 class b2Contact;
@@ -123,6 +124,47 @@ public:
 	}
 };
 
+/// Two fixtures began to touch during the last step.
+/// See b2World::SetContactEvents
+struct B2_API b2ContactBeginEvent
+{
+	b2Fixture* fixtureA;
+	b2Fixture* fixtureB;
+	b2FixtureUserData userDataA;
+	b2FixtureUserData userDataB;
+};
+
+/// Two fixtures stopped touching during the last step. This is also recorded for
+/// touching contacts that are destroyed between steps, for example by destroying a
+/// body, and is then reported with the next step.
+/// See b2World::SetContactEvents
+struct B2_API b2ContactEndEvent
+{
+	b2Fixture* fixtureA;
+	b2Fixture* fixtureB;
+	b2FixtureUserData userDataA;
+	b2FixtureUserData userDataB;
+};
+
+/// Two solid fixtures began to touch faster than the hit event threshold.
+/// See b2World::SetContactEvents
+struct B2_API b2ContactHitEvent
+{
+	b2Fixture* fixtureA;
+	b2Fixture* fixtureB;
+	b2FixtureUserData userDataA;
+	b2FixtureUserData userDataB;
+
+	/// World contact point with the highest approach speed
+	b2Vec2 point;
+
+	/// World normal pointing from A to B
+	b2Vec2 normal;
+
+	/// Relative normal velocity of the bodies before the collision is solved
+	float approachSpeed;
+};
+
 /// Callback class for AABB queries.
 /// See b2World::Query
 class B2_API b2QueryCallback
@@ -135,6 +177,67 @@ public:
 	virtual bool ReportFixture(b2Fixture* fixture) = 0;
 };
 
+/// A hit reported by b2World::QueryAABBBatch.
+struct B2_API b2FixtureQueryHit
+{
+	/// Index of the query AABB in the batch
+	int32 queryIndex;
+
+	/// Fixture whose fat AABB overlaps the query AABB
+	b2Fixture* fixture;
+
+	/// Child primitive index, e.g. the edge of a chain shape
+	int32 childIndex;
+};
+
+/// The closest hit of a ray, reported by b2World::RayCastBatch.
+struct B2_API b2RayCastHit
+{
+	/// Fixture hit by the ray, nullptr if the ray hit nothing
+	b2Fixture* fixture;
+
+	/// Point of initial intersection
+	b2Vec2 point;
+
+	/// Normal vector at the point of intersection
+	b2Vec2 normal;
+
+	/// Fraction along the ray at the point of intersection, the input max fraction for a miss
+	float fraction;
+};
+
+/// A swept shape for b2World::ShapeCastBatch.
+struct B2_API b2ShapeCastQuery
+{
+	/// The shape to sweep. All of its children are swept.
+	const b2Shape* shape;
+
+	/// The transform of the shape at the start of the sweep
+	b2Transform transform;
+
+	/// The translation of the sweep. The rotation is held fixed.
+	b2Vec2 translation;
+};
+
+/// The first hit of a swept shape, reported by b2World::ShapeCastBatch.
+struct B2_API b2ShapeCastHit
+{
+	/// Fixture hit by the shape, nullptr if the shape hit nothing
+	b2Fixture* fixture;
+
+	/// Child primitive of the fixture that was hit, e.g. the edge of a chain shape
+	int32 childIndex;
+
+	/// Point of first contact on the fixture
+	b2Vec2 point;
+
+	/// Normal of the fixture surface at the point of contact
+	b2Vec2 normal;
+
+	/// Fraction of the translation at the time of contact, one for a miss
+	float fraction;
+};
+
 /// Callback class for ray casts.
 /// See b2World::RayCast
 class B2_API b2RayCastCallback
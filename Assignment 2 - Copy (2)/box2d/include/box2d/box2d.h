@@ -36,10 +36,13 @@
 
 #include "b2_broad_phase.h"
 #include "b2_dynamic_tree.h"
+#include "b2_sort_and_sweep.h"
+#include "b2_uniform_grid.h"
 
 #include "b2_body.h"
 #include "b2_contact.h"
 #include "b2_fixture.h"
+#include "b2_thread_pool.h"
 #include "b2_time_step.h"
 #include "b2_world.h"
 #include "b2_world_callbacks.h"
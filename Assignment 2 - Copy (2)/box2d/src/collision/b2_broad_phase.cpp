@@ -21,10 +21,52 @@
 // SOFTWARE.
 
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_thread_pool.h"
+#include "common/b2_snapshot.h"
+
+#include <algorithm>
 #include <string.h>
 
+// A pair found on a worker thread, tagged with the move buffer index of its query.
+struct b2ThreadPair
+{
+	int32 moveIndex;
+	int32 proxyIdA;
+	int32 proxyIdB;
+};
+
+struct b2ThreadPairBuffer
+{
+	void Push(int32 moveIndex, int32 proxyIdA, int32 proxyIdB)
+	{
+		if (count == capacity)
+		{
+			b2ThreadPair* oldPairs = pairs;
+			capacity = b2Max(2 * capacity, 64);
+			pairs = (b2ThreadPair*)b2Alloc(capacity * sizeof(b2ThreadPair));
+			if (oldPairs)
+			{
+				memcpy(pairs, oldPairs, count * sizeof(b2ThreadPair));
+				b2Free(oldPairs);
+			}
+		}
+
+		b2ThreadPair* pair = pairs + count;
+		pair->moveIndex = moveIndex;
+		pair->proxyIdA = b2Min(proxyIdA, proxyIdB);
+		pair->proxyIdB = b2Max(proxyIdA, proxyIdB);
+		++count;
+	}
+
+	b2ThreadPair* pairs;
+	int32 count;
+	int32 capacity;
+	int32 readIndex;
+};
+
 b2BroadPhase::b2BroadPhase()
 {
+	m_type = b2_treeBroadPhase;
 	m_proxyCount = 0;
 
 	m_pairCapacity = 16;
@@ -34,17 +76,53 @@ b2BroadPhase::b2BroadPhase()
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_threadPairBuffers = nullptr;
+	m_threadPairBufferCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
+	for (int32 i = 0; i < m_threadPairBufferCount; ++i)
+	{
+		if (m_threadPairBuffers[i].pairs)
+		{
+			b2Free(m_threadPairBuffers[i].pairs);
+		}
+	}
+
+	if (m_threadPairBuffers)
+	{
+		b2Free(m_threadPairBuffers);
+	}
+
 	b2Free(m_moveBuffer);
 	b2Free(m_pairBuffer);
 }
 
+void b2BroadPhase::SetType(b2BroadPhaseType type, float gridCellSize)
+{
+	b2Assert(m_proxyCount == 0);
+	m_type = type;
+	m_grid.SetCellSize(gridCellSize);
+}
+
 int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	int32 proxyId;
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		proxyId = m_sortAndSweep.CreateProxy(aabb, userData);
+		break;
+	case b2_gridBroadPhase:
+		proxyId = m_grid.CreateProxy(aabb, userData);
+		break;
+	default:
+		proxyId = m_tree.CreateProxy(aabb, userData);
+		break;
+	}
+
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
@@ -54,12 +132,37 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.DestroyProxy(proxyId);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.DestroyProxy(proxyId);
+		break;
+	default:
+		m_tree.DestroyProxy(proxyId);
+		break;
+	}
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		buffer = m_sortAndSweep.MoveProxy(proxyId, aabb, displacement);
+		break;
+	case b2_gridBroadPhase:
+		buffer = m_grid.MoveProxy(proxyId, aabb, displacement);
+		break;
+	default:
+		buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+		break;
+	}
+
 	if (buffer)
 	{
 		BufferMove(proxyId);
@@ -97,7 +200,7 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 	}
 }
 
-// This is called from b2DynamicTree::Query when we are gathering pairs.
+// This is called from b2DynamicTree::Query and b2UniformGrid::Query when we are gathering pairs.
 bool b2BroadPhase::QueryCallback(int32 proxyId)
 {
 	// A proxy cannot form a pair with itself.
@@ -106,13 +209,21 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 		return true;
 	}
 
-	const bool moved = m_tree.WasMoved(proxyId);
+	const bool moved = WasMoved(proxyId);
 	if (moved && proxyId > m_queryProxyId)
 	{
 		// Both proxies are moving. Avoid duplicate pairs.
 		return true;
 	}
 
+	PairCallback(proxyId, m_queryProxyId);
+
+	return true;
+}
+
+// This is called from b2SortAndSweep::FindPairs, which reports each pair once.
+void b2BroadPhase::PairCallback(int32 proxyIdA, int32 proxyIdB)
+{
 	// Grow the pair buffer as needed.
 	if (m_pairCount == m_pairCapacity)
 	{
@@ -123,9 +234,311 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 		b2Free(oldBuffer);
 	}
 
-	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyId, m_queryProxyId);
-	m_pairBuffer[m_pairCount].proxyIdB = b2Max(proxyId, m_queryProxyId);
+	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyIdA, proxyIdB);
+	m_pairBuffer[m_pairCount].proxyIdB = b2Max(proxyIdA, proxyIdB);
 	++m_pairCount;
+}
 
-	return true;
+static bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
+{
+	if (pair1.proxyIdA < pair2.proxyIdA)
+	{
+		return true;
+	}
+
+	if (pair1.proxyIdA == pair2.proxyIdA)
+	{
+		return pair1.proxyIdB < pair2.proxyIdB;
+	}
+
+	return false;
+}
+
+void b2BroadPhase::SortPairs()
+{
+	std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, b2PairLessThan);
+}
+
+void b2BroadPhase::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_proxyCount);
+	writer->WriteArray(m_moveBuffer, m_moveCount, m_moveCapacity);
+
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.Save(writer);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.Save(writer);
+		break;
+	default:
+		m_tree.Save(writer);
+		break;
+	}
+}
+
+void b2BroadPhase::Restore(b2SnapshotReader* reader)
+{
+	m_proxyCount = reader->Read<int32>();
+	m_moveCount = reader->ReadArray(&m_moveBuffer, &m_moveCapacity);
+
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		m_sortAndSweep.Restore(reader);
+		break;
+	case b2_gridBroadPhase:
+		m_grid.Restore(reader);
+		break;
+	default:
+		m_tree.Restore(reader);
+		break;
+	}
+}
+
+int32 b2BroadPhase::Check(b2SnapshotReader* reader) const
+{
+	// The snapshot header has the proxy count of this broad-phase.
+	if (reader->Read<int32>() != m_proxyCount)
+	{
+		reader->invalid = true;
+	}
+
+	// The moved proxies are checked once the capacity is known.
+	int32 moveCapacity;
+	int32 moveCount = reader->ReadArrayHeader<int32>(&moveCapacity);
+	int32 maxMoveId = -1;
+	for (int32 i = 0; i < moveCount && reader->invalid == false; ++i)
+	{
+		int32 proxyId = reader->Read<int32>();
+		if (proxyId < e_nullProxy)
+		{
+			reader->invalid = true;
+		}
+		maxMoveId = b2Max(maxMoveId, proxyId);
+	}
+
+	int32 capacity;
+	switch (m_type)
+	{
+	case b2_sortAndSweepBroadPhase:
+		capacity = m_sortAndSweep.Check(reader);
+		break;
+	case b2_gridBroadPhase:
+		capacity = m_grid.Check(reader);
+		break;
+	default:
+		capacity = m_tree.Check(reader);
+		break;
+	}
+
+	if (maxMoveId >= capacity)
+	{
+		reader->invalid = true;
+	}
+
+	return capacity;
+}
+
+// Collects the hits of one query of a batch.
+struct b2BroadPhaseBatchWriter
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		if (count < capacity)
+		{
+			hits[count].queryIndex = queryIndex;
+			hits[count].proxyId = proxyId;
+		}
+		++count;
+		return true;
+	}
+
+	b2TreeQueryHit* hits;
+	int32 count;
+	int32 capacity;
+	int32 queryIndex;
+};
+
+int32 b2BroadPhase::QueryBatch(const b2AABB* aabbs, int32 count, b2TreeQueryHit* hits, int32 hitCapacity,
+							   b2ThreadPool* threadPool) const
+{
+	if (m_type == b2_treeBroadPhase)
+	{
+		return m_tree.QueryBatch(aabbs, count, hits, hitCapacity, threadPool);
+	}
+
+	b2BroadPhaseBatchWriter writer;
+	writer.hits = hits;
+	writer.count = 0;
+	writer.capacity = hitCapacity;
+	for (int32 i = 0; i < count; ++i)
+	{
+		writer.queryIndex = i;
+		Query(&writer, aabbs[i]);
+	}
+
+	return writer.count;
+}
+
+// Same filter as b2BroadPhase::QueryCallback, writing to a thread's buffer.
+struct b2PairQueryCallback
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		// A proxy cannot form a pair with itself.
+		if (proxyId == queryProxyId)
+		{
+			return true;
+		}
+
+		if (broadPhase->WasMoved(proxyId) && proxyId > queryProxyId)
+		{
+			// Both proxies are moving. Avoid duplicate pairs.
+			return true;
+		}
+
+		buffer->Push(moveIndex, proxyId, queryProxyId);
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2ThreadPairBuffer* buffer;
+	int32 queryProxyId;
+	int32 moveIndex;
+};
+
+class b2FindPairsTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		b2PairQueryCallback callback;
+		callback.broadPhase = broadPhase;
+		callback.buffer = buffers + threadIndex;
+
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 proxyId = moveBuffer[i];
+			if (proxyId == b2BroadPhase::e_nullProxy)
+			{
+				continue;
+			}
+
+			callback.queryProxyId = proxyId;
+			callback.moveIndex = i;
+			broadPhase->Query(&callback, broadPhase->GetFatAABB(proxyId));
+		}
+	}
+
+	const b2BroadPhase* broadPhase;
+	const int32* moveBuffer;
+	b2ThreadPairBuffer* buffers;
+};
+
+// Query the moved proxies on the thread pool. Queries only read the broad-phase,
+// so they can run concurrently. The pairs are merged into the pair buffer in move
+// buffer order, which is the order of the serial loop.
+void b2BroadPhase::FindPairsParallel(b2ThreadPool* threadPool)
+{
+	int32 threadCount = threadPool->GetThreadCount();
+	if (m_threadPairBufferCount < threadCount)
+	{
+		b2ThreadPairBuffer* oldBuffers = m_threadPairBuffers;
+		m_threadPairBuffers = (b2ThreadPairBuffer*)b2Alloc(threadCount * sizeof(b2ThreadPairBuffer));
+		memset(m_threadPairBuffers, 0, threadCount * sizeof(b2ThreadPairBuffer));
+		if (oldBuffers)
+		{
+			memcpy(m_threadPairBuffers, oldBuffers, m_threadPairBufferCount * sizeof(b2ThreadPairBuffer));
+			b2Free(oldBuffers);
+		}
+		m_threadPairBufferCount = threadCount;
+	}
+
+	for (int32 i = 0; i < threadCount; ++i)
+	{
+		m_threadPairBuffers[i].count = 0;
+		m_threadPairBuffers[i].readIndex = 0;
+	}
+
+	b2FindPairsTask task;
+	task.broadPhase = this;
+	task.moveBuffer = m_moveBuffer;
+	task.buffers = m_threadPairBuffers;
+
+	threadPool->ParallelFor(&task, m_moveCount, 32);
+
+	// Each thread processed increasing ranges, so every buffer is sorted by move index.
+	// A move index is handled by one thread, so merging keeps its pairs in query order.
+	for (;;)
+	{
+		b2ThreadPairBuffer* next = nullptr;
+		for (int32 i = 0; i < threadCount; ++i)
+		{
+			b2ThreadPairBuffer* buffer = m_threadPairBuffers + i;
+			if (buffer->readIndex == buffer->count)
+			{
+				continue;
+			}
+
+			if (next == nullptr || buffer->pairs[buffer->readIndex].moveIndex < next->pairs[next->readIndex].moveIndex)
+			{
+				next = buffer;
+			}
+		}
+
+		if (next == nullptr)
+		{
+			break;
+		}
+
+		// Copy the whole run of this move index.
+		int32 moveIndex = next->pairs[next->readIndex].moveIndex;
+		while (next->readIndex < next->count && next->pairs[next->readIndex].moveIndex == moveIndex)
+		{
+			const b2ThreadPair* pair = next->pairs + next->readIndex;
+			PairCallback(pair->proxyIdA, pair->proxyIdB);
+			next->readIndex += 1;
+		}
+	}
+}
+
+// Feeds the rays of a batch one by one to a batch callback.
+struct b2BroadPhaseRayCastWrapper
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		float maxFraction = input.maxFraction;
+		callback->RayCastProxy(proxyId, rayIndex, 1u, &maxFraction);
+		return maxFraction;
+	}
+
+	b2TreeRayCastBatchCallback* callback;
+	int32 rayIndex;
+};
+
+void b2BroadPhase::RayCastBatch(b2TreeRayCastBatchCallback* callback, const b2RayCastInput* inputs, int32 count,
+								b2ThreadPool* threadPool) const
+{
+	if (m_type == b2_treeBroadPhase)
+	{
+		m_tree.RayCastBatch(callback, inputs, count, threadPool);
+		return;
+	}
+
+	b2BroadPhaseRayCastWrapper wrapper;
+	wrapper.callback = callback;
+	for (int32 i = 0; i < count; ++i)
+	{
+		// Same rays as the tree skips.
+		const b2RayCastInput& input = inputs[i];
+		if (input.maxFraction <= 0.0f || (input.p2 - input.p1).Length() < b2_epsilon)
+		{
+			continue;
+		}
+
+		wrapper.rayIndex = i;
+		RayCast(&wrapper, input);
+	}
 }
@@ -23,6 +23,7 @@
 #include "box2d/b2_collision.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_polygon_shape.h"
+#include "b2_collide_wide.h"
 
 void b2CollideCircles(
 	b2Manifold* manifold,
@@ -88,6 +89,18 @@ void b2CollidePolygonAndCircle(
 		}
 	}
 
+	b2FinishCollidePolygonAndCircle(manifold, polygonA, circleB, cLocal, normalIndex, separation);
+}
+
+void b2FinishCollidePolygonAndCircle(b2Manifold* manifold,
+									 const b2PolygonShape* polygonA, const b2CircleShape* circleB,
+									 const b2Vec2& cLocal, int32 normalIndex, float separation)
+{
+	float radius = polygonA->m_radius + circleB->m_radius;
+	int32 vertexCount = polygonA->m_count;
+	const b2Vec2* vertices = polygonA->m_vertices;
+	const b2Vec2* normals = polygonA->m_normals;
+
 	// Vertices that subtend the incident face.
 	int32 vertIndex1 = normalIndex;
 	int32 vertIndex2 = vertIndex1 + 1 < vertexCount ? vertIndex1 + 1 : 0;
@@ -22,6 +22,7 @@
 
 #include "box2d/b2_collision.h"
 #include "box2d/b2_polygon_shape.h"
+#include "b2_collide_wide.h"
 
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
 static float b2FindMaxSeparation(int32* edgeIndex,
@@ -134,6 +135,16 @@ void b2CollidePolygons(b2Manifold* manifold,
 	if (separationB > totalRadius)
 		return;
 
+	b2FinishCollidePolygons(manifold, polyA, xfA, polyB, xfB, edgeA, separationA, edgeB, separationB);
+}
+
+void b2FinishCollidePolygons(b2Manifold* manifold,
+							 const b2PolygonShape* polyA, const b2Transform& xfA,
+							 const b2PolygonShape* polyB, const b2Transform& xfB,
+							 int32 edgeA, float separationA, int32 edgeB, float separationB)
+{
+	float totalRadius = polyA->m_radius + polyB->m_radius;
+
 	const b2PolygonShape* poly1;	// reference polygon
 	const b2PolygonShape* poly2;	// incident polygon
 	b2Transform xf1, xf2;
@@ -0,0 +1,311 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "box2d/b2_circle_shape.h"
+#include "box2d/b2_polygon_shape.h"
+#include "b2_collide_wide.h"
+#include "common/b2_simd.h"
+
+// Transforms of a group of pairs, one lane per pair.
+struct b2TransformLanes
+{
+	void Set(int32 lane, const b2Transform& xf)
+	{
+		c[lane] = xf.q.c;
+		s[lane] = xf.q.s;
+		px[lane] = xf.p.x;
+		py[lane] = xf.p.y;
+	}
+
+	alignas(b2_simdAlignment) float c[b2_simdWidth];
+	alignas(b2_simdAlignment) float s[b2_simdWidth];
+	alignas(b2_simdAlignment) float px[b2_simdWidth];
+	alignas(b2_simdAlignment) float py[b2_simdWidth];
+};
+
+// Polygons of a group of pairs, one lane per pair. Index i of a lane past the polygon
+// count repeats the last vertex and normal. That changes no minimum and no maximum
+// below, because the maximum only moves on a strict increase.
+struct b2PolygonLanes
+{
+	void Set(const b2PolygonShape* const* polygons)
+	{
+		maxCount = 0;
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			maxCount = b2Max(maxCount, polygons[lane]->m_count);
+		}
+
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			const b2PolygonShape* polygon = polygons[lane];
+			int32 last = polygon->m_count - 1;
+			for (int32 i = 0; i < maxCount; ++i)
+			{
+				int32 k = b2Min(i, last);
+				vx[i][lane] = polygon->m_vertices[k].x;
+				vy[i][lane] = polygon->m_vertices[k].y;
+				nx[i][lane] = polygon->m_normals[k].x;
+				ny[i][lane] = polygon->m_normals[k].y;
+			}
+		}
+	}
+
+	alignas(b2_simdAlignment) float vx[b2_maxPolygonVertices][b2_simdWidth];
+	alignas(b2_simdAlignment) float vy[b2_maxPolygonVertices][b2_simdWidth];
+	alignas(b2_simdAlignment) float nx[b2_maxPolygonVertices][b2_simdWidth];
+	alignas(b2_simdAlignment) float ny[b2_maxPolygonVertices][b2_simdWidth];
+	int32 maxCount;
+};
+
+// b2FindMaxSeparation for each lane. xf takes poly1 into the frame of poly2.
+static void b2FindMaxSeparationWide(float* separations, float* edges,
+									const b2PolygonLanes* poly1, const b2PolygonLanes* poly2,
+									const b2TransformLanes* xf)
+{
+	b2FloatW c = b2LoadW(xf->c);
+	b2FloatW s = b2LoadW(xf->s);
+	b2FloatW px = b2LoadW(xf->px);
+	b2FloatW py = b2LoadW(xf->py);
+
+	b2FloatW bestIndex = b2ZeroW();
+	b2FloatW maxSeparation = b2SplatW(-b2_maxFloat);
+	for (int32 i = 0; i < poly1->maxCount; ++i)
+	{
+		// Get poly1 normal in frame2.
+		b2FloatW n1x = b2LoadW(poly1->nx[i]);
+		b2FloatW n1y = b2LoadW(poly1->ny[i]);
+		b2FloatW nx = b2SubW(b2MulW(c, n1x), b2MulW(s, n1y));
+		b2FloatW ny = b2AddW(b2MulW(s, n1x), b2MulW(c, n1y));
+
+		b2FloatW v1x = b2LoadW(poly1->vx[i]);
+		b2FloatW v1y = b2LoadW(poly1->vy[i]);
+		b2FloatW wx = b2AddW(b2SubW(b2MulW(c, v1x), b2MulW(s, v1y)), px);
+		b2FloatW wy = b2AddW(b2AddW(b2MulW(s, v1x), b2MulW(c, v1y)), py);
+
+		// Find deepest point for normal i.
+		b2FloatW si = b2SplatW(b2_maxFloat);
+		for (int32 j = 0; j < poly2->maxCount; ++j)
+		{
+			b2FloatW dx = b2SubW(b2LoadW(poly2->vx[j]), wx);
+			b2FloatW dy = b2SubW(b2LoadW(poly2->vy[j]), wy);
+			b2FloatW sij = b2AddW(b2MulW(nx, dx), b2MulW(ny, dy));
+			si = b2MinW(sij, si);
+		}
+
+		b2FloatW greater = b2LessW(maxSeparation, si);
+		maxSeparation = b2BlendW(maxSeparation, si, greater);
+		bestIndex = b2BlendW(bestIndex, b2SplatW(float(i)), greater);
+	}
+
+	b2StoreW(separations, maxSeparation);
+	b2StoreW(edges, bestIndex);
+}
+
+void b2CollidePolygonsWide(const b2ShapePair* pairs, int32 count)
+{
+	b2Assert(0 < count && count <= b2_simdWidth);
+
+	// Unused lanes repeat the last pair.
+	const b2PolygonShape* polygonsA[b2_simdWidth];
+	const b2PolygonShape* polygonsB[b2_simdWidth];
+	b2TransformLanes xfAB, xfBA;
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2ShapePair* pair = pairs + b2Min(lane, count - 1);
+		polygonsA[lane] = (const b2PolygonShape*)pair->shapeA;
+		polygonsB[lane] = (const b2PolygonShape*)pair->shapeB;
+		xfAB.Set(lane, b2MulT(*pair->xfB, *pair->xfA));
+		xfBA.Set(lane, b2MulT(*pair->xfA, *pair->xfB));
+	}
+
+	b2PolygonLanes lanesA, lanesB;
+	lanesA.Set(polygonsA);
+	lanesB.Set(polygonsB);
+
+	alignas(b2_simdAlignment) float separationA[b2_simdWidth];
+	alignas(b2_simdAlignment) float edgeA[b2_simdWidth];
+	b2FindMaxSeparationWide(separationA, edgeA, &lanesA, &lanesB, &xfAB);
+
+	// The second search is only needed if some pair is not separated yet.
+	bool separated = true;
+	for (int32 lane = 0; lane < count; ++lane)
+	{
+		float totalRadius = polygonsA[lane]->m_radius + polygonsB[lane]->m_radius;
+		separated = separated && separationA[lane] > totalRadius;
+	}
+
+	alignas(b2_simdAlignment) float separationB[b2_simdWidth];
+	alignas(b2_simdAlignment) float edgeB[b2_simdWidth];
+	if (separated == false)
+	{
+		b2FindMaxSeparationWide(separationB, edgeB, &lanesB, &lanesA, &xfBA);
+	}
+	else
+	{
+		// Every lane exits on separationA, but keep the lanes defined.
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			separationB[lane] = -b2_maxFloat;
+			edgeB[lane] = 0.0f;
+		}
+	}
+
+	for (int32 lane = 0; lane < count; ++lane)
+	{
+		const b2ShapePair* pair = pairs + lane;
+		pair->manifold->pointCount = 0;
+
+		float totalRadius = polygonsA[lane]->m_radius + polygonsB[lane]->m_radius;
+		if (separationA[lane] > totalRadius || separationB[lane] > totalRadius)
+		{
+			continue;
+		}
+
+		b2FinishCollidePolygons(pair->manifold, polygonsA[lane], *pair->xfA, polygonsB[lane], *pair->xfB,
+								int32(edgeA[lane]), separationA[lane], int32(edgeB[lane]), separationB[lane]);
+	}
+}
+
+void b2CollidePolygonAndCircleWide(const b2ShapePair* pairs, int32 count)
+{
+	b2Assert(0 < count && count <= b2_simdWidth);
+
+	// Compute the circle positions in the frames of the polygons.
+	const b2PolygonShape* polygons[b2_simdWidth];
+	alignas(b2_simdAlignment) float cx[b2_simdWidth];
+	alignas(b2_simdAlignment) float cy[b2_simdWidth];
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2ShapePair* pair = pairs + b2Min(lane, count - 1);
+		const b2CircleShape* circle = (const b2CircleShape*)pair->shapeB;
+		polygons[lane] = (const b2PolygonShape*)pair->shapeA;
+		b2Vec2 cLocal = b2MulT(*pair->xfA, b2Mul(*pair->xfB, circle->m_p));
+		cx[lane] = cLocal.x;
+		cy[lane] = cLocal.y;
+	}
+
+	b2PolygonLanes lanes;
+	lanes.Set(polygons);
+
+	// Find the min separating edge.
+	b2FloatW cLocalX = b2LoadW(cx);
+	b2FloatW cLocalY = b2LoadW(cy);
+	b2FloatW normalIndex = b2ZeroW();
+	b2FloatW separation = b2SplatW(-b2_maxFloat);
+	for (int32 i = 0; i < lanes.maxCount; ++i)
+	{
+		b2FloatW dx = b2SubW(cLocalX, b2LoadW(lanes.vx[i]));
+		b2FloatW dy = b2SubW(cLocalY, b2LoadW(lanes.vy[i]));
+		b2FloatW s = b2AddW(b2MulW(b2LoadW(lanes.nx[i]), dx), b2MulW(b2LoadW(lanes.ny[i]), dy));
+
+		b2FloatW greater = b2LessW(separation, s);
+		separation = b2BlendW(separation, s, greater);
+		normalIndex = b2BlendW(normalIndex, b2SplatW(float(i)), greater);
+	}
+
+	alignas(b2_simdAlignment) float separations[b2_simdWidth];
+	alignas(b2_simdAlignment) float normalIndices[b2_simdWidth];
+	b2StoreW(separations, separation);
+	b2StoreW(normalIndices, normalIndex);
+
+	for (int32 lane = 0; lane < count; ++lane)
+	{
+		const b2ShapePair* pair = pairs + lane;
+		const b2CircleShape* circle = (const b2CircleShape*)pair->shapeB;
+		pair->manifold->pointCount = 0;
+
+		// The scalar version exits early on any edge beyond the radius, which is
+		// the same as the largest separation being beyond the radius.
+		float radius = polygons[lane]->m_radius + circle->m_radius;
+		if (separations[lane] > radius)
+		{
+			continue;
+		}
+
+		b2FinishCollidePolygonAndCircle(pair->manifold, polygons[lane], circle, b2Vec2(cx[lane], cy[lane]),
+										int32(normalIndices[lane]), separations[lane]);
+	}
+}
+
+void b2CollideCirclesWide(const b2ShapePair* pairs, int32 count)
+{
+	b2Assert(0 < count && count <= b2_simdWidth);
+
+	b2TransformLanes xfA, xfB;
+	alignas(b2_simdAlignment) float ax[b2_simdWidth];
+	alignas(b2_simdAlignment) float ay[b2_simdWidth];
+	alignas(b2_simdAlignment) float bx[b2_simdWidth];
+	alignas(b2_simdAlignment) float by[b2_simdWidth];
+	alignas(b2_simdAlignment) float radii[b2_simdWidth];
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2ShapePair* pair = pairs + b2Min(lane, count - 1);
+		const b2CircleShape* circleA = (const b2CircleShape*)pair->shapeA;
+		const b2CircleShape* circleB = (const b2CircleShape*)pair->shapeB;
+		xfA.Set(lane, *pair->xfA);
+		xfB.Set(lane, *pair->xfB);
+		ax[lane] = circleA->m_p.x;
+		ay[lane] = circleA->m_p.y;
+		bx[lane] = circleB->m_p.x;
+		by[lane] = circleB->m_p.y;
+		radii[lane] = circleA->m_radius + circleB->m_radius;
+	}
+
+	b2FloatW cA = b2LoadW(xfA.c), sA = b2LoadW(xfA.s);
+	b2FloatW cB = b2LoadW(xfB.c), sB = b2LoadW(xfB.s);
+	b2FloatW localAx = b2LoadW(ax), localAy = b2LoadW(ay);
+	b2FloatW localBx = b2LoadW(bx), localBy = b2LoadW(by);
+
+	b2FloatW pAx = b2AddW(b2SubW(b2MulW(cA, localAx), b2MulW(sA, localAy)), b2LoadW(xfA.px));
+	b2FloatW pAy = b2AddW(b2AddW(b2MulW(sA, localAx), b2MulW(cA, localAy)), b2LoadW(xfA.py));
+	b2FloatW pBx = b2AddW(b2SubW(b2MulW(cB, localBx), b2MulW(sB, localBy)), b2LoadW(xfB.px));
+	b2FloatW pBy = b2AddW(b2AddW(b2MulW(sB, localBx), b2MulW(cB, localBy)), b2LoadW(xfB.py));
+
+	b2FloatW dx = b2SubW(pBx, pAx);
+	b2FloatW dy = b2SubW(pBy, pAy);
+	b2FloatW distSqr = b2AddW(b2MulW(dx, dx), b2MulW(dy, dy));
+	b2FloatW radius = b2LoadW(radii);
+
+	// distSqr > radius * radius
+	uint32 separated = b2MaskBitsW(b2LessW(b2MulW(radius, radius), distSqr));
+
+	for (int32 lane = 0; lane < count; ++lane)
+	{
+		const b2ShapePair* pair = pairs + lane;
+		b2Manifold* manifold = pair->manifold;
+		manifold->pointCount = 0;
+		if (separated & (1u << lane))
+		{
+			continue;
+		}
+
+		const b2CircleShape* circleA = (const b2CircleShape*)pair->shapeA;
+		const b2CircleShape* circleB = (const b2CircleShape*)pair->shapeB;
+		manifold->type = b2Manifold::e_circles;
+		manifold->localPoint = circleA->m_p;
+		manifold->localNormal.SetZero();
+		manifold->pointCount = 1;
+
+		manifold->points[0].localPoint = circleB->m_p;
+		manifold->points[0].id.key = 0;
+	}
+}
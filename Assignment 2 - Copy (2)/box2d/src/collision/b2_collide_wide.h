@@ -0,0 +1,60 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef B2_COLLIDE_WIDE_H
+#define B2_COLLIDE_WIDE_H
+
+#include "box2d/b2_collision.h"
+
+class b2CircleShape;
+class b2PolygonShape;
+
+// A shape pair for the wide narrow phase kernels. The kernel writes the manifold.
+struct b2ShapePair
+{
+	const b2Shape* shapeA;
+	const b2Shape* shapeB;
+	const b2Transform* xfA;
+	const b2Transform* xfB;
+	b2Manifold* manifold;
+};
+
+// Collide up to b2_simdWidth pairs of the same shape types at once. The lanes run the
+// arithmetic of b2CollidePolygons, b2CollidePolygonAndCircle and b2CollideCircles in
+// the same order, so each manifold matches the scalar function bit for bit.
+void b2CollidePolygonsWide(const b2ShapePair* pairs, int32 count);
+void b2CollidePolygonAndCircleWide(const b2ShapePair* pairs, int32 count);
+void b2CollideCirclesWide(const b2ShapePair* pairs, int32 count);
+
+// The scalar rest of b2CollidePolygons after both separating axis searches passed.
+// The manifold point count must already be zero.
+void b2FinishCollidePolygons(b2Manifold* manifold,
+							 const b2PolygonShape* polyA, const b2Transform& xfA,
+							 const b2PolygonShape* polyB, const b2Transform& xfB,
+							 int32 edgeA, float separationA, int32 edgeB, float separationB);
+
+// The scalar rest of b2CollidePolygonAndCircle after the separating axis search passed.
+// The manifold point count must already be zero.
+void b2FinishCollidePolygonAndCircle(b2Manifold* manifold,
+									 const b2PolygonShape* polygonA, const b2CircleShape* circleB,
+									 const b2Vec2& cLocal, int32 normalIndex, float separation);
+
+#endif
@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
 #include "box2d/b2_distance.h"
 
@@ -240,6 +241,27 @@ bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB)
 {
+	b2SimplexCache cache;
+	cache.count = 0;
+	return b2TestOverlap(shapeA, indexA, shapeB, indexB, xfA, xfB, &cache);
+}
+
+bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
+					const b2Shape* shapeB, int32 indexB,
+					const b2Transform& xfA, const b2Transform& xfB,
+					b2SimplexCache* cache)
+{
+	// Circles are common sensor shapes and don't need GJK.
+	if (shapeA->m_type == b2Shape::e_circle && shapeB->m_type == b2Shape::e_circle)
+	{
+		const b2CircleShape* circleA = (const b2CircleShape*)shapeA;
+		const b2CircleShape* circleB = (const b2CircleShape*)shapeB;
+		b2Vec2 pA = b2Mul(xfA, circleA->m_p);
+		b2Vec2 pB = b2Mul(xfB, circleB->m_p);
+		float radius = circleA->m_radius + circleB->m_radius + 10.0f * b2_epsilon;
+		return b2DistanceSquared(pA, pB) < radius * radius;
+	}
+
 	b2DistanceInput input;
 	input.proxyA.Set(shapeA, indexA);
 	input.proxyB.Set(shapeB, indexB);
@@ -247,12 +269,19 @@ bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 	input.transformB = xfB;
 	input.useRadii = true;
 
-	b2SimplexCache cache;
-	cache.count = 0;
+	// A shape can be edited between calls, so drop a cache that no longer fits it.
+	for (int32 i = 0; i < cache->count; ++i)
+	{
+		if (cache->indexA[i] >= input.proxyA.m_count || cache->indexB[i] >= input.proxyB.m_count)
+		{
+			cache->count = 0;
+			break;
+		}
+	}
 
 	b2DistanceOutput output;
 
-	b2Distance(&output, &cache, &input);
+	b2Distance(&output, cache, &input);
 
 	return output.distance < 10.0f * b2_epsilon;
 }
@@ -25,9 +25,14 @@
 #include "box2d/b2_edge_shape.h"
 #include "box2d/b2_chain_shape.h"
 #include "box2d/b2_polygon_shape.h"
+#include "common/b2_simd.h"
+
+#include <atomic>
 
 // GJK using Voronoi regions (Christer Ericson) and Barycentric coordinates.
-B2_API int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
+// These statistics are for testing. Sensors and batched TOI call GJK on a thread
+// pool, so they are atomic and each call adds its totals once.
+B2_API std::atomic<int32> b2_gjkCalls(0), b2_gjkIters(0), b2_gjkMaxIters(0);
 
 void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 {
@@ -93,6 +98,16 @@ void b2DistanceProxy::Set(const b2Vec2* vertices, int32 count, float radius)
     m_radius = radius;
 }
 
+int32 b2DistanceProxy::GetSupport(const b2Vec2& d) const
+{
+	return b2SupportIndex(m_vertices, m_count, d);
+}
+
+const b2Vec2& b2DistanceProxy::GetSupportVertex(const b2Vec2& d) const
+{
+	return m_vertices[b2SupportIndex(m_vertices, m_count, d)];
+}
+
 struct b2SimplexVertex
 {
 	b2Vec2 wA;		// support point in proxyA
@@ -455,7 +470,7 @@ void b2Distance(b2DistanceOutput* output,
 				b2SimplexCache* cache,
 				const b2DistanceInput* input)
 {
-	++b2_gjkCalls;
+	b2_gjkCalls.fetch_add(1, std::memory_order_relaxed);
 
 	const b2DistanceProxy* proxyA = &input->proxyA;
 	const b2DistanceProxy* proxyB = &input->proxyB;
@@ -536,7 +551,6 @@ void b2Distance(b2DistanceOutput* output,
 
 		// Iteration count is equated to the number of support point calls.
 		++iter;
-		++b2_gjkIters;
 
 		// Check for duplicate support points. This is the main termination criteria.
 		bool duplicate = false;
@@ -559,7 +573,11 @@ void b2Distance(b2DistanceOutput* output,
 		++simplex.m_count;
 	}
 
-	b2_gjkMaxIters = b2Max(b2_gjkMaxIters, iter);
+	b2_gjkIters.fetch_add(iter, std::memory_order_relaxed);
+	int32 maxIters = b2_gjkMaxIters.load(std::memory_order_relaxed);
+	while (iter > maxIters && b2_gjkMaxIters.compare_exchange_weak(maxIters, iter, std::memory_order_relaxed) == false)
+	{
+	}
 
 	// Prepare output.
 	simplex.GetWitnessPoints(&output->pointA, &output->pointB);
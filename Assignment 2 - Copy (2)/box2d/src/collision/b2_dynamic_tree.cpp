@@ -20,6 +20,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 #include "box2d/b2_dynamic_tree.h"
+#include "box2d/b2_thread_pool.h"
+#include "common/b2_simd.h"
+#include "common/b2_snapshot.h"
+
 #include <string.h>
 
 b2DynamicTree::b2DynamicTree()
@@ -42,12 +46,21 @@ b2DynamicTree::b2DynamicTree()
 	m_freeList = 0;
 
 	m_insertionCount = 0;
+	m_refitMode = false;
+
+	m_compactNodes = nullptr;
+	m_compactCount = 0;
+	m_compactCapacity = 0;
+	m_compactRoot = b2_nullNode;
+	m_compactMode = false;
+	m_compactValid = false;
 }
 
 b2DynamicTree::~b2DynamicTree()
 {
 	// This frees the entire tree in one shot.
 	b2Free(m_nodes);
+	b2Free(m_compactNodes);
 }
 
 // Allocate a node from the pool. Grow the pool if necessary.
@@ -136,59 +149,27 @@ bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& d
 
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
-	// Extend AABB
-	b2AABB fatAABB;
-	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
-	fatAABB.lowerBound = aabb.lowerBound - r;
-	fatAABB.upperBound = aabb.upperBound + r;
-
-	// Predict AABB movement
-	b2Vec2 d = b2_aabbMultiplier * displacement;
-
-	if (d.x < 0.0f)
-	{
-		fatAABB.lowerBound.x += d.x;
-	}
-	else
+	b2AABB fatAABB = b2MakeFatAABB(aabb, displacement);
+	if (b2FatAABBNeedsUpdate(m_nodes[proxyId].aabb, aabb, fatAABB) == false)
 	{
-		fatAABB.upperBound.x += d.x;
+		// No tree update needed.
+		return false;
 	}
 
-	if (d.y < 0.0f)
+	if (m_refitMode)
 	{
-		fatAABB.lowerBound.y += d.y;
+		m_nodes[proxyId].aabb = fatAABB;
+		RefitAncestors(m_nodes[proxyId].parent);
 	}
 	else
 	{
-		fatAABB.upperBound.y += d.y;
-	}
-
-	const b2AABB& treeAABB = m_nodes[proxyId].aabb;
-	if (treeAABB.Contains(aabb))
-	{
-		// The tree AABB still contains the object, but it might be too large.
-		// Perhaps the object was moving fast but has since gone to sleep.
-		// The huge AABB is larger than the new fat AABB.
-		b2AABB hugeAABB;
-		hugeAABB.lowerBound = fatAABB.lowerBound - 4.0f * r;
-		hugeAABB.upperBound = fatAABB.upperBound + 4.0f * r;
+		RemoveLeaf(proxyId);
 
-		if (hugeAABB.Contains(treeAABB))
-		{
-			// The tree AABB contains the object AABB and the tree AABB is
-			// not too large. No tree update needed.
-			return false;
-		}
+		m_nodes[proxyId].aabb = fatAABB;
 
-		// Otherwise the tree AABB is huge and needs to be shrunk
+		InsertLeaf(proxyId);
 	}
 
-	RemoveLeaf(proxyId);
-
-	m_nodes[proxyId].aabb = fatAABB;
-
-	InsertLeaf(proxyId);
-
 	m_nodes[proxyId].moved = true;
 
 	return true;
@@ -197,6 +178,7 @@ bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& d
 void b2DynamicTree::InsertLeaf(int32 leaf)
 {
 	++m_insertionCount;
+	m_compactValid = false;
 
 	if (m_root == b2_nullNode)
 	{
@@ -336,6 +318,8 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 void b2DynamicTree::RemoveLeaf(int32 leaf)
 {
+	m_compactValid = false;
+
 	if (leaf == m_root)
 	{
 		m_root = b2_nullNode;
@@ -716,6 +700,8 @@ int32 b2DynamicTree::GetMaxBalance() const
 
 void b2DynamicTree::RebuildBottomUp()
 {
+	m_compactValid = false;
+
 	int32* nodes = (int32*)b2Alloc(m_nodeCount * sizeof(int32));
 	int32 count = 0;
 
@@ -790,8 +776,902 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+// Recompute ancestor AABBs after a leaf changed. Stops once an AABB is unchanged.
+void b2DynamicTree::RefitAncestors(int32 index)
+{
+	m_compactValid = false;
+
+	while (index != b2_nullNode)
+	{
+		b2TreeNode* node = m_nodes + index;
+
+		b2AABB aabb;
+		aabb.Combine(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb);
+		if (aabb.lowerBound == node->aabb.lowerBound && aabb.upperBound == node->aabb.upperBound)
+		{
+			break;
+		}
+
+		node->aabb = aabb;
+		index = node->parent;
+	}
+}
+
+void b2DynamicTree::GetQuality(b2TreeQuality* quality) const
+{
+	quality->height = GetHeight();
+	quality->maxBalance = GetMaxBalance();
+	quality->areaRatio = GetAreaRatio();
+}
+
+#define b2_treeBinCount 16
+
+struct b2TreeBin
+{
+	b2AABB aabb;
+	int32 count;
+};
+
+static int32 b2GetTreeBin(float center, float minCenter, float binScale)
+{
+	int32 bin = int32(binScale * (center - minCenter));
+	return b2Clamp(bin, 0, b2_treeBinCount - 1);
+}
+
+// Split leaves into two non-empty groups along the axis with the largest center extent.
+// The split plane between bins that minimizes the surface area heuristic is chosen.
+// Returns the number of leaves in the first group.
+int32 b2DynamicTree::PartitionSAH(int32* leaves, b2Vec2* centers, int32 count)
+{
+	b2Assert(count > 1);
+
+	if (count == 2)
+	{
+		return 1;
+	}
+
+	b2Vec2 lowerBound = centers[0];
+	b2Vec2 upperBound = centers[0];
+	for (int32 i = 1; i < count; ++i)
+	{
+		lowerBound = b2Min(lowerBound, centers[i]);
+		upperBound = b2Max(upperBound, centers[i]);
+	}
+
+	b2Vec2 extent = upperBound - lowerBound;
+	int32 axis = extent.x >= extent.y ? 0 : 1;
+	float axisExtent = axis == 0 ? extent.x : extent.y;
+	if (axisExtent <= 0.0f)
+	{
+		// All centers are the same. Split in the middle.
+		return count / 2;
+	}
+
+	float minCenter = axis == 0 ? lowerBound.x : lowerBound.y;
+	float binScale = b2_treeBinCount / axisExtent;
+
+	b2TreeBin bins[b2_treeBinCount];
+	for (int32 i = 0; i < b2_treeBinCount; ++i)
+	{
+		bins[i].count = 0;
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		float center = axis == 0 ? centers[i].x : centers[i].y;
+		b2TreeBin* bin = bins + b2GetTreeBin(center, minCenter, binScale);
+		const b2AABB& aabb = m_nodes[leaves[i]].aabb;
+		if (bin->count == 0)
+		{
+			bin->aabb = aabb;
+		}
+		else
+		{
+			bin->aabb.Combine(aabb);
+		}
+		bin->count += 1;
+	}
+
+	// Sweep from the right to get the cost of the right side of each plane.
+	// Plane i separates bins [0, i] from bins [i + 1, b2_treeBinCount).
+	float rightCosts[b2_treeBinCount - 1];
+	int32 rightCounts[b2_treeBinCount - 1];
+	b2AABB rightAABB;
+	int32 rightCount = 0;
+	for (int32 i = b2_treeBinCount - 1; i > 0; --i)
+	{
+		if (bins[i].count > 0)
+		{
+			if (rightCount == 0)
+			{
+				rightAABB = bins[i].aabb;
+			}
+			else
+			{
+				rightAABB.Combine(bins[i].aabb);
+			}
+			rightCount += bins[i].count;
+		}
+
+		rightCounts[i - 1] = rightCount;
+		rightCosts[i - 1] = rightCount > 0 ? rightCount * rightAABB.GetPerimeter() : 0.0f;
+	}
+
+	float bestCost = b2_maxFloat;
+	int32 bestPlane = -1;
+	b2AABB leftAABB;
+	int32 leftCount = 0;
+	for (int32 i = 0; i < b2_treeBinCount - 1; ++i)
+	{
+		if (bins[i].count > 0)
+		{
+			if (leftCount == 0)
+			{
+				leftAABB = bins[i].aabb;
+			}
+			else
+			{
+				leftAABB.Combine(bins[i].aabb);
+			}
+			leftCount += bins[i].count;
+		}
+
+		if (leftCount == 0 || rightCounts[i] == 0)
+		{
+			continue;
+		}
+
+		float cost = leftCount * leftAABB.GetPerimeter() + rightCosts[i];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestPlane = i;
+		}
+	}
+
+	// The first and last bins are occupied, so some plane is valid.
+	b2Assert(bestPlane != -1);
+
+	// Partition in place.
+	int32 i1 = 0;
+	int32 i2 = count;
+	while (i1 < i2)
+	{
+		float center = axis == 0 ? centers[i1].x : centers[i1].y;
+		if (b2GetTreeBin(center, minCenter, binScale) <= bestPlane)
+		{
+			++i1;
+		}
+		else
+		{
+			--i2;
+			b2Swap(leaves[i1], leaves[i2]);
+			b2Swap(centers[i1], centers[i2]);
+		}
+	}
+
+	b2Assert(0 < i1 && i1 < count);
+	return i1;
+}
+
+struct b2TreeBuildItem
+{
+	int32 nodeId;
+	int32 start;
+	int32 count;
+};
+
+// Build a sub-tree over the given leaves and return its root. The internal nodes
+// are allocated from the pool. Uses an explicit stack because a poor split
+// sequence can make the tree deep.
+int32 b2DynamicTree::BuildTopDown(int32* leaves, b2Vec2* centers, int32 count)
+{
+	b2Assert(count > 0);
+
+	if (count == 1)
+	{
+		m_nodes[leaves[0]].parent = b2_nullNode;
+		return leaves[0];
+	}
+
+	// Internal nodes in allocation order. Parents come before their children.
+	int32* internalNodes = (int32*)b2Alloc((count - 1) * sizeof(int32));
+	int32 internalCount = 0;
+
+	int32 root = AllocateNode();
+	internalNodes[internalCount++] = root;
+
+	b2GrowableStack<b2TreeBuildItem, 64> stack;
+	b2TreeBuildItem rootItem = { root, 0, count };
+	stack.Push(rootItem);
+
+	while (stack.GetCount() > 0)
+	{
+		b2TreeBuildItem item = stack.Pop();
+		int32 split = PartitionSAH(leaves + item.start, centers + item.start, item.count);
+
+		int32 starts[2] = { item.start, item.start + split };
+		int32 counts[2] = { split, item.count - split };
+		int32 children[2];
+		for (int32 i = 0; i < 2; ++i)
+		{
+			if (counts[i] == 1)
+			{
+				children[i] = leaves[starts[i]];
+			}
+			else
+			{
+				children[i] = AllocateNode();
+				internalNodes[internalCount++] = children[i];
+
+				b2TreeBuildItem childItem = { children[i], starts[i], counts[i] };
+				stack.Push(childItem);
+			}
+
+			m_nodes[children[i]].parent = item.nodeId;
+		}
+
+		m_nodes[item.nodeId].child1 = children[0];
+		m_nodes[item.nodeId].child2 = children[1];
+	}
+
+	b2Assert(internalCount == count - 1);
+
+	// Compute bounds and heights, children first.
+	for (int32 i = internalCount - 1; i >= 0; --i)
+	{
+		b2TreeNode* node = m_nodes + internalNodes[i];
+		const b2TreeNode* child1 = m_nodes + node->child1;
+		const b2TreeNode* child2 = m_nodes + node->child2;
+		node->aabb.Combine(child1->aabb, child2->aabb);
+		node->height = 1 + b2Max(child1->height, child2->height);
+	}
+
+	b2Free(internalNodes);
+
+	m_nodes[root].parent = b2_nullNode;
+	return root;
+}
+
+void b2DynamicTree::RebuildSubtree(int32 proxyId, int32 levels)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	b2Assert(m_nodes[proxyId].IsLeaf());
+
+	int32 nodeId = proxyId;
+	for (int32 i = 0; i < levels && m_nodes[nodeId].parent != b2_nullNode; ++i)
+	{
+		nodeId = m_nodes[nodeId].parent;
+	}
+
+	RebuildNode(nodeId);
+	Validate();
+}
+
+void b2DynamicTree::RebuildNode(int32 nodeId)
+{
+	b2Assert(0 <= nodeId && nodeId < m_nodeCapacity);
+	b2Assert(m_nodes[nodeId].height >= 0);
+
+	if (m_nodes[nodeId].IsLeaf())
+	{
+		return;
+	}
+
+	m_compactValid = false;
+
+	int32 parent = m_nodes[nodeId].parent;
+	bool isChild1 = parent != b2_nullNode && m_nodes[parent].child1 == nodeId;
+
+	// A sub-tree of height h has at most 2^h leaves.
+	int32 capacity = m_nodes[nodeId].height < 30 ? b2Min(m_nodeCount, 1 << m_nodes[nodeId].height) : m_nodeCount;
+	int32* leaves = (int32*)b2Alloc(capacity * sizeof(int32));
+	int32 leafCount = 0;
+
+	// Collect the leaves and free the internal nodes.
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(nodeId);
+	while (stack.GetCount() > 0)
+	{
+		int32 index = stack.Pop();
+		b2TreeNode* node = m_nodes + index;
+		if (node->IsLeaf())
+		{
+			b2Assert(leafCount < capacity);
+			leaves[leafCount++] = index;
+			continue;
+		}
+
+		stack.Push(node->child1);
+		stack.Push(node->child2);
+		FreeNode(index);
+	}
+
+	b2Vec2* centers = (b2Vec2*)b2Alloc(leafCount * sizeof(b2Vec2));
+	for (int32 i = 0; i < leafCount; ++i)
+	{
+		centers[i] = m_nodes[leaves[i]].aabb.GetCenter();
+	}
+
+	int32 root = BuildTopDown(leaves, centers, leafCount);
+
+	b2Free(centers);
+	b2Free(leaves);
+
+	m_nodes[root].parent = parent;
+	if (parent == b2_nullNode)
+	{
+		m_root = root;
+		return;
+	}
+
+	if (isChild1)
+	{
+		m_nodes[parent].child1 = root;
+	}
+	else
+	{
+		m_nodes[parent].child2 = root;
+	}
+
+	// The bounds above are unchanged but the heights may differ.
+	for (int32 index = parent; index != b2_nullNode; index = m_nodes[index].parent)
+	{
+		b2TreeNode* node = m_nodes + index;
+		node->height = 1 + b2Max(m_nodes[node->child1].height, m_nodes[node->child2].height);
+	}
+}
+
+void b2DynamicTree::Rebuild(b2TreeQuality* before, b2TreeQuality* after)
+{
+	if (before)
+	{
+		GetQuality(before);
+	}
+
+	if (m_root != b2_nullNode)
+	{
+		RebuildNode(m_root);
+	}
+
+	if (after)
+	{
+		GetQuality(after);
+	}
+
+	Validate();
+}
+
+void b2DynamicTree::SetCompactMode(bool flag)
+{
+	m_compactMode = flag;
+	m_compactValid = false;
+
+	if (flag == false)
+	{
+		b2Free(m_compactNodes);
+		m_compactNodes = nullptr;
+		m_compactCount = 0;
+		m_compactCapacity = 0;
+	}
+}
+
+// Quantize a child AABB relative to the frame of its parent. The codes are moved outward
+// until the decoded bounds contain the child, so the compact walk never culls a node
+// that the regular walk visits. Returns the decoded bounds, which frame the grandchildren.
+static void b2EncodeCompactBounds(uint16* bounds, b2AABB* decoded, const b2AABB& aabb, const b2AABB& frame,
+								  const b2Vec2& step, const b2Vec2& invStep)
+{
+	float lx = b2Clamp((aabb.lowerBound.x - frame.lowerBound.x) * invStep.x, 0.0f, 65535.0f);
+	float ly = b2Clamp((aabb.lowerBound.y - frame.lowerBound.y) * invStep.y, 0.0f, 65535.0f);
+	float ux = b2Clamp((frame.upperBound.x - aabb.upperBound.x) * invStep.x, 0.0f, 65535.0f);
+	float uy = b2Clamp((frame.upperBound.y - aabb.upperBound.y) * invStep.y, 0.0f, 65535.0f);
+
+	bounds[0] = uint16(lx);
+	bounds[1] = uint16(ly);
+	bounds[2] = uint16(65535 - int32(ux));
+	bounds[3] = uint16(65535 - int32(uy));
+
+	b2DecodeCompactBounds(decoded, bounds, frame, step);
+	while (bounds[0] > 0 && decoded->lowerBound.x > aabb.lowerBound.x)
+	{
+		--bounds[0];
+		b2DecodeCompactBounds(decoded, bounds, frame, step);
+	}
+
+	while (bounds[1] > 0 && decoded->lowerBound.y > aabb.lowerBound.y)
+	{
+		--bounds[1];
+		b2DecodeCompactBounds(decoded, bounds, frame, step);
+	}
+
+	while (bounds[2] < 65535 && decoded->upperBound.x < aabb.upperBound.x)
+	{
+		++bounds[2];
+		b2DecodeCompactBounds(decoded, bounds, frame, step);
+	}
+
+	while (bounds[3] < 65535 && decoded->upperBound.y < aabb.upperBound.y)
+	{
+		++bounds[3];
+		b2DecodeCompactBounds(decoded, bounds, frame, step);
+	}
+}
+
+struct b2CompactBuildItem
+{
+	int32 nodeId;
+	int32* slot;
+	b2AABB frame;
+};
+
+void b2DynamicTree::UpdateCompact()
+{
+	if (m_compactMode == false || m_compactValid)
+	{
+		return;
+	}
+
+	// A tree with n leaves has n - 1 internal nodes.
+	int32 capacity = m_nodeCount / 2 + 1;
+	if (m_compactCapacity < capacity)
+	{
+		b2Free(m_compactNodes);
+		m_compactCapacity = b2Max(capacity, 2 * m_compactCapacity);
+		m_compactNodes = (b2CompactTreeNode*)b2Alloc(m_compactCapacity * sizeof(b2CompactTreeNode));
+	}
+
+	m_compactCount = 0;
+	m_compactRoot = b2_nullNode;
+	m_compactValid = true;
+
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// Depth first so that child1 usually follows its parent. The frame of a child is
+	// its decoded bounds, which is what the walk sees.
+	b2GrowableStack<b2CompactBuildItem, 256> stack;
+	b2CompactBuildItem root;
+	root.nodeId = m_root;
+	root.slot = &m_compactRoot;
+	root.frame = m_nodes[m_root].aabb;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactBuildItem item = stack.Pop();
+		const b2TreeNode* node = m_nodes + item.nodeId;
+
+		if (node->IsLeaf())
+		{
+			*item.slot = -2 - item.nodeId;
+			continue;
+		}
+
+		b2Assert(m_compactCount < m_compactCapacity);
+		int32 index = m_compactCount++;
+		*item.slot = index;
+
+		const b2TreeNode* node1 = m_nodes + node->child1;
+		const b2TreeNode* node2 = m_nodes + node->child2;
+
+		// The walk is bound by cache misses on the regular nodes, so fetch the
+		// grandchildren while the children are encoded.
+		if (node1->IsLeaf() == false)
+		{
+			b2Prefetch(m_nodes + node1->child1);
+			b2Prefetch(m_nodes + node1->child2);
+		}
+
+		if (node2->IsLeaf() == false)
+		{
+			b2Prefetch(m_nodes + node2->child1);
+			b2Prefetch(m_nodes + node2->child2);
+		}
+
+		b2CompactTreeNode* compactNode = m_compactNodes + index;
+		b2Vec2 step = b2GetCompactStep(item.frame);
+		b2Vec2 invStep;
+		invStep.x = step.x > 0.0f ? 1.0f / step.x : 0.0f;
+		invStep.y = step.y > 0.0f ? 1.0f / step.y : 0.0f;
+
+		b2CompactBuildItem child1, child2;
+		child1.nodeId = node->child1;
+		child1.slot = compactNode->children + 0;
+		b2EncodeCompactBounds(compactNode->bounds[0], &child1.frame, node1->aabb, item.frame, step, invStep);
+
+		child2.nodeId = node->child2;
+		child2.slot = compactNode->children + 1;
+		b2EncodeCompactBounds(compactNode->bounds[1], &child2.frame, node2->aabb, item.frame, step, invStep);
+
+		stack.Push(child2);
+		stack.Push(child1);
+	}
+}
+
+// Writes batch query hits straight into the caller's array. Keeps counting past the
+// capacity so the caller learns the required size.
+struct b2TreeHitWriter
+{
+	void Add(int32 queryIndex, int32 proxyId)
+	{
+		if (count < capacity)
+		{
+			hits[count].queryIndex = queryIndex;
+			hits[count].proxyId = proxyId;
+		}
+		++count;
+	}
+
+	b2TreeQueryHit* hits;
+	int32 count;
+	int32 capacity;
+};
+
+// Per thread hit buffer for the threaded batch query. Grows on demand.
+struct b2TreeHitBuffer
+{
+	void Add(int32 queryIndex, int32 proxyId)
+	{
+		if (count == capacity)
+		{
+			capacity = b2Max(2 * capacity, 256);
+			b2TreeQueryHit* oldHits = hits;
+			hits = (b2TreeQueryHit*)b2Alloc(capacity * sizeof(b2TreeQueryHit));
+			if (oldHits)
+			{
+				memcpy(hits, oldHits, count * sizeof(b2TreeQueryHit));
+				b2Free(oldHits);
+			}
+		}
+
+		hits[count].queryIndex = queryIndex;
+		hits[count].proxyId = proxyId;
+		++count;
+	}
+
+	b2TreeQueryHit* hits;
+	int32 count;
+	int32 capacity;
+};
+
+// Traverse the tree once for up to b2_simdWidth queries. A node is visited if any
+// lane overlaps it. Children are contained in their parent, so each node can test
+// all lanes without tracking which lanes reached it.
+template <typename T>
+static void b2QueryGroup(T* output, const b2TreeNode* nodes, int32 root, const b2AABB* aabbs, int32 baseIndex, int32 laneCount)
+{
+	// Unused lanes get an inverted box that overlaps nothing.
+	b2FloatW lowerX = b2SplatW(b2_maxFloat);
+	b2FloatW lowerY = b2SplatW(b2_maxFloat);
+	b2FloatW upperX = b2SplatW(-b2_maxFloat);
+	b2FloatW upperY = b2SplatW(-b2_maxFloat);
+	for (int32 lane = 0; lane < laneCount; ++lane)
+	{
+		const b2AABB& aabb = aabbs[baseIndex + lane];
+		b2SetLaneW(&lowerX, lane, aabb.lowerBound.x);
+		b2SetLaneW(&lowerY, lane, aabb.lowerBound.y);
+		b2SetLaneW(&upperX, lane, aabb.upperBound.x);
+		b2SetLaneW(&upperY, lane, aabb.upperBound.y);
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2TreeNode* node = nodes + nodeId;
+
+		// Same test as b2TestOverlap, for all lanes.
+		b2FloatW overlapX = b2AndW(b2GreaterEqualW(upperX, b2SplatW(node->aabb.lowerBound.x)), b2GreaterEqualW(b2SplatW(node->aabb.upperBound.x), lowerX));
+		b2FloatW overlapY = b2AndW(b2GreaterEqualW(upperY, b2SplatW(node->aabb.lowerBound.y)), b2GreaterEqualW(b2SplatW(node->aabb.upperBound.y), lowerY));
+		uint32 bits = b2MaskBitsW(b2AndW(overlapX, overlapY));
+		if (bits == 0)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			for (int32 lane = 0; lane < laneCount; ++lane)
+			{
+				if (bits & (1u << lane))
+				{
+					output->Add(baseIndex + lane, nodeId);
+				}
+			}
+		}
+		else
+		{
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
+}
+
+struct b2TreeQueryGroup
+{
+	int32 threadIndex;
+	int32 offset;
+	int32 count;
+};
+
+// Each group records where its hits landed so the results can be stitched
+// together in group order, whatever thread ran it.
+class b2TreeQueryBatchTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		b2TreeHitBuffer* buffer = buffers + threadIndex;
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 baseIndex = i * b2_simdWidth;
+			b2TreeQueryGroup* group = groups + i;
+			group->threadIndex = threadIndex;
+			group->offset = buffer->count;
+			b2QueryGroup(buffer, nodes, root, aabbs, baseIndex, b2Min(int32(b2_simdWidth), count - baseIndex));
+			group->count = buffer->count - group->offset;
+		}
+	}
+
+	const b2TreeNode* nodes;
+	int32 root;
+	const b2AABB* aabbs;
+	int32 count;
+	b2TreeQueryGroup* groups;
+	b2TreeHitBuffer* buffers;
+};
+
+int32 b2DynamicTree::QueryBatch(const b2AABB* aabbs, int32 count, b2TreeQueryHit* hits, int32 hitCapacity,
+								b2ThreadPool* threadPool) const
+{
+	b2Assert(count >= 0 && hitCapacity >= 0);
+
+	b2TreeHitWriter writer;
+	writer.hits = hits;
+	writer.count = 0;
+	writer.capacity = hitCapacity;
+
+	int32 groupCount = (count + b2_simdWidth - 1) / b2_simdWidth;
+
+	if (threadPool == nullptr || threadPool->GetThreadCount() < 2 || groupCount < 2)
+	{
+		for (int32 i = 0; i < groupCount; ++i)
+		{
+			int32 baseIndex = i * b2_simdWidth;
+			b2QueryGroup(&writer, m_nodes, m_root, aabbs, baseIndex, b2Min(int32(b2_simdWidth), count - baseIndex));
+		}
+
+		return writer.count;
+	}
+
+	int32 threadCount = threadPool->GetThreadCount();
+	b2TreeHitBuffer* buffers = (b2TreeHitBuffer*)b2Alloc(threadCount * sizeof(b2TreeHitBuffer));
+	memset(buffers, 0, threadCount * sizeof(b2TreeHitBuffer));
+
+	b2TreeQueryBatchTask task;
+	task.nodes = m_nodes;
+	task.root = m_root;
+	task.aabbs = aabbs;
+	task.count = count;
+	task.groups = (b2TreeQueryGroup*)b2Alloc(groupCount * sizeof(b2TreeQueryGroup));
+	task.buffers = buffers;
+
+	threadPool->ParallelFor(&task, groupCount, 4);
+
+	for (int32 i = 0; i < groupCount; ++i)
+	{
+		const b2TreeQueryGroup* group = task.groups + i;
+		const b2TreeQueryHit* groupHits = buffers[group->threadIndex].hits + group->offset;
+		for (int32 j = 0; j < group->count; ++j)
+		{
+			writer.Add(groupHits[j].queryIndex, groupHits[j].proxyId);
+		}
+	}
+
+	b2Free(task.groups);
+	for (int32 i = 0; i < threadCount; ++i)
+	{
+		if (buffers[i].hits)
+		{
+			b2Free(buffers[i].hits);
+		}
+	}
+	b2Free(buffers);
+
+	return writer.count;
+}
+
+// Walk the tree once for up to b2_simdWidth rays. A node is visited if any lane
+// crosses it, using the same segment tests as RayCast. Instead of a stack the walk
+// descends to child1 and then climbs the parent links to the next child2.
+static void b2RayCastGroup(b2TreeRayCastBatchCallback* callback, const b2TreeNode* nodes, int32 root,
+						   const b2RayCastInput* inputs, int32 baseIndex, int32 laneCount)
+{
+	if (root == b2_nullNode)
+	{
+		return;
+	}
+
+	alignas(b2_simdAlignment) float maxFractions[b2_simdWidth];
+	b2FloatW p1X = b2ZeroW(), p1Y = b2ZeroW();
+	b2FloatW dX = b2ZeroW(), dY = b2ZeroW();
+	b2FloatW vX = b2ZeroW(), vY = b2ZeroW();
+	uint32 activeMask = 0;
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		maxFractions[lane] = 0.0f;
+		if (lane >= laneCount)
+		{
+			continue;
+		}
+
+		const b2RayCastInput& input = inputs[baseIndex + lane];
+		b2Vec2 d = input.p2 - input.p1;
+		b2Vec2 r = d;
+		if (r.Normalize() == 0.0f || input.maxFraction <= 0.0f)
+		{
+			continue;
+		}
+
+		// v is perpendicular to the segment.
+		b2Vec2 v = b2Cross(1.0f, r);
+		b2SetLaneW(&p1X, lane, input.p1.x);
+		b2SetLaneW(&p1Y, lane, input.p1.y);
+		b2SetLaneW(&dX, lane, d.x);
+		b2SetLaneW(&dY, lane, d.y);
+		b2SetLaneW(&vX, lane, v.x);
+		b2SetLaneW(&vY, lane, v.y);
+		maxFractions[lane] = input.maxFraction;
+		activeMask |= 1u << lane;
+	}
+
+	if (activeMask == 0)
+	{
+		return;
+	}
+
+	b2FloatW absVX = b2MaxW(vX, b2NegW(vX));
+	b2FloatW absVY = b2MaxW(vY, b2NegW(vY));
+
+	// Bounding boxes of the clipped segments.
+	b2FloatW lowerX, lowerY, upperX, upperY;
+	{
+		b2FloatW fraction = b2LoadW(maxFractions);
+		b2FloatW tX = b2AddW(p1X, b2MulW(fraction, dX));
+		b2FloatW tY = b2AddW(p1Y, b2MulW(fraction, dY));
+		lowerX = b2MinW(p1X, tX);
+		lowerY = b2MinW(p1Y, tY);
+		upperX = b2MaxW(p1X, tX);
+		upperY = b2MaxW(p1Y, tY);
+	}
+
+	int32 nodeId = root;
+	for (;;)
+	{
+		const b2TreeNode* node = nodes + nodeId;
+		const b2AABB& aabb = node->aabb;
+
+		// Same tests as RayCast, for all lanes: segment box overlap and the separating
+		// axis of the segment, |dot(v, p1 - c)| <= dot(|v|, h).
+		b2FloatW overlapX = b2AndW(b2GreaterEqualW(upperX, b2SplatW(aabb.lowerBound.x)), b2GreaterEqualW(b2SplatW(aabb.upperBound.x), lowerX));
+		b2FloatW overlapY = b2AndW(b2GreaterEqualW(upperY, b2SplatW(aabb.lowerBound.y)), b2GreaterEqualW(b2SplatW(aabb.upperBound.y), lowerY));
+		b2Vec2 c = aabb.GetCenter();
+		b2Vec2 h = aabb.GetExtents();
+		b2FloatW dot = b2AddW(b2MulW(vX, b2SubW(p1X, b2SplatW(c.x))), b2MulW(vY, b2SubW(p1Y, b2SplatW(c.y))));
+		b2FloatW extent = b2AddW(b2MulW(absVX, b2SplatW(h.x)), b2MulW(absVY, b2SplatW(h.y)));
+		b2FloatW axis = b2GreaterEqualW(extent, b2MaxW(dot, b2NegW(dot)));
+		uint32 bits = b2MaskBitsW(b2AndW(b2AndW(overlapX, overlapY), axis)) & activeMask;
+
+		if (bits != 0)
+		{
+			if (node->IsLeaf() == false)
+			{
+				nodeId = node->child1;
+				continue;
+			}
+
+			callback->RayCastProxy(nodeId, baseIndex, bits, maxFractions);
+
+			// Clip the segments to the fractions left by the callback.
+			for (int32 lane = 0; lane < laneCount; ++lane)
+			{
+				if ((bits & (1u << lane)) && maxFractions[lane] <= 0.0f)
+				{
+					activeMask &= ~(1u << lane);
+				}
+			}
+
+			if (activeMask == 0)
+			{
+				return;
+			}
+
+			b2FloatW fraction = b2LoadW(maxFractions);
+			b2FloatW tX = b2AddW(p1X, b2MulW(fraction, dX));
+			b2FloatW tY = b2AddW(p1Y, b2MulW(fraction, dY));
+			lowerX = b2MinW(p1X, tX);
+			lowerY = b2MinW(p1Y, tY);
+			upperX = b2MaxW(p1X, tX);
+			upperY = b2MaxW(p1Y, tY);
+		}
+
+		// Climb to the next child2 that has not been visited.
+		for (;;)
+		{
+			if (nodeId == root)
+			{
+				return;
+			}
+
+			int32 parentId = nodes[nodeId].parent;
+			if (nodes[parentId].child1 == nodeId)
+			{
+				nodeId = nodes[parentId].child2;
+				break;
+			}
+
+			nodeId = parentId;
+		}
+	}
+}
+
+// Every group writes only its own rays, so the groups need no merging.
+class b2TreeRayCastBatchTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		B2_NOT_USED(threadIndex);
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 baseIndex = i * b2_simdWidth;
+			b2RayCastGroup(callback, nodes, root, inputs, baseIndex, b2Min(int32(b2_simdWidth), count - baseIndex));
+		}
+	}
+
+	b2TreeRayCastBatchCallback* callback;
+	const b2TreeNode* nodes;
+	int32 root;
+	const b2RayCastInput* inputs;
+	int32 count;
+};
+
+void b2DynamicTree::RayCastBatch(b2TreeRayCastBatchCallback* callback, const b2RayCastInput* inputs, int32 count,
+								 b2ThreadPool* threadPool) const
+{
+	b2Assert(count >= 0);
+
+	b2TreeRayCastBatchTask task;
+	task.callback = callback;
+	task.nodes = m_nodes;
+	task.root = m_root;
+	task.inputs = inputs;
+	task.count = count;
+
+	int32 groupCount = (count + b2_simdWidth - 1) / b2_simdWidth;
+	if (threadPool == nullptr || threadPool->GetThreadCount() < 2 || groupCount < 2)
+	{
+		task.Execute(0, groupCount, 0);
+		return;
+	}
+
+	threadPool->ParallelFor(&task, groupCount, 4);
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
+	m_compactValid = false;
+
 	// Build array of leaves. Free the rest.
 	for (int32 i = 0; i < m_nodeCapacity; ++i)
 	{
@@ -799,3 +1679,53 @@ void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 		m_nodes[i].aabb.upperBound -= newOrigin;
 	}
 }
+
+void b2DynamicTree::Save(b2SnapshotWriter* writer) const
+{
+	// Free nodes are kept for the free list. The user data is relinked by the world.
+	writer->WriteArray(m_nodes, m_nodeCapacity, m_nodeCapacity, &b2TreeNode::userData);
+	writer->Write(m_root);
+	writer->Write(m_nodeCount);
+	writer->Write(m_freeList);
+	writer->Write(m_insertionCount);
+}
+
+void b2DynamicTree::Restore(b2SnapshotReader* reader)
+{
+	reader->ReadArray(&m_nodes, &m_nodeCapacity);
+	m_root = reader->Read<int32>();
+	m_nodeCount = reader->Read<int32>();
+	m_freeList = reader->Read<int32>();
+	m_insertionCount = reader->Read<int32>();
+	m_compactValid = false;
+}
+
+int32 b2DynamicTree::Check(b2SnapshotReader* reader) const
+{
+	int32 capacity;
+	int32 count = reader->ReadArrayHeader<b2TreeNode>(&capacity);
+	for (int32 i = 0; i < count && reader->invalid == false; ++i)
+	{
+		// The rest of a free node is left over from growth or a past use.
+		b2TreeNode node = reader->Read<b2TreeNode>();
+		reader->CheckLink(node.parent, capacity);
+		if (node.height >= 0)
+		{
+			reader->CheckBool(node.moved);
+			reader->CheckLink(node.child1, capacity);
+			reader->CheckLink(node.child2, capacity);
+		}
+	}
+
+	reader->CheckLink(reader->Read<int32>(), capacity);
+	int32 nodeCount = reader->Read<int32>();
+	reader->CheckLink(reader->Read<int32>(), capacity);
+	reader->Read<int32>();
+
+	if (count != capacity || nodeCount < 0 || nodeCount > capacity)
+	{
+		reader->invalid = true;
+	}
+
+	return capacity;
+}
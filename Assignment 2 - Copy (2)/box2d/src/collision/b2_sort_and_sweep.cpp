@@ -0,0 +1,415 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "box2d/b2_sort_and_sweep.h"
+#include "common/b2_snapshot.h"
+
+#include <string.h>
+
+b2SortAndSweep::b2SortAndSweep()
+{
+	m_proxyCapacity = 16;
+	m_proxies = (b2SortProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SortProxy));
+	memset(m_proxies, 0, m_proxyCapacity * sizeof(b2SortProxy));
+
+	// Build a linked list for the free list.
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+		m_proxies[i].entryIndex = -1;
+	}
+	m_proxies[m_proxyCapacity - 1].next = -1;
+	m_proxies[m_proxyCapacity - 1].entryIndex = -1;
+	m_freeList = 0;
+
+	m_entryCapacity = 16;
+	m_entryCount = 0;
+	m_entries = (b2SortEntry*)b2Alloc(m_entryCapacity * sizeof(b2SortEntry));
+	m_active = (int32*)b2Alloc(m_entryCapacity * sizeof(int32));
+
+	m_largeCapacity = 4;
+	m_largeCount = 0;
+	m_large = (int32*)b2Alloc(m_largeCapacity * sizeof(int32));
+
+	m_maxWidth = 0.0f;
+	m_largeWidth = b2_maxFloat;
+}
+
+b2SortAndSweep::~b2SortAndSweep()
+{
+	b2Free(m_large);
+	b2Free(m_active);
+	b2Free(m_entries);
+	b2Free(m_proxies);
+}
+
+int32 b2SortAndSweep::AllocateProxy()
+{
+	// Expand the proxy pool as needed.
+	if (m_freeList == -1)
+	{
+		b2SortProxy* oldProxies = m_proxies;
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity *= 2;
+		m_proxies = (b2SortProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SortProxy));
+		memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2SortProxy));
+		b2Free(oldProxies);
+
+		// Build a linked list for the free list.
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].entryIndex = -1;
+		}
+		m_proxies[m_proxyCapacity - 1].next = -1;
+		m_proxies[m_proxyCapacity - 1].entryIndex = -1;
+		m_freeList = oldCapacity;
+	}
+
+	int32 proxyId = m_freeList;
+	m_freeList = m_proxies[proxyId].next;
+	m_proxies[proxyId].userData = nullptr;
+	m_proxies[proxyId].largeIndex = -1;
+	return proxyId;
+}
+
+void b2SortAndSweep::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].next = m_freeList;
+	m_proxies[proxyId].entryIndex = -1;
+	m_freeList = proxyId;
+}
+
+int32 b2SortAndSweep::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId = AllocateProxy();
+
+	if (m_entryCount == m_entryCapacity)
+	{
+		b2SortEntry* oldEntries = m_entries;
+		m_entryCapacity *= 2;
+		m_entries = (b2SortEntry*)b2Alloc(m_entryCapacity * sizeof(b2SortEntry));
+		memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2SortEntry));
+		b2Free(oldEntries);
+
+		b2Free(m_active);
+		m_active = (int32*)b2Alloc(m_entryCapacity * sizeof(int32));
+	}
+
+	// Append and shift the entry into place.
+	int32 index = m_entryCount;
+	++m_entryCount;
+	m_entries[index].aabb = b2MakeFatAABB(aabb, b2Vec2_zero);
+	m_entries[index].proxyId = proxyId;
+	m_entries[index].moved = true;
+
+	b2SortProxy* proxy = m_proxies + proxyId;
+	proxy->userData = userData;
+	proxy->entryIndex = index;
+
+	Classify(proxyId);
+	SortEntry(index);
+
+	return proxyId;
+}
+
+void b2SortAndSweep::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].entryIndex != -1);
+
+	if (m_proxies[proxyId].largeIndex != -1)
+	{
+		RemoveLarge(proxyId);
+	}
+
+	// Close the gap in the sorted array.
+	for (int32 i = m_proxies[proxyId].entryIndex; i < m_entryCount - 1; ++i)
+	{
+		m_entries[i] = m_entries[i + 1];
+		m_proxies[m_entries[i].proxyId].entryIndex = i;
+	}
+	--m_entryCount;
+
+	FreeProxy(proxyId);
+}
+
+bool b2SortAndSweep::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].entryIndex != -1);
+
+	int32 index = m_proxies[proxyId].entryIndex;
+	b2AABB fatAABB = b2MakeFatAABB(aabb, displacement);
+	if (b2FatAABBNeedsUpdate(m_entries[index].aabb, aabb, fatAABB) == false)
+	{
+		return false;
+	}
+
+	m_entries[index].aabb = fatAABB;
+	m_entries[index].moved = true;
+
+	Classify(proxyId);
+	SortEntry(index);
+
+	return true;
+}
+
+// Insertion sort step. Proxies moving steadily only pass a few neighbors.
+void b2SortAndSweep::SortEntry(int32 index)
+{
+	b2SortEntry entry = m_entries[index];
+	float x = entry.aabb.lowerBound.x;
+
+	while (index > 0 && m_entries[index - 1].aabb.lowerBound.x > x)
+	{
+		m_entries[index] = m_entries[index - 1];
+		m_proxies[m_entries[index].proxyId].entryIndex = index;
+		--index;
+	}
+
+	while (index < m_entryCount - 1 && m_entries[index + 1].aabb.lowerBound.x < x)
+	{
+		m_entries[index] = m_entries[index + 1];
+		m_proxies[m_entries[index].proxyId].entryIndex = index;
+		++index;
+	}
+
+	m_entries[index] = entry;
+	m_proxies[entry.proxyId].entryIndex = index;
+}
+
+// Keep the query window bound valid for a new or moved proxy.
+void b2SortAndSweep::Classify(int32 proxyId)
+{
+	const b2AABB& aabb = GetFatAABB(proxyId);
+	float width = aabb.upperBound.x - aabb.lowerBound.x;
+	bool large = width > m_largeWidth;
+	bool wasLarge = m_proxies[proxyId].largeIndex != -1;
+
+	if (large && wasLarge == false)
+	{
+		AddLarge(proxyId);
+	}
+	else if (large == false)
+	{
+		if (wasLarge)
+		{
+			RemoveLarge(proxyId);
+		}
+
+		m_maxWidth = b2Max(m_maxWidth, width);
+	}
+}
+
+void b2SortAndSweep::AddLarge(int32 proxyId)
+{
+	if (m_largeCount == m_largeCapacity)
+	{
+		int32* oldLarge = m_large;
+		m_largeCapacity *= 2;
+		m_large = (int32*)b2Alloc(m_largeCapacity * sizeof(int32));
+		memcpy(m_large, oldLarge, m_largeCount * sizeof(int32));
+		b2Free(oldLarge);
+	}
+
+	m_proxies[proxyId].largeIndex = m_largeCount;
+	m_large[m_largeCount] = proxyId;
+	++m_largeCount;
+}
+
+void b2SortAndSweep::RemoveLarge(int32 proxyId)
+{
+	int32 index = m_proxies[proxyId].largeIndex;
+	b2Assert(0 <= index && index < m_largeCount);
+
+	--m_largeCount;
+	m_large[index] = m_large[m_largeCount];
+	m_proxies[m_large[index]].largeIndex = index;
+	m_proxies[proxyId].largeIndex = -1;
+}
+
+// Called after each sweep. Picks the large proxies from the current average width
+// and tightens the query window to the widest remaining proxy.
+void b2SortAndSweep::UpdateLargeProxies()
+{
+	if (m_entryCount == 0)
+	{
+		m_maxWidth = 0.0f;
+		return;
+	}
+
+	float widthSum = 0.0f;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		widthSum += m_entries[i].aabb.upperBound.x - m_entries[i].aabb.lowerBound.x;
+	}
+
+	m_largeWidth = b2_sweepLargeProxyScale * widthSum / float(m_entryCount);
+	m_maxWidth = 0.0f;
+
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		Classify(m_entries[i].proxyId);
+	}
+}
+
+// First entry with a lower bound not less than x.
+int32 b2SortAndSweep::LowerBound(float x) const
+{
+	int32 low = 0;
+	int32 high = m_entryCount;
+	while (low < high)
+	{
+		int32 mid = (low + high) >> 1;
+		if (m_entries[mid].aabb.lowerBound.x < x)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+void b2SortAndSweep::Validate() const
+{
+#if defined(b2DEBUG)
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		int32 proxyId = m_entries[i].proxyId;
+		b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+		b2Assert(m_proxies[proxyId].entryIndex == i);
+		b2Assert(i == 0 || m_entries[i - 1].aabb.lowerBound.x <= m_entries[i].aabb.lowerBound.x);
+
+		const b2AABB& aabb = m_entries[i].aabb;
+		float width = aabb.upperBound.x - aabb.lowerBound.x;
+		b2Assert(m_proxies[proxyId].largeIndex != -1 || width <= m_maxWidth);
+	}
+
+	for (int32 i = 0; i < m_largeCount; ++i)
+	{
+		b2Assert(m_proxies[m_large[i]].largeIndex == i);
+	}
+#endif
+}
+
+void b2SortAndSweep::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// The order along x does not change.
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		m_entries[i].aabb.lowerBound -= newOrigin;
+		m_entries[i].aabb.upperBound -= newOrigin;
+	}
+}
+
+void b2SortAndSweep::Save(b2SnapshotWriter* writer) const
+{
+	writer->WriteArray(m_proxies, m_proxyCapacity, m_proxyCapacity, &b2SortProxy::userData);
+	writer->Write(m_freeList);
+	writer->WriteArray(m_entries, m_entryCount, m_entryCapacity);
+	writer->WriteArray(m_large, m_largeCount, m_largeCapacity);
+	writer->Write(m_maxWidth);
+	writer->Write(m_largeWidth);
+}
+
+void b2SortAndSweep::Restore(b2SnapshotReader* reader)
+{
+	reader->ReadArray(&m_proxies, &m_proxyCapacity);
+	m_freeList = reader->Read<int32>();
+
+	// The active list has room for every entry.
+	int32 entryCapacity = m_entryCapacity;
+	m_entryCount = reader->ReadArray(&m_entries, &m_entryCapacity);
+	if (m_entryCapacity != entryCapacity)
+	{
+		b2Free(m_active);
+		m_active = (int32*)b2Alloc(m_entryCapacity * sizeof(int32));
+	}
+
+	m_largeCount = reader->ReadArray(&m_large, &m_largeCapacity);
+	m_maxWidth = reader->Read<float>();
+	m_largeWidth = reader->Read<float>();
+}
+
+int32 b2SortAndSweep::Check(b2SnapshotReader* reader) const
+{
+	// Only live proxies have a large index. The entry and large counts come later.
+	int32 capacity;
+	int32 count = reader->ReadArrayHeader<b2SortProxy>(&capacity);
+	int32 maxEntryIndex = -1;
+	int32 maxLargeIndex = -1;
+	for (int32 i = 0; i < count && reader->invalid == false; ++i)
+	{
+		b2SortProxy proxy = reader->Read<b2SortProxy>();
+		reader->CheckLink(proxy.next, capacity);
+		if (proxy.entryIndex < -1 || (proxy.entryIndex != -1 && proxy.largeIndex < -1))
+		{
+			reader->invalid = true;
+		}
+		else if (proxy.entryIndex != -1)
+		{
+			maxEntryIndex = b2Max(maxEntryIndex, proxy.entryIndex);
+			maxLargeIndex = b2Max(maxLargeIndex, proxy.largeIndex);
+		}
+	}
+	reader->CheckLink(reader->Read<int32>(), capacity);
+
+	int32 entryCapacity;
+	int32 entryCount = reader->ReadArrayHeader<b2SortEntry>(&entryCapacity);
+	for (int32 i = 0; i < entryCount && reader->invalid == false; ++i)
+	{
+		b2SortEntry entry = reader->Read<b2SortEntry>();
+		reader->CheckBool(entry.moved);
+		if (entry.proxyId < 0 || entry.proxyId >= capacity)
+		{
+			reader->invalid = true;
+		}
+	}
+
+	int32 largeCapacity;
+	int32 largeCount = reader->ReadArrayHeader<int32>(&largeCapacity);
+	for (int32 i = 0; i < largeCount && reader->invalid == false; ++i)
+	{
+		int32 proxyId = reader->Read<int32>();
+		if (proxyId < 0 || proxyId >= capacity)
+		{
+			reader->invalid = true;
+		}
+	}
+
+	reader->Read<float>();
+	reader->Read<float>();
+
+	if (count != capacity || maxEntryIndex >= entryCount || maxLargeIndex >= largeCount)
+	{
+		reader->invalid = true;
+	}
+
+	return capacity;
+}
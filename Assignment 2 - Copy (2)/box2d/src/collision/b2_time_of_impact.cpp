@@ -27,11 +27,38 @@
 #include "box2d/b2_time_of_impact.h"
 #include "box2d/b2_timer.h"
 
+#include <atomic>
 #include <stdio.h>
 
-B2_API float b2_toiTime, b2_toiMaxTime;
-B2_API int32 b2_toiCalls, b2_toiIters, b2_toiMaxIters;
-B2_API int32 b2_toiRootIters, b2_toiMaxRootIters;
+// These statistics are for testing. Batched TOI runs on a thread pool, so they are
+// atomic and each call adds its totals once.
+B2_API std::atomic<float> b2_toiTime(0.0f), b2_toiMaxTime(0.0f);
+B2_API std::atomic<int32> b2_toiCalls(0), b2_toiIters(0), b2_toiMaxIters(0);
+B2_API std::atomic<int32> b2_toiRootIters(0), b2_toiMaxRootIters(0);
+
+static inline void b2AtomicMax(std::atomic<int32>* value, int32 x)
+{
+	int32 old = value->load(std::memory_order_relaxed);
+	while (x > old && value->compare_exchange_weak(old, x, std::memory_order_relaxed) == false)
+	{
+	}
+}
+
+static inline void b2AtomicMax(std::atomic<float>* value, float x)
+{
+	float old = value->load(std::memory_order_relaxed);
+	while (x > old && value->compare_exchange_weak(old, x, std::memory_order_relaxed) == false)
+	{
+	}
+}
+
+static inline void b2AtomicAdd(std::atomic<float>* value, float x)
+{
+	float old = value->load(std::memory_order_relaxed);
+	while (value->compare_exchange_weak(old, old + x, std::memory_order_relaxed) == false)
+	{
+	}
+}
 
 //
 struct b2SeparationFunction
@@ -259,7 +286,7 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 {
 	b2Timer timer;
 
-	++b2_toiCalls;
+	b2_toiCalls.fetch_add(1, std::memory_order_relaxed);
 
 	output->state = b2TOIOutput::e_unknown;
 	output->t = input->tMax;
@@ -426,7 +453,6 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 				}
 
 				++rootIterCount;
-				++b2_toiRootIters;
 
 				float s = fcn.Evaluate(indexA, indexB, t);
 
@@ -455,7 +481,8 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 				}
 			}
 
-			b2_toiMaxRootIters = b2Max(b2_toiMaxRootIters, rootIterCount);
+			b2_toiRootIters.fetch_add(rootIterCount, std::memory_order_relaxed);
+			b2AtomicMax(&b2_toiMaxRootIters, rootIterCount);
 
 			++pushBackIter;
 
@@ -466,7 +493,6 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 		}
 
 		++iter;
-		++b2_toiIters;
 
 		if (done)
 		{
@@ -482,9 +508,10 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 		}
 	}
 
-	b2_toiMaxIters = b2Max(b2_toiMaxIters, iter);
+	b2_toiIters.fetch_add(iter, std::memory_order_relaxed);
+	b2AtomicMax(&b2_toiMaxIters, iter);
 
 	float time = timer.GetMilliseconds();
-	b2_toiMaxTime = b2Max(b2_toiMaxTime, time);
-	b2_toiTime += time;
+	b2AtomicMax(&b2_toiMaxTime, time);
+	b2AtomicAdd(&b2_toiTime, time);
 }
@@ -0,0 +1,457 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "box2d/b2_uniform_grid.h"
+#include "common/b2_snapshot.h"
+
+#include <string.h>
+
+b2UniformGrid::b2UniformGrid()
+{
+	m_proxyCapacity = 16;
+	m_proxies = (b2GridProxy*)b2Alloc(m_proxyCapacity * sizeof(b2GridProxy));
+
+	// Build a linked list for the free list. Value-initialization clears the proxies.
+	for (int32 i = 0; i < m_proxyCapacity; ++i)
+	{
+		m_proxies[i] = b2GridProxy();
+		m_proxies[i].next = i + 1;
+	}
+	m_proxies[m_proxyCapacity - 1].next = -1;
+	m_freeProxy = 0;
+
+	m_entryCapacity = 64;
+	m_entryCount = 0;
+	m_entries = (b2GridEntry*)b2Alloc(m_entryCapacity * sizeof(b2GridEntry));
+
+	// Build a linked list for the free list. Free entries have no proxy.
+	for (int32 i = 0; i < m_entryCapacity - 1; ++i)
+	{
+		m_entries[i].proxyId = -1;
+		m_entries[i].next = i + 1;
+	}
+	m_entries[m_entryCapacity - 1].proxyId = -1;
+	m_entries[m_entryCapacity - 1].next = -1;
+	m_freeEntry = 0;
+
+	m_bucketCount = 64;
+	m_buckets = (int32*)b2Alloc(m_bucketCount * sizeof(int32));
+	memset(m_buckets, 0xFF, m_bucketCount * sizeof(int32));
+
+	m_largeCapacity = 4;
+	m_largeCount = 0;
+	m_large = (int32*)b2Alloc(m_largeCapacity * sizeof(int32));
+
+	SetCellSize(b2_gridCellSize);
+}
+
+b2UniformGrid::~b2UniformGrid()
+{
+	b2Free(m_large);
+	b2Free(m_buckets);
+	b2Free(m_entries);
+	b2Free(m_proxies);
+}
+
+void b2UniformGrid::SetCellSize(float cellSize)
+{
+	b2Assert(cellSize > 0.0f);
+	b2Assert(m_entryCount == 0 && m_largeCount == 0);
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.0f / cellSize;
+}
+
+int32 b2UniformGrid::AllocateProxy()
+{
+	// Expand the proxy pool as needed.
+	if (m_freeProxy == -1)
+	{
+		b2GridProxy* oldProxies = m_proxies;
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity *= 2;
+		m_proxies = (b2GridProxy*)b2Alloc(m_proxyCapacity * sizeof(b2GridProxy));
+		memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2GridProxy));
+		b2Free(oldProxies);
+
+		// Build a linked list for the free list.
+		for (int32 i = oldCapacity; i < m_proxyCapacity; ++i)
+		{
+			m_proxies[i] = b2GridProxy();
+			m_proxies[i].next = i + 1;
+		}
+		m_proxies[m_proxyCapacity - 1].next = -1;
+		m_freeProxy = oldCapacity;
+	}
+
+	int32 proxyId = m_freeProxy;
+	b2GridProxy* proxy = m_proxies + proxyId;
+	m_freeProxy = proxy->next;
+	proxy->userData = nullptr;
+	proxy->largeIndex = -1;
+	proxy->allocated = true;
+	proxy->moved = false;
+	return proxyId;
+}
+
+void b2UniformGrid::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].next = m_freeProxy;
+	m_proxies[proxyId].allocated = false;
+	m_freeProxy = proxyId;
+}
+
+int32 b2UniformGrid::AllocateEntry()
+{
+	// Expand the entry pool as needed.
+	if (m_freeEntry == -1)
+	{
+		b2GridEntry* oldEntries = m_entries;
+		int32 oldCapacity = m_entryCapacity;
+		m_entryCapacity *= 2;
+		m_entries = (b2GridEntry*)b2Alloc(m_entryCapacity * sizeof(b2GridEntry));
+		memcpy(m_entries, oldEntries, oldCapacity * sizeof(b2GridEntry));
+		b2Free(oldEntries);
+
+		// Build a linked list for the free list.
+		for (int32 i = oldCapacity; i < m_entryCapacity - 1; ++i)
+		{
+			m_entries[i].proxyId = -1;
+			m_entries[i].next = i + 1;
+		}
+		m_entries[m_entryCapacity - 1].proxyId = -1;
+		m_entries[m_entryCapacity - 1].next = -1;
+		m_freeEntry = oldCapacity;
+	}
+
+	int32 entryId = m_freeEntry;
+	m_freeEntry = m_entries[entryId].next;
+	++m_entryCount;
+	return entryId;
+}
+
+void b2UniformGrid::FreeEntry(int32 entryId)
+{
+	b2Assert(0 <= entryId && entryId < m_entryCapacity);
+	m_entries[entryId].proxyId = -1;
+	m_entries[entryId].next = m_freeEntry;
+	m_freeEntry = entryId;
+	--m_entryCount;
+}
+
+// Double the bucket count and relink the live entries. This keeps the chains short.
+void b2UniformGrid::GrowBuckets()
+{
+	b2Free(m_buckets);
+	m_bucketCount *= 2;
+	m_buckets = (int32*)b2Alloc(m_bucketCount * sizeof(int32));
+	memset(m_buckets, 0xFF, m_bucketCount * sizeof(int32));
+
+	for (int32 entryId = 0; entryId < m_entryCapacity; ++entryId)
+	{
+		b2GridEntry* entry = m_entries + entryId;
+		if (entry->proxyId == -1)
+		{
+			continue;
+		}
+
+		int32 bucket = GetBucket(entry->cellX, entry->cellY);
+		entry->next = m_buckets[bucket];
+		m_buckets[bucket] = entryId;
+	}
+}
+
+void b2UniformGrid::InsertCells(int32 proxyId)
+{
+	b2GridProxy* proxy = m_proxies + proxyId;
+	proxy->lowerX = GetCell(proxy->aabb.lowerBound.x);
+	proxy->lowerY = GetCell(proxy->aabb.lowerBound.y);
+	proxy->upperX = GetCell(proxy->aabb.upperBound.x);
+	proxy->upperY = GetCell(proxy->aabb.upperBound.y);
+
+	float cellCount = float(proxy->upperX - proxy->lowerX + 1) * float(proxy->upperY - proxy->lowerY + 1);
+	if (cellCount > float(b2_gridMaxProxyCells))
+	{
+		if (m_largeCount == m_largeCapacity)
+		{
+			int32* oldLarge = m_large;
+			m_largeCapacity *= 2;
+			m_large = (int32*)b2Alloc(m_largeCapacity * sizeof(int32));
+			memcpy(m_large, oldLarge, m_largeCount * sizeof(int32));
+			b2Free(oldLarge);
+		}
+
+		proxy->largeIndex = m_largeCount;
+		m_large[m_largeCount] = proxyId;
+		++m_largeCount;
+		return;
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			int32 entryId = AllocateEntry();
+			b2GridEntry* entry = m_entries + entryId;
+			entry->proxyId = proxyId;
+			entry->cellX = x;
+			entry->cellY = y;
+
+			int32 bucket = GetBucket(x, y);
+			entry->next = m_buckets[bucket];
+			m_buckets[bucket] = entryId;
+		}
+	}
+
+	while (m_entryCount > m_bucketCount)
+	{
+		GrowBuckets();
+	}
+}
+
+void b2UniformGrid::RemoveCells(int32 proxyId)
+{
+	b2GridProxy* proxy = m_proxies + proxyId;
+	if (proxy->largeIndex != -1)
+	{
+		int32 index = proxy->largeIndex;
+		--m_largeCount;
+		m_large[index] = m_large[m_largeCount];
+		m_proxies[m_large[index]].largeIndex = index;
+		proxy->largeIndex = -1;
+		return;
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			// Unlink the entry of this proxy from the cell bucket.
+			int32* link = m_buckets + GetBucket(x, y);
+			while (*link != -1)
+			{
+				b2GridEntry* entry = m_entries + *link;
+				if (entry->proxyId == proxyId && entry->cellX == x && entry->cellY == y)
+				{
+					int32 entryId = *link;
+					*link = entry->next;
+					FreeEntry(entryId);
+					break;
+				}
+
+				link = &entry->next;
+			}
+		}
+	}
+}
+
+int32 b2UniformGrid::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId = AllocateProxy();
+
+	b2GridProxy* proxy = m_proxies + proxyId;
+	proxy->aabb = b2MakeFatAABB(aabb, b2Vec2_zero);
+	proxy->userData = userData;
+	proxy->moved = true;
+
+	InsertCells(proxyId);
+
+	return proxyId;
+}
+
+void b2UniformGrid::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	RemoveCells(proxyId);
+	FreeProxy(proxyId);
+}
+
+bool b2UniformGrid::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].allocated);
+
+	b2GridProxy* proxy = m_proxies + proxyId;
+	b2AABB fatAABB = b2MakeFatAABB(aabb, displacement);
+	if (b2FatAABBNeedsUpdate(proxy->aabb, aabb, fatAABB) == false)
+	{
+		return false;
+	}
+
+	proxy->moved = true;
+
+	// Only relink when the covered cells change.
+	if (proxy->largeIndex == -1 &&
+		GetCell(fatAABB.lowerBound.x) == proxy->lowerX && GetCell(fatAABB.lowerBound.y) == proxy->lowerY &&
+		GetCell(fatAABB.upperBound.x) == proxy->upperX && GetCell(fatAABB.upperBound.y) == proxy->upperY)
+	{
+		proxy->aabb = fatAABB;
+		return true;
+	}
+
+	RemoveCells(proxyId);
+	proxy->aabb = fatAABB;
+	InsertCells(proxyId);
+
+	return true;
+}
+
+void b2UniformGrid::Validate() const
+{
+#if defined(b2DEBUG)
+	int32 entryCount = 0;
+	for (int32 bucket = 0; bucket < m_bucketCount; ++bucket)
+	{
+		for (int32 entryId = m_buckets[bucket]; entryId != -1; entryId = m_entries[entryId].next)
+		{
+			const b2GridEntry* entry = m_entries + entryId;
+			b2Assert(GetBucket(entry->cellX, entry->cellY) == bucket);
+
+			const b2GridProxy* proxy = m_proxies + entry->proxyId;
+			b2Assert(proxy->allocated && proxy->largeIndex == -1);
+			b2Assert(proxy->lowerX <= entry->cellX && entry->cellX <= proxy->upperX);
+			b2Assert(proxy->lowerY <= entry->cellY && entry->cellY <= proxy->upperY);
+			++entryCount;
+		}
+	}
+
+	b2Assert(entryCount == m_entryCount);
+
+	for (int32 i = 0; i < m_largeCount; ++i)
+	{
+		b2Assert(m_proxies[m_large[i]].largeIndex == i);
+	}
+#endif
+}
+
+void b2UniformGrid::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// The cells change, so relink every proxy.
+	for (int32 proxyId = 0; proxyId < m_proxyCapacity; ++proxyId)
+	{
+		b2GridProxy* proxy = m_proxies + proxyId;
+		if (proxy->allocated == false)
+		{
+			continue;
+		}
+
+		RemoveCells(proxyId);
+		proxy->aabb.lowerBound -= newOrigin;
+		proxy->aabb.upperBound -= newOrigin;
+		InsertCells(proxyId);
+	}
+}
+
+void b2UniformGrid::Save(b2SnapshotWriter* writer) const
+{
+	// Free proxies and entries are kept for the free lists.
+	writer->WriteArray(m_proxies, m_proxyCapacity, m_proxyCapacity, &b2GridProxy::userData);
+	writer->Write(m_freeProxy);
+	writer->WriteArray(m_entries, m_entryCapacity, m_entryCapacity);
+	writer->Write(m_entryCount);
+	writer->Write(m_freeEntry);
+	writer->WriteArray(m_buckets, m_bucketCount, m_bucketCount);
+	writer->WriteArray(m_large, m_largeCount, m_largeCapacity);
+}
+
+void b2UniformGrid::Restore(b2SnapshotReader* reader)
+{
+	reader->ReadArray(&m_proxies, &m_proxyCapacity);
+	m_freeProxy = reader->Read<int32>();
+	reader->ReadArray(&m_entries, &m_entryCapacity);
+	m_entryCount = reader->Read<int32>();
+	m_freeEntry = reader->Read<int32>();
+	reader->ReadArray(&m_buckets, &m_bucketCount);
+	m_largeCount = reader->ReadArray(&m_large, &m_largeCapacity);
+}
+
+int32 b2UniformGrid::Check(b2SnapshotReader* reader) const
+{
+	// Only live proxies have a large index. The large count comes last.
+	int32 capacity;
+	int32 count = reader->ReadArrayHeader<b2GridProxy>(&capacity);
+	int32 maxLargeIndex = -1;
+	for (int32 i = 0; i < count && reader->invalid == false; ++i)
+	{
+		b2GridProxy proxy = reader->Read<b2GridProxy>();
+		reader->CheckBool(proxy.allocated);
+		reader->CheckBool(proxy.moved);
+		reader->CheckLink(proxy.next, capacity);
+		if (reader->invalid)
+		{
+			break;
+		}
+
+		if (proxy.allocated && proxy.largeIndex < -1)
+		{
+			reader->invalid = true;
+		}
+		else if (proxy.allocated)
+		{
+			maxLargeIndex = b2Max(maxLargeIndex, proxy.largeIndex);
+		}
+	}
+	reader->CheckLink(reader->Read<int32>(), capacity);
+
+	// Free entries have no proxy.
+	int32 entryCapacity;
+	int32 entryCount = reader->ReadArrayHeader<b2GridEntry>(&entryCapacity);
+	for (int32 i = 0; i < entryCount && reader->invalid == false; ++i)
+	{
+		b2GridEntry entry = reader->Read<b2GridEntry>();
+		reader->CheckLink(entry.proxyId, capacity);
+		reader->CheckLink(entry.next, entryCapacity);
+	}
+
+	int32 liveEntryCount = reader->Read<int32>();
+	reader->CheckLink(reader->Read<int32>(), entryCapacity);
+
+	// The bucket of a cell is found with a mask.
+	int32 bucketCapacity;
+	int32 bucketCount = reader->ReadArrayHeader<int32>(&bucketCapacity);
+	for (int32 i = 0; i < bucketCount && reader->invalid == false; ++i)
+	{
+		reader->CheckLink(reader->Read<int32>(), entryCapacity);
+	}
+
+	int32 largeCapacity;
+	int32 largeCount = reader->ReadArrayHeader<int32>(&largeCapacity);
+	for (int32 i = 0; i < largeCount && reader->invalid == false; ++i)
+	{
+		int32 proxyId = reader->Read<int32>();
+		if (proxyId < 0 || proxyId >= capacity)
+		{
+			reader->invalid = true;
+		}
+	}
+
+	if (count != capacity || entryCount != entryCapacity || liveEntryCount < 0 || liveEntryCount > entryCapacity ||
+		bucketCount <= 0 || (bucketCount & (bucketCount - 1)) != 0 || maxLargeIndex >= largeCount)
+	{
+		reader->invalid = true;
+	}
+
+	return capacity;
+}
@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include "box2d/b2_block_allocator.h"
+#include <algorithm>
 #include <limits.h>
 #include <string.h>
 #include <stddef.h>
@@ -96,6 +97,10 @@ b2BlockAllocator::b2BlockAllocator()
 	
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_liveCounts, 0, sizeof(m_liveCounts));
+	memset(m_peakCounts, 0, sizeof(m_peakCounts));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+	memset(m_roundingBytes, 0, sizeof(m_roundingBytes));
 }
 
 b2BlockAllocator::~b2BlockAllocator()
@@ -125,6 +130,13 @@ void* b2BlockAllocator::Allocate(int32 size)
 	int32 index = b2_sizeMap.values[size];
 	b2Assert(0 <= index && index < b2_blockSizeCount);
 
+	m_liveCounts[index] += 1;
+	if (m_liveCounts[index] > m_peakCounts[index])
+	{
+		m_peakCounts[index] = m_liveCounts[index];
+	}
+	m_roundingBytes[index] += b2_blockSizes[index] - size;
+
 	if (m_freeLists[index])
 	{
 		b2Block* block = m_freeLists[index];
@@ -163,6 +175,7 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 		m_freeLists[index] = chunk->blocks->next;
 		++m_chunkCount;
+		m_chunkCounts[index] += 1;
 
 		return chunk->blocks;
 	}
@@ -186,6 +199,10 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	int32 index = b2_sizeMap.values[size];
 	b2Assert(0 <= index && index < b2_blockSizeCount);
 
+	b2Assert(m_liveCounts[index] > 0);
+	m_liveCounts[index] -= 1;
+	m_roundingBytes[index] -= b2_blockSizes[index] - size;
+
 #if defined(_DEBUG)
 	// Verify the memory address and size is valid.
 	int32 blockSize = b2_blockSizes[index];
@@ -227,4 +244,149 @@ void b2BlockAllocator::Clear()
 	m_chunkCount = 0;
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_liveCounts, 0, sizeof(m_liveCounts));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+	memset(m_roundingBytes, 0, sizeof(m_roundingBytes));
+}
+
+// A chunk address and its index, for finding the chunk that holds a block.
+struct b2ChunkRef
+{
+	const int8* blocks;
+	int32 index;
+};
+
+static bool b2ChunkLessThan(const b2ChunkRef& a, const b2ChunkRef& b)
+{
+	return a.blocks < b.blocks;
+}
+
+// Find the chunk holding a block. The references are sorted by address.
+static int32 b2FindChunk(const b2ChunkRef* refs, int32 count, const void* p)
+{
+	int32 low = 0;
+	int32 high = count - 1;
+	while (low < high)
+	{
+		int32 mid = (low + high + 1) >> 1;
+		if (refs[mid].blocks <= (const int8*)p)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	b2Assert(refs[low].blocks <= (const int8*)p && (const int8*)p < refs[low].blocks + b2_chunkSize);
+	return refs[low].index;
+}
+
+int32 b2BlockAllocator::Trim()
+{
+	if (m_chunkCount == 0)
+	{
+		return 0;
+	}
+
+	b2ChunkRef* refs = (b2ChunkRef*)b2Alloc(m_chunkCount * sizeof(b2ChunkRef));
+	int32* freeCounts = (int32*)b2Alloc(m_chunkCount * sizeof(int32));
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		refs[i].blocks = (const int8*)m_chunks[i].blocks;
+		refs[i].index = i;
+		freeCounts[i] = 0;
+	}
+
+	std::sort(refs, refs + m_chunkCount, b2ChunkLessThan);
+
+	// Count the free blocks in each chunk. A chunk is empty when all its blocks are free.
+	for (int32 index = 0; index < b2_blockSizeCount; ++index)
+	{
+		for (b2Block* block = m_freeLists[index]; block; block = block->next)
+		{
+			int32 chunkIndex = b2FindChunk(refs, m_chunkCount, block);
+			freeCounts[chunkIndex] += 1;
+		}
+	}
+
+	bool found = false;
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		b2Chunk* chunk = m_chunks + i;
+		if (freeCounts[i] == b2_chunkSize / chunk->blockSize)
+		{
+			found = true;
+			break;
+		}
+	}
+
+	int32 released = 0;
+	if (found)
+	{
+		// Take the blocks of empty chunks off the free lists, keeping the order of the rest.
+		for (int32 index = 0; index < b2_blockSizeCount; ++index)
+		{
+			b2Block** link = m_freeLists + index;
+			while (*link)
+			{
+				b2Block* block = *link;
+				int32 chunkIndex = b2FindChunk(refs, m_chunkCount, block);
+				const b2Chunk* chunk = m_chunks + chunkIndex;
+				if (freeCounts[chunkIndex] == b2_chunkSize / chunk->blockSize)
+				{
+					*link = block->next;
+				}
+				else
+				{
+					link = &block->next;
+				}
+			}
+		}
+
+		int32 count = 0;
+		for (int32 i = 0; i < m_chunkCount; ++i)
+		{
+			b2Chunk* chunk = m_chunks + i;
+			if (freeCounts[i] == b2_chunkSize / chunk->blockSize)
+			{
+				m_chunkCounts[b2_sizeMap.values[chunk->blockSize]] -= 1;
+				b2Free(chunk->blocks);
+				released += b2_chunkSize;
+			}
+			else
+			{
+				m_chunks[count++] = *chunk;
+			}
+		}
+
+		memset(m_chunks + count, 0, (m_chunkCount - count) * sizeof(b2Chunk));
+		m_chunkCount = count;
+	}
+
+	b2Free(freeCounts);
+	b2Free(refs);
+
+	return released;
+}
+
+b2BlockStats b2BlockAllocator::GetStats(int32 index) const
+{
+	b2Assert(0 <= index && index < b2_blockSizeCount);
+
+	int32 blockSize = b2_blockSizes[index];
+
+	b2BlockStats stats;
+	stats.blockSize = blockSize;
+	stats.liveCount = m_liveCounts[index];
+	stats.peakCount = m_peakCounts[index];
+	stats.chunkCount = m_chunkCounts[index];
+	stats.wastedBytes = m_roundingBytes[index] + m_chunkCounts[index] * (b2_chunkSize % blockSize);
+	return stats;
+}
+
+int32 b2BlockAllocator::GetChunkBytes() const
+{
+	return m_chunkCount * b2_chunkSize;
 }
@@ -24,6 +24,108 @@
 
 const b2Vec2 b2Vec2_zero(0.0f, 0.0f);
 
+#if defined(B2_DETERMINISTIC)
+
+// Reduce the angle to r in [-pi/4, pi/4] and the quadrant, so that angle = r + quadrant * pi/2.
+// Pi/2 is split in two floats to keep the reduction accurate for large angles.
+static float b2ReduceAngle(float angle, int32* quadrant)
+{
+	const float twoOverPi = 0.636619772f;
+	const float halfPiHigh = 1.57079637f;
+	const float halfPiLow = -4.37113883e-8f;
+
+	float k = floorf(angle * twoOverPi + 0.5f);
+	*quadrant = int32(k) & 3;
+	return (angle - k * halfPiHigh) - k * halfPiLow;
+}
+
+// Taylor polynomials, accurate on [-pi/4, pi/4].
+static float b2SinPoly(float r)
+{
+	float r2 = r * r;
+	return r + r * r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f + r2 * (-1.0f / 5040.0f + r2 * (1.0f / 362880.0f))));
+}
+
+static float b2CosPoly(float r)
+{
+	float r2 = r * r;
+	return 1.0f + r2 * (-0.5f + r2 * (1.0f / 24.0f + r2 * (-1.0f / 720.0f + r2 * (1.0f / 40320.0f))));
+}
+
+float b2ComputeSin(float angle)
+{
+	int32 quadrant;
+	float r = b2ReduceAngle(angle, &quadrant);
+	switch (quadrant)
+	{
+	case 0:
+		return b2SinPoly(r);
+	case 1:
+		return b2CosPoly(r);
+	case 2:
+		return -b2SinPoly(r);
+	default:
+		return -b2CosPoly(r);
+	}
+}
+
+float b2ComputeCos(float angle)
+{
+	int32 quadrant;
+	float r = b2ReduceAngle(angle, &quadrant);
+	switch (quadrant)
+	{
+	case 0:
+		return b2CosPoly(r);
+	case 1:
+		return -b2SinPoly(r);
+	case 2:
+		return -b2CosPoly(r);
+	default:
+		return b2SinPoly(r);
+	}
+}
+
+float b2ComputeAtan2(float y, float x)
+{
+	const float pi = 3.14159265f;
+	const float tanPiOverEight = 0.414213562f;
+
+	float ax = b2Abs(x);
+	float ay = b2Abs(y);
+	float mx = b2Max(ax, ay);
+	if (mx == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	// atan(t) for t in [0, 1], shifted by pi/4 to keep the series argument small.
+	float t = b2Min(ax, ay) / mx;
+	float offset = 0.0f;
+	if (t > tanPiOverEight)
+	{
+		t = (t - 1.0f) / (t + 1.0f);
+		offset = 0.25f * pi;
+	}
+
+	float t2 = t * t;
+	float a = offset + t + t * t2 * (-1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (-1.0f / 7.0f + t2 * (1.0f / 9.0f + t2 * (-1.0f / 11.0f)))));
+
+	if (ay > ax)
+	{
+		a = 0.5f * pi - a;
+	}
+
+	if (x < 0.0f)
+	{
+		a = pi - a;
+	}
+
+	return y < 0.0f ? -a : a;
+}
+
+#endif
+
 /// Solve A * x = b, where b is a column vector. This is more efficient
 /// than computing the inverse in one-shot cases.
 b2Vec3 b2Mat33::Solve33(const b2Vec3& b) const
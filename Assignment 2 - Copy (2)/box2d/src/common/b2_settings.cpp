@@ -23,21 +23,68 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "box2d/b2_settings.h"
+#include <atomic>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 
 b2Version b2_version = {2, 4, 0};
 
+// Each allocation is prefixed with its size so b2Free_Default can count it. The
+// prefix keeps the alignment of malloc.
+static const int32 b2_allocHeaderSize = 16;
+
+static std::atomic<int32> b2_allocCount(0);
+static std::atomic<int32> b2_liveCount(0);
+static std::atomic<int32> b2_liveBytes(0);
+static std::atomic<int32> b2_peakBytes(0);
+
 // Memory allocators. Modify these to use your own allocator.
 void* b2Alloc_Default(int32 size)
 {
-	return malloc(size);
+	int8* mem = (int8*)malloc(b2_allocHeaderSize + size);
+	if (mem == nullptr)
+	{
+		return nullptr;
+	}
+
+	*(int32*)mem = size;
+
+	b2_allocCount.fetch_add(1, std::memory_order_relaxed);
+	b2_liveCount.fetch_add(1, std::memory_order_relaxed);
+	int32 liveBytes = b2_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	int32 peakBytes = b2_peakBytes.load(std::memory_order_relaxed);
+	while (liveBytes > peakBytes && b2_peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed) == false)
+	{
+	}
+
+	return mem + b2_allocHeaderSize;
 }
 
 void b2Free_Default(void* mem)
 {
-	free(mem);
+	if (mem == nullptr)
+	{
+		return;
+	}
+
+	int8* block = (int8*)mem - b2_allocHeaderSize;
+	int32 size = *(int32*)block;
+
+	b2_liveCount.fetch_sub(1, std::memory_order_relaxed);
+	b2_liveBytes.fetch_sub(size, std::memory_order_relaxed);
+
+	free(block);
+}
+
+b2AllocStats b2GetAllocStats()
+{
+	b2AllocStats stats;
+	stats.allocCount = b2_allocCount.load(std::memory_order_relaxed);
+	stats.liveCount = b2_liveCount.load(std::memory_order_relaxed);
+	stats.liveBytes = b2_liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = b2_peakBytes.load(std::memory_order_relaxed);
+	return stats;
 }
 
 // You can modify this to use your logging facility.
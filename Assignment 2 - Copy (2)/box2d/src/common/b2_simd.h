@@ -0,0 +1,361 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_SIMD_H
+#define B2_SIMD_H
+
+#include "box2d/b2_math.h"
+#include "box2d/b2_settings.h"
+
+#include <math.h>
+#include <string.h>
+
+// Internal wide float type used by the vectorized solver and collision paths.
+// b2FloatW holds b2_simdWidth lanes. AVX2 builds use 8 lanes, SSE2 and AArch64
+// NEON use 4 lanes. Other targets get a portable 4 lane fallback.
+// Comparisons return lane masks (all bits set or clear) for b2BlendW.
+// b2MaskBitsW packs a lane mask into one bit per lane.
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define B2_SIMD_AVX2 1
+#define b2_simdWidth 8
+
+typedef __m256 b2FloatW;
+
+inline b2FloatW b2ZeroW() { return _mm256_setzero_ps(); }
+inline b2FloatW b2SplatW(float a) { return _mm256_set1_ps(a); }
+inline b2FloatW b2LoadW(const float* a) { return _mm256_load_ps(a); }
+inline void b2StoreW(float* a, b2FloatW b) { _mm256_store_ps(a, b); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm256_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm256_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm256_mul_ps(a, b); }
+inline b2FloatW b2DivW(b2FloatW a, b2FloatW b) { return _mm256_div_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm256_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm256_max_ps(a, b); }
+inline b2FloatW b2SqrtW(b2FloatW a) { return _mm256_sqrt_ps(a); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline b2FloatW b2LessW(b2FloatW a, b2FloatW b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm256_and_ps(a, b); }
+inline b2FloatW b2OrW(b2FloatW a, b2FloatW b) { return _mm256_or_ps(a, b); }
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask) { return _mm256_blendv_ps(a, b, mask); }
+inline bool b2AnyW(b2FloatW mask) { return _mm256_movemask_ps(mask) != 0; }
+inline uint32 b2MaskBitsW(b2FloatW mask) { return uint32(_mm256_movemask_ps(mask)); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define B2_SIMD_SSE2 1
+#define b2_simdWidth 4
+
+typedef __m128 b2FloatW;
+
+inline b2FloatW b2ZeroW() { return _mm_setzero_ps(); }
+inline b2FloatW b2SplatW(float a) { return _mm_set1_ps(a); }
+inline b2FloatW b2LoadW(const float* a) { return _mm_load_ps(a); }
+inline void b2StoreW(float* a, b2FloatW b) { _mm_store_ps(a, b); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm_mul_ps(a, b); }
+inline b2FloatW b2DivW(b2FloatW a, b2FloatW b) { return _mm_div_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm_max_ps(a, b); }
+inline b2FloatW b2SqrtW(b2FloatW a) { return _mm_sqrt_ps(a); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm_cmpge_ps(a, b); }
+inline b2FloatW b2LessW(b2FloatW a, b2FloatW b) { return _mm_cmplt_ps(a, b); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm_and_ps(a, b); }
+inline b2FloatW b2OrW(b2FloatW a, b2FloatW b) { return _mm_or_ps(a, b); }
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask) { return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b)); }
+inline bool b2AnyW(b2FloatW mask) { return _mm_movemask_ps(mask) != 0; }
+inline uint32 b2MaskBitsW(b2FloatW mask) { return uint32(_mm_movemask_ps(mask)); }
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define B2_SIMD_NEON 1
+#define b2_simdWidth 4
+
+typedef float32x4_t b2FloatW;
+
+inline b2FloatW b2ZeroW() { return vdupq_n_f32(0.0f); }
+inline b2FloatW b2SplatW(float a) { return vdupq_n_f32(a); }
+inline b2FloatW b2LoadW(const float* a) { return vld1q_f32(a); }
+inline void b2StoreW(float* a, b2FloatW b) { vst1q_f32(a, b); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return vaddq_f32(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return vsubq_f32(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return vmulq_f32(a, b); }
+inline b2FloatW b2DivW(b2FloatW a, b2FloatW b) { return vdivq_f32(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return vminq_f32(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return vmaxq_f32(a, b); }
+inline b2FloatW b2SqrtW(b2FloatW a) { return vsqrtq_f32(a); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline b2FloatW b2LessW(b2FloatW a, b2FloatW b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline b2FloatW b2OrW(b2FloatW a, b2FloatW b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask) { return vbslq_f32(vreinterpretq_u32_f32(mask), b, a); }
+inline bool b2AnyW(b2FloatW mask) { return vmaxvq_u32(vreinterpretq_u32_f32(mask)) != 0; }
+
+inline uint32 b2MaskBitsW(b2FloatW mask)
+{
+	static const uint32 weights[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(weights)));
+}
+
+#else
+
+#define B2_SIMD_NONE 1
+#define b2_simdWidth 4
+
+struct b2FloatW
+{
+	float x[b2_simdWidth];
+};
+
+inline b2FloatW b2ZeroW() { b2FloatW r; for (int32 i = 0; i < b2_simdWidth; ++i) r.x[i] = 0.0f; return r; }
+inline b2FloatW b2SplatW(float a) { b2FloatW r; for (int32 i = 0; i < b2_simdWidth; ++i) r.x[i] = a; return r; }
+inline b2FloatW b2LoadW(const float* a) { b2FloatW r; for (int32 i = 0; i < b2_simdWidth; ++i) r.x[i] = a[i]; return r; }
+inline void b2StoreW(float* a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a[i] = b.x[i]; }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] += b.x[i]; return a; }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] -= b.x[i]; return a; }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] *= b.x[i]; return a; }
+inline b2FloatW b2DivW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] /= b.x[i]; return a; }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] = a.x[i] < b.x[i] ? a.x[i] : b.x[i]; return a; }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] = a.x[i] > b.x[i] ? a.x[i] : b.x[i]; return a; }
+inline b2FloatW b2SqrtW(b2FloatW a) { for (int32 i = 0; i < b2_simdWidth; ++i) a.x[i] = sqrtf(a.x[i]); return a; }
+
+inline b2FloatW b2MaskW(bool flags[b2_simdWidth])
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 bits = flags[i] ? 0xFFFFFFFF : 0;
+		memcpy(r.x + i, &bits, sizeof(float));
+	}
+	return r;
+}
+
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { bool f[b2_simdWidth]; for (int32 i = 0; i < b2_simdWidth; ++i) f[i] = a.x[i] >= b.x[i]; return b2MaskW(f); }
+inline b2FloatW b2LessW(b2FloatW a, b2FloatW b) { bool f[b2_simdWidth]; for (int32 i = 0; i < b2_simdWidth; ++i) f[i] = a.x[i] < b.x[i]; return b2MaskW(f); }
+
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b)
+{
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 ua, ub;
+		memcpy(&ua, a.x + i, sizeof(float));
+		memcpy(&ub, b.x + i, sizeof(float));
+		ua &= ub;
+		memcpy(a.x + i, &ua, sizeof(float));
+	}
+	return a;
+}
+
+inline b2FloatW b2OrW(b2FloatW a, b2FloatW b)
+{
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 ua, ub;
+		memcpy(&ua, a.x + i, sizeof(float));
+		memcpy(&ub, b.x + i, sizeof(float));
+		ua |= ub;
+		memcpy(a.x + i, &ua, sizeof(float));
+	}
+	return a;
+}
+
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask)
+{
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 m;
+		memcpy(&m, mask.x + i, sizeof(float));
+		a.x[i] = m ? b.x[i] : a.x[i];
+	}
+	return a;
+}
+
+inline bool b2AnyW(b2FloatW mask)
+{
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 m;
+		memcpy(&m, mask.x + i, sizeof(float));
+		if (m)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+inline uint32 b2MaskBitsW(b2FloatW mask)
+{
+	uint32 bits = 0;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		uint32 m;
+		memcpy(&m, mask.x + i, sizeof(float));
+		bits |= (m & 1) << i;
+	}
+	return bits;
+}
+
+#endif
+
+/// Byte alignment required by b2LoadW/b2StoreW.
+#define b2_simdAlignment (4 * b2_simdWidth)
+
+// Helpers built on the primitives above.
+inline b2FloatW b2NegW(b2FloatW a) { return b2SubW(b2ZeroW(), a); }
+
+// a * b - c * d
+inline b2FloatW b2CrossW(b2FloatW ax, b2FloatW ay, b2FloatW bx, b2FloatW by)
+{
+	return b2SubW(b2MulW(ax, by), b2MulW(ay, bx));
+}
+
+inline b2FloatW b2ClampW(b2FloatW a, b2FloatW low, b2FloatW high)
+{
+	return b2MaxW(low, b2MinW(a, high));
+}
+
+inline float b2GetLaneW(const b2FloatW& a, int32 lane)
+{
+	float r;
+	memcpy(&r, (const char*)&a + lane * sizeof(float), sizeof(float));
+	return r;
+}
+
+inline void b2SetLaneW(b2FloatW* a, int32 lane, float value)
+{
+	memcpy((char*)a + lane * sizeof(float), &value, sizeof(float));
+}
+
+// Set a lane of a b2BlendW mask.
+inline void b2SetMaskLaneW(b2FloatW* a, int32 lane, bool flag)
+{
+	uint32 bits = flag ? 0xFFFFFFFF : 0;
+	memcpy((char*)a + lane * sizeof(float), &bits, sizeof(float));
+}
+
+// Round a pointer up to b2_simdAlignment.
+inline void* b2AlignW(void* p)
+{
+	uintptr_t address = (uintptr_t)p;
+	address = (address + b2_simdAlignment - 1) & ~uintptr_t(b2_simdAlignment - 1);
+	return (void*)address;
+}
+
+// Hint that the cache line holding p will be read soon.
+inline void b2Prefetch(const void* p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(p);
+#elif defined(B2_SIMD_AVX2) || defined(B2_SIMD_SSE2)
+	_mm_prefetch((const char*)p, _MM_HINT_T0);
+#else
+	B2_NOT_USED(p);
+#endif
+}
+
+// Index of the first point with the largest dot product with d, the same index as a
+// scalar scan with a strict comparison. Four to eight points are scanned as two groups
+// of four. The second group starts at count - 4 so no point past count is read.
+inline int32 b2SupportIndex(const b2Vec2* points, int32 count, const b2Vec2& d)
+{
+#if defined(B2_SIMD_AVX2) || defined(B2_SIMD_SSE2) || defined(B2_SIMD_NEON)
+	if (4 <= count && count <= 8)
+	{
+		const float* first = &points[0].x;
+		const float* last = &points[count - 4].x;
+
+#if defined(B2_SIMD_NEON)
+		float32x4x2_t a = vld2q_f32(first);
+		float32x4x2_t b = vld2q_f32(last);
+		float32x4_t dx = vdupq_n_f32(d.x);
+		float32x4_t dy = vdupq_n_f32(d.y);
+		float32x4_t dotA = vaddq_f32(vmulq_f32(a.val[0], dx), vmulq_f32(a.val[1], dy));
+		float32x4_t dotB = vaddq_f32(vmulq_f32(b.val[0], dx), vmulq_f32(b.val[1], dy));
+		float32x4_t best = vdupq_n_f32(vmaxvq_f32(vmaxq_f32(dotA, dotB)));
+		static const uint32 weights[4] = { 1, 2, 4, 8 };
+		uint32 maskA = vaddvq_u32(vandq_u32(vceqq_f32(dotA, best), vld1q_u32(weights)));
+		uint32 maskB = vaddvq_u32(vandq_u32(vceqq_f32(dotB, best), vld1q_u32(weights)));
+#else
+		// Split the interleaved (x, y) pairs into x and y lanes.
+		__m128 a0 = _mm_loadu_ps(first);
+		__m128 a1 = _mm_loadu_ps(first + 4);
+		__m128 b0 = _mm_loadu_ps(last);
+		__m128 b1 = _mm_loadu_ps(last + 4);
+		__m128 dx = _mm_set1_ps(d.x);
+		__m128 dy = _mm_set1_ps(d.y);
+		__m128 dotA = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)), dx),
+								 _mm_mul_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)), dy));
+		__m128 dotB = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)), dx),
+								 _mm_mul_ps(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)), dy));
+		__m128 best = _mm_max_ps(dotA, dotB);
+		best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+		best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+		uint32 maskA = uint32(_mm_movemask_ps(_mm_cmpeq_ps(dotA, best)));
+		uint32 maskB = uint32(_mm_movemask_ps(_mm_cmpeq_ps(dotB, best)));
+#endif
+
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if (maskA & (1u << i))
+			{
+				return i;
+			}
+		}
+
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if (maskB & (1u << i))
+			{
+				return count - 4 + i;
+			}
+		}
+
+		// NaN direction
+		return 0;
+	}
+#endif
+
+	int32 bestIndex = 0;
+	float bestValue = b2Dot(points[0], d);
+	for (int32 i = 1; i < count; ++i)
+	{
+		float value = b2Dot(points[i], d);
+		if (value > bestValue)
+		{
+			bestIndex = i;
+			bestValue = value;
+		}
+	}
+
+	return bestIndex;
+}
+
+#endif
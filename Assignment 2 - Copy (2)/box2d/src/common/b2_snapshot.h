@@ -0,0 +1,214 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef B2_SNAPSHOT_H
+#define B2_SNAPSHOT_H
+
+#include "box2d/b2_common.h"
+
+#include <string.h>
+
+// Writes the flat buffer of b2World::SaveSnapshot. Writes past the capacity are only
+// counted, so one pass gives the size the snapshot needs.
+struct b2SnapshotWriter
+{
+	void Write(const void* data, int32 size)
+	{
+		if (offset + size <= capacity)
+		{
+			memcpy(buffer + offset, data, size);
+		}
+		offset += size;
+	}
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		Write(&value, sizeof(T));
+	}
+
+	// Write the first count elements of an array and its capacity.
+	template <typename T>
+	void WriteArray(const T* array, int32 count, int32 arrayCapacity)
+	{
+		Write(arrayCapacity);
+		Write(count);
+		Write(array, count * int32(sizeof(T)));
+	}
+
+	// Write an array like WriteArray with a pointer field of every element cleared.
+	template <typename T>
+	void WriteArray(const T* array, int32 count, int32 arrayCapacity, void* T::* pointer)
+	{
+		Write(arrayCapacity);
+		Write(count);
+		for (int32 i = 0; i < count; ++i)
+		{
+			T element = array[i];
+			element.*pointer = nullptr;
+			Write(element);
+		}
+	}
+
+	uint8* buffer;
+	int32 capacity;
+	int32 offset;
+};
+
+// Reads a buffer written by b2SnapshotWriter. A read past the end of the buffer or a
+// link out of range sets the invalid flag and yields zeros or null, so a damaged buffer
+// cannot overrun memory.
+struct b2SnapshotReader
+{
+	void Read(void* data, int32 count)
+	{
+		if (invalid || count < 0 || count > size - offset)
+		{
+			invalid = true;
+			memset(data, 0, count > 0 ? count : 0);
+			return;
+		}
+
+		memcpy(data, buffer + offset, count);
+		offset += count;
+	}
+
+	template <typename T>
+	T Read()
+	{
+		T value;
+		Read(&value, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void Read(T* value)
+	{
+		Read(value, sizeof(T));
+	}
+
+	// Read an array written by WriteArray. The allocation gets the saved capacity, so
+	// free lists and growth work as they did when the array was saved. If the capacity
+	// or count fail the checks of ReadArrayHeader the array is left alone and the invalid
+	// flag is set. Returns the element count.
+	template <typename T>
+	int32 ReadArray(T** array, int32* arrayCapacity)
+	{
+		int32 savedCapacity;
+		int32 count = ReadArrayHeader<T>(&savedCapacity);
+		if (invalid)
+		{
+			return 0;
+		}
+
+		if (*arrayCapacity != savedCapacity)
+		{
+			b2Free(*array);
+			*array = savedCapacity > 0 ? (T*)b2Alloc(savedCapacity * sizeof(T)) : nullptr;
+			*arrayCapacity = savedCapacity;
+		}
+		Read(*array, count * int32(sizeof(T)));
+		return count;
+	}
+
+	// Read the capacity and count written by WriteArray, leaving the elements to be read
+	// one by one. The count is checked like in ReadArray and the capacity must give an
+	// allocation size that fits in an int32. Returns the element count.
+	template <typename T>
+	int32 ReadArrayHeader(int32* arrayCapacity)
+	{
+		*arrayCapacity = Read<int32>();
+		int32 count = Read<int32>();
+		if (invalid || count < 0 || *arrayCapacity < count || *arrayCapacity > 0x7fffffff / int32(sizeof(T)) ||
+			count > (size - offset) / int32(sizeof(T)))
+		{
+			invalid = true;
+			return 0;
+		}
+
+		return count;
+	}
+
+	// Move past data that is not needed.
+	void Skip(int32 count)
+	{
+		if (invalid || count < 0 || count > size - offset)
+		{
+			invalid = true;
+			return;
+		}
+
+		offset += count;
+	}
+
+	// Read a bool as its byte. A damaged bool sets the invalid flag, loading it as a
+	// bool would be undefined.
+	void CheckBool()
+	{
+		if (Read<uint8>() > 1)
+		{
+			invalid = true;
+		}
+	}
+
+	// Check a bool of an element that has been read as a whole.
+	void CheckBool(const bool& value)
+	{
+		uint8 byte;
+		memcpy(&byte, &value, sizeof(byte));
+		if (byte > 1)
+		{
+			invalid = true;
+		}
+	}
+
+	// Set the invalid flag unless the index is -1 or in [0, count).
+	void CheckLink(int32 index, int32 count)
+	{
+		if (index < -1 || index >= count)
+		{
+			invalid = true;
+		}
+	}
+
+	// Read an index written for a link and look it up. -1 is a null link.
+	template <typename T>
+	T* ReadLink(T* const* array, int32 count)
+	{
+		int32 index = Read<int32>();
+		if (index < -1 || index >= count)
+		{
+			invalid = true;
+			return nullptr;
+		}
+
+		return index >= 0 ? array[index] : nullptr;
+	}
+
+	const uint8* buffer;
+	int32 size;
+	int32 offset;
+	bool invalid;
+};
+
+#endif
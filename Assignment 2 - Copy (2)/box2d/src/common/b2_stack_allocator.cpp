@@ -23,38 +23,114 @@
 #include "box2d/b2_stack_allocator.h"
 #include "box2d/b2_math.h"
 
+#include <string.h>
+
+// Allocations are rounded up so every block starts on this boundary.
+static const int32 b2_stackAlignment = 16;
+
 b2StackAllocator::b2StackAllocator()
 {
+	m_chunks = nullptr;
+	m_chunkCount = 0;
+	m_chunkCapacity = 0;
+	m_chunkIndex = 0;
 	m_index = 0;
 	m_allocation = 0;
 	m_maxAllocation = 0;
+	m_growCount = 0;
+	m_entries = nullptr;
 	m_entryCount = 0;
+	m_entryCapacity = 0;
 }
 
 b2StackAllocator::~b2StackAllocator()
 {
-	b2Assert(m_index == 0);
+	b2Assert(m_chunkIndex == 0 && m_index == 0);
 	b2Assert(m_entryCount == 0);
+
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		b2Free(m_chunks[i].data);
+	}
+	b2Free(m_chunks);
+	b2Free(m_entries);
+}
+
+void b2StackAllocator::AddChunk(int32 size)
+{
+	if (m_chunkCount == m_chunkCapacity)
+	{
+		b2StackChunk* oldChunks = m_chunks;
+		m_chunkCapacity = b2Max(2 * m_chunkCapacity, 4);
+		m_chunks = (b2StackChunk*)b2Alloc(m_chunkCapacity * sizeof(b2StackChunk));
+		if (oldChunks)
+		{
+			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2StackChunk));
+			b2Free(oldChunks);
+		}
+	}
+
+	b2StackChunk* chunk = m_chunks + m_chunkCount;
+	chunk->data = (char*)b2Alloc(size);
+	chunk->size = size;
+	++m_chunkCount;
 }
 
 void* b2StackAllocator::Allocate(int32 size)
 {
-	b2Assert(m_entryCount < b2_maxStackEntries);
+	// Deep nesting grows the entries instead of running past them.
+	if (m_entryCount == m_entryCapacity)
+	{
+		b2StackEntry* oldEntries = m_entries;
+		m_entryCapacity = b2Max(2 * m_entryCapacity, b2_maxStackEntries);
+		m_entries = (b2StackEntry*)b2Alloc(m_entryCapacity * sizeof(b2StackEntry));
+		if (oldEntries)
+		{
+			memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2StackEntry));
+			b2Free(oldEntries);
+		}
+	}
+
+	size = (size + b2_stackAlignment - 1) & ~(b2_stackAlignment - 1);
 
 	b2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
-	if (m_index + size > b2_stackSize)
-	{
-		entry->data = (char*)b2Alloc(size);
-		entry->usedMalloc = true;
-	}
-	else
+	entry->chunkIndex = m_chunkIndex;
+	entry->index = m_index;
+
+	if (m_chunkCount == 0 || m_index + size > m_chunks[m_chunkIndex].size)
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += size;
+		// Move to the next chunk that is big enough. Smaller chunks are skipped
+		// until the stack unwinds past them.
+		int32 chunkIndex = m_chunkCount == 0 ? 0 : m_chunkIndex + 1;
+		while (chunkIndex < m_chunkCount && m_chunks[chunkIndex].size < size)
+		{
+			++chunkIndex;
+		}
+
+		if (chunkIndex == m_chunkCount)
+		{
+			// Grow geometrically so a large world settles on a few chunks.
+			int32 chunkSize = b2Max(size, b2_stackSize);
+			if (m_chunkCount > 0)
+			{
+				chunkSize = b2Max(chunkSize, 2 * m_chunks[m_chunkCount - 1].size);
+			}
+
+			AddChunk(chunkSize);
+			if (m_chunkCount > 1)
+			{
+				++m_growCount;
+			}
+		}
+
+		m_chunkIndex = chunkIndex;
+		m_index = 0;
 	}
 
+	entry->data = m_chunks[m_chunkIndex].data + m_index;
+	m_index += size;
+
 	m_allocation += size;
 	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 	++m_entryCount;
@@ -67,21 +143,33 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
-	{
-		b2Free(p);
-	}
-	else
-	{
-		m_index -= entry->size;
-	}
+	B2_NOT_USED(p);
+
+	m_chunkIndex = entry->chunkIndex;
+	m_index = entry->index;
 	m_allocation -= entry->size;
 	--m_entryCount;
+}
 
-	p = nullptr;
+void b2StackAllocator::Reset()
+{
+	m_chunkIndex = 0;
+	m_index = 0;
+	m_allocation = 0;
+	m_entryCount = 0;
 }
 
 int32 b2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
 }
+
+int32 b2StackAllocator::GetCapacity() const
+{
+	int32 capacity = 0;
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		capacity += m_chunks[i].size;
+	}
+	return capacity;
+}
@@ -0,0 +1,203 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_thread_pool.h"
+#include "box2d/b2_math.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+struct b2ThreadPoolImpl
+{
+	void WorkerMain(int32 threadIndex);
+	void Run(int32 threadIndex);
+
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	std::thread* workers;
+	int32 workerCount;
+
+	// The current batch. Written under the mutex before the generation is bumped.
+	b2ThreadTask* task;
+	int32 itemCount;
+	int32 rangeSize;
+	std::atomic<int32> nextItem;
+
+	int32 generation;
+	int32 busyWorkers;
+	bool running;
+	bool exit;
+};
+
+// Grab ranges until the batch is exhausted. Threads that finish early pick up
+// the remaining ranges, so uneven items (e.g. islands of different sizes) balance.
+void b2ThreadPoolImpl::Run(int32 threadIndex)
+{
+	for (;;)
+	{
+		int32 begin = nextItem.fetch_add(rangeSize);
+		if (begin >= itemCount)
+		{
+			break;
+		}
+
+		int32 end = b2Min(begin + rangeSize, itemCount);
+		task->Execute(begin, end, threadIndex);
+	}
+}
+
+void b2ThreadPoolImpl::WorkerMain(int32 threadIndex)
+{
+	int32 seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (exit == false && generation == seenGeneration)
+			{
+				wakeCondition.wait(lock);
+			}
+
+			if (exit)
+			{
+				return;
+			}
+
+			seenGeneration = generation;
+		}
+
+		Run(threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busyWorkers;
+			if (busyWorkers == 0)
+			{
+				doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+b2ThreadPool::b2ThreadPool(int32 threadCount)
+{
+	b2Assert(threadCount > 0);
+	m_threadCount = b2Max(threadCount, 1);
+
+	void* mem = b2Alloc(sizeof(b2ThreadPoolImpl));
+	m_impl = new (mem) b2ThreadPoolImpl;
+	m_impl->task = nullptr;
+	m_impl->itemCount = 0;
+	m_impl->rangeSize = 1;
+	m_impl->nextItem = 0;
+	m_impl->generation = 0;
+	m_impl->busyWorkers = 0;
+	m_impl->running = false;
+	m_impl->exit = false;
+
+	m_impl->workerCount = m_threadCount - 1;
+	m_impl->workers = nullptr;
+	if (m_impl->workerCount > 0)
+	{
+		m_impl->workers = (std::thread*)b2Alloc(m_impl->workerCount * sizeof(std::thread));
+		for (int32 i = 0; i < m_impl->workerCount; ++i)
+		{
+			new (m_impl->workers + i) std::thread(&b2ThreadPoolImpl::WorkerMain, m_impl, i + 1);
+		}
+	}
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_impl->mutex);
+		m_impl->exit = true;
+	}
+	m_impl->wakeCondition.notify_all();
+
+	for (int32 i = 0; i < m_impl->workerCount; ++i)
+	{
+		m_impl->workers[i].join();
+		m_impl->workers[i].~thread();
+	}
+
+	if (m_impl->workers)
+	{
+		b2Free(m_impl->workers);
+	}
+
+	m_impl->~b2ThreadPoolImpl();
+	b2Free(m_impl);
+}
+
+void b2ThreadPool::ParallelFor(b2ThreadTask* task, int32 itemCount, int32 minRange)
+{
+	if (itemCount <= 0)
+	{
+		return;
+	}
+
+	minRange = b2Max(minRange, 1);
+
+	b2ThreadPoolImpl* impl = m_impl;
+	if (impl->workerCount == 0 || itemCount <= minRange)
+	{
+		task->Execute(0, itemCount, 0);
+		return;
+	}
+
+	b2Assert(impl->running == false);
+	impl->running = true;
+
+	// Several ranges per thread so that fast threads can steal from slow ones.
+	int32 rangeSize = b2Max(minRange, itemCount / (4 * m_threadCount));
+
+	{
+		std::lock_guard<std::mutex> lock(impl->mutex);
+		impl->task = task;
+		impl->itemCount = itemCount;
+		impl->rangeSize = rangeSize;
+		impl->nextItem = 0;
+		impl->busyWorkers = impl->workerCount;
+		++impl->generation;
+	}
+	impl->wakeCondition.notify_all();
+
+	// The calling thread is thread 0.
+	impl->Run(0);
+
+	{
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		while (impl->busyWorkers > 0)
+		{
+			impl->doneCondition.wait(lock);
+		}
+		impl->task = nullptr;
+	}
+
+	impl->running = false;
+}
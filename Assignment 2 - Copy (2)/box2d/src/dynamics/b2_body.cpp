@@ -27,6 +27,114 @@
 #include "box2d/b2_world.h"
 
 #include <new>
+#include <string.h>
+
+b2BodyStates::b2BodyStates()
+{
+	count = 0;
+	capacity = 0;
+	centers = nullptr;
+	angles = nullptr;
+	linearVelocities = nullptr;
+	angularVelocities = nullptr;
+	forces = nullptr;
+	torques = nullptr;
+	invMasses = nullptr;
+	invInertias = nullptr;
+	bodies = nullptr;
+}
+
+b2BodyStates::~b2BodyStates()
+{
+	b2Free(centers);
+	b2Free(angles);
+	b2Free(linearVelocities);
+	b2Free(angularVelocities);
+	b2Free(forces);
+	b2Free(torques);
+	b2Free(invMasses);
+	b2Free(invInertias);
+	b2Free(bodies);
+}
+
+template <typename T>
+static void b2GrowStateArray(T*& array, int32 count, int32 capacity)
+{
+	T* old = array;
+	array = (T*)b2Alloc(capacity * sizeof(T));
+	if (old != nullptr)
+	{
+		memcpy(array, old, count * sizeof(T));
+		b2Free(old);
+	}
+}
+
+int32 b2BodyStates::Add(b2Body* body)
+{
+	if (count == capacity)
+	{
+		int32 newCapacity = capacity == 0 ? 16 : 2 * capacity;
+		b2GrowStateArray(centers, count, newCapacity);
+		b2GrowStateArray(angles, count, newCapacity);
+		b2GrowStateArray(linearVelocities, count, newCapacity);
+		b2GrowStateArray(angularVelocities, count, newCapacity);
+		b2GrowStateArray(forces, count, newCapacity);
+		b2GrowStateArray(torques, count, newCapacity);
+		b2GrowStateArray(invMasses, count, newCapacity);
+		b2GrowStateArray(invInertias, count, newCapacity);
+		b2GrowStateArray(bodies, count, newCapacity);
+		capacity = newCapacity;
+	}
+
+	bodies[count] = body;
+	return count++;
+}
+
+void b2BodyStates::Remove(int32 index)
+{
+	b2Assert(0 <= index && index < count);
+	int32 last = --count;
+	if (index == last)
+	{
+		return;
+	}
+
+	centers[index] = centers[last];
+	angles[index] = angles[last];
+	linearVelocities[index] = linearVelocities[last];
+	angularVelocities[index] = angularVelocities[last];
+	forces[index] = forces[last];
+	torques[index] = torques[last];
+	invMasses[index] = invMasses[last];
+	invInertias[index] = invInertias[last];
+	bodies[index] = bodies[last];
+	bodies[index]->m_stateIndex = index;
+}
+
+template <typename T>
+static inline void b2SwapState(T* array, int32 indexA, int32 indexB)
+{
+	T tmp = array[indexA];
+	array[indexA] = array[indexB];
+	array[indexB] = tmp;
+}
+
+void b2BodyStates::Swap(int32 indexA, int32 indexB)
+{
+	b2Assert(0 <= indexA && indexA < count);
+	b2Assert(0 <= indexB && indexB < count);
+	b2SwapState(centers, indexA, indexB);
+	b2SwapState(angles, indexA, indexB);
+	b2SwapState(linearVelocities, indexA, indexB);
+	b2SwapState(angularVelocities, indexA, indexB);
+	b2SwapState(forces, indexA, indexB);
+	b2SwapState(torques, indexA, indexB);
+	b2SwapState(invMasses, indexA, indexB);
+	b2SwapState(invInertias, indexA, indexB);
+	b2SwapState(bodies, indexA, indexB);
+	bodies[indexA]->m_stateIndex = indexA;
+	bodies[indexB]->m_stateIndex = indexB;
+}
 
 b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 {
@@ -61,41 +169,47 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 	}
 
 	m_world = world;
+	m_islandIndex = -1;
+	m_islandId = b2_nullIsland;
+	m_islandPrev = nullptr;
+	m_islandNext = nullptr;
+	m_states = &world->m_bodyStates;
+	m_stateIndex = m_states->Add(this);
 
 	m_xf.p = bd->position;
 	m_xf.q.Set(bd->angle);
 
-	m_sweep.localCenter.SetZero();
-	m_sweep.c0 = m_xf.p;
-	m_sweep.c = m_xf.p;
-	m_sweep.a0 = bd->angle;
-	m_sweep.a = bd->angle;
-	m_sweep.alpha0 = 0.0f;
+	m_localCenter.SetZero();
+	m_center0 = m_xf.p;
+	m_angle0 = bd->angle;
+	m_alpha0 = 0.0f;
+	m_states->centers[m_stateIndex] = m_xf.p;
+	m_states->angles[m_stateIndex] = bd->angle;
 
 	m_jointList = nullptr;
 	m_contactList = nullptr;
 	m_prev = nullptr;
 	m_next = nullptr;
 
-	m_linearVelocity = bd->linearVelocity;
-	m_angularVelocity = bd->angularVelocity;
+	m_states->linearVelocities[m_stateIndex] = bd->linearVelocity;
+	m_states->angularVelocities[m_stateIndex] = bd->angularVelocity;
 
 	m_linearDamping = bd->linearDamping;
 	m_angularDamping = bd->angularDamping;
 	m_gravityScale = bd->gravityScale;
 
-	m_force.SetZero();
-	m_torque = 0.0f;
+	m_states->forces[m_stateIndex].SetZero();
+	m_states->torques[m_stateIndex] = 0.0f;
 
 	m_sleepTime = 0.0f;
 
 	m_type = bd->type;
 
 	m_mass = 0.0f;
-	m_invMass = 0.0f;
+	m_states->invMasses[m_stateIndex] = 0.0f;
 
 	m_I = 0.0f;
-	m_invI = 0.0f;
+	m_states->invInertias[m_stateIndex] = 0.0f;
 
 	m_userData = bd->userData;
 
@@ -106,6 +220,33 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 b2Body::~b2Body()
 {
 	// shapes and joints are destroyed in b2World::Destroy
+	m_states->Remove(m_stateIndex);
+}
+
+void b2Body::SetAwake(bool flag)
+{
+	if (m_type == b2_staticBody)
+	{
+		return;
+	}
+
+	if (flag)
+	{
+		m_flags |= e_awakeFlag;
+		m_sleepTime = 0.0f;
+
+		// The whole island wakes up in the next step.
+		m_world->m_islandManager.WakeIsland(m_islandId);
+	}
+	else
+	{
+		m_flags &= ~e_awakeFlag;
+		m_sleepTime = 0.0f;
+		m_states->linearVelocities[m_stateIndex].SetZero();
+		m_states->angularVelocities[m_stateIndex] = 0.0f;
+		m_states->forces[m_stateIndex].SetZero();
+		m_states->torques[m_stateIndex] = 0.0f;
+	}
 }
 
 void b2Body::SetType(b2BodyType type)
@@ -127,18 +268,18 @@ void b2Body::SetType(b2BodyType type)
 
 	if (m_type == b2_staticBody)
 	{
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
-		m_sweep.a0 = m_sweep.a;
-		m_sweep.c0 = m_sweep.c;
+		m_states->linearVelocities[m_stateIndex].SetZero();
+		m_states->angularVelocities[m_stateIndex] = 0.0f;
+		m_angle0 = m_states->angles[m_stateIndex];
+		m_center0 = m_states->centers[m_stateIndex];
 		m_flags &= ~e_awakeFlag;
 		SynchronizeFixtures();
 	}
 
 	SetAwake(true);
 
-	m_force.SetZero();
-	m_torque = 0.0f;
+	m_states->forces[m_stateIndex].SetZero();
+	m_states->torques[m_stateIndex] = 0.0f;
 
 	// Delete the attached contacts.
 	b2ContactEdge* ce = m_contactList;
@@ -150,6 +291,8 @@ void b2Body::SetType(b2BodyType type)
 	}
 	m_contactList = nullptr;
 
+	ResetIsland();
+
 	// Touch the proxies so that new contacts will be created (when appropriate)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
@@ -175,6 +318,7 @@ b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 	void* memory = allocator->Allocate(sizeof(b2Fixture));
 	b2Fixture* fixture = new (memory) b2Fixture;
 	fixture->Create(allocator, this, def);
+	fixture->m_creationId = m_world->m_creationCount++;
 
 	if (m_flags & e_enabledFlag)
 	{
@@ -270,6 +414,8 @@ void b2Body::DestroyFixture(b2Fixture* fixture)
 		fixture->DestroyProxies(broadPhase);
 	}
 
+	m_world->m_contactManager.ForgetFixture(fixture);
+
 	fixture->m_body = nullptr;
 	fixture->m_next = nullptr;
 	fixture->Destroy(allocator);
@@ -284,19 +430,22 @@ void b2Body::DestroyFixture(b2Fixture* fixture)
 
 void b2Body::ResetMassData()
 {
+	b2BodyStates* states = m_states;
+	int32 index = m_stateIndex;
+
 	// Compute mass data from shapes. Each shape has its own density.
 	m_mass = 0.0f;
-	m_invMass = 0.0f;
 	m_I = 0.0f;
-	m_invI = 0.0f;
-	m_sweep.localCenter.SetZero();
+	states->invMasses[index] = 0.0f;
+	states->invInertias[index] = 0.0f;
+	m_localCenter.SetZero();
 
 	// Static and kinematic bodies have zero mass.
 	if (m_type == b2_staticBody || m_type == b2_kinematicBody)
 	{
-		m_sweep.c0 = m_xf.p;
-		m_sweep.c = m_xf.p;
-		m_sweep.a0 = m_sweep.a;
+		m_center0 = m_xf.p;
+		states->centers[index] = m_xf.p;
+		m_angle0 = states->angles[index];
 		return;
 	}
 
@@ -321,8 +470,8 @@ void b2Body::ResetMassData()
 	// Compute center of mass.
 	if (m_mass > 0.0f)
 	{
-		m_invMass = 1.0f / m_mass;
-		localCenter *= m_invMass;
+		states->invMasses[index] = 1.0f / m_mass;
+		localCenter *= states->invMasses[index];
 	}
 
 	if (m_I > 0.0f && (m_flags & e_fixedRotationFlag) == 0)
@@ -330,22 +479,22 @@ void b2Body::ResetMassData()
 		// Center the inertia about the center of mass.
 		m_I -= m_mass * b2Dot(localCenter, localCenter);
 		b2Assert(m_I > 0.0f);
-		m_invI = 1.0f / m_I;
+		states->invInertias[index] = 1.0f / m_I;
 
 	}
 	else
 	{
 		m_I = 0.0f;
-		m_invI = 0.0f;
+		states->invInertias[index] = 0.0f;
 	}
 
 	// Move center of mass.
-	b2Vec2 oldCenter = m_sweep.c;
-	m_sweep.localCenter = localCenter;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	b2Vec2 oldCenter = states->centers[index];
+	m_localCenter = localCenter;
+	m_center0 = states->centers[index] = b2Mul(m_xf, m_localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	states->linearVelocities[index] += b2Cross(states->angularVelocities[index], states->centers[index] - oldCenter);
 }
 
 void b2Body::SetMassData(const b2MassData* massData)
@@ -361,9 +510,11 @@ void b2Body::SetMassData(const b2MassData* massData)
 		return;
 	}
 
-	m_invMass = 0.0f;
+	b2BodyStates* states = m_states;
+	int32 index = m_stateIndex;
+
 	m_I = 0.0f;
-	m_invI = 0.0f;
+	states->invInertias[index] = 0.0f;
 
 	m_mass = massData->mass;
 	if (m_mass <= 0.0f)
@@ -371,22 +522,22 @@ void b2Body::SetMassData(const b2MassData* massData)
 		m_mass = 1.0f;
 	}
 
-	m_invMass = 1.0f / m_mass;
+	states->invMasses[index] = 1.0f / m_mass;
 
 	if (massData->I > 0.0f && (m_flags & b2Body::e_fixedRotationFlag) == 0)
 	{
 		m_I = massData->I - m_mass * b2Dot(massData->center, massData->center);
 		b2Assert(m_I > 0.0f);
-		m_invI = 1.0f / m_I;
+		states->invInertias[index] = 1.0f / m_I;
 	}
 
 	// Move center of mass.
-	b2Vec2 oldCenter = m_sweep.c;
-	m_sweep.localCenter =  massData->center;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	b2Vec2 oldCenter = states->centers[index];
+	m_localCenter =  massData->center;
+	m_center0 = states->centers[index] = b2Mul(m_xf, m_localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	states->linearVelocities[index] += b2Cross(states->angularVelocities[index], states->centers[index] - oldCenter);
 }
 
 bool b2Body::ShouldCollide(const b2Body* other) const
@@ -423,11 +574,11 @@ void b2Body::SetTransform(const b2Vec2& position, float angle)
 	m_xf.q.Set(angle);
 	m_xf.p = position;
 
-	m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
-	m_sweep.a = angle;
+	m_states->centers[m_stateIndex] = b2Mul(m_xf, m_localCenter);
+	m_states->angles[m_stateIndex] = angle;
 
-	m_sweep.c0 = m_sweep.c;
-	m_sweep.a0 = angle;
+	m_center0 = m_states->centers[m_stateIndex];
+	m_angle0 = angle;
 
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
@@ -446,8 +597,8 @@ void b2Body::SynchronizeFixtures()
 	if (m_flags & b2Body::e_awakeFlag)
 	{
 		b2Transform xf1;
-		xf1.q.Set(m_sweep.a0);
-		xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
+		xf1.q.Set(m_angle0);
+		xf1.p = m_center0 - b2Mul(xf1.q, m_localCenter);
 
 		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 		{
@@ -485,6 +636,8 @@ void b2Body::SetEnabled(bool flag)
 
 		// Contacts are created at the beginning of the next
 		m_world->m_newContacts = true;
+
+		ResetIsland();
 	}
 	else
 	{
@@ -506,6 +659,29 @@ void b2Body::SetEnabled(bool flag)
 			m_world->m_contactManager.Destroy(ce0->contact);
 		}
 		m_contactList = nullptr;
+
+		ResetIsland();
+	}
+}
+
+void b2Body::ResetIsland()
+{
+	b2IslandManager* islandManager = &m_world->m_islandManager;
+	for (b2JointEdge* je = m_jointList; je; je = je->next)
+	{
+		islandManager->UnlinkJoint(je->joint);
+	}
+
+	islandManager->RemoveBody(this);
+
+	if (m_type != b2_staticBody && IsEnabled())
+	{
+		islandManager->AddBody(this);
+	}
+
+	for (b2JointEdge* je = m_jointList; je; je = je->next)
+	{
+		islandManager->LinkJoint(je->joint);
 	}
 }
 
@@ -526,7 +702,7 @@ void b2Body::SetFixedRotation(bool flag)
 		m_flags &= ~e_fixedRotationFlag;
 	}
 
-	m_angularVelocity = 0.0f;
+	m_states->angularVelocities[m_stateIndex] = 0.0f;
 
 	ResetMassData();
 }
@@ -542,9 +718,10 @@ void b2Body::Dump()
 	b2Dump("  b2BodyDef bd;\n");
 	b2Dump("  bd.type = b2BodyType(%d);\n", m_type);
 	b2Dump("  bd.position.Set(%.9g, %.9g);\n", m_xf.p.x, m_xf.p.y);
-	b2Dump("  bd.angle = %.9g;\n", m_sweep.a);
-	b2Dump("  bd.linearVelocity.Set(%.9g, %.9g);\n", m_linearVelocity.x, m_linearVelocity.y);
-	b2Dump("  bd.angularVelocity = %.9g;\n", m_angularVelocity);
+	b2Vec2 v = GetLinearVelocity();
+	b2Dump("  bd.angle = %.9g;\n", GetAngle());
+	b2Dump("  bd.linearVelocity.Set(%.9g, %.9g);\n", v.x, v.y);
+	b2Dump("  bd.angularVelocity = %.9g;\n", GetAngularVelocity());
 	b2Dump("  bd.linearDamping = %.9g;\n", m_linearDamping);
 	b2Dump("  bd.angularDamping = %.9g;\n", m_angularDamping);
 	b2Dump("  bd.allowSleep = bool(%d);\n", m_flags & e_autoSleepFlag);
@@ -0,0 +1,309 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "b2_constraint_graph.h"
+#include "b2_contact_solver.h"
+
+#include "box2d/b2_body.h"
+#include "box2d/b2_joint.h"
+#include "box2d/b2_stack_allocator.h"
+#include "box2d/b2_thread_pool.h"
+
+#include <string.h>
+
+static_assert(b2_graphColorCount <= 32, "body color masks are 32 bits");
+
+enum b2GraphStage
+{
+	e_warmStartStage,
+	e_velocityStage,
+	e_positionStage
+};
+
+class b2GraphColorTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 id = constraints[i];
+			if (id < contactCount)
+			{
+				switch (stage)
+				{
+				case e_warmStartStage:
+					contactSolver->WarmStart(id);
+					break;
+
+				case e_velocityStage:
+					contactSolver->SolveVelocityConstraint(id);
+					break;
+
+				case e_positionStage:
+					minSeparations[threadIndex] = contactSolver->SolvePositionConstraint(id, minSeparations[threadIndex]);
+					break;
+				}
+			}
+			else
+			{
+				b2Joint* joint = joints[id - contactCount];
+				if (stage == e_velocityStage)
+				{
+					joint->SolveVelocityConstraints(*data);
+				}
+				else if (stage == e_positionStage)
+				{
+					bool jointOkay = joint->SolvePositionConstraints(*data);
+					jointsOkay[threadIndex] = jointsOkay[threadIndex] && jointOkay;
+				}
+			}
+		}
+	}
+
+	int32 stage;
+	const int32* constraints;
+	b2ContactSolver* contactSolver;
+	b2Joint** joints;
+	int32 contactCount;
+	const b2SolverData* data;
+	float* minSeparations;
+	bool* jointsOkay;
+};
+
+// Pick the lowest color that neither body uses yet. Returns b2_graphColorCount if none is free.
+static int32 b2AssignColor(uint32* bodyColors, int32 indexA, bool movableA, int32 indexB, bool movableB)
+{
+	uint32 used = 0;
+	if (movableA)
+	{
+		used |= bodyColors[indexA];
+	}
+	if (movableB)
+	{
+		used |= bodyColors[indexB];
+	}
+
+	for (int32 i = 0; i < b2_graphColorCount; ++i)
+	{
+		uint32 bit = uint32(1) << i;
+		if ((used & bit) == 0)
+		{
+			if (movableA)
+			{
+				bodyColors[indexA] |= bit;
+			}
+			if (movableB)
+			{
+				bodyColors[indexB] |= bit;
+			}
+			return i;
+		}
+	}
+
+	return b2_graphColorCount;
+}
+
+b2ConstraintGraph::b2ConstraintGraph(b2ContactSolver* contactSolver, b2Joint** joints, int32 jointCount,
+									 int32 bodySlotCount, b2StackAllocator* allocator, b2ThreadPool* threadPool)
+{
+	m_contactSolver = contactSolver;
+	m_joints = joints;
+	m_contactCount = contactSolver->m_count;
+	m_jointCount = jointCount;
+	m_allocator = allocator;
+	m_threadPool = threadPool;
+	m_threadCount = threadPool != nullptr ? threadPool->GetThreadCount() : 1;
+
+	int32 constraintCount = m_contactCount + m_jointCount;
+	m_constraints = (int32*)m_allocator->Allocate(constraintCount * sizeof(int32));
+	m_minSeparations = (float*)m_allocator->Allocate(m_threadCount * sizeof(float));
+	m_jointsOkay = (bool*)m_allocator->Allocate(m_threadCount * sizeof(bool));
+
+	uint32* bodyColors = (uint32*)m_allocator->Allocate(bodySlotCount * sizeof(uint32));
+	memset(bodyColors, 0, bodySlotCount * sizeof(uint32));
+
+	int32* colorIds = (int32*)m_allocator->Allocate(constraintCount * sizeof(int32));
+
+	// Count contacts and joints per color. Slot b2_graphColorCount is the overflow.
+	int32 contactCounts[b2_graphColorCount + 1] = {};
+	int32 jointCounts[b2_graphColorCount + 1] = {};
+
+	const b2ContactVelocityConstraint* velocityConstraints = contactSolver->m_velocityConstraints;
+	for (int32 i = 0; i < m_contactCount; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = velocityConstraints + i;
+		bool movableA = vc->invMassA != 0.0f || vc->invIA != 0.0f;
+		bool movableB = vc->invMassB != 0.0f || vc->invIB != 0.0f;
+		int32 color = b2AssignColor(bodyColors, vc->indexA, movableA, vc->indexB, movableB);
+		colorIds[i] = color;
+		contactCounts[color] += 1;
+	}
+
+	for (int32 i = 0; i < m_jointCount; ++i)
+	{
+		b2Joint* joint = joints[i];
+		b2Body* bodyA = joint->GetBodyA();
+		b2Body* bodyB = joint->GetBodyB();
+
+		int32 color = b2_graphColorCount;
+		if (joint->GetType() != e_gearJoint && bodyA->GetType() == b2_dynamicBody && bodyB->GetType() == b2_dynamicBody)
+		{
+			color = b2AssignColor(bodyColors, bodyA->m_islandIndex, true, bodyB->m_islandIndex, true);
+		}
+
+		colorIds[m_contactCount + i] = color;
+		jointCounts[color] += 1;
+	}
+
+	int32 start = 0;
+	m_colorCount = 0;
+	for (int32 i = 0; i <= b2_graphColorCount; ++i)
+	{
+		b2GraphColor* color = m_colors + i;
+		color->start = start;
+		color->contactCount = contactCounts[i];
+		color->jointCount = jointCounts[i];
+		start += color->contactCount + color->jointCount;
+
+		if (i < b2_graphColorCount && color->contactCount + color->jointCount > 0)
+		{
+			m_colorCount = i + 1;
+		}
+	}
+
+	// Stable fill keeps the island order inside each color.
+	int32 contactCursors[b2_graphColorCount + 1];
+	int32 jointCursors[b2_graphColorCount + 1];
+	for (int32 i = 0; i <= b2_graphColorCount; ++i)
+	{
+		contactCursors[i] = m_colors[i].start;
+		jointCursors[i] = m_colors[i].start + m_colors[i].contactCount;
+	}
+
+	for (int32 i = 0; i < m_contactCount; ++i)
+	{
+		m_constraints[contactCursors[colorIds[i]]++] = i;
+	}
+
+	for (int32 i = 0; i < m_jointCount; ++i)
+	{
+		m_constraints[jointCursors[colorIds[m_contactCount + i]]++] = m_contactCount + i;
+	}
+
+	m_allocator->Free(colorIds);
+	m_allocator->Free(bodyColors);
+}
+
+b2ConstraintGraph::~b2ConstraintGraph()
+{
+	m_allocator->Free(m_jointsOkay);
+	m_allocator->Free(m_minSeparations);
+	m_allocator->Free(m_constraints);
+}
+
+void b2ConstraintGraph::SolveColor(const b2GraphColor* color, int32 stage, const b2SolverData* data, bool parallel)
+{
+	int32 count = color->contactCount + color->jointCount;
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2GraphColorTask task;
+	task.stage = stage;
+	task.constraints = m_constraints + color->start;
+	task.contactSolver = m_contactSolver;
+	task.joints = m_joints;
+	task.contactCount = m_contactCount;
+	task.data = data;
+	task.minSeparations = m_minSeparations;
+	task.jointsOkay = m_jointsOkay;
+
+	if (parallel && m_threadPool != nullptr)
+	{
+		m_threadPool->ParallelFor(&task, count, 32);
+	}
+	else
+	{
+		task.Execute(0, count, 0);
+	}
+}
+
+void b2ConstraintGraph::WarmStart()
+{
+	for (int32 i = 0; i < m_colorCount; ++i)
+	{
+		SolveColor(m_colors + i, e_warmStartStage, nullptr, true);
+	}
+
+	SolveColor(m_colors + b2_graphColorCount, e_warmStartStage, nullptr, false);
+}
+
+void b2ConstraintGraph::SolveVelocityConstraints(const b2SolverData& data)
+{
+	for (int32 i = 0; i < m_colorCount; ++i)
+	{
+		SolveColor(m_colors + i, e_velocityStage, &data, true);
+	}
+
+	SolveColor(m_colors + b2_graphColorCount, e_velocityStage, &data, false);
+}
+
+bool b2ConstraintGraph::SolvePositionConstraints(const b2SolverData& data)
+{
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		m_minSeparations[i] = 0.0f;
+		m_jointsOkay[i] = true;
+	}
+
+	for (int32 i = 0; i < m_colorCount; ++i)
+	{
+		SolveColor(m_colors + i, e_positionStage, &data, true);
+	}
+
+	SolveColor(m_colors + b2_graphColorCount, e_positionStage, &data, false);
+
+	float minSeparation = 0.0f;
+	bool jointsOkay = true;
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		minSeparation = b2Min(minSeparation, m_minSeparations[i]);
+		jointsOkay = jointsOkay && m_jointsOkay[i];
+	}
+
+	// Same tolerance as b2ContactSolver::SolvePositionConstraints.
+	return minSeparation >= -3.0f * b2_linearSlop && jointsOkay;
+}
+
+void b2ConstraintGraph::GetProfile(b2Profile* profile) const
+{
+	profile->colorCount = float(m_colorCount);
+	for (int32 i = 0; i < b2_graphColorCount; ++i)
+	{
+		profile->colorSizes[i] = float(m_colors[i].contactCount + m_colors[i].jointCount);
+	}
+
+	const b2GraphColor* overflow = m_colors + b2_graphColorCount;
+	profile->colorOverflow = float(overflow->contactCount + overflow->jointCount);
+}
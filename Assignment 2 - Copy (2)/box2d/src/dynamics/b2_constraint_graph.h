@@ -0,0 +1,85 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_CONSTRAINT_GRAPH_H
+#define B2_CONSTRAINT_GRAPH_H
+
+#include "box2d/b2_settings.h"
+#include "box2d/b2_time_step.h"
+
+class b2ContactSolver;
+class b2Joint;
+class b2StackAllocator;
+class b2ThreadPool;
+
+struct b2GraphColor
+{
+	int32 start;
+	int32 contactCount;
+	int32 jointCount;
+};
+
+/// Greedy coloring of the constraint graph of an island. Constraints with the same
+/// color share no body that the solver can move, so each color is solved in parallel.
+/// Constraints that do not fit in b2_graphColorCount colors go to an overflow set that
+/// is solved on the calling thread after the colors. So do joints attached to a static,
+/// kinematic or third body, because joints always write both bodies.
+/// This is an internal class.
+class b2ConstraintGraph
+{
+public:
+	b2ConstraintGraph(b2ContactSolver* contactSolver, b2Joint** joints, int32 jointCount,
+					  int32 bodySlotCount, b2StackAllocator* allocator, b2ThreadPool* threadPool);
+	~b2ConstraintGraph();
+
+	void WarmStart();
+	void SolveVelocityConstraints(const b2SolverData& data);
+	bool SolvePositionConstraints(const b2SolverData& data);
+
+	/// Write the color statistics.
+	void GetProfile(b2Profile* profile) const;
+
+private:
+	void SolveColor(const b2GraphColor* color, int32 stage, const b2SolverData* data, bool parallel);
+
+	b2ContactSolver* m_contactSolver;
+	b2Joint** m_joints;
+	int32 m_contactCount;
+	int32 m_jointCount;
+	b2StackAllocator* m_allocator;
+	b2ThreadPool* m_threadPool;
+
+	// Constraint ids sorted by color, contacts before joints. Contact ids come first,
+	// joint ids are offset by the contact count.
+	int32* m_constraints;
+
+	// The last color is the overflow.
+	b2GraphColor m_colors[b2_graphColorCount + 1];
+	int32 m_colorCount;
+
+	// Per thread results of the position solver.
+	float* m_minSeparations;
+	bool* m_jointsOkay;
+	int32 m_threadCount;
+};
+
+#endif
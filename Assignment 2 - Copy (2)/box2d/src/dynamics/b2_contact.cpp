@@ -117,9 +117,12 @@ void b2Contact::Destroy(b2Contact* contact, b2BlockAllocator* allocator)
 		fixtureB->GetBody()->SetAwake(true);
 	}
 
-	b2Shape::Type typeA = fixtureA->GetType();
-	b2Shape::Type typeB = fixtureB->GetType();
+	Destroy(contact, fixtureA->GetType(), fixtureB->GetType(), allocator);
+}
 
+void b2Contact::Destroy(b2Contact* contact, b2Shape::Type typeA, b2Shape::Type typeB, b2BlockAllocator* allocator)
+{
+	b2Assert(s_initialized == true);
 	b2Assert(0 <= typeA && typeA < b2Shape::e_typeCount);
 	b2Assert(0 <= typeB && typeB < b2Shape::e_typeCount);
 
@@ -152,6 +155,12 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 	m_nodeB.next = nullptr;
 	m_nodeB.other = nullptr;
 
+	m_islandId = b2_nullIsland;
+	m_islandPrev = nullptr;
+	m_islandNext = nullptr;
+
+	m_simplexCache.count = 0;
+
 	m_toiCount = 0;
 
 	m_friction = b2MixFriction(m_fixtureA->m_friction, m_fixtureB->m_friction);
@@ -159,13 +168,24 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 	m_restitutionThreshold = b2MixRestitutionThreshold(m_fixtureA->m_restitutionThreshold, m_fixtureB->m_restitutionThreshold);
 
 	m_tangentSpeed = 0.0f;
+
+	m_index = 0;
 }
 
 // Update the contact manifold and touching status.
 // Note: do not assume the fixture AABBs are overlapping or are valid.
-void b2Contact::Update(b2ContactListener* listener)
+void b2Contact::Update(b2ContactListener* listener, const b2Manifold* manifold)
 {
-	b2Manifold oldManifold = m_manifold;
+	b2Manifold oldManifold;
+	uint32 events = UpdateManifold(&oldManifold, manifold);
+	ReportEvents(events, &oldManifold, listener);
+}
+
+// This only writes to the contact, so different contacts can be updated
+// concurrently. The side effects are returned as events for ReportEvents.
+uint32 b2Contact::UpdateManifold(b2Manifold* oldManifold, const b2Manifold* manifold)
+{
+	uint32 events = 0;
 
 	// Re-enable this contact.
 	m_flags |= e_enabledFlag;
@@ -177,24 +197,41 @@ void b2Contact::Update(b2ContactListener* listener)
 	bool sensorB = m_fixtureB->IsSensor();
 	bool sensor = sensorA || sensorB;
 
-	b2Body* bodyA = m_fixtureA->GetBody();
-	b2Body* bodyB = m_fixtureB->GetBody();
+	const b2Body* bodyA = m_fixtureA->GetBody();
+	const b2Body* bodyB = m_fixtureB->GetBody();
 	const b2Transform& xfA = bodyA->GetTransform();
 	const b2Transform& xfB = bodyB->GetTransform();
 
 	// Is this contact a sensor?
 	if (sensor)
 	{
-		const b2Shape* shapeA = m_fixtureA->GetShape();
-		const b2Shape* shapeB = m_fixtureB->GetShape();
-		touching = b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB);
-
-		// Sensors don't generate manifolds.
+		// Sensors don't generate manifolds and never reach the solver, so there
+		// is nothing to warm start or pre-solve.
+		oldManifold->pointCount = 0;
 		m_manifold.pointCount = 0;
+
+		// The proxy AABBs bound the shapes at their current transforms. Most sensor
+		// pairs that stop overlapping are rejected here without a distance query.
+		const b2AABB& aabbA = m_fixtureA->m_proxies[m_indexA].aabb;
+		const b2AABB& aabbB = m_fixtureB->m_proxies[m_indexB].aabb;
+		if (b2TestOverlap(aabbA, aabbB))
+		{
+			const b2Shape* shapeA = m_fixtureA->GetShape();
+			const b2Shape* shapeB = m_fixtureB->GetShape();
+			touching = b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB, &m_simplexCache);
+		}
 	}
 	else
 	{
-		Evaluate(&m_manifold, xfA, xfB);
+		*oldManifold = m_manifold;
+		if (manifold != nullptr)
+		{
+			m_manifold = *manifold;
+		}
+		else
+		{
+			Evaluate(&m_manifold, xfA, xfB);
+		}
 		touching = m_manifold.pointCount > 0;
 
 		// Match old contact ids to new contact ids and copy the
@@ -206,9 +243,9 @@ void b2Contact::Update(b2ContactListener* listener)
 			mp2->tangentImpulse = 0.0f;
 			b2ContactID id2 = mp2->id;
 
-			for (int32 j = 0; j < oldManifold.pointCount; ++j)
+			for (int32 j = 0; j < oldManifold->pointCount; ++j)
 			{
-				b2ManifoldPoint* mp1 = oldManifold.points + j;
+				b2ManifoldPoint* mp1 = oldManifold->points + j;
 
 				if (mp1->id.key == id2.key)
 				{
@@ -221,8 +258,7 @@ void b2Contact::Update(b2ContactListener* listener)
 
 		if (touching != wasTouching)
 		{
-			bodyA->SetAwake(true);
-			bodyB->SetAwake(true);
+			events |= e_wakeEvent;
 		}
 	}
 
@@ -235,18 +271,60 @@ void b2Contact::Update(b2ContactListener* listener)
 		m_flags &= ~e_touchingFlag;
 	}
 
-	if (wasTouching == false && touching == true && listener)
+	if (wasTouching == false && touching == true)
+	{
+		events |= e_beginTouchEvent;
+	}
+
+	if (wasTouching == true && touching == false)
+	{
+		events |= e_endTouchEvent;
+	}
+
+	if (sensor == false && touching)
+	{
+		events |= e_preSolveEvent;
+	}
+
+	return events;
+}
+
+void b2Contact::ReportEvents(uint32 events, const b2Manifold* oldManifold, b2ContactListener* listener)
+{
+	if (events & e_wakeEvent)
+	{
+		b2Body* bodyA = m_fixtureA->GetBody();
+		b2Body* bodyB = m_fixtureB->GetBody();
+		bodyA->SetAwake(true);
+		bodyB->SetAwake(true);
+
+		// The touching state changed, so the contact joins or leaves an island.
+		bodyA->m_world->m_islandManager.UpdateContact(this);
+	}
+
+	b2ContactManager* contactManager = &m_fixtureA->GetBody()->m_world->m_contactManager;
+	if (contactManager->m_recordEvents && (events & (e_beginTouchEvent | e_endTouchEvent)))
+	{
+		contactManager->RecordEvents(this, events);
+	}
+
+	if (listener == nullptr)
+	{
+		return;
+	}
+
+	if (events & e_beginTouchEvent)
 	{
 		listener->BeginContact(this);
 	}
 
-	if (wasTouching == true && touching == false && listener)
+	if (events & e_endTouchEvent)
 	{
 		listener->EndContact(this);
 	}
 
-	if (sensor == false && touching && listener)
+	if (events & e_preSolveEvent)
 	{
-		listener->PreSolve(this, &oldManifold);
+		listener->PreSolve(this, oldManifold);
 	}
 }
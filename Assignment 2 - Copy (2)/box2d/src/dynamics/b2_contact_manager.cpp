@@ -23,12 +23,67 @@
 #include "box2d/b2_body.h"
 #include "box2d/b2_contact.h"
 #include "box2d/b2_contact_manager.h"
+#include "box2d/b2_circle_shape.h"
+#include "box2d/b2_polygon_shape.h"
 #include "box2d/b2_fixture.h"
+#include "box2d/b2_thread_pool.h"
+#include "box2d/b2_timer.h"
+#include "box2d/b2_world.h"
 #include "box2d/b2_world_callbacks.h"
+#include "collision/b2_collide_wide.h"
+#include "common/b2_simd.h"
+
+#include <new>
+#include <string.h>
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
 
+// Deterministic builds always collect the contacts before updating them. A body woken
+// by an update then has the same effect with and without a thread pool.
+#if defined(B2_DETERMINISTIC)
+static const bool b2_collectContacts = true;
+#else
+static const bool b2_collectContacts = false;
+#endif
+
+// A contact listener event recorded on a worker thread. Index is the position of
+// the contact in m_updateBuffer.
+struct b2ContactUpdateEvent
+{
+	int32 index;
+	uint32 events;
+	b2Manifold oldManifold;
+};
+
+struct b2ContactEventBuffer
+{
+	void Push(int32 index, uint32 events, const b2Manifold& oldManifold)
+	{
+		if (count == capacity)
+		{
+			b2ContactUpdateEvent* oldEvents = this->events;
+			capacity = b2Max(2 * capacity, 64);
+			this->events = (b2ContactUpdateEvent*)b2Alloc(capacity * sizeof(b2ContactUpdateEvent));
+			if (oldEvents)
+			{
+				memcpy(this->events, oldEvents, count * sizeof(b2ContactUpdateEvent));
+				b2Free(oldEvents);
+			}
+		}
+
+		b2ContactUpdateEvent* event = this->events + count++;
+		event->index = index;
+		event->events = events;
+		event->oldManifold = oldManifold;
+	}
+
+	b2ContactUpdateEvent* events;
+	int32 count;
+	int32 capacity;
+	int32 readIndex;
+};
+
 b2ContactManager::b2ContactManager()
 {
 	m_contactList = nullptr;
@@ -36,6 +91,232 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = nullptr;
+
+	m_threadPool = nullptr;
+	m_updateBuffer = nullptr;
+	m_updateCapacity = 0;
+	m_updateCount = 0;
+	m_eventBuffers = nullptr;
+	m_eventBufferCount = 0;
+
+	m_wideNarrowPhase = false;
+	m_manifoldBuffer = nullptr;
+	m_bucketBuffer = nullptr;
+	m_wideCapacity = 0;
+
+	ClearCounters();
+
+	m_recordEvents = false;
+	m_hitEventThreshold = b2_hitEventThreshold;
+	m_beginEvents = nullptr;
+	m_beginEventCount = 0;
+	m_beginEventCapacity = 0;
+	m_endEvents = nullptr;
+	m_endEventCount = 0;
+	m_endEventCapacity = 0;
+	m_stepEndEventCount = 0;
+	m_hitEvents = nullptr;
+	m_hitEventCount = 0;
+	m_hitEventCapacity = 0;
+}
+
+b2ContactManager::~b2ContactManager()
+{
+	SetThreadPool(nullptr);
+
+	if (m_manifoldBuffer)
+	{
+		b2Free(m_manifoldBuffer);
+		b2Free(m_bucketBuffer);
+	}
+
+	if (m_beginEvents)
+	{
+		b2Free(m_beginEvents);
+	}
+
+	if (m_endEvents)
+	{
+		b2Free(m_endEvents);
+	}
+
+	if (m_hitEvents)
+	{
+		b2Free(m_hitEvents);
+	}
+}
+
+// Grow an event array if it is full and return the next event.
+template <typename T>
+static T* b2PushEvent(T** events, int32* count, int32* capacity)
+{
+	if (*count == *capacity)
+	{
+		T* oldEvents = *events;
+		*capacity = b2Max(2 * *capacity, 16);
+		*events = (T*)b2Alloc(*capacity * sizeof(T));
+		if (oldEvents)
+		{
+			memcpy(*events, oldEvents, *count * sizeof(T));
+			b2Free(oldEvents);
+		}
+	}
+
+	return *events + (*count)++;
+}
+
+void b2ContactManager::RecordEvents(b2Contact* c, uint32 events)
+{
+	b2Fixture* fixtureA = c->m_fixtureA;
+	b2Fixture* fixtureB = c->m_fixtureB;
+
+	if (events & b2Contact::e_beginTouchEvent)
+	{
+		b2ContactBeginEvent* event = b2PushEvent(&m_beginEvents, &m_beginEventCount, &m_beginEventCapacity);
+		event->fixtureA = fixtureA;
+		event->fixtureB = fixtureB;
+		event->userDataA = fixtureA->m_userData;
+		event->userDataB = fixtureB->m_userData;
+
+		if (c->m_manifold.pointCount > 0)
+		{
+			// Find the point where the bodies approach each other the fastest.
+			b2Body* bodyA = fixtureA->m_body;
+			b2Body* bodyB = fixtureB->m_body;
+			b2WorldManifold worldManifold;
+			c->GetWorldManifold(&worldManifold);
+
+			int32 bestIndex = 0;
+			float approachSpeed = -b2_maxFloat;
+			for (int32 i = 0; i < c->m_manifold.pointCount; ++i)
+			{
+				b2Vec2 point = worldManifold.points[i];
+				b2Vec2 vA = bodyA->GetLinearVelocityFromWorldPoint(point);
+				b2Vec2 vB = bodyB->GetLinearVelocityFromWorldPoint(point);
+				float speed = b2Dot(vA - vB, worldManifold.normal);
+				if (speed > approachSpeed)
+				{
+					approachSpeed = speed;
+					bestIndex = i;
+				}
+			}
+
+			if (approachSpeed > m_hitEventThreshold)
+			{
+				b2ContactHitEvent* hit = b2PushEvent(&m_hitEvents, &m_hitEventCount, &m_hitEventCapacity);
+				hit->fixtureA = fixtureA;
+				hit->fixtureB = fixtureB;
+				hit->userDataA = fixtureA->m_userData;
+				hit->userDataB = fixtureB->m_userData;
+				hit->point = worldManifold.points[bestIndex];
+				hit->normal = worldManifold.normal;
+				hit->approachSpeed = approachSpeed;
+			}
+		}
+	}
+
+	if (events & b2Contact::e_endTouchEvent)
+	{
+		b2ContactEndEvent* event = b2PushEvent(&m_endEvents, &m_endEventCount, &m_endEventCapacity);
+		event->fixtureA = fixtureA;
+		event->fixtureB = fixtureB;
+		event->userDataA = fixtureA->m_userData;
+		event->userDataB = fixtureB->m_userData;
+	}
+}
+
+void b2ContactManager::ClearEvents()
+{
+	m_beginEventCount = 0;
+	m_endEventCount = 0;
+	m_stepEndEventCount = 0;
+	m_hitEventCount = 0;
+}
+
+void b2ContactManager::ClearStepEvents()
+{
+	int32 keepCount = m_endEventCount - m_stepEndEventCount;
+	if (keepCount > 0)
+	{
+		memmove(m_endEvents, m_endEvents + m_stepEndEventCount, keepCount * sizeof(b2ContactEndEvent));
+	}
+
+	m_beginEventCount = 0;
+	m_endEventCount = keepCount;
+	m_stepEndEventCount = 0;
+	m_hitEventCount = 0;
+}
+
+void b2ContactManager::ForgetFixture(const b2Fixture* fixture)
+{
+	for (int32 i = 0; i < m_beginEventCount; ++i)
+	{
+		b2ContactBeginEvent* event = m_beginEvents + i;
+		event->fixtureA = event->fixtureA == fixture ? nullptr : event->fixtureA;
+		event->fixtureB = event->fixtureB == fixture ? nullptr : event->fixtureB;
+	}
+
+	for (int32 i = 0; i < m_endEventCount; ++i)
+	{
+		b2ContactEndEvent* event = m_endEvents + i;
+		event->fixtureA = event->fixtureA == fixture ? nullptr : event->fixtureA;
+		event->fixtureB = event->fixtureB == fixture ? nullptr : event->fixtureB;
+	}
+
+	for (int32 i = 0; i < m_hitEventCount; ++i)
+	{
+		b2ContactHitEvent* event = m_hitEvents + i;
+		event->fixtureA = event->fixtureA == fixture ? nullptr : event->fixtureA;
+		event->fixtureB = event->fixtureB == fixture ? nullptr : event->fixtureB;
+	}
+}
+
+void b2ContactManager::ClearCounters()
+{
+	m_pairCount = 0;
+	m_moveCount = 0;
+	m_collideCount = 0;
+	m_createCount = 0;
+	m_destroyCount = 0;
+	m_updatePairsTime = 0.0f;
+}
+
+void b2ContactManager::SetThreadPool(b2ThreadPool* threadPool)
+{
+	for (int32 i = 0; i < m_eventBufferCount; ++i)
+	{
+		if (m_eventBuffers[i].events)
+		{
+			b2Free(m_eventBuffers[i].events);
+		}
+	}
+
+	if (m_eventBuffers)
+	{
+		b2Free(m_eventBuffers);
+		m_eventBuffers = nullptr;
+	}
+	m_eventBufferCount = 0;
+
+	if (m_updateBuffer)
+	{
+		b2Free(m_updateBuffer);
+		m_updateBuffer = nullptr;
+	}
+	m_updateCapacity = 0;
+	m_updateCount = 0;
+
+	m_threadPool = threadPool;
+
+	if (m_threadPool == nullptr || m_threadPool->GetThreadCount() < 2)
+	{
+		m_threadPool = nullptr;
+		return;
+	}
+
+	m_eventBufferCount = m_threadPool->GetThreadCount();
+	m_eventBuffers = (b2ContactEventBuffer*)b2Alloc(m_eventBufferCount * sizeof(b2ContactEventBuffer));
+	memset(m_eventBuffers, 0, m_eventBufferCount * sizeof(b2ContactEventBuffer));
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -50,6 +331,15 @@ void b2ContactManager::Destroy(b2Contact* c)
 		m_contactListener->EndContact(c);
 	}
 
+	// Outside of the step the event goes with the next step. If a fixture is being
+	// destroyed, ForgetFixture clears its pointer.
+	if (m_recordEvents && c->IsTouching())
+	{
+		RecordEvents(c, b2Contact::e_endTouchEvent);
+	}
+
+	bodyA->m_world->m_islandManager.RemoveContact(c);
+
 	// Remove from the world.
 	if (c->m_prev)
 	{
@@ -101,6 +391,7 @@ void b2ContactManager::Destroy(b2Contact* c)
 	// Call the factory.
 	b2Contact::Destroy(c, m_allocator);
 	--m_contactCount;
+	++m_destroyCount;
 }
 
 // This is the top level collision call for the time step. Here
@@ -108,10 +399,14 @@ void b2ContactManager::Destroy(b2Contact* c)
 // contact list.
 void b2ContactManager::Collide()
 {
+	m_updateCount = 0;
+
 	// Update awake contacts.
 	b2Contact* c = m_contactList;
 	while (c)
 	{
+		b2Contact* next = c->GetNext();
+
 		b2Fixture* fixtureA = c->GetFixtureA();
 		b2Fixture* fixtureB = c->GetFixtureB();
 		int32 indexA = c->GetChildIndexA();
@@ -125,18 +420,16 @@ void b2ContactManager::Collide()
 			// Should these bodies collide?
 			if (bodyB->ShouldCollide(bodyA) == false)
 			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
+				Destroy(c);
+				c = next;
 				continue;
 			}
 
 			// Check user filtering.
 			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
 			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
+				Destroy(c);
+				c = next;
 				continue;
 			}
 
@@ -150,7 +443,7 @@ void b2ContactManager::Collide()
 		// At least one body must be awake and it must be dynamic or kinematic.
 		if (activeA == false && activeB == false)
 		{
-			c = c->GetNext();
+			c = next;
 			continue;
 		}
 
@@ -161,21 +454,318 @@ void b2ContactManager::Collide()
 		// Here we destroy contacts that cease to overlap in the broad-phase.
 		if (overlap == false)
 		{
-			b2Contact* cNuke = c;
-			c = cNuke->GetNext();
-			Destroy(cNuke);
+			Destroy(c);
+			c = next;
 			continue;
 		}
 
 		// The contact persists.
-		c->Update(m_contactListener);
-		c = c->GetNext();
+		++m_collideCount;
+		if (m_threadPool || b2_collectContacts || m_wideNarrowPhase)
+		{
+			if (m_updateCount == m_updateCapacity)
+			{
+				b2Contact** oldBuffer = m_updateBuffer;
+				m_updateCapacity = b2Max(2 * m_updateCapacity, 256);
+				m_updateBuffer = (b2Contact**)b2Alloc(m_updateCapacity * sizeof(b2Contact*));
+				if (oldBuffer)
+				{
+					memcpy(m_updateBuffer, oldBuffer, m_updateCount * sizeof(b2Contact*));
+					b2Free(oldBuffer);
+				}
+			}
+
+			m_updateBuffer[m_updateCount++] = c;
+		}
+		else
+		{
+			c->Update(m_contactListener);
+		}
+
+		c = next;
+	}
+
+	if (m_wideNarrowPhase)
+	{
+		CollideWide();
+	}
+
+	if (m_threadPool)
+	{
+		UpdateContacts();
+	}
+	else
+	{
+		for (int32 i = 0; i < m_updateCount; ++i)
+		{
+			const b2Manifold* manifold = m_wideNarrowPhase ? m_manifoldBuffer + i : nullptr;
+			m_updateBuffer[i]->Update(m_contactListener, manifold);
+		}
+	}
+}
+
+// Shape pair types of the wide narrow phase. The last bucket holds the other solid
+// contacts, which are evaluated one by one.
+enum b2ContactBucket
+{
+	b2_polygonBucket = 0,
+	b2_polygonCircleBucket,
+	b2_circleBucket,
+	b2_otherBucket,
+	b2_bucketCount
+};
+
+// Sensors get b2_bucketCount, they are not evaluated.
+static int32 b2GetContactBucket(b2Contact* c)
+{
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	if (fixtureA->IsSensor() || fixtureB->IsSensor())
+	{
+		return b2_bucketCount;
+	}
+
+	// The contact factory puts the polygon first in polygon and circle contacts.
+	b2Shape::Type typeA = fixtureA->GetType();
+	b2Shape::Type typeB = fixtureB->GetType();
+	if (typeA == b2Shape::e_polygon && typeB == b2Shape::e_polygon)
+	{
+		return b2_polygonBucket;
+	}
+
+	if (typeA == b2Shape::e_polygon && typeB == b2Shape::e_circle)
+	{
+		return b2_polygonCircleBucket;
+	}
+
+	if (typeA == b2Shape::e_circle && typeB == b2Shape::e_circle)
+	{
+		return b2_circleBucket;
+	}
+
+	return b2_otherBucket;
+}
+
+// Computes the manifolds of the collected contacts in groups of b2_simdWidth contacts
+// of the same bucket. The contacts are only read, and each manifold is written to its
+// slot in the manifold buffer.
+class b2CollideContactsTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		B2_NOT_USED(threadIndex);
+
+		for (int32 group = begin; group < end; ++group)
+		{
+			int32 bucket = 0;
+			while (group >= groupStarts[bucket + 1])
+			{
+				++bucket;
+			}
+
+			int32 first = bucketStarts[bucket] + (group - groupStarts[bucket]) * b2_simdWidth;
+			int32 count = b2Min(int32(b2_simdWidth), bucketStarts[bucket + 1] - first);
+
+			b2ShapePair pairs[b2_simdWidth];
+			for (int32 i = 0; i < count; ++i)
+			{
+				int32 index = buckets[first + i];
+				b2Contact* c = contacts[index];
+				b2Fixture* fixtureA = c->GetFixtureA();
+				b2Fixture* fixtureB = c->GetFixtureB();
+				b2ShapePair* pair = pairs + i;
+				pair->shapeA = fixtureA->GetShape();
+				pair->shapeB = fixtureB->GetShape();
+				pair->xfA = &fixtureA->GetBody()->GetTransform();
+				pair->xfB = &fixtureB->GetBody()->GetTransform();
+				pair->manifold = manifolds + index;
+			}
+
+			switch (bucket)
+			{
+			case b2_polygonBucket:
+				b2CollidePolygonsWide(pairs, count);
+				break;
+
+			case b2_polygonCircleBucket:
+				b2CollidePolygonAndCircleWide(pairs, count);
+				break;
+
+			case b2_circleBucket:
+				b2CollideCirclesWide(pairs, count);
+				break;
+
+			default:
+				for (int32 i = 0; i < count; ++i)
+				{
+					b2Contact* c = contacts[buckets[first + i]];
+					c->Evaluate(pairs[i].manifold, *pairs[i].xfA, *pairs[i].xfB);
+				}
+				break;
+			}
+		}
+	}
+
+	b2Contact** contacts;
+	b2Manifold* manifolds;
+	const int32* buckets;
+	int32 bucketStarts[b2_bucketCount + 1];
+	int32 groupStarts[b2_bucketCount + 1];
+};
+
+// Sort the collected contacts into buckets by shape pair type and compute their new
+// manifolds with the wide kernels. Sensors have no manifold and are skipped.
+void b2ContactManager::CollideWide()
+{
+	if (m_wideCapacity < m_updateCount)
+	{
+		if (m_manifoldBuffer)
+		{
+			b2Free(m_manifoldBuffer);
+			b2Free(m_bucketBuffer);
+		}
+
+		m_wideCapacity = b2Max(m_updateCapacity, m_updateCount);
+		m_manifoldBuffer = (b2Manifold*)b2Alloc(m_wideCapacity * sizeof(b2Manifold));
+		m_bucketBuffer = (int32*)b2Alloc(m_wideCapacity * sizeof(int32));
+	}
+
+	int32 bucketCounts[b2_bucketCount + 1] = {};
+	for (int32 i = 0; i < m_updateCount; ++i)
+	{
+		bucketCounts[b2GetContactBucket(m_updateBuffer[i])] += 1;
+	}
+
+	b2CollideContactsTask task;
+	task.contacts = m_updateBuffer;
+	task.manifolds = m_manifoldBuffer;
+	task.buckets = m_bucketBuffer;
+	task.bucketStarts[0] = 0;
+	task.groupStarts[0] = 0;
+	for (int32 i = 0; i < b2_bucketCount; ++i)
+	{
+		task.bucketStarts[i + 1] = task.bucketStarts[i] + bucketCounts[i];
+		task.groupStarts[i + 1] = task.groupStarts[i] + (bucketCounts[i] + b2_simdWidth - 1) / b2_simdWidth;
+	}
+
+	// Fill the buckets in contact order.
+	int32 writeIndices[b2_bucketCount];
+	for (int32 i = 0; i < b2_bucketCount; ++i)
+	{
+		writeIndices[i] = task.bucketStarts[i];
+	}
+
+	for (int32 i = 0; i < m_updateCount; ++i)
+	{
+		int32 bucket = b2GetContactBucket(m_updateBuffer[i]);
+		if (bucket < b2_bucketCount)
+		{
+			m_bucketBuffer[writeIndices[bucket]++] = i;
+		}
+	}
+
+	int32 groupCount = task.groupStarts[b2_bucketCount];
+	if (m_threadPool)
+	{
+		m_threadPool->ParallelFor(&task, groupCount, 8);
+	}
+	else
+	{
+		task.Execute(0, groupCount, 0);
+	}
+}
+
+class b2UpdateContactsTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		b2ContactEventBuffer* buffer = buffers + threadIndex;
+		for (int32 i = begin; i < end; ++i)
+		{
+			b2Manifold oldManifold;
+			const b2Manifold* manifold = manifolds != nullptr ? manifolds + i : nullptr;
+			uint32 events = contacts[i]->UpdateManifold(&oldManifold, manifold) & eventMask;
+			if (events)
+			{
+				buffer->Push(i, events, oldManifold);
+			}
+		}
+	}
+
+	b2Contact** contacts;
+	const b2Manifold* manifolds;
+	b2ContactEventBuffer* buffers;
+	uint32 eventMask;
+};
+
+// Update the manifolds of the collected contacts on the thread pool. Listener
+// callbacks and body wake ups are recorded per thread and then replayed here in
+// contact list order. Contacts that only become active because of a wake up in
+// this step are updated in the next step.
+void b2ContactManager::UpdateContacts()
+{
+	for (int32 i = 0; i < m_eventBufferCount; ++i)
+	{
+		m_eventBuffers[i].count = 0;
+		m_eventBuffers[i].readIndex = 0;
+	}
+
+	b2UpdateContactsTask task;
+	task.contacts = m_updateBuffer;
+	task.manifolds = m_wideNarrowPhase ? m_manifoldBuffer : nullptr;
+	task.buffers = m_eventBuffers;
+	task.eventMask = ~uint32(0);
+
+	// Only wake ups matter if nobody is listening.
+	if (m_contactListener == nullptr || m_contactListener == &b2_defaultListener)
+	{
+		task.eventMask = b2Contact::e_wakeEvent;
+		if (m_recordEvents)
+		{
+			task.eventMask |= b2Contact::e_beginTouchEvent | b2Contact::e_endTouchEvent;
+		}
+	}
+
+	m_threadPool->ParallelFor(&task, m_updateCount, 64);
+
+	// Each thread processed increasing ranges, so every buffer is sorted by index.
+	// Merge them to replay the events in the order of the serial update.
+	for (;;)
+	{
+		b2ContactEventBuffer* next = nullptr;
+		for (int32 i = 0; i < m_eventBufferCount; ++i)
+		{
+			b2ContactEventBuffer* buffer = m_eventBuffers + i;
+			if (buffer->readIndex == buffer->count)
+			{
+				continue;
+			}
+
+			if (next == nullptr || buffer->events[buffer->readIndex].index < next->events[next->readIndex].index)
+			{
+				next = buffer;
+			}
+		}
+
+		if (next == nullptr)
+		{
+			break;
+		}
+
+		const b2ContactUpdateEvent* event = next->events + next->readIndex;
+		m_updateBuffer[event->index]->ReportEvents(event->events, &event->oldManifold, m_contactListener);
+		next->readIndex += 1;
 	}
 }
 
 void b2ContactManager::FindNewContacts()
 {
-	m_broadPhase.UpdatePairs(this);
+	b2Timer timer;
+	m_moveCount += m_broadPhase.GetMoveCount();
+	m_broadPhase.UpdatePairs(this, m_threadPool);
+	m_updatePairsTime += timer.GetMilliseconds();
 }
 
 void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
@@ -192,6 +782,8 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 	b2Body* bodyA = fixtureA->GetBody();
 	b2Body* bodyB = fixtureB->GetBody();
 
+	++m_pairCount;
+
 	// Are the fixtures on the same body?
 	if (bodyA == bodyB)
 	{
@@ -290,4 +882,5 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 	bodyB->m_contactList = &c->m_nodeB;
 
 	++m_contactCount;
+	++m_createCount;
 }
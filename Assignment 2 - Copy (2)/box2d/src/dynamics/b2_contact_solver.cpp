@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include "b2_contact_solver.h"
+#include "common/b2_simd.h"
 
 #include "box2d/b2_body.h"
 #include "box2d/b2_contact.h"
@@ -48,6 +49,49 @@ struct b2ContactPositionConstraint
 	int32 pointCount;
 };
 
+struct b2WideContactPoint
+{
+	b2FloatW rAx, rAy;
+	b2FloatW rBx, rBy;
+	b2FloatW normalImpulse;
+	b2FloatW tangentImpulse;
+	b2FloatW normalMass;
+	b2FloatW tangentMass;
+	b2FloatW velocityBias;
+	b2FloatW localPointX, localPointY;
+};
+
+// b2_simdWidth constraints in structure of arrays form. A body that can move
+// appears at most once in a batch. All lanes share the point counts and manifold kind.
+struct b2WideContactConstraint
+{
+	b2WideContactPoint points[b2_maxManifoldPoints];
+	b2FloatW normalX, normalY;
+	b2FloatW invMassA, invMassB;
+	b2FloatW invIA, invIB;
+	b2FloatW friction;
+	b2FloatW tangentSpeed;
+
+	// Block solver
+	b2FloatW k11, k12, k22;
+	b2FloatW normalMass11, normalMass12, normalMass22;
+
+	// Position solver
+	b2FloatW localNormalX, localNormalY;
+	b2FloatW localPointX, localPointY;
+	b2FloatW localCenterAx, localCenterAy;
+	b2FloatW localCenterBx, localCenterBy;
+	b2FloatW radiusA, radiusB;
+	b2FloatW faceB;
+
+	int32 indexA[b2_simdWidth];
+	int32 indexB[b2_simdWidth];
+	int32 constraintIndex[b2_simdWidth];
+	int32 pointCount;
+	int32 positionPointCount;
+	bool circles;
+};
+
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -59,6 +103,23 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
 
+	m_wideMemory = nullptr;
+	m_wideConstraints = nullptr;
+	m_wideCount = 0;
+	m_remainder = nullptr;
+	m_remainderCount = 0;
+	m_softness.biasRate = 0.0f;
+	m_softness.massScale = 1.0f;
+	m_softness.impulseScale = 0.0f;
+	m_inv_h = 0.0f;
+	if (m_step.wideContactSolver)
+	{
+		int32 maxWideCount = m_count / b2_simdWidth;
+		m_wideMemory = m_allocator->Allocate(maxWideCount * sizeof(b2WideContactConstraint) + b2_simdAlignment);
+		m_wideConstraints = (b2WideContactConstraint*)b2AlignW(m_wideMemory);
+		m_remainder = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	}
+
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
 	{
@@ -84,10 +145,10 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		vc->tangentSpeed = contact->m_tangentSpeed;
 		vc->indexA = bodyA->m_islandIndex;
 		vc->indexB = bodyB->m_islandIndex;
-		vc->invMassA = bodyA->m_invMass;
-		vc->invMassB = bodyB->m_invMass;
-		vc->invIA = bodyA->m_invI;
-		vc->invIB = bodyB->m_invI;
+		vc->invMassA = bodyA->GetInverseMass();
+		vc->invMassB = bodyB->GetInverseMass();
+		vc->invIA = bodyA->GetInverseInertia();
+		vc->invIB = bodyB->GetInverseInertia();
 		vc->contactIndex = i;
 		vc->pointCount = pointCount;
 		vc->K.SetZero();
@@ -96,12 +157,12 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		b2ContactPositionConstraint* pc = m_positionConstraints + i;
 		pc->indexA = bodyA->m_islandIndex;
 		pc->indexB = bodyB->m_islandIndex;
-		pc->invMassA = bodyA->m_invMass;
-		pc->invMassB = bodyB->m_invMass;
-		pc->localCenterA = bodyA->m_sweep.localCenter;
-		pc->localCenterB = bodyB->m_sweep.localCenter;
-		pc->invIA = bodyA->m_invI;
-		pc->invIB = bodyB->m_invI;
+		pc->invMassA = bodyA->GetInverseMass();
+		pc->invMassB = bodyB->GetInverseMass();
+		pc->localCenterA = bodyA->m_localCenter;
+		pc->localCenterB = bodyB->m_localCenter;
+		pc->invIA = bodyA->GetInverseInertia();
+		pc->invIB = bodyB->GetInverseInertia();
 		pc->localNormal = manifold->localNormal;
 		pc->localPoint = manifold->localPoint;
 		pc->pointCount = pointCount;
@@ -130,6 +191,7 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 			vcp->normalMass = 0.0f;
 			vcp->tangentMass = 0.0f;
 			vcp->velocityBias = 0.0f;
+			vcp->separation = 0.0f;
 
 			pc->localPoints[j] = cp->localPoint;
 		}
@@ -138,6 +200,12 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wideMemory != nullptr)
+	{
+		m_allocator->Free(m_remainder);
+		m_allocator->Free(m_wideMemory);
+	}
+
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -194,6 +262,7 @@ void b2ContactSolver::InitializeVelocityConstraints()
 
 			vcp->rA = worldManifold.points[j] - cA;
 			vcp->rB = worldManifold.points[j] - cB;
+			vcp->separation = worldManifold.separations[j];
 
 			float rnA = b2Cross(vcp->rA, vc->normal);
 			float rnB = b2Cross(vcp->rB, vc->normal);
@@ -252,75 +321,123 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	if (m_step.wideContactSolver)
+	{
+		PrepareWideConstraints();
+	}
 }
 
-void b2ContactSolver::WarmStart()
+static void b2WarmStartContact(const b2ContactVelocityConstraint* vc, b2Velocity* velocities)
 {
-	// Warm start.
-	for (int32 i = 0; i < m_count; ++i)
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float wB = velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+
+	for (int32 j = 0; j < pointCount; ++j)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
-
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float mA = vc->invMassA;
-		float iA = vc->invIA;
-		float mB = vc->invMassB;
-		float iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
+		const b2VelocityConstraintPoint* vcp = vc->points + j;
+		b2Vec2 P = vcp->normalImpulse * normal + vcp->tangentImpulse * tangent;
+		wA -= iA * b2Cross(vcp->rA, P);
+		vA -= mA * P;
+		wB += iB * b2Cross(vcp->rB, P);
+		vB += mB * P;
+	}
 
-		b2Vec2 vA = m_velocities[indexA].v;
-		float wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float wB = m_velocities[indexB].w;
+	// Bodies that cannot move may be shared with other threads, see b2ConstraintGraph.
+	if (mA != 0.0f || iA != 0.0f)
+	{
+		velocities[indexA].v = vA;
+		velocities[indexA].w = wA;
+	}
 
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
+	if (mB != 0.0f || iB != 0.0f)
+	{
+		velocities[indexB].v = vB;
+		velocities[indexB].w = wB;
+	}
+}
 
-		for (int32 j = 0; j < pointCount; ++j)
-		{
-			b2VelocityConstraintPoint* vcp = vc->points + j;
-			b2Vec2 P = vcp->normalImpulse * normal + vcp->tangentImpulse * tangent;
-			wA -= iA * b2Cross(vcp->rA, P);
-			vA -= mA * P;
-			wB += iB * b2Cross(vcp->rB, P);
-			vB += mB * P;
-		}
+void b2ContactSolver::WarmStart()
+{
+	if (m_step.wideContactSolver)
+	{
+		WarmStartWide();
+		return;
+	}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+	// Warm start.
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2WarmStartContact(m_velocityConstraints + i, m_velocities);
 	}
 }
 
-void b2ContactSolver::SolveVelocityConstraints()
+static void b2SolveContactVelocity(b2ContactVelocityConstraint* vc, b2Velocity* velocities)
 {
-	for (int32 i = 0; i < m_count; ++i)
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float wB = velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float friction = vc->friction;
+
+	b2Assert(pointCount == 1 || pointCount == 2);
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float mA = vc->invMassA;
-		float iA = vc->invIA;
-		float mB = vc->invMassB;
-		float iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-		b2Vec2 vA = m_velocities[indexA].v;
-		float wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float wB = m_velocities[indexB].w;
+		// Compute tangent force
+		float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
+		float lambda = vcp->tangentMass * (-vt);
 
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
-		float friction = vc->friction;
+		// b2Clamp the accumulated force
+		float maxFriction = friction * vcp->normalImpulse;
+		float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
 
-		b2Assert(pointCount == 1 || pointCount == 2);
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
 
-		// Solve tangent constraints first because non-penetration is more important
-		// than friction.
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+
+	// Solve normal constraints
+	if (pointCount == 1 || g_blockSolve == false)
+	{
 		for (int32 j = 0; j < pointCount; ++j)
 		{
 			b2VelocityConstraintPoint* vcp = vc->points + j;
@@ -328,302 +445,500 @@ void b2ContactSolver::SolveVelocityConstraints()
 			// Relative velocity at contact
 			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-			// Compute tangent force
-			float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
-			float lambda = vcp->tangentMass * (-vt);
+			// Compute normal impulse
+			float vn = b2Dot(dv, normal);
+			float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			// b2Clamp the accumulated force
-			float maxFriction = friction * vcp->normalImpulse;
-			float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - vcp->tangentImpulse;
-			vcp->tangentImpulse = newImpulse;
+			// b2Clamp the accumulated impulse
+			float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
 
 			// Apply contact impulse
-			b2Vec2 P = lambda * tangent;
-
+			b2Vec2 P = lambda * normal;
 			vA -= mA * P;
 			wA -= iA * b2Cross(vcp->rA, P);
 
 			vB += mB * P;
 			wB += iB * b2Cross(vcp->rB, P);
 		}
-
-		// Solve normal constraints
-		if (pointCount == 1 || g_blockSolve == false)
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// Build the mini LCP for this contact patch
+		//
+		// vn = A * x + b, vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+		//
+		// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
+		// b = vn0 - velocityBias
+		//
+		// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
+		// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
+		// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
+		// solution that satisfies the problem is chosen.
+		// 
+		// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
+		// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+		//
+		// Substitute:
+		// 
+		// x = a + d
+		// 
+		// a := old total impulse
+		// x := new total impulse
+		// d := incremental impulse 
+		//
+		// For the current iteration we extend the formula for the incremental impulse
+		// to compute the new total impulse:
+		//
+		// vn = A * d + b
+		//    = A * (x - a) + b
+		//    = A * x + b - A * a
+		//    = A * x + b'
+		// b' = b - A * a;
+
+		b2VelocityConstraintPoint* cp1 = vc->points + 0;
+		b2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+		b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+		b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+		b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float vn1 = b2Dot(dv1, normal);
+		float vn2 = b2Dot(dv2, normal);
+
+		b2Vec2 b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= b2Mul(vc->K, a);
+
+		const float k_errorTol = 1e-3f;
+		B2_NOT_USED(k_errorTol);
+
+		for (;;)
 		{
-			for (int32 j = 0; j < pointCount; ++j)
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			b2Vec2 x = - b2Mul(vc->normalMass, b);
+
+			if (x.x >= 0.0f && x.y >= 0.0f)
 			{
-				b2VelocityConstraintPoint* vcp = vc->points + j;
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-				// Relative velocity at contact
-				b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-				// Compute normal impulse
-				float vn = b2Dot(dv, normal);
-				float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-				// b2Clamp the accumulated impulse
-				float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
-				lambda = newImpulse - vcp->normalImpulse;
-				vcp->normalImpulse = newImpulse;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-				// Apply contact impulse
-				b2Vec2 P = lambda * normal;
-				vA -= mA * P;
-				wA -= iA * b2Cross(vcp->rA, P);
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
+				vn2 = b2Dot(dv2, normal);
 
-				vB += mB * P;
-				wB += iB * b2Cross(vcp->rB, P);
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+#endif
+				break;
 			}
-		}
-		else
-		{
-			// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
-			// Build the mini LCP for this contact patch
+
 			//
-			// vn = A * x + b, vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+			// Case 2: vn1 = 0 and x2 = 0
 			//
-			// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
-			// b = vn0 - velocityBias
+			//   0 = a11 * x1 + a12 * 0 + b1' 
+			// vn2 = a21 * x1 + a22 * 0 + b2'
 			//
-			// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
-			// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
-			// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
-			// solution that satisfies the problem is chosen.
-			// 
-			// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
-			// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+			x.x = - cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.ex.y * x.x + b.y;
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
+
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
+
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
+
+
 			//
-			// Substitute:
-			// 
-			// x = a + d
-			// 
-			// a := old total impulse
-			// x := new total impulse
-			// d := incremental impulse 
+			// Case 3: vn2 = 0 and x1 = 0
 			//
-			// For the current iteration we extend the formula for the incremental impulse
-			// to compute the new total impulse:
+			// vn1 = a11 * 0 + a12 * x2 + b1' 
+			//   0 = a21 * 0 + a22 * x2 + b2'
 			//
-			// vn = A * d + b
-			//    = A * (x - a) + b
-			//    = A * x + b - A * a
-			//    = A * x + b'
-			// b' = b - A * a;
+			x.x = 0.0f;
+			x.y = - cp2->normalMass * b.y;
+			vn1 = vc->K.ey.x * x.y + b.x;
+			vn2 = 0.0f;
 
-			b2VelocityConstraintPoint* cp1 = vc->points + 0;
-			b2VelocityConstraintPoint* cp2 = vc->points + 1;
+			if (x.y >= 0.0f && vn1 >= 0.0f)
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-			b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
-			b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-			// Relative velocity at contact
-			b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-			b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-			// Compute normal velocity
-			float vn1 = b2Dot(dv1, normal);
-			float vn2 = b2Dot(dv2, normal);
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-			b2Vec2 b;
-			b.x = vn1 - cp1->velocityBias;
-			b.y = vn2 - cp2->velocityBias;
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
 
-			// Compute b'
-			b -= b2Mul(vc->K, a);
+				// Compute normal velocity
+				vn2 = b2Dot(dv2, normal);
 
-			const float k_errorTol = 1e-3f;
-			B2_NOT_USED(k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
 
-			for (;;)
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			// 
+			// vn1 = b1
+			// vn2 = b2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f )
 			{
-				//
-				// Case 1: vn = 0
-				//
-				// 0 = A * x + b'
-				//
-				// Solve for x:
-				//
-				// x = - inv(A) * b'
-				//
-				b2Vec2 x = - b2Mul(vc->normalMass, b);
-
-				if (x.x >= 0.0f && x.y >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				break;
+			}
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
-					vn2 = b2Dot(dv2, normal);
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
+		}
+	}
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
+	// Bodies that cannot move may be shared with other threads.
+	if (mA != 0.0f || iA != 0.0f)
+	{
+		velocities[indexA].v = vA;
+		velocities[indexA].w = wA;
+	}
 
-				//
-				// Case 2: vn1 = 0 and x2 = 0
-				//
-				//   0 = a11 * x1 + a12 * 0 + b1' 
-				// vn2 = a21 * x1 + a22 * 0 + b2'
-				//
-				x.x = - cp1->normalMass * b.x;
-				x.y = 0.0f;
-				vn1 = 0.0f;
-				vn2 = vc->K.ex.y * x.x + b.y;
-				if (x.x >= 0.0f && vn2 >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
+	if (mB != 0.0f || iB != 0.0f)
+	{
+		velocities[indexB].v = vB;
+		velocities[indexB].w = wB;
+	}
+}
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+void b2ContactSolver::SolveVelocityConstraints()
+{
+	if (m_step.wideContactSolver)
+	{
+		SolveVelocityConstraintsWide();
+		return;
+	}
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SolveContactVelocity(m_velocityConstraints + i, m_velocities);
+	}
+}
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+void b2ContactSolver::WarmStart(int32 index)
+{
+	b2WarmStartContact(m_velocityConstraints + index, m_velocities);
+}
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+void b2ContactSolver::SolveVelocityConstraint(int32 index)
+{
+	b2SolveContactVelocity(m_velocityConstraints + index, m_velocities);
+}
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
+void b2ContactSolver::StoreImpulses()
+{
+	if (m_step.wideContactSolver)
+	{
+		StoreWideImpulses();
+	}
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2Manifold* manifold = m_contacts[vc->contactIndex]->GetManifold();
 
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			manifold->points[j].normalImpulse = vc->points[j].normalImpulse;
+			manifold->points[j].tangentImpulse = vc->points[j].tangentImpulse;
+		}
+	}
+}
 
-				//
-				// Case 3: vn2 = 0 and x1 = 0
-				//
-				// vn1 = a11 * 0 + a12 * x2 + b1' 
-				//   0 = a21 * 0 + a22 * x2 + b2'
-				//
-				x.x = 0.0f;
-				x.y = - cp2->normalMass * b.y;
-				vn1 = vc->K.ey.x * x.y + b.x;
-				vn2 = 0.0f;
+void b2ContactSolver::PrepareSoftConstraints(float h)
+{
+	// The contact stiffness is limited by the sub-step rate.
+	float inv_h = h > 0.0f ? 1.0f / h : 0.0f;
+	float hertz = b2Min(b2_contactHertz, 0.25f * inv_h);
+	float omega = 2.0f * b2_pi * hertz;
+	float a1 = 2.0f * b2_contactDampingRatio + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+
+	m_softness.biasRate = omega / a1;
+	m_softness.massScale = a2 * a3;
+	m_softness.impulseScale = a3;
+	m_inv_h = inv_h;
+}
 
-				if (x.y >= 0.0f && vn1 >= 0.0f)
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
+// Solve a contact as a soft constraint. The separation is updated from the body motion
+// since the constraint was initialized, so the manifold does not need to be rebuilt for
+// each sub-step. With useBias false the overlap is not pushed out, which removes the
+// velocity added by the soft push (relaxation).
+static void b2SolveContactSoft(b2ContactVelocityConstraint* vc, b2Velocity* velocities, const b2Position* positions,
+							   const b2Rot* deltaRotations, const b2Softness& softness, float inv_h, bool useBias)
+{
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float wB = velocities[indexB].w;
+
+	b2Vec2 dc = positions[indexB].c - positions[indexA].c;
+	b2Rot qA = deltaRotations[indexA];
+	b2Rot qB = deltaRotations[indexB];
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float friction = vc->friction;
+
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+		// The anchors started at the same point, so this is zero before the bodies move.
+		b2Vec2 d = dc + b2Mul(qB, vcp->rB) - b2Mul(qA, vcp->rA);
+		float s = b2Dot(d, normal) + vcp->separation;
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+		float velocityBias = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+		if (s > 0.0f)
+		{
+			// Speculative: allow the bodies to close the gap in this sub-step.
+			velocityBias = s * inv_h;
+		}
+		else if (useBias)
+		{
+			velocityBias = b2Max(softness.biasRate * b2Min(s + b2_linearSlop, 0.0f), -b2_contactPushVelocity);
+			massScale = softness.massScale;
+			impulseScale = softness.impulseScale;
+		}
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+		float vn = b2Dot(dv, normal);
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+		float lambda = -vcp->normalMass * massScale * (vn + velocityBias) - impulseScale * vcp->normalImpulse;
 
-					// Compute normal velocity
-					vn2 = b2Dot(dv2, normal);
+		// b2Clamp the accumulated impulse
+		float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - vcp->normalImpulse;
+		vcp->normalImpulse = newImpulse;
 
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
+		b2Vec2 P = lambda * normal;
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
 
-				//
-				// Case 4: x1 = 0 and x2 = 0
-				// 
-				// vn1 = b1
-				// vn2 = b2;
-				x.x = 0.0f;
-				x.y = 0.0f;
-				vn1 = b.x;
-				vn2 = b.y;
-
-				if (vn1 >= 0.0f && vn2 >= 0.0f )
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+		float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
+		float lambda = vcp->tangentMass * (-vt);
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+		float maxFriction = friction * vcp->normalImpulse;
+		float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
 
-					break;
-				}
+		b2Vec2 P = lambda * tangent;
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
 
-				// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
-				break;
-			}
-		}
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+
+	if (mA != 0.0f || iA != 0.0f)
+	{
+		velocities[indexA].v = vA;
+		velocities[indexA].w = wA;
+	}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+	if (mB != 0.0f || iB != 0.0f)
+	{
+		velocities[indexB].v = vB;
+		velocities[indexB].w = wB;
 	}
 }
 
-void b2ContactSolver::StoreImpulses()
+void b2ContactSolver::SolveSoftConstraints(const b2Rot* deltaRotations, bool useBias)
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SolveContactSoft(m_velocityConstraints + i, m_velocities, m_positions, deltaRotations, m_softness, m_inv_h, useBias);
+	}
+}
+
+// The soft solver does not use the restitution bias while sub-stepping. Instead the
+// bounce is applied once at the end of the step to the points that carry load.
+void b2ContactSolver::ApplyRestitution()
 {
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
-		b2Manifold* manifold = m_contacts[vc->contactIndex]->GetManifold();
+		if (vc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		b2Vec2 normal = vc->normal;
 
 		for (int32 j = 0; j < vc->pointCount; ++j)
 		{
-			manifold->points[j].normalImpulse = vc->points[j].normalImpulse;
-			manifold->points[j].tangentImpulse = vc->points[j].tangentImpulse;
+			b2VelocityConstraintPoint* vcp = vc->points + j;
+			if (vcp->velocityBias == 0.0f || vcp->normalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			float vn = b2Dot(dv, normal);
+
+			float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+			float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+
+			b2Vec2 P = lambda * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(vcp->rA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(vcp->rB, P);
+		}
+
+		if (mA != 0.0f || iA != 0.0f)
+		{
+			m_velocities[indexA].v = vA;
+			m_velocities[indexA].w = wA;
+		}
+
+		if (mB != 0.0f || iB != 0.0f)
+		{
+			m_velocities[indexB].v = vB;
+			m_velocities[indexB].w = wB;
 		}
 	}
 }
 
 struct b2PositionSolverManifold
 {
-	void Initialize(b2ContactPositionConstraint* pc, const b2Transform& xfA, const b2Transform& xfB, int32 index)
+	void Initialize(const b2ContactPositionConstraint* pc, const b2Transform& xfA, const b2Transform& xfB, int32 index)
 	{
 		b2Assert(pc->pointCount > 0);
 
@@ -672,78 +987,95 @@ struct b2PositionSolverManifold
 	float separation;
 };
 
-// Sequential solver.
-bool b2ContactSolver::SolvePositionConstraints()
+static float b2SolveContactPosition(const b2ContactPositionConstraint* pc, b2Position* positions, float minSeparation)
 {
-	float minSeparation = 0.0f;
-
-	for (int32 i = 0; i < m_count; ++i)
+	int32 indexA = pc->indexA;
+	int32 indexB = pc->indexB;
+	b2Vec2 localCenterA = pc->localCenterA;
+	float mA = pc->invMassA;
+	float iA = pc->invIA;
+	b2Vec2 localCenterB = pc->localCenterB;
+	float mB = pc->invMassB;
+	float iB = pc->invIB;
+	int32 pointCount = pc->pointCount;
+
+	b2Vec2 cA = positions[indexA].c;
+	float aA = positions[indexA].a;
+
+	b2Vec2 cB = positions[indexB].c;
+	float aB = positions[indexB].a;
+
+	// Solve normal constraints
+	for (int32 j = 0; j < pointCount; ++j)
 	{
-		b2ContactPositionConstraint* pc = m_positionConstraints + i;
+		b2Transform xfA, xfB;
+		xfA.q.Set(aA);
+		xfB.q.Set(aB);
+		xfA.p = cA - b2Mul(xfA.q, localCenterA);
+		xfB.p = cB - b2Mul(xfB.q, localCenterB);
 
-		int32 indexA = pc->indexA;
-		int32 indexB = pc->indexB;
-		b2Vec2 localCenterA = pc->localCenterA;
-		float mA = pc->invMassA;
-		float iA = pc->invIA;
-		b2Vec2 localCenterB = pc->localCenterB;
-		float mB = pc->invMassB;
-		float iB = pc->invIB;
-		int32 pointCount = pc->pointCount;
+		b2PositionSolverManifold psm;
+		psm.Initialize(pc, xfA, xfB, j);
+		b2Vec2 normal = psm.normal;
 
-		b2Vec2 cA = m_positions[indexA].c;
-		float aA = m_positions[indexA].a;
+		b2Vec2 point = psm.point;
+		float separation = psm.separation;
 
-		b2Vec2 cB = m_positions[indexB].c;
-		float aB = m_positions[indexB].a;
+		b2Vec2 rA = point - cA;
+		b2Vec2 rB = point - cB;
 
-		// Solve normal constraints
-		for (int32 j = 0; j < pointCount; ++j)
-		{
-			b2Transform xfA, xfB;
-			xfA.q.Set(aA);
-			xfB.q.Set(aB);
-			xfA.p = cA - b2Mul(xfA.q, localCenterA);
-			xfB.p = cB - b2Mul(xfB.q, localCenterB);
+		// Track max constraint error.
+		minSeparation = b2Min(minSeparation, separation);
 
-			b2PositionSolverManifold psm;
-			psm.Initialize(pc, xfA, xfB, j);
-			b2Vec2 normal = psm.normal;
+		// Prevent large corrections and allow slop.
+		float C = b2Clamp(b2_baumgarte * (separation + b2_linearSlop), -b2_maxLinearCorrection, 0.0f);
 
-			b2Vec2 point = psm.point;
-			float separation = psm.separation;
+		// Compute the effective mass.
+		float rnA = b2Cross(rA, normal);
+		float rnB = b2Cross(rB, normal);
+		float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
 
-			b2Vec2 rA = point - cA;
-			b2Vec2 rB = point - cB;
+		// Compute normal impulse
+		float impulse = K > 0.0f ? - C / K : 0.0f;
 
-			// Track max constraint error.
-			minSeparation = b2Min(minSeparation, separation);
+		b2Vec2 P = impulse * normal;
 
-			// Prevent large corrections and allow slop.
-			float C = b2Clamp(b2_baumgarte * (separation + b2_linearSlop), -b2_maxLinearCorrection, 0.0f);
+		cA -= mA * P;
+		aA -= iA * b2Cross(rA, P);
 
-			// Compute the effective mass.
-			float rnA = b2Cross(rA, normal);
-			float rnB = b2Cross(rB, normal);
-			float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+		cB += mB * P;
+		aB += iB * b2Cross(rB, P);
+	}
 
-			// Compute normal impulse
-			float impulse = K > 0.0f ? - C / K : 0.0f;
+	// Bodies that cannot move may be shared with other threads.
+	if (mA != 0.0f || iA != 0.0f)
+	{
+		positions[indexA].c = cA;
+		positions[indexA].a = aA;
+	}
 
-			b2Vec2 P = impulse * normal;
+	if (mB != 0.0f || iB != 0.0f)
+	{
+		positions[indexB].c = cB;
+		positions[indexB].a = aB;
+	}
 
-			cA -= mA * P;
-			aA -= iA * b2Cross(rA, P);
+	return minSeparation;
+}
 
-			cB += mB * P;
-			aB += iB * b2Cross(rB, P);
-		}
+// Sequential solver.
+bool b2ContactSolver::SolvePositionConstraints()
+{
+	if (m_step.wideContactSolver)
+	{
+		return SolvePositionConstraintsWide();
+	}
 
-		m_positions[indexA].c = cA;
-		m_positions[indexA].a = aA;
+	float minSeparation = 0.0f;
 
-		m_positions[indexB].c = cB;
-		m_positions[indexB].a = aB;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		minSeparation = b2SolveContactPosition(m_positionConstraints + i, m_positions, minSeparation);
 	}
 
 	// We can't expect minSpeparation >= -b2_linearSlop because we don't
@@ -751,6 +1083,11 @@ bool b2ContactSolver::SolvePositionConstraints()
 	return minSeparation >= -3.0f * b2_linearSlop;
 }
 
+float b2ContactSolver::SolvePositionConstraint(int32 index, float minSeparation)
+{
+	return b2SolveContactPosition(m_positionConstraints + index, m_positions, minSeparation);
+}
+
 // Sequential position solver for position constraints.
 bool b2ContactSolver::SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB)
 {
@@ -841,3 +1178,730 @@ bool b2ContactSolver::SolveTOIPositionConstraints(int32 toiIndexA, int32 toiInde
 	// push the separation above -b2_linearSlop.
 	return minSeparation >= -1.5f * b2_linearSlop;
 }
+
+// Wide solver
+//
+// Constraints are packed into batches of b2_simdWidth lanes. Bodies that cannot move
+// (zero inverse mass and inertia) may repeat inside a batch because the solver never
+// changes their velocity or position. Constraints that do not end up in a full batch
+// are solved by the scalar code above.
+
+// Batches are only filled from constraints with the same key so all lanes run the same code.
+enum b2WideKey
+{
+	e_wideCircles = 0,
+	e_wideOnePoint,
+	e_wideRedundantPoint,
+	e_wideTwoPoint,
+	e_wideKeyCount
+};
+
+// Number of partially filled batches searched for a free slot before giving up on the oldest.
+#define b2_wideOpenBatchCount 8
+
+struct b2WideBatchBuilder
+{
+	int32 indices[b2_simdWidth];
+	int32 bodies[2 * b2_simdWidth];
+	int32 count;
+	int32 bodyCount;
+};
+
+static bool b2CanAddToBatch(const b2WideBatchBuilder* batch, int32 bodyA, int32 bodyB)
+{
+	for (int32 i = 0; i < batch->bodyCount; ++i)
+	{
+		if (batch->bodies[i] == bodyA || batch->bodies[i] == bodyB)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void b2RemoveBatch(b2WideBatchBuilder* batches, int32* count, int32 index)
+{
+	for (int32 i = index + 1; i < *count; ++i)
+	{
+		batches[i - 1] = batches[i];
+	}
+	*count -= 1;
+}
+
+static void b2FillWideConstraint(b2WideContactConstraint* wc, const int32* indices,
+	const b2ContactVelocityConstraint* velocityConstraints, const b2ContactPositionConstraint* positionConstraints)
+{
+	const b2ContactVelocityConstraint* vc0 = velocityConstraints + indices[0];
+	const b2ContactPositionConstraint* pc0 = positionConstraints + indices[0];
+	wc->pointCount = vc0->pointCount;
+	wc->positionPointCount = pc0->pointCount;
+	wc->circles = pc0->type == b2Manifold::e_circles;
+
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2ContactVelocityConstraint* vc = velocityConstraints + indices[lane];
+		const b2ContactPositionConstraint* pc = positionConstraints + indices[lane];
+
+		wc->indexA[lane] = vc->indexA;
+		wc->indexB[lane] = vc->indexB;
+		wc->constraintIndex[lane] = indices[lane];
+
+		b2SetLaneW(&wc->normalX, lane, vc->normal.x);
+		b2SetLaneW(&wc->normalY, lane, vc->normal.y);
+		b2SetLaneW(&wc->invMassA, lane, vc->invMassA);
+		b2SetLaneW(&wc->invMassB, lane, vc->invMassB);
+		b2SetLaneW(&wc->invIA, lane, vc->invIA);
+		b2SetLaneW(&wc->invIB, lane, vc->invIB);
+		b2SetLaneW(&wc->friction, lane, vc->friction);
+		b2SetLaneW(&wc->tangentSpeed, lane, vc->tangentSpeed);
+
+		b2SetLaneW(&wc->k11, lane, vc->K.ex.x);
+		b2SetLaneW(&wc->k12, lane, vc->K.ey.x);
+		b2SetLaneW(&wc->k22, lane, vc->K.ey.y);
+		b2SetLaneW(&wc->normalMass11, lane, vc->normalMass.ex.x);
+		b2SetLaneW(&wc->normalMass12, lane, vc->normalMass.ey.x);
+		b2SetLaneW(&wc->normalMass22, lane, vc->normalMass.ey.y);
+
+		b2SetLaneW(&wc->localNormalX, lane, pc->localNormal.x);
+		b2SetLaneW(&wc->localNormalY, lane, pc->localNormal.y);
+		b2SetLaneW(&wc->localPointX, lane, pc->localPoint.x);
+		b2SetLaneW(&wc->localPointY, lane, pc->localPoint.y);
+		b2SetLaneW(&wc->localCenterAx, lane, pc->localCenterA.x);
+		b2SetLaneW(&wc->localCenterAy, lane, pc->localCenterA.y);
+		b2SetLaneW(&wc->localCenterBx, lane, pc->localCenterB.x);
+		b2SetLaneW(&wc->localCenterBy, lane, pc->localCenterB.y);
+		b2SetLaneW(&wc->radiusA, lane, pc->radiusA);
+		b2SetLaneW(&wc->radiusB, lane, pc->radiusB);
+		b2SetMaskLaneW(&wc->faceB, lane, pc->type == b2Manifold::e_faceB);
+
+		for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+		{
+			b2WideContactPoint* wcp = wc->points + j;
+			b2VelocityConstraintPoint zero = {};
+			const b2VelocityConstraintPoint* vcp = j < vc->pointCount ? vc->points + j : &zero;
+			b2Vec2 localPoint = j < pc->pointCount ? pc->localPoints[j] : b2Vec2_zero;
+
+			b2SetLaneW(&wcp->rAx, lane, vcp->rA.x);
+			b2SetLaneW(&wcp->rAy, lane, vcp->rA.y);
+			b2SetLaneW(&wcp->rBx, lane, vcp->rB.x);
+			b2SetLaneW(&wcp->rBy, lane, vcp->rB.y);
+			b2SetLaneW(&wcp->normalImpulse, lane, vcp->normalImpulse);
+			b2SetLaneW(&wcp->tangentImpulse, lane, vcp->tangentImpulse);
+			b2SetLaneW(&wcp->normalMass, lane, vcp->normalMass);
+			b2SetLaneW(&wcp->tangentMass, lane, vcp->tangentMass);
+			b2SetLaneW(&wcp->velocityBias, lane, vcp->velocityBias);
+			b2SetLaneW(&wcp->localPointX, lane, localPoint.x);
+			b2SetLaneW(&wcp->localPointY, lane, localPoint.y);
+		}
+	}
+}
+
+void b2ContactSolver::PrepareWideConstraints()
+{
+	b2WideBatchBuilder open[e_wideKeyCount][b2_wideOpenBatchCount];
+	int32 openCount[e_wideKeyCount] = {};
+
+	m_wideCount = 0;
+	m_remainderCount = 0;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		const b2ContactPositionConstraint* pc = m_positionConstraints + i;
+
+		int32 key;
+		if (pc->type == b2Manifold::e_circles)
+		{
+			key = e_wideCircles;
+		}
+		else if (pc->pointCount == 1)
+		{
+			key = e_wideOnePoint;
+		}
+		else
+		{
+			key = vc->pointCount == 1 ? e_wideRedundantPoint : e_wideTwoPoint;
+		}
+
+		// Only bodies that can move conflict.
+		int32 bodyA = vc->invMassA > 0.0f || vc->invIA > 0.0f ? vc->indexA : -1;
+		int32 bodyB = vc->invMassB > 0.0f || vc->invIB > 0.0f ? vc->indexB : -1;
+
+		b2WideBatchBuilder* batches = open[key];
+		int32 index = -1;
+		for (int32 j = 0; j < openCount[key]; ++j)
+		{
+			if (b2CanAddToBatch(batches + j, bodyA, bodyB))
+			{
+				index = j;
+				break;
+			}
+		}
+
+		if (index == -1)
+		{
+			if (openCount[key] == b2_wideOpenBatchCount)
+			{
+				// Give up on the oldest batch.
+				const b2WideBatchBuilder* oldest = batches + 0;
+				for (int32 j = 0; j < oldest->count; ++j)
+				{
+					m_remainder[m_remainderCount++] = oldest->indices[j];
+				}
+				b2RemoveBatch(batches, openCount + key, 0);
+			}
+
+			index = openCount[key]++;
+			batches[index].count = 0;
+			batches[index].bodyCount = 0;
+		}
+
+		b2WideBatchBuilder* batch = batches + index;
+		batch->indices[batch->count++] = i;
+		if (bodyA != -1)
+		{
+			batch->bodies[batch->bodyCount++] = bodyA;
+		}
+		if (bodyB != -1)
+		{
+			batch->bodies[batch->bodyCount++] = bodyB;
+		}
+
+		if (batch->count == b2_simdWidth)
+		{
+			b2Assert(m_wideCount < m_count / b2_simdWidth);
+			b2FillWideConstraint(m_wideConstraints + m_wideCount, batch->indices, m_velocityConstraints, m_positionConstraints);
+			++m_wideCount;
+			b2RemoveBatch(batches, openCount + key, index);
+		}
+	}
+
+	for (int32 key = 0; key < e_wideKeyCount; ++key)
+	{
+		for (int32 j = 0; j < openCount[key]; ++j)
+		{
+			const b2WideBatchBuilder* batch = open[key] + j;
+			for (int32 k = 0; k < batch->count; ++k)
+			{
+				m_remainder[m_remainderCount++] = batch->indices[k];
+			}
+		}
+	}
+
+	b2Assert(m_wideCount * b2_simdWidth + m_remainderCount == m_count);
+
+#if defined(b2DEBUG)
+	ValidateWideConstraints();
+#endif
+}
+
+static inline bool b2CanMove(float invMass, float invI)
+{
+	return invMass > 0.0f || invI > 0.0f;
+}
+
+// Check the packing: every constraint is in one batch or in the remainder, the lanes of
+// a batch share the point counts and manifold kind, and no body that can move is
+// repeated in a batch.
+void b2ContactSolver::ValidateWideConstraints() const
+{
+	bool* packed = (bool*)m_allocator->Allocate(m_count * sizeof(bool));
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		packed[i] = false;
+	}
+
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		const b2WideContactConstraint* wc = m_wideConstraints + i;
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			int32 index = wc->constraintIndex[lane];
+			b2Assert(0 <= index && index < m_count && packed[index] == false);
+			packed[index] = true;
+
+			const b2ContactVelocityConstraint* vc = m_velocityConstraints + index;
+			const b2ContactPositionConstraint* pc = m_positionConstraints + index;
+			b2Assert(vc->pointCount == wc->pointCount && pc->pointCount == wc->positionPointCount);
+			b2Assert((pc->type == b2Manifold::e_circles) == wc->circles);
+			b2Assert(wc->indexA[lane] == vc->indexA && wc->indexB[lane] == vc->indexB);
+
+			bool movesA = b2CanMove(vc->invMassA, vc->invIA);
+			bool movesB = b2CanMove(vc->invMassB, vc->invIB);
+			for (int32 other = 0; other < lane; ++other)
+			{
+				const b2ContactVelocityConstraint* vo = m_velocityConstraints + wc->constraintIndex[other];
+				bool movesOtherA = b2CanMove(vo->invMassA, vo->invIA);
+				bool movesOtherB = b2CanMove(vo->invMassB, vo->invIB);
+				b2Assert(movesA == false || movesOtherA == false || vc->indexA != vo->indexA);
+				b2Assert(movesA == false || movesOtherB == false || vc->indexA != vo->indexB);
+				b2Assert(movesB == false || movesOtherA == false || vc->indexB != vo->indexA);
+				b2Assert(movesB == false || movesOtherB == false || vc->indexB != vo->indexB);
+				B2_NOT_USED(movesOtherA);
+				B2_NOT_USED(movesOtherB);
+			}
+			B2_NOT_USED(movesA);
+			B2_NOT_USED(movesB);
+		}
+	}
+
+	for (int32 i = 0; i < m_remainderCount; ++i)
+	{
+		int32 index = m_remainder[i];
+		b2Assert(0 <= index && index < m_count && packed[index] == false);
+		packed[index] = true;
+	}
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2Assert(packed[i]);
+	}
+
+	m_allocator->Free(packed);
+}
+
+struct b2WideBody
+{
+	b2FloatW vx, vy, w;
+};
+
+static void b2GatherWide(b2WideBody* bodyA, b2WideBody* bodyB, const b2WideContactConstraint* wc, const b2Velocity* velocities)
+{
+	alignas(b2_simdAlignment) float values[6][b2_simdWidth];
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2Velocity& vA = velocities[wc->indexA[lane]];
+		const b2Velocity& vB = velocities[wc->indexB[lane]];
+		values[0][lane] = vA.v.x;
+		values[1][lane] = vA.v.y;
+		values[2][lane] = vA.w;
+		values[3][lane] = vB.v.x;
+		values[4][lane] = vB.v.y;
+		values[5][lane] = vB.w;
+	}
+
+	bodyA->vx = b2LoadW(values[0]);
+	bodyA->vy = b2LoadW(values[1]);
+	bodyA->w = b2LoadW(values[2]);
+	bodyB->vx = b2LoadW(values[3]);
+	bodyB->vy = b2LoadW(values[4]);
+	bodyB->w = b2LoadW(values[5]);
+}
+
+static void b2ScatterWide(b2Velocity* velocities, const b2WideContactConstraint* wc, const b2WideBody* bodyA, const b2WideBody* bodyB)
+{
+	alignas(b2_simdAlignment) float values[6][b2_simdWidth];
+	b2StoreW(values[0], bodyA->vx);
+	b2StoreW(values[1], bodyA->vy);
+	b2StoreW(values[2], bodyA->w);
+	b2StoreW(values[3], bodyB->vx);
+	b2StoreW(values[4], bodyB->vy);
+	b2StoreW(values[5], bodyB->w);
+
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		b2Velocity& vA = velocities[wc->indexA[lane]];
+		b2Velocity& vB = velocities[wc->indexB[lane]];
+		vA.v.Set(values[0][lane], values[1][lane]);
+		vA.w = values[2][lane];
+		vB.v.Set(values[3][lane], values[4][lane]);
+		vB.w = values[5][lane];
+	}
+}
+
+// vA -= mA * P, wA -= iA * cross(rA, P), vB += mB * P, wB += iB * cross(rB, P)
+static inline void b2ApplyImpulseWide(b2WideBody* bodyA, b2WideBody* bodyB, const b2WideContactConstraint* wc,
+	const b2WideContactPoint* cp, b2FloatW Px, b2FloatW Py)
+{
+	bodyA->vx = b2SubW(bodyA->vx, b2MulW(wc->invMassA, Px));
+	bodyA->vy = b2SubW(bodyA->vy, b2MulW(wc->invMassA, Py));
+	bodyA->w = b2SubW(bodyA->w, b2MulW(wc->invIA, b2CrossW(cp->rAx, cp->rAy, Px, Py)));
+
+	bodyB->vx = b2AddW(bodyB->vx, b2MulW(wc->invMassB, Px));
+	bodyB->vy = b2AddW(bodyB->vy, b2MulW(wc->invMassB, Py));
+	bodyB->w = b2AddW(bodyB->w, b2MulW(wc->invIB, b2CrossW(cp->rBx, cp->rBy, Px, Py)));
+}
+
+// Relative velocity at contact: vB + cross(wB, rB) - vA - cross(wA, rA)
+static inline void b2RelativeVelocityWide(b2FloatW* dvx, b2FloatW* dvy, const b2WideBody* bodyA, const b2WideBody* bodyB,
+	const b2WideContactPoint* cp)
+{
+	*dvx = b2AddW(b2SubW(b2SubW(bodyB->vx, b2MulW(bodyB->w, cp->rBy)), bodyA->vx), b2MulW(bodyA->w, cp->rAy));
+	*dvy = b2SubW(b2SubW(b2AddW(bodyB->vy, b2MulW(bodyB->w, cp->rBx)), bodyA->vy), b2MulW(bodyA->w, cp->rAx));
+}
+
+void b2ContactSolver::WarmStartWide()
+{
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		const b2WideContactConstraint* wc = m_wideConstraints + i;
+
+		b2WideBody bodyA, bodyB;
+		b2GatherWide(&bodyA, &bodyB, wc, m_velocities);
+
+		b2FloatW tangentX = wc->normalY;
+		b2FloatW tangentY = b2NegW(wc->normalX);
+
+		for (int32 j = 0; j < wc->pointCount; ++j)
+		{
+			const b2WideContactPoint* cp = wc->points + j;
+			b2FloatW Px = b2AddW(b2MulW(cp->normalImpulse, wc->normalX), b2MulW(cp->tangentImpulse, tangentX));
+			b2FloatW Py = b2AddW(b2MulW(cp->normalImpulse, wc->normalY), b2MulW(cp->tangentImpulse, tangentY));
+			b2ApplyImpulseWide(&bodyA, &bodyB, wc, cp, Px, Py);
+		}
+
+		b2ScatterWide(m_velocities, wc, &bodyA, &bodyB);
+	}
+
+	for (int32 i = 0; i < m_remainderCount; ++i)
+	{
+		b2WarmStartContact(m_velocityConstraints + m_remainder[i], m_velocities);
+	}
+}
+
+void b2ContactSolver::SolveVelocityConstraintsWide()
+{
+	b2FloatW zero = b2ZeroW();
+
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		b2WideContactConstraint* wc = m_wideConstraints + i;
+
+		b2WideBody bodyA, bodyB;
+		b2GatherWide(&bodyA, &bodyB, wc, m_velocities);
+
+		b2FloatW normalX = wc->normalX;
+		b2FloatW normalY = wc->normalY;
+		b2FloatW tangentX = normalY;
+		b2FloatW tangentY = b2NegW(normalX);
+		int32 pointCount = wc->pointCount;
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2WideContactPoint* cp = wc->points + j;
+
+			b2FloatW dvx, dvy;
+			b2RelativeVelocityWide(&dvx, &dvy, &bodyA, &bodyB, cp);
+
+			// Compute tangent force
+			b2FloatW vt = b2SubW(b2AddW(b2MulW(dvx, tangentX), b2MulW(dvy, tangentY)), wc->tangentSpeed);
+			b2FloatW lambda = b2MulW(cp->tangentMass, b2NegW(vt));
+
+			// Clamp the accumulated force
+			b2FloatW maxFriction = b2MulW(wc->friction, cp->normalImpulse);
+			b2FloatW newImpulse = b2ClampW(b2AddW(cp->tangentImpulse, lambda), b2NegW(maxFriction), maxFriction);
+			lambda = b2SubW(newImpulse, cp->tangentImpulse);
+			cp->tangentImpulse = newImpulse;
+
+			// Apply contact impulse
+			b2ApplyImpulseWide(&bodyA, &bodyB, wc, cp, b2MulW(lambda, tangentX), b2MulW(lambda, tangentY));
+		}
+
+		// Solve normal constraints
+		if (pointCount == 1 || g_blockSolve == false)
+		{
+			for (int32 j = 0; j < pointCount; ++j)
+			{
+				b2WideContactPoint* cp = wc->points + j;
+
+				b2FloatW dvx, dvy;
+				b2RelativeVelocityWide(&dvx, &dvy, &bodyA, &bodyB, cp);
+
+				// Compute normal impulse
+				b2FloatW vn = b2AddW(b2MulW(dvx, normalX), b2MulW(dvy, normalY));
+				b2FloatW lambda = b2MulW(b2NegW(cp->normalMass), b2SubW(vn, cp->velocityBias));
+
+				// Clamp the accumulated impulse
+				b2FloatW newImpulse = b2MaxW(b2AddW(cp->normalImpulse, lambda), zero);
+				lambda = b2SubW(newImpulse, cp->normalImpulse);
+				cp->normalImpulse = newImpulse;
+
+				// Apply contact impulse
+				b2ApplyImpulseWide(&bodyA, &bodyB, wc, cp, b2MulW(lambda, normalX), b2MulW(lambda, normalY));
+			}
+		}
+		else
+		{
+			// Block solver. This evaluates all four cases of the scalar solver and selects
+			// the first valid solution in each lane. Lanes without a solution keep their impulse.
+			b2WideContactPoint* cp1 = wc->points + 0;
+			b2WideContactPoint* cp2 = wc->points + 1;
+
+			b2FloatW a1 = cp1->normalImpulse;
+			b2FloatW a2 = cp2->normalImpulse;
+
+			b2FloatW dv1x, dv1y, dv2x, dv2y;
+			b2RelativeVelocityWide(&dv1x, &dv1y, &bodyA, &bodyB, cp1);
+			b2RelativeVelocityWide(&dv2x, &dv2y, &bodyA, &bodyB, cp2);
+
+			// Compute normal velocity
+			b2FloatW vn1 = b2AddW(b2MulW(dv1x, normalX), b2MulW(dv1y, normalY));
+			b2FloatW vn2 = b2AddW(b2MulW(dv2x, normalX), b2MulW(dv2y, normalY));
+
+			// Compute b'
+			b2FloatW bx = b2SubW(vn1, cp1->velocityBias);
+			b2FloatW by = b2SubW(vn2, cp2->velocityBias);
+			bx = b2SubW(bx, b2AddW(b2MulW(wc->k11, a1), b2MulW(wc->k12, a2)));
+			by = b2SubW(by, b2AddW(b2MulW(wc->k12, a1), b2MulW(wc->k22, a2)));
+
+			// Case 1: vn = 0
+			b2FloatW x1 = b2NegW(b2AddW(b2MulW(wc->normalMass11, bx), b2MulW(wc->normalMass12, by)));
+			b2FloatW x2 = b2NegW(b2AddW(b2MulW(wc->normalMass12, bx), b2MulW(wc->normalMass22, by)));
+			b2FloatW case1 = b2AndW(b2GreaterEqualW(x1, zero), b2GreaterEqualW(x2, zero));
+
+			// Case 2: vn1 = 0 and x2 = 0
+			b2FloatW x1Case2 = b2MulW(b2NegW(cp1->normalMass), bx);
+			b2FloatW vn2Case2 = b2AddW(b2MulW(wc->k12, x1Case2), by);
+			b2FloatW case2 = b2AndW(b2GreaterEqualW(x1Case2, zero), b2GreaterEqualW(vn2Case2, zero));
+
+			// Case 3: vn2 = 0 and x1 = 0
+			b2FloatW x2Case3 = b2MulW(b2NegW(cp2->normalMass), by);
+			b2FloatW vn1Case3 = b2AddW(b2MulW(wc->k12, x2Case3), bx);
+			b2FloatW case3 = b2AndW(b2GreaterEqualW(x2Case3, zero), b2GreaterEqualW(vn1Case3, zero));
+
+			// Case 4: x1 = 0 and x2 = 0
+			b2FloatW case4 = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+
+			// Select in reverse order so the first valid case wins.
+			b2FloatW newImpulse1 = b2BlendW(a1, zero, case4);
+			b2FloatW newImpulse2 = b2BlendW(a2, zero, case4);
+			newImpulse1 = b2BlendW(newImpulse1, zero, case3);
+			newImpulse2 = b2BlendW(newImpulse2, x2Case3, case3);
+			newImpulse1 = b2BlendW(newImpulse1, x1Case2, case2);
+			newImpulse2 = b2BlendW(newImpulse2, zero, case2);
+			newImpulse1 = b2BlendW(newImpulse1, x1, case1);
+			newImpulse2 = b2BlendW(newImpulse2, x2, case1);
+
+			// Get the incremental impulse
+			b2FloatW d1 = b2SubW(newImpulse1, a1);
+			b2FloatW d2 = b2SubW(newImpulse2, a2);
+
+			// Apply incremental impulse
+			b2FloatW P1x = b2MulW(d1, normalX);
+			b2FloatW P1y = b2MulW(d1, normalY);
+			b2FloatW P2x = b2MulW(d2, normalX);
+			b2FloatW P2y = b2MulW(d2, normalY);
+
+			bodyA.vx = b2SubW(bodyA.vx, b2MulW(wc->invMassA, b2AddW(P1x, P2x)));
+			bodyA.vy = b2SubW(bodyA.vy, b2MulW(wc->invMassA, b2AddW(P1y, P2y)));
+			bodyA.w = b2SubW(bodyA.w, b2MulW(wc->invIA,
+				b2AddW(b2CrossW(cp1->rAx, cp1->rAy, P1x, P1y), b2CrossW(cp2->rAx, cp2->rAy, P2x, P2y))));
+
+			bodyB.vx = b2AddW(bodyB.vx, b2MulW(wc->invMassB, b2AddW(P1x, P2x)));
+			bodyB.vy = b2AddW(bodyB.vy, b2MulW(wc->invMassB, b2AddW(P1y, P2y)));
+			bodyB.w = b2AddW(bodyB.w, b2MulW(wc->invIB,
+				b2AddW(b2CrossW(cp1->rBx, cp1->rBy, P1x, P1y), b2CrossW(cp2->rBx, cp2->rBy, P2x, P2y))));
+
+			// Accumulate
+			cp1->normalImpulse = newImpulse1;
+			cp2->normalImpulse = newImpulse2;
+		}
+
+		b2ScatterWide(m_velocities, wc, &bodyA, &bodyB);
+	}
+
+	for (int32 i = 0; i < m_remainderCount; ++i)
+	{
+		b2SolveContactVelocity(m_velocityConstraints + m_remainder[i], m_velocities);
+	}
+}
+
+void b2ContactSolver::StoreWideImpulses()
+{
+	// Copy the batch impulses back so the manifolds and post solve see them.
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		const b2WideContactConstraint* wc = m_wideConstraints + i;
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + wc->constraintIndex[lane];
+			for (int32 j = 0; j < wc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = b2GetLaneW(wc->points[j].normalImpulse, lane);
+				vc->points[j].tangentImpulse = b2GetLaneW(wc->points[j].tangentImpulse, lane);
+			}
+		}
+	}
+}
+
+bool b2ContactSolver::SolvePositionConstraintsWide()
+{
+	b2FloatW zero = b2ZeroW();
+	b2FloatW half = b2SplatW(0.5f);
+	b2FloatW epsilon = b2SplatW(b2_epsilon);
+	b2FloatW linearSlop = b2SplatW(b2_linearSlop);
+	b2FloatW baumgarte = b2SplatW(b2_baumgarte);
+	b2FloatW maxCorrection = b2SplatW(-b2_maxLinearCorrection);
+	b2FloatW minSeparation = zero;
+
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		const b2WideContactConstraint* wc = m_wideConstraints + i;
+
+		alignas(b2_simdAlignment) float values[6][b2_simdWidth];
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			const b2Position& pA = m_positions[wc->indexA[lane]];
+			const b2Position& pB = m_positions[wc->indexB[lane]];
+			values[0][lane] = pA.c.x;
+			values[1][lane] = pA.c.y;
+			values[2][lane] = pA.a;
+			values[3][lane] = pB.c.x;
+			values[4][lane] = pB.c.y;
+			values[5][lane] = pB.a;
+		}
+
+		b2FloatW cAx = b2LoadW(values[0]);
+		b2FloatW cAy = b2LoadW(values[1]);
+		b2FloatW aA = b2LoadW(values[2]);
+		b2FloatW cBx = b2LoadW(values[3]);
+		b2FloatW cBy = b2LoadW(values[4]);
+		b2FloatW aB = b2LoadW(values[5]);
+
+		// Solve normal constraints
+		for (int32 j = 0; j < wc->positionPointCount; ++j)
+		{
+			// The angles change after each point so the rotations are rebuilt per point.
+			alignas(b2_simdAlignment) float rotations[4][b2_simdWidth];
+			b2StoreW(values[2], aA);
+			b2StoreW(values[5], aB);
+			for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+			{
+				rotations[0][lane] = b2Sin(values[2][lane]);
+				rotations[1][lane] = b2Cos(values[2][lane]);
+				rotations[2][lane] = b2Sin(values[5][lane]);
+				rotations[3][lane] = b2Cos(values[5][lane]);
+			}
+
+			b2FloatW qAs = b2LoadW(rotations[0]);
+			b2FloatW qAc = b2LoadW(rotations[1]);
+			b2FloatW qBs = b2LoadW(rotations[2]);
+			b2FloatW qBc = b2LoadW(rotations[3]);
+
+			// xf.p = c - q * localCenter
+			b2FloatW pAx = b2SubW(cAx, b2SubW(b2MulW(qAc, wc->localCenterAx), b2MulW(qAs, wc->localCenterAy)));
+			b2FloatW pAy = b2SubW(cAy, b2AddW(b2MulW(qAs, wc->localCenterAx), b2MulW(qAc, wc->localCenterAy)));
+			b2FloatW pBx = b2SubW(cBx, b2SubW(b2MulW(qBc, wc->localCenterBx), b2MulW(qBs, wc->localCenterBy)));
+			b2FloatW pBy = b2SubW(cBy, b2AddW(b2MulW(qBs, wc->localCenterBx), b2MulW(qBc, wc->localCenterBy)));
+
+			const b2WideContactPoint* cp = wc->points + j;
+			b2FloatW normalX, normalY, pointX, pointY, separation;
+			if (wc->circles)
+			{
+				b2FloatW pointAx = b2AddW(b2SubW(b2MulW(qAc, wc->localPointX), b2MulW(qAs, wc->localPointY)), pAx);
+				b2FloatW pointAy = b2AddW(b2AddW(b2MulW(qAs, wc->localPointX), b2MulW(qAc, wc->localPointY)), pAy);
+				b2FloatW pointBx = b2AddW(b2SubW(b2MulW(qBc, cp->localPointX), b2MulW(qBs, cp->localPointY)), pBx);
+				b2FloatW pointBy = b2AddW(b2AddW(b2MulW(qBs, cp->localPointX), b2MulW(qBc, cp->localPointY)), pBy);
+
+				b2FloatW dx = b2SubW(pointBx, pointAx);
+				b2FloatW dy = b2SubW(pointBy, pointAy);
+
+				// Normalize, leaving tiny vectors alone like b2Vec2::Normalize
+				b2FloatW length = b2SqrtW(b2AddW(b2MulW(dx, dx), b2MulW(dy, dy)));
+				b2FloatW invLength = b2DivW(b2SplatW(1.0f), length);
+				b2FloatW tiny = b2LessW(length, epsilon);
+				normalX = b2BlendW(b2MulW(dx, invLength), dx, tiny);
+				normalY = b2BlendW(b2MulW(dy, invLength), dy, tiny);
+
+				pointX = b2MulW(half, b2AddW(pointAx, pointBx));
+				pointY = b2MulW(half, b2AddW(pointAy, pointBy));
+				separation = b2AddW(b2MulW(dx, normalX), b2MulW(dy, normalY));
+			}
+			else
+			{
+				// e_faceB lanes swap the roles of the bodies and flip the normal.
+				b2FloatW faceB = wc->faceB;
+				b2FloatW planeS = b2BlendW(qAs, qBs, faceB);
+				b2FloatW planeC = b2BlendW(qAc, qBc, faceB);
+				b2FloatW planePx = b2BlendW(pAx, pBx, faceB);
+				b2FloatW planePy = b2BlendW(pAy, pBy, faceB);
+				b2FloatW clipS = b2BlendW(qBs, qAs, faceB);
+				b2FloatW clipC = b2BlendW(qBc, qAc, faceB);
+				b2FloatW clipPx = b2BlendW(pBx, pAx, faceB);
+				b2FloatW clipPy = b2BlendW(pBy, pAy, faceB);
+
+				normalX = b2SubW(b2MulW(planeC, wc->localNormalX), b2MulW(planeS, wc->localNormalY));
+				normalY = b2AddW(b2MulW(planeS, wc->localNormalX), b2MulW(planeC, wc->localNormalY));
+
+				b2FloatW planePointX = b2AddW(b2SubW(b2MulW(planeC, wc->localPointX), b2MulW(planeS, wc->localPointY)), planePx);
+				b2FloatW planePointY = b2AddW(b2AddW(b2MulW(planeS, wc->localPointX), b2MulW(planeC, wc->localPointY)), planePy);
+
+				pointX = b2AddW(b2SubW(b2MulW(clipC, cp->localPointX), b2MulW(clipS, cp->localPointY)), clipPx);
+				pointY = b2AddW(b2AddW(b2MulW(clipS, cp->localPointX), b2MulW(clipC, cp->localPointY)), clipPy);
+
+				separation = b2AddW(b2MulW(b2SubW(pointX, planePointX), normalX), b2MulW(b2SubW(pointY, planePointY), normalY));
+
+				// Ensure normal points from A to B
+				normalX = b2BlendW(normalX, b2NegW(normalX), faceB);
+				normalY = b2BlendW(normalY, b2NegW(normalY), faceB);
+			}
+
+			separation = b2SubW(b2SubW(separation, wc->radiusA), wc->radiusB);
+
+			b2FloatW rAx = b2SubW(pointX, cAx);
+			b2FloatW rAy = b2SubW(pointY, cAy);
+			b2FloatW rBx = b2SubW(pointX, cBx);
+			b2FloatW rBy = b2SubW(pointY, cBy);
+
+			// Track max constraint error.
+			minSeparation = b2MinW(minSeparation, separation);
+
+			// Prevent large corrections and allow slop.
+			b2FloatW C = b2ClampW(b2MulW(baumgarte, b2AddW(separation, linearSlop)), maxCorrection, zero);
+
+			// Compute the effective mass.
+			b2FloatW rnA = b2CrossW(rAx, rAy, normalX, normalY);
+			b2FloatW rnB = b2CrossW(rBx, rBy, normalX, normalY);
+			b2FloatW K = b2AddW(b2AddW(b2AddW(wc->invMassA, wc->invMassB), b2MulW(b2MulW(wc->invIA, rnA), rnA)),
+				b2MulW(b2MulW(wc->invIB, rnB), rnB));
+
+			// Compute normal impulse
+			b2FloatW impulse = b2BlendW(zero, b2DivW(b2NegW(C), K), b2LessW(zero, K));
+
+			b2FloatW Px = b2MulW(impulse, normalX);
+			b2FloatW Py = b2MulW(impulse, normalY);
+
+			cAx = b2SubW(cAx, b2MulW(wc->invMassA, Px));
+			cAy = b2SubW(cAy, b2MulW(wc->invMassA, Py));
+			aA = b2SubW(aA, b2MulW(wc->invIA, b2CrossW(rAx, rAy, Px, Py)));
+
+			cBx = b2AddW(cBx, b2MulW(wc->invMassB, Px));
+			cBy = b2AddW(cBy, b2MulW(wc->invMassB, Py));
+			aB = b2AddW(aB, b2MulW(wc->invIB, b2CrossW(rBx, rBy, Px, Py)));
+		}
+
+		b2StoreW(values[0], cAx);
+		b2StoreW(values[1], cAy);
+		b2StoreW(values[2], aA);
+		b2StoreW(values[3], cBx);
+		b2StoreW(values[4], cBy);
+		b2StoreW(values[5], aB);
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			b2Position& pA = m_positions[wc->indexA[lane]];
+			b2Position& pB = m_positions[wc->indexB[lane]];
+			pA.c.Set(values[0][lane], values[1][lane]);
+			pA.a = values[2][lane];
+			pB.c.Set(values[3][lane], values[4][lane]);
+			pB.a = values[5][lane];
+		}
+	}
+
+	float scalarMinSeparation = 0.0f;
+	for (int32 i = 0; i < m_remainderCount; ++i)
+	{
+		scalarMinSeparation = b2SolveContactPosition(m_positionConstraints + m_remainder[i], m_positions, scalarMinSeparation);
+	}
+
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		scalarMinSeparation = b2Min(scalarMinSeparation, b2GetLaneW(minSeparation, lane));
+	}
+
+	// We can't expect minSpeparation >= -b2_linearSlop because we don't
+	// push the separation above -b2_linearSlop.
+	return scalarMinSeparation >= -3.0f * b2_linearSlop;
+}
@@ -31,6 +31,7 @@ class b2Contact;
 class b2Body;
 class b2StackAllocator;
 struct b2ContactPositionConstraint;
+struct b2WideContactConstraint;
 
 struct b2VelocityConstraintPoint
 {
@@ -41,6 +42,7 @@ struct b2VelocityConstraintPoint
 	float normalMass;
 	float tangentMass;
 	float velocityBias;
+	float separation;
 };
 
 struct b2ContactVelocityConstraint
@@ -61,6 +63,14 @@ struct b2ContactVelocityConstraint
 	int32 contactIndex;
 };
 
+// Soft constraint coefficients for a spring with the given stiffness and damping.
+struct b2Softness
+{
+	float biasRate;
+	float massScale;
+	float impulseScale;
+};
+
 struct b2ContactSolverDef
 {
 	b2TimeStep step;
@@ -86,6 +96,25 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	// Solve a single constraint. Used by b2ConstraintGraph.
+	void WarmStart(int32 index);
+	void SolveVelocityConstraint(int32 index);
+	float SolvePositionConstraint(int32 index, float minSeparation);
+
+	// Wide solver, see b2TimeStep::wideContactSolver.
+	void PrepareWideConstraints();
+	void WarmStartWide();
+	void SolveVelocityConstraintsWide();
+	void StoreWideImpulses();
+	bool SolvePositionConstraintsWide();
+	void ValidateWideConstraints() const;
+
+	// Soft step solver, see b2TimeStep::subStepCount. The delta rotations rotate the
+	// body anchors from their orientation when the constraints were initialized.
+	void PrepareSoftConstraints(float h);
+	void SolveSoftConstraints(const b2Rot* deltaRotations, bool useBias);
+	void ApplyRestitution();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -94,6 +123,16 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+
+	// Full SIMD batches and the indices of the constraints left over for the scalar solver.
+	void* m_wideMemory;
+	b2WideContactConstraint* m_wideConstraints;
+	int32 m_wideCount;
+	int32* m_remainder;
+	int32 m_remainderCount;
+
+	b2Softness m_softness;
+	float m_inv_h;
 };
 
 #endif
@@ -25,6 +25,8 @@
 #include "box2d/b2_distance_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // 1-D constrained system
 // m (v2 - v1) = lambda
 // v2 + (beta/h) * x1 + gamma * lambda = 0, gamma has units of inverse mass.
@@ -77,12 +79,12 @@ void b2DistanceJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	b2Vec2 cA = data.positions[m_indexA].c;
 	float aA = data.positions[m_indexA].a;
@@ -365,6 +367,66 @@ float b2DistanceJoint::GetCurrentLength() const
 	return length;
 }
 
+void b2DistanceJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_stiffness);
+	writer->Write(m_damping);
+	writer->Write(m_bias);
+	writer->Write(m_length);
+	writer->Write(m_minLength);
+	writer->Write(m_maxLength);
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_gamma);
+	writer->Write(m_impulse);
+	writer->Write(m_lowerImpulse);
+	writer->Write(m_upperImpulse);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_u);
+	writer->Write(m_rA);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_currentLength);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_softMass);
+	writer->Write(m_mass);
+}
+
+void b2DistanceJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_stiffness);
+	reader->Read(&m_damping);
+	reader->Read(&m_bias);
+	reader->Read(&m_length);
+	reader->Read(&m_minLength);
+	reader->Read(&m_maxLength);
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_gamma);
+	reader->Read(&m_impulse);
+	reader->Read(&m_lowerImpulse);
+	reader->Read(&m_upperImpulse);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_u);
+	reader->Read(&m_rA);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_currentLength);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_softMass);
+	reader->Read(&m_mass);
+}
+
 void b2DistanceJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
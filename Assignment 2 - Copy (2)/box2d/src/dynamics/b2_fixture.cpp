@@ -227,6 +227,17 @@ void b2Fixture::SetSensor(bool sensor)
 	{
 		m_body->SetAwake(true);
 		m_isSensor = sensor;
+
+		// Touching contacts of this fixture join or leave islands.
+		b2IslandManager* islandManager = &m_body->GetWorld()->m_islandManager;
+		for (b2ContactEdge* edge = m_body->GetContactList(); edge; edge = edge->next)
+		{
+			b2Contact* contact = edge->contact;
+			if (contact->GetFixtureA() == this || contact->GetFixtureB() == this)
+			{
+				islandManager->UpdateContact(contact);
+			}
+		}
 	}
 }
 
@@ -26,6 +26,8 @@
 #include "box2d/b2_body.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // Gear Joint:
 // C0 = (coordinate1 + ratio * coordinate2)_initial
 // C = (coordinate1 + ratio * coordinate2) - C0 = 0
@@ -69,9 +71,9 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 
 	// Get geometry of joint1
 	b2Transform xfA = m_bodyA->m_xf;
-	float aA = m_bodyA->m_sweep.a;
+	float aA = m_bodyA->GetAngle();
 	b2Transform xfC = m_bodyC->m_xf;
-	float aC = m_bodyC->m_sweep.a;
+	float aC = m_bodyC->GetAngle();
 
 	if (m_typeA == e_revoluteJoint)
 	{
@@ -104,9 +106,9 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 
 	// Get geometry of joint2
 	b2Transform xfB = m_bodyB->m_xf;
-	float aB = m_bodyB->m_sweep.a;
+	float aB = m_bodyB->GetAngle();
 	b2Transform xfD = m_bodyD->m_xf;
-	float aD = m_bodyD->m_sweep.a;
+	float aD = m_bodyD->GetAngle();
 
 	if (m_typeB == e_revoluteJoint)
 	{
@@ -144,18 +146,18 @@ void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 	m_indexB = m_bodyB->m_islandIndex;
 	m_indexC = m_bodyC->m_islandIndex;
 	m_indexD = m_bodyD->m_islandIndex;
-	m_lcA = m_bodyA->m_sweep.localCenter;
-	m_lcB = m_bodyB->m_sweep.localCenter;
-	m_lcC = m_bodyC->m_sweep.localCenter;
-	m_lcD = m_bodyD->m_sweep.localCenter;
-	m_mA = m_bodyA->m_invMass;
-	m_mB = m_bodyB->m_invMass;
-	m_mC = m_bodyC->m_invMass;
-	m_mD = m_bodyD->m_invMass;
-	m_iA = m_bodyA->m_invI;
-	m_iB = m_bodyB->m_invI;
-	m_iC = m_bodyC->m_invI;
-	m_iD = m_bodyD->m_invI;
+	m_lcA = m_bodyA->m_localCenter;
+	m_lcB = m_bodyB->m_localCenter;
+	m_lcC = m_bodyC->m_localCenter;
+	m_lcD = m_bodyD->m_localCenter;
+	m_mA = m_bodyA->GetInverseMass();
+	m_mB = m_bodyB->GetInverseMass();
+	m_mC = m_bodyC->GetInverseMass();
+	m_mD = m_bodyD->GetInverseMass();
+	m_iA = m_bodyA->GetInverseInertia();
+	m_iB = m_bodyB->GetInverseInertia();
+	m_iC = m_bodyC->GetInverseInertia();
+	m_iD = m_bodyD->GetInverseInertia();
 
 	float aA = data.positions[m_indexA].a;
 	b2Vec2 vA = data.velocities[m_indexA].v;
@@ -410,6 +412,86 @@ float b2GearJoint::GetRatio() const
 	return m_ratio;
 }
 
+void b2GearJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_typeA);
+	writer->Write(m_typeB);
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_localAnchorC);
+	writer->Write(m_localAnchorD);
+	writer->Write(m_localAxisC);
+	writer->Write(m_localAxisD);
+	writer->Write(m_referenceAngleA);
+	writer->Write(m_referenceAngleB);
+	writer->Write(m_constant);
+	writer->Write(m_ratio);
+	writer->Write(m_impulse);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_indexC);
+	writer->Write(m_indexD);
+	writer->Write(m_lcA);
+	writer->Write(m_lcB);
+	writer->Write(m_lcC);
+	writer->Write(m_lcD);
+	writer->Write(m_mA);
+	writer->Write(m_mB);
+	writer->Write(m_mC);
+	writer->Write(m_mD);
+	writer->Write(m_iA);
+	writer->Write(m_iB);
+	writer->Write(m_iC);
+	writer->Write(m_iD);
+	writer->Write(m_JvAC);
+	writer->Write(m_JvBD);
+	writer->Write(m_JwA);
+	writer->Write(m_JwB);
+	writer->Write(m_JwC);
+	writer->Write(m_JwD);
+	writer->Write(m_mass);
+}
+
+void b2GearJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_typeA);
+	reader->Read(&m_typeB);
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_localAnchorC);
+	reader->Read(&m_localAnchorD);
+	reader->Read(&m_localAxisC);
+	reader->Read(&m_localAxisD);
+	reader->Read(&m_referenceAngleA);
+	reader->Read(&m_referenceAngleB);
+	reader->Read(&m_constant);
+	reader->Read(&m_ratio);
+	reader->Read(&m_impulse);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_indexC);
+	reader->Read(&m_indexD);
+	reader->Read(&m_lcA);
+	reader->Read(&m_lcB);
+	reader->Read(&m_lcC);
+	reader->Read(&m_lcD);
+	reader->Read(&m_mA);
+	reader->Read(&m_mB);
+	reader->Read(&m_mC);
+	reader->Read(&m_mD);
+	reader->Read(&m_iA);
+	reader->Read(&m_iB);
+	reader->Read(&m_iC);
+	reader->Read(&m_iD);
+	reader->Read(&m_JvAC);
+	reader->Read(&m_JvBD);
+	reader->Read(&m_JwA);
+	reader->Read(&m_JwB);
+	reader->Read(&m_JwC);
+	reader->Read(&m_JwD);
+	reader->Read(&m_mass);
+}
+
 void b2GearJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
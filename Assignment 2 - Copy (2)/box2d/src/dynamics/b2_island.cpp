@@ -30,8 +30,11 @@
 #include "box2d/b2_world.h"
 
 #include "b2_island.h"
+#include "dynamics/b2_constraint_graph.h"
 #include "dynamics/b2_contact_solver.h"
 
+#include <new>
+
 /*
 Position Correction Notes
 =========================
@@ -155,7 +158,8 @@ b2Island::b2Island(
 	int32 contactCapacity,
 	int32 jointCapacity,
 	b2StackAllocator* allocator,
-	b2ContactListener* listener)
+	b2ContactListener* listener,
+	int32 staticSlotCount)
 {
 	m_bodyCapacity = bodyCapacity;
 	m_contactCapacity = contactCapacity;
@@ -163,16 +167,23 @@ b2Island::b2Island(
 	m_bodyCount = 0;
 	m_contactCount = 0;
 	m_jointCount = 0;
+	m_staticSlotCount = staticSlotCount;
 
 	m_allocator = allocator;
 	m_listener = listener;
+	m_states = nullptr;
+	m_impulses = nullptr;
+	m_threadPool = nullptr;
+	m_graphColoring = false;
+	m_splitPending = false;
+	m_sleepReady = false;
 
 	m_bodies = (b2Body**)m_allocator->Allocate(bodyCapacity * sizeof(b2Body*));
 	m_contacts = (b2Contact**)m_allocator->Allocate(contactCapacity	 * sizeof(b2Contact*));
 	m_joints = (b2Joint**)m_allocator->Allocate(jointCapacity * sizeof(b2Joint*));
 
-	m_velocities = (b2Velocity*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Velocity));
-	m_positions = (b2Position*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Position));
+	m_velocities = (b2Velocity*)m_allocator->Allocate((m_staticSlotCount + m_bodyCapacity) * sizeof(b2Velocity));
+	m_positions = (b2Position*)m_allocator->Allocate((m_staticSlotCount + m_bodyCapacity) * sizeof(b2Position));
 }
 
 b2Island::~b2Island()
@@ -191,25 +202,40 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 
 	float h = step.dt;
 
+	// The world lays out island bodies in island order, so the body state of this
+	// island is the slot range [base, base + m_bodyCount).
+	b2BodyStates* states = m_states;
+	int32 base = m_bodies[0]->m_stateIndex;
+	b2Vec2* centers = states->centers + base;
+	float* angles = states->angles + base;
+	b2Vec2* linearVelocities = states->linearVelocities + base;
+	float* angularVelocities = states->angularVelocities + base;
+	const b2Vec2* forces = states->forces + base;
+	const float* torques = states->torques + base;
+	const float* invMasses = states->invMasses + base;
+	const float* invInertias = states->invInertias + base;
+
 	// Integrate velocities and apply damping. Initialize the body state.
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* b = m_bodies[i];
+		b2Assert(b->m_stateIndex == base + i);
 
-		b2Vec2 c = b->m_sweep.c;
-		float a = b->m_sweep.a;
-		b2Vec2 v = b->m_linearVelocity;
-		float w = b->m_angularVelocity;
+		b2Vec2 c = centers[i];
+		float a = angles[i];
+		b2Vec2 v = linearVelocities[i];
+		float w = angularVelocities[i];
 
 		// Store positions for continuous collision.
-		b->m_sweep.c0 = b->m_sweep.c;
-		b->m_sweep.a0 = b->m_sweep.a;
+		b->m_center0 = c;
+		b->m_angle0 = a;
 
-		if (b->m_type == b2_dynamicBody)
+		// The soft step solver integrates velocities in each sub-step.
+		if (b->m_type == b2_dynamicBody && step.subStepCount == 0)
 		{
 			// Integrate velocities.
-			v += h * b->m_invMass * (b->m_gravityScale * b->m_mass * gravity + b->m_force);
-			w += h * b->m_invI * b->m_torque;
+			v += h * invMasses[i] * (b->m_gravityScale * b->m_mass * gravity + forces[i]);
+			w += h * invInertias[i] * torques[i];
 
 			// Apply damping.
 			// ODE: dv/dt + c * v = 0
@@ -222,10 +248,11 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			w *= 1.0f / (1.0f + h * b->m_angularDamping);
 		}
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		int32 index = m_staticSlotCount + i;
+		m_positions[index].c = c;
+		m_positions[index].a = a;
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
 	}
 
 	timer.Reset();
@@ -236,9 +263,10 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	solverData.positions = m_positions;
 	solverData.velocities = m_velocities;
 
-	// Initialize velocity constraints.
+	// Initialize velocity constraints. The wide solver does not apply to colored islands.
 	b2ContactSolverDef contactSolverDef;
 	contactSolverDef.step = step;
+	contactSolverDef.step.wideContactSolver = step.wideContactSolver && m_graphColoring == false;
 	contactSolverDef.contacts = m_contacts;
 	contactSolverDef.count = m_contactCount;
 	contactSolverDef.positions = m_positions;
@@ -248,98 +276,164 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	b2ContactSolver contactSolver(&contactSolverDef);
 	contactSolver.InitializeVelocityConstraints();
 
-	if (step.warmStarting)
+	profile->colorCount = 0.0f;
+	for (int32 i = 0; i < b2_graphColorCount; ++i)
 	{
-		contactSolver.WarmStart();
+		profile->colorSizes[i] = 0.0f;
 	}
-	
-	for (int32 i = 0; i < m_jointCount; ++i)
+	profile->colorOverflow = 0.0f;
+	profile->wideBatchCount = contactSolver.m_wideCount;
+	profile->wideRemainderCount = contactSolver.m_remainderCount;
+
+	bool positionSolved = false;
+	if (step.subStepCount > 0)
 	{
-		m_joints[i]->InitVelocityConstraints(solverData);
-	}
+		profile->solveInit = timer.GetMilliseconds();
 
-	profile->solveInit = timer.GetMilliseconds();
+		timer.Reset();
+		positionSolved = SolveSoft(step, gravity, &contactSolver);
+		profile->solveVelocity = timer.GetMilliseconds();
 
-	// Solve velocity constraints
-	timer.Reset();
-	for (int32 i = 0; i < step.velocityIterations; ++i)
+		timer.Reset();
+	}
+	else
 	{
-		for (int32 j = 0; j < m_jointCount; ++j)
+		b2ConstraintGraph* graph = nullptr;
+		if (m_graphColoring)
 		{
-			m_joints[j]->SolveVelocityConstraints(solverData);
+			void* mem = m_allocator->Allocate(sizeof(b2ConstraintGraph));
+			graph = new (mem) b2ConstraintGraph(&contactSolver, m_joints, m_jointCount,
+				m_staticSlotCount + m_bodyCount, m_allocator, m_threadPool);
+			graph->GetProfile(profile);
 		}
 
-		contactSolver.SolveVelocityConstraints();
-	}
+		if (step.warmStarting)
+		{
+			if (graph)
+			{
+				graph->WarmStart();
+			}
+			else
+			{
+				contactSolver.WarmStart();
+			}
+		}
 
-	// Store impulses for warm starting
-	contactSolver.StoreImpulses();
-	profile->solveVelocity = timer.GetMilliseconds();
+		for (int32 i = 0; i < m_jointCount; ++i)
+		{
+			m_joints[i]->InitVelocityConstraints(solverData);
+		}
 
-	// Integrate positions
-	for (int32 i = 0; i < m_bodyCount; ++i)
-	{
-		b2Vec2 c = m_positions[i].c;
-		float a = m_positions[i].a;
-		b2Vec2 v = m_velocities[i].v;
-		float w = m_velocities[i].w;
+		profile->solveInit = timer.GetMilliseconds();
 
-		// Check for large velocities
-		b2Vec2 translation = h * v;
-		if (b2Dot(translation, translation) > b2_maxTranslationSquared)
+		// Solve velocity constraints
+		timer.Reset();
+		for (int32 i = 0; i < step.velocityIterations; ++i)
 		{
-			float ratio = b2_maxTranslation / translation.Length();
-			v *= ratio;
+			if (graph)
+			{
+				graph->SolveVelocityConstraints(solverData);
+				continue;
+			}
+
+			for (int32 j = 0; j < m_jointCount; ++j)
+			{
+				m_joints[j]->SolveVelocityConstraints(solverData);
+			}
+
+			contactSolver.SolveVelocityConstraints();
 		}
 
-		float rotation = h * w;
-		if (rotation * rotation > b2_maxRotationSquared)
+		// Store impulses for warm starting
+		contactSolver.StoreImpulses();
+		profile->solveVelocity = timer.GetMilliseconds();
+
+		// Integrate positions
+		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
-			float ratio = b2_maxRotation / b2Abs(rotation);
-			w *= ratio;
-		}
+			int32 index = m_staticSlotCount + i;
+			b2Vec2 c = m_positions[index].c;
+			float a = m_positions[index].a;
+			b2Vec2 v = m_velocities[index].v;
+			float w = m_velocities[index].w;
+
+			// Check for large velocities
+			b2Vec2 translation = h * v;
+			if (b2Dot(translation, translation) > b2_maxTranslationSquared)
+			{
+				float ratio = b2_maxTranslation / translation.Length();
+				v *= ratio;
+			}
 
-		// Integrate
-		c += h * v;
-		a += h * w;
+			float rotation = h * w;
+			if (rotation * rotation > b2_maxRotationSquared)
+			{
+				float ratio = b2_maxRotation / b2Abs(rotation);
+				w *= ratio;
+			}
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
-	}
+			// Integrate
+			c += h * v;
+			a += h * w;
 
-	// Solve position constraints
-	timer.Reset();
-	bool positionSolved = false;
-	for (int32 i = 0; i < step.positionIterations; ++i)
-	{
-		bool contactsOkay = contactSolver.SolvePositionConstraints();
+			m_positions[index].c = c;
+			m_positions[index].a = a;
+			m_velocities[index].v = v;
+			m_velocities[index].w = w;
+		}
 
-		bool jointsOkay = true;
-		for (int32 j = 0; j < m_jointCount; ++j)
+		// Solve position constraints
+		timer.Reset();
+		for (int32 i = 0; i < step.positionIterations; ++i)
 		{
-			bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
-			jointsOkay = jointsOkay && jointOkay;
+			if (graph)
+			{
+				if (graph->SolvePositionConstraints(solverData))
+				{
+					positionSolved = true;
+					break;
+				}
+
+				continue;
+			}
+
+			bool contactsOkay = contactSolver.SolvePositionConstraints();
+
+			bool jointsOkay = true;
+			for (int32 j = 0; j < m_jointCount; ++j)
+			{
+				bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
+				jointsOkay = jointsOkay && jointOkay;
+			}
+
+			if (contactsOkay && jointsOkay)
+			{
+				// Exit early if the position errors are small.
+				positionSolved = true;
+				break;
+			}
 		}
 
-		if (contactsOkay && jointsOkay)
+		if (graph)
 		{
-			// Exit early if the position errors are small.
-			positionSolved = true;
-			break;
+			graph->~b2ConstraintGraph();
+			m_allocator->Free(graph);
 		}
 	}
 
 	// Copy state buffers back to the bodies
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Body* body = m_bodies[i];
-		body->m_sweep.c = m_positions[i].c;
-		body->m_sweep.a = m_positions[i].a;
-		body->m_linearVelocity = m_velocities[i].v;
-		body->m_angularVelocity = m_velocities[i].w;
-		body->SynchronizeTransform();
+		int32 index = m_staticSlotCount + i;
+		centers[i] = m_positions[index].c;
+		angles[i] = m_positions[index].a;
+		linearVelocities[i] = m_velocities[index].v;
+		angularVelocities[i] = m_velocities[index].w;
+	}
+
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		m_bodies[i]->SynchronizeTransform();
 	}
 
 	profile->solvePosition = timer.GetMilliseconds();
@@ -362,8 +456,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			}
 
 			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+				angularVelocities[i] * angularVelocities[i] > angTolSqr ||
+				b2Dot(linearVelocities[i], linearVelocities[i]) > linTolSqr)
 			{
 				b->m_sleepTime = 0.0f;
 				minSleepTime = 0.0f;
@@ -375,7 +469,8 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			}
 		}
 
-		if (minSleepTime >= b2_timeToSleep && positionSolved)
+		m_sleepReady = minSleepTime >= b2_timeToSleep && positionSolved;
+		if (m_sleepReady && m_splitPending == false)
 		{
 			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
@@ -386,19 +481,158 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	}
 }
 
+// Soft step: sub-step the island with one soft velocity iteration and one relax
+// iteration per sub-step. Returns false if the joints have large position errors.
+bool b2Island::SolveSoft(const b2TimeStep& step, const b2Vec2& gravity, b2ContactSolver* contactSolver)
+{
+	int32 subStepCount = step.subStepCount;
+	float h = step.dt / subStepCount;
+
+	b2TimeStep subStep = step;
+	subStep.dt = h;
+	subStep.inv_dt = h > 0.0f ? 1.0f / h : 0.0f;
+	subStep.velocityIterations = 1;
+	subStep.positionIterations = 1;
+
+	b2SolverData solverData;
+	solverData.step = subStep;
+	solverData.positions = m_positions;
+	solverData.velocities = m_velocities;
+
+	int32 base = m_bodies[0]->m_stateIndex;
+	const b2Vec2* forces = m_states->forces + base;
+	const float* torques = m_states->torques + base;
+	const float* invMasses = m_states->invMasses + base;
+	const float* invInertias = m_states->invInertias + base;
+	const float* angles0 = m_states->angles + base;
+
+	// Rotation of each body since the contact constraints were initialized. Static
+	// slots keep the identity.
+	int32 slotCount = m_staticSlotCount + m_bodyCount;
+	b2Rot* deltaRotations = (b2Rot*)m_allocator->Allocate(slotCount * sizeof(b2Rot));
+	for (int32 i = 0; i < slotCount; ++i)
+	{
+		deltaRotations[i].SetIdentity();
+	}
+
+	contactSolver->PrepareSoftConstraints(h);
+
+	bool jointsOkay = true;
+	for (int32 subStepIndex = 0; subStepIndex < subStepCount; ++subStepIndex)
+	{
+		// Integrate velocities and apply damping.
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			b2Body* b = m_bodies[i];
+			if (b->m_type != b2_dynamicBody)
+			{
+				continue;
+			}
+
+			int32 index = m_staticSlotCount + i;
+			b2Vec2 v = m_velocities[index].v;
+			float w = m_velocities[index].w;
+
+			v += h * invMasses[i] * (b->m_gravityScale * b->m_mass * gravity + forces[i]);
+			w += h * invInertias[i] * torques[i];
+
+			v *= 1.0f / (1.0f + h * b->m_linearDamping);
+			w *= 1.0f / (1.0f + h * b->m_angularDamping);
+
+			m_velocities[index].v = v;
+			m_velocities[index].w = w;
+		}
+
+		// Impulses carry over between sub-steps, so only the first sub-step uses the
+		// step ratio and the warm starting flag.
+		if (subStepIndex > 0)
+		{
+			solverData.step.dtRatio = 1.0f;
+			solverData.step.warmStarting = true;
+		}
+
+		for (int32 i = 0; i < m_jointCount; ++i)
+		{
+			m_joints[i]->InitVelocityConstraints(solverData);
+		}
+
+		contactSolver->WarmStart();
+
+		for (int32 i = 0; i < m_jointCount; ++i)
+		{
+			m_joints[i]->SolveVelocityConstraints(solverData);
+		}
+
+		contactSolver->SolveSoftConstraints(deltaRotations, true);
+
+		// Integrate positions
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			int32 index = m_staticSlotCount + i;
+			b2Vec2 v = m_velocities[index].v;
+			float w = m_velocities[index].w;
+
+			// Check for large velocities
+			b2Vec2 translation = h * v;
+			if (b2Dot(translation, translation) > b2_maxTranslationSquared)
+			{
+				float ratio = b2_maxTranslation / translation.Length();
+				v *= ratio;
+			}
+
+			float rotation = h * w;
+			if (rotation * rotation > b2_maxRotationSquared)
+			{
+				float ratio = b2_maxRotation / b2Abs(rotation);
+				w *= ratio;
+			}
+
+			m_positions[index].c += h * v;
+			m_positions[index].a += h * w;
+			m_velocities[index].v = v;
+			m_velocities[index].w = w;
+		}
+
+		jointsOkay = true;
+		for (int32 i = 0; i < m_jointCount; ++i)
+		{
+			bool jointOkay = m_joints[i]->SolvePositionConstraints(solverData);
+			jointsOkay = jointsOkay && jointOkay;
+		}
+
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			int32 index = m_staticSlotCount + i;
+			deltaRotations[index].Set(m_positions[index].a - angles0[i]);
+		}
+
+		// Relax: remove the velocity added by pushing apart overlapping bodies.
+		contactSolver->SolveSoftConstraints(deltaRotations, false);
+	}
+
+	contactSolver->ApplyRestitution();
+	contactSolver->StoreImpulses();
+
+	m_allocator->Free(deltaRotations);
+
+	return jointsOkay;
+}
+
 void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB)
 {
+	b2Assert(m_staticSlotCount == 0);
 	b2Assert(toiIndexA < m_bodyCount);
 	b2Assert(toiIndexB < m_bodyCount);
 
-	// Initialize the body state.
+	// Initialize the body state. TOI islands are not laid out in slot order.
+	b2BodyStates* states = m_states;
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Body* b = m_bodies[i];
-		m_positions[i].c = b->m_sweep.c;
-		m_positions[i].a = b->m_sweep.a;
-		m_velocities[i].v = b->m_linearVelocity;
-		m_velocities[i].w = b->m_angularVelocity;
+		int32 slot = m_bodies[i]->m_stateIndex;
+		m_positions[i].c = states->centers[slot];
+		m_positions[i].a = states->angles[slot];
+		m_velocities[i].v = states->linearVelocities[slot];
+		m_velocities[i].w = states->angularVelocities[slot];
 	}
 
 	b2ContactSolverDef contactSolverDef;
@@ -454,10 +688,10 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 #endif
 
 	// Leap of faith to new safe state.
-	m_bodies[toiIndexA]->m_sweep.c0 = m_positions[toiIndexA].c;
-	m_bodies[toiIndexA]->m_sweep.a0 = m_positions[toiIndexA].a;
-	m_bodies[toiIndexB]->m_sweep.c0 = m_positions[toiIndexB].c;
-	m_bodies[toiIndexB]->m_sweep.a0 = m_positions[toiIndexB].a;
+	m_bodies[toiIndexA]->m_center0 = m_positions[toiIndexA].c;
+	m_bodies[toiIndexA]->m_angle0 = m_positions[toiIndexA].a;
+	m_bodies[toiIndexB]->m_center0 = m_positions[toiIndexB].c;
+	m_bodies[toiIndexB]->m_angle0 = m_positions[toiIndexB].a;
 
 	// No warm starting is needed for TOI events because warm
 	// starting impulses were applied in the discrete solver.
@@ -508,10 +742,11 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 
 		// Sync bodies
 		b2Body* body = m_bodies[i];
-		body->m_sweep.c = c;
-		body->m_sweep.a = a;
-		body->m_linearVelocity = v;
-		body->m_angularVelocity = w;
+		int32 slot = body->m_stateIndex;
+		states->centers[slot] = c;
+		states->angles[slot] = a;
+		states->linearVelocities[slot] = v;
+		states->angularVelocities[slot] = w;
 		body->SynchronizeTransform();
 	}
 
@@ -520,7 +755,7 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 
 void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 {
-	if (m_listener == nullptr)
+	if (m_listener == nullptr && m_impulses == nullptr)
 	{
 		return;
 	}
@@ -539,6 +774,12 @@ void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 			impulse.tangentImpulses[j] = vc->points[j].tangentImpulse;
 		}
 
+		if (m_impulses)
+		{
+			m_impulses[i] = impulse;
+			continue;
+		}
+
 		m_listener->PostSolve(c, &impulse);
 	}
 }
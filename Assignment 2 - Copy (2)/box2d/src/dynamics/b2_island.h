@@ -30,7 +30,10 @@
 class b2Contact;
 class b2Joint;
 class b2StackAllocator;
+class b2ThreadPool;
 class b2ContactListener;
+class b2ContactSolver;
+struct b2ContactImpulse;
 struct b2ContactVelocityConstraint;
 struct b2Profile;
 
@@ -39,7 +42,7 @@ class b2Island
 {
 public:
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
-			b2StackAllocator* allocator, b2ContactListener* listener);
+			b2StackAllocator* allocator, b2ContactListener* listener, int32 staticSlotCount = 0);
 	~b2Island();
 
 	void Clear()
@@ -53,14 +56,29 @@ public:
 
 	void SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB);
 
+	bool SolveSoft(const b2TimeStep& step, const b2Vec2& gravity, b2ContactSolver* contactSolver);
+
 	void Add(b2Body* body)
 	{
 		b2Assert(m_bodyCount < m_bodyCapacity);
-		body->m_islandIndex = m_bodyCount;
+		body->m_islandIndex = m_staticSlotCount + m_bodyCount;
 		m_bodies[m_bodyCount] = body;
 		++m_bodyCount;
 	}
 
+	// Load a static body that owns a shared solver slot. Islands solved in parallel
+	// share static bodies, so these are never added to m_bodies or written back.
+	void AddStatic(const b2Body* body)
+	{
+		int32 slot = body->m_islandIndex;
+		int32 stateIndex = body->m_stateIndex;
+		b2Assert(0 <= slot && slot < m_staticSlotCount);
+		m_positions[slot].c = m_states->centers[stateIndex];
+		m_positions[slot].a = m_states->angles[stateIndex];
+		m_velocities[slot].v = m_states->linearVelocities[stateIndex];
+		m_velocities[slot].w = m_states->angularVelocities[stateIndex];
+	}
+
 	void Add(b2Contact* contact)
 	{
 		b2Assert(m_contactCount < m_contactCapacity);
@@ -82,9 +100,28 @@ public:
 	b2Contact** m_contacts;
 	b2Joint** m_joints;
 
+	// Persistent body state owned by the world.
+	b2BodyStates* m_states;
+
+	// Solver state. Static slots come first, island bodies start at m_staticSlotCount.
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
 
+	// If set, Report stores the impulses here instead of calling the listener.
+	b2ContactImpulse* m_impulses;
+
+	// If set, the constraints are solved by color, see b2ConstraintGraph. The colors are
+	// solved on the thread pool if there is one.
+	bool m_graphColoring;
+	b2ThreadPool* m_threadPool;
+
+	// Set by the world if the island may have come apart. It is split instead of put
+	// to sleep, see b2IslandManager.
+	bool m_splitPending;
+
+	// Set by Solve if all bodies came to rest.
+	bool m_sleepReady;
+
 	int32 m_bodyCount;
 	int32 m_jointCount;
 	int32 m_contactCount;
@@ -92,6 +129,7 @@ public:
 	int32 m_bodyCapacity;
 	int32 m_contactCapacity;
 	int32 m_jointCapacity;
+	int32 m_staticSlotCount;
 };
 
 #endif
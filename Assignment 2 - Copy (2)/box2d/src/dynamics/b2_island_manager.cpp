@@ -0,0 +1,773 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "box2d/b2_island_manager.h"
+#include "box2d/b2_body.h"
+#include "box2d/b2_contact.h"
+#include "box2d/b2_fixture.h"
+#include "box2d/b2_joint.h"
+#include "common/b2_snapshot.h"
+
+#include <string.h>
+
+b2IslandManager::b2IslandManager()
+{
+	m_islands = nullptr;
+	m_islandCapacity = 0;
+	m_islandCount = 0;
+	m_freeList = b2_nullIsland;
+
+	m_awakeIslands = nullptr;
+	m_awakeCount = 0;
+	m_awakeCapacity = 0;
+}
+
+b2IslandManager::~b2IslandManager()
+{
+	if (m_islands)
+	{
+		b2Free(m_islands);
+	}
+
+	if (m_awakeIslands)
+	{
+		b2Free(m_awakeIslands);
+	}
+}
+
+int32 b2IslandManager::AllocateIsland()
+{
+	if (m_freeList == b2_nullIsland)
+	{
+		b2PersistentIsland* oldIslands = m_islands;
+		int32 oldCapacity = m_islandCapacity;
+		m_islandCapacity = b2Max(2 * oldCapacity, 16);
+		m_islands = (b2PersistentIsland*)b2Alloc(m_islandCapacity * sizeof(b2PersistentIsland));
+		if (oldIslands)
+		{
+			memcpy(m_islands, oldIslands, oldCapacity * sizeof(b2PersistentIsland));
+			b2Free(oldIslands);
+		}
+
+		// Build a linked list for the free list. Free islands have a negative body count.
+		for (int32 i = oldCapacity; i < m_islandCapacity; ++i)
+		{
+			m_islands[i].next = i + 1;
+			m_islands[i].bodyCount = -1;
+		}
+		m_islands[m_islandCapacity - 1].next = b2_nullIsland;
+		m_freeList = oldCapacity;
+	}
+
+	int32 islandId = m_freeList;
+	b2PersistentIsland* island = m_islands + islandId;
+	m_freeList = island->next;
+
+	island->bodyList = nullptr;
+	island->contactList = nullptr;
+	island->jointList = nullptr;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->jointCount = 0;
+	island->removeCount = 0;
+	island->awakeIndex = b2_nullIsland;
+	island->next = b2_nullIsland;
+	++m_islandCount;
+	return islandId;
+}
+
+void b2IslandManager::FreeIsland(int32 islandId)
+{
+	SleepIsland(islandId);
+
+	b2PersistentIsland* island = m_islands + islandId;
+	b2Assert(island->bodyCount == 0 && island->contactCount == 0 && island->jointCount == 0);
+	island->bodyCount = -1;
+	island->next = m_freeList;
+	m_freeList = islandId;
+	--m_islandCount;
+}
+
+void b2IslandManager::WakeIsland(int32 islandId)
+{
+	if (islandId == b2_nullIsland)
+	{
+		return;
+	}
+
+	b2PersistentIsland* island = m_islands + islandId;
+	b2Assert(island->bodyCount > 0);
+	if (island->awakeIndex != b2_nullIsland)
+	{
+		return;
+	}
+
+	if (m_awakeCount == m_awakeCapacity)
+	{
+		int32* oldAwake = m_awakeIslands;
+		m_awakeCapacity = b2Max(2 * m_awakeCapacity, 16);
+		m_awakeIslands = (int32*)b2Alloc(m_awakeCapacity * sizeof(int32));
+		if (oldAwake)
+		{
+			memcpy(m_awakeIslands, oldAwake, m_awakeCount * sizeof(int32));
+			b2Free(oldAwake);
+		}
+	}
+
+	island->awakeIndex = m_awakeCount;
+	m_awakeIslands[m_awakeCount++] = islandId;
+}
+
+void b2IslandManager::SleepIsland(int32 islandId)
+{
+	b2PersistentIsland* island = m_islands + islandId;
+	int32 index = island->awakeIndex;
+	if (index == b2_nullIsland)
+	{
+		return;
+	}
+
+	int32 movedId = m_awakeIslands[--m_awakeCount];
+	m_awakeIslands[index] = movedId;
+	m_islands[movedId].awakeIndex = index;
+	island->awakeIndex = b2_nullIsland;
+}
+
+void b2IslandManager::AddBody(b2Body* body)
+{
+	b2Assert(body->m_islandId == b2_nullIsland);
+	b2Assert(body->m_type != b2_staticBody && body->IsEnabled());
+
+	int32 islandId = AllocateIsland();
+	b2PersistentIsland* island = m_islands + islandId;
+	island->bodyList = body;
+	island->bodyCount = 1;
+
+	body->m_islandId = islandId;
+	body->m_islandPrev = nullptr;
+	body->m_islandNext = nullptr;
+
+	if (body->IsAwake())
+	{
+		WakeIsland(islandId);
+	}
+}
+
+void b2IslandManager::RemoveBody(b2Body* body)
+{
+	int32 islandId = body->m_islandId;
+	if (islandId == b2_nullIsland)
+	{
+		return;
+	}
+
+	b2PersistentIsland* island = m_islands + islandId;
+	if (body->m_islandPrev)
+	{
+		body->m_islandPrev->m_islandNext = body->m_islandNext;
+	}
+
+	if (body->m_islandNext)
+	{
+		body->m_islandNext->m_islandPrev = body->m_islandPrev;
+	}
+
+	if (body == island->bodyList)
+	{
+		island->bodyList = body->m_islandNext;
+	}
+
+	body->m_islandId = b2_nullIsland;
+	body->m_islandPrev = nullptr;
+	body->m_islandNext = nullptr;
+
+	island->bodyCount -= 1;
+	island->removeCount += 1;
+
+	if (island->bodyCount == 0)
+	{
+		FreeIsland(islandId);
+	}
+}
+
+void b2IslandManager::AddToIsland(int32 islandId, b2Contact* contact)
+{
+	b2PersistentIsland* island = m_islands + islandId;
+	contact->m_islandId = islandId;
+	contact->m_islandPrev = nullptr;
+	contact->m_islandNext = island->contactList;
+	if (island->contactList)
+	{
+		island->contactList->m_islandPrev = contact;
+	}
+	island->contactList = contact;
+	island->contactCount += 1;
+}
+
+void b2IslandManager::AddToIsland(int32 islandId, b2Joint* joint)
+{
+	b2PersistentIsland* island = m_islands + islandId;
+	joint->m_islandId = islandId;
+	joint->m_islandPrev = nullptr;
+	joint->m_islandNext = island->jointList;
+	if (island->jointList)
+	{
+		island->jointList->m_islandPrev = joint;
+	}
+	island->jointList = joint;
+	island->jointCount += 1;
+}
+
+// Relabel the members of the smaller island and splice its lists in front of
+// the lists of the larger one.
+int32 b2IslandManager::MergeIslands(int32 islandIdA, int32 islandIdB)
+{
+	b2Assert(islandIdA != islandIdB);
+
+	int32 bigId = islandIdA;
+	int32 smallId = islandIdB;
+	if (m_islands[bigId].bodyCount < m_islands[smallId].bodyCount)
+	{
+		bigId = islandIdB;
+		smallId = islandIdA;
+	}
+
+	b2PersistentIsland* big = m_islands + bigId;
+	b2PersistentIsland* small = m_islands + smallId;
+
+	if (small->bodyList)
+	{
+		b2Body* tail = small->bodyList;
+		tail->m_islandId = bigId;
+		while (tail->m_islandNext)
+		{
+			tail = tail->m_islandNext;
+			tail->m_islandId = bigId;
+		}
+
+		tail->m_islandNext = big->bodyList;
+		if (big->bodyList)
+		{
+			big->bodyList->m_islandPrev = tail;
+		}
+		big->bodyList = small->bodyList;
+	}
+
+	if (small->contactList)
+	{
+		b2Contact* tail = small->contactList;
+		tail->m_islandId = bigId;
+		while (tail->m_islandNext)
+		{
+			tail = tail->m_islandNext;
+			tail->m_islandId = bigId;
+		}
+
+		tail->m_islandNext = big->contactList;
+		if (big->contactList)
+		{
+			big->contactList->m_islandPrev = tail;
+		}
+		big->contactList = small->contactList;
+	}
+
+	if (small->jointList)
+	{
+		b2Joint* tail = small->jointList;
+		tail->m_islandId = bigId;
+		while (tail->m_islandNext)
+		{
+			tail = tail->m_islandNext;
+			tail->m_islandId = bigId;
+		}
+
+		tail->m_islandNext = big->jointList;
+		if (big->jointList)
+		{
+			big->jointList->m_islandPrev = tail;
+		}
+		big->jointList = small->jointList;
+	}
+
+	big->bodyCount += small->bodyCount;
+	big->contactCount += small->contactCount;
+	big->jointCount += small->jointCount;
+	big->removeCount += small->removeCount;
+
+	bool awake = small->awakeIndex != b2_nullIsland;
+
+	small->bodyList = nullptr;
+	small->contactList = nullptr;
+	small->jointList = nullptr;
+	small->bodyCount = 0;
+	small->contactCount = 0;
+	small->jointCount = 0;
+	FreeIsland(smallId);
+
+	if (awake)
+	{
+		WakeIsland(bigId);
+	}
+
+	return bigId;
+}
+
+void b2IslandManager::LinkContact(b2Contact* contact)
+{
+	int32 islandIdA = contact->GetFixtureA()->GetBody()->m_islandId;
+	int32 islandIdB = contact->GetFixtureB()->GetBody()->m_islandId;
+	b2Assert(islandIdA != b2_nullIsland || islandIdB != b2_nullIsland);
+
+	int32 islandId = islandIdA != b2_nullIsland ? islandIdA : islandIdB;
+	if (islandIdA != b2_nullIsland && islandIdB != b2_nullIsland && islandIdA != islandIdB)
+	{
+		islandId = MergeIslands(islandIdA, islandIdB);
+	}
+
+	AddToIsland(islandId, contact);
+}
+
+void b2IslandManager::UnlinkContact(b2Contact* contact)
+{
+	int32 islandId = contact->m_islandId;
+	b2Assert(islandId != b2_nullIsland);
+	b2PersistentIsland* island = m_islands + islandId;
+
+	if (contact->m_islandPrev)
+	{
+		contact->m_islandPrev->m_islandNext = contact->m_islandNext;
+	}
+
+	if (contact->m_islandNext)
+	{
+		contact->m_islandNext->m_islandPrev = contact->m_islandPrev;
+	}
+
+	if (contact == island->contactList)
+	{
+		island->contactList = contact->m_islandNext;
+	}
+
+	contact->m_islandId = b2_nullIsland;
+	contact->m_islandPrev = nullptr;
+	contact->m_islandNext = nullptr;
+
+	island->contactCount -= 1;
+	island->removeCount += 1;
+}
+
+void b2IslandManager::UpdateContact(b2Contact* contact)
+{
+	// Only solid touching contacts connect bodies.
+	bool link = contact->IsTouching() &&
+		contact->GetFixtureA()->IsSensor() == false &&
+		contact->GetFixtureB()->IsSensor() == false;
+
+	if (link && contact->m_islandId == b2_nullIsland)
+	{
+		LinkContact(contact);
+	}
+	else if (link == false && contact->m_islandId != b2_nullIsland)
+	{
+		UnlinkContact(contact);
+	}
+}
+
+void b2IslandManager::RemoveContact(b2Contact* contact)
+{
+	if (contact->m_islandId != b2_nullIsland)
+	{
+		UnlinkContact(contact);
+	}
+}
+
+void b2IslandManager::LinkJoint(b2Joint* joint)
+{
+	b2Assert(joint->m_islandId == b2_nullIsland);
+
+	b2Body* bodyA = joint->m_bodyA;
+	b2Body* bodyB = joint->m_bodyB;
+
+	// Joints connected to disabled bodies are not simulated.
+	if (bodyA->IsEnabled() == false || bodyB->IsEnabled() == false)
+	{
+		return;
+	}
+
+	int32 islandIdA = bodyA->m_islandId;
+	int32 islandIdB = bodyB->m_islandId;
+	if (islandIdA == b2_nullIsland && islandIdB == b2_nullIsland)
+	{
+		return;
+	}
+
+	int32 islandId = islandIdA != b2_nullIsland ? islandIdA : islandIdB;
+	if (islandIdA != b2_nullIsland && islandIdB != b2_nullIsland && islandIdA != islandIdB)
+	{
+		islandId = MergeIslands(islandIdA, islandIdB);
+	}
+
+	AddToIsland(islandId, joint);
+}
+
+void b2IslandManager::UnlinkJoint(b2Joint* joint)
+{
+	int32 islandId = joint->m_islandId;
+	if (islandId == b2_nullIsland)
+	{
+		return;
+	}
+
+	b2PersistentIsland* island = m_islands + islandId;
+
+	if (joint->m_islandPrev)
+	{
+		joint->m_islandPrev->m_islandNext = joint->m_islandNext;
+	}
+
+	if (joint->m_islandNext)
+	{
+		joint->m_islandNext->m_islandPrev = joint->m_islandPrev;
+	}
+
+	if (joint == island->jointList)
+	{
+		island->jointList = joint->m_islandNext;
+	}
+
+	joint->m_islandId = b2_nullIsland;
+	joint->m_islandPrev = nullptr;
+	joint->m_islandNext = nullptr;
+
+	island->jointCount -= 1;
+	island->removeCount += 1;
+}
+
+// Find the connected components with a depth first search that is limited to the
+// members of this island. Contacts and joints keep the old island id until they
+// are moved, which marks them as pending.
+void b2IslandManager::SplitIsland(int32 islandId)
+{
+	b2PersistentIsland* island = m_islands + islandId;
+	bool awake = island->awakeIndex != b2_nullIsland;
+
+	int32 bodyCount = island->bodyCount;
+	b2Body** bodies = (b2Body**)b2Alloc(2 * bodyCount * sizeof(b2Body*));
+	b2Body** stack = bodies + bodyCount;
+
+	int32 index = 0;
+	for (b2Body* b = island->bodyList; b; b = b->m_islandNext)
+	{
+		bodies[index++] = b;
+		b->m_islandId = b2_nullIsland;
+	}
+	b2Assert(index == bodyCount);
+
+	island->bodyList = nullptr;
+	island->contactList = nullptr;
+	island->jointList = nullptr;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->jointCount = 0;
+
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		b2Body* seed = bodies[i];
+		if (seed->m_islandId != b2_nullIsland)
+		{
+			continue;
+		}
+
+		int32 newId = AllocateIsland();
+
+		int32 stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_islandId = newId;
+
+		while (stackCount > 0)
+		{
+			b2Body* b = stack[--stackCount];
+
+			b2PersistentIsland* newIsland = m_islands + newId;
+			b->m_islandPrev = nullptr;
+			b->m_islandNext = newIsland->bodyList;
+			if (newIsland->bodyList)
+			{
+				newIsland->bodyList->m_islandPrev = b;
+			}
+			newIsland->bodyList = b;
+			newIsland->bodyCount += 1;
+
+			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				b2Contact* contact = ce->contact;
+				if (contact->m_islandId != islandId)
+				{
+					continue;
+				}
+
+				AddToIsland(newId, contact);
+
+				b2Body* other = ce->other;
+				if (other->m_type != b2_staticBody && other->m_islandId == b2_nullIsland)
+				{
+					other->m_islandId = newId;
+					stack[stackCount++] = other;
+				}
+			}
+
+			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				b2Joint* joint = je->joint;
+				if (joint->m_islandId != islandId)
+				{
+					continue;
+				}
+
+				AddToIsland(newId, joint);
+
+				b2Body* other = je->other;
+				if (other->m_type != b2_staticBody && other->m_islandId == b2_nullIsland)
+				{
+					other->m_islandId = newId;
+					stack[stackCount++] = other;
+				}
+			}
+		}
+
+		if (awake)
+		{
+			WakeIsland(newId);
+		}
+	}
+
+	b2Free(bodies);
+
+	FreeIsland(islandId);
+}
+
+void b2IslandManager::Validate() const
+{
+#if defined(b2DEBUG)
+	int32 islandCount = 0;
+	for (int32 islandId = 0; islandId < m_islandCapacity; ++islandId)
+	{
+		const b2PersistentIsland* island = m_islands + islandId;
+		if (island->bodyCount < 0)
+		{
+			continue;
+		}
+
+		++islandCount;
+		b2Assert(island->bodyCount > 0);
+
+		int32 count = 0;
+		const b2Body* prevBody = nullptr;
+		for (const b2Body* b = island->bodyList; b; b = b->m_islandNext)
+		{
+			b2Assert(b->m_islandId == islandId);
+			b2Assert(b->m_islandPrev == prevBody);
+			b2Assert(b->m_type != b2_staticBody && b->IsEnabled());
+			prevBody = b;
+			++count;
+		}
+		b2Assert(count == island->bodyCount);
+
+		count = 0;
+		const b2Contact* prevContact = nullptr;
+		for (const b2Contact* c = island->contactList; c; c = c->m_islandNext)
+		{
+			b2Assert(c->m_islandId == islandId);
+			b2Assert(c->m_islandPrev == prevContact);
+			b2Assert(c->IsTouching());
+			prevContact = c;
+			++count;
+		}
+		b2Assert(count == island->contactCount);
+
+		count = 0;
+		const b2Joint* prevJoint = nullptr;
+		for (const b2Joint* j = island->jointList; j; j = j->m_islandNext)
+		{
+			b2Assert(j->m_islandId == islandId);
+			b2Assert(j->m_islandPrev == prevJoint);
+			prevJoint = j;
+			++count;
+		}
+		b2Assert(count == island->jointCount);
+
+		if (island->awakeIndex != b2_nullIsland)
+		{
+			b2Assert(island->awakeIndex < m_awakeCount);
+			b2Assert(m_awakeIslands[island->awakeIndex] == islandId);
+		}
+	}
+	b2Assert(islandCount == m_islandCount);
+#endif
+}
+
+void b2IslandManager::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_islandCapacity);
+	writer->Write(m_islandCount);
+	writer->Write(m_freeList);
+
+	// The list heads are stored by index: bodies by state slot, contacts and joints
+	// by m_index. Free slots only keep the free list.
+	for (int32 i = 0; i < m_islandCapacity; ++i)
+	{
+		const b2PersistentIsland* island = m_islands + i;
+		writer->Write(island->bodyCount);
+		writer->Write(island->next);
+		if (island->bodyCount < 0)
+		{
+			continue;
+		}
+
+		writer->Write(island->bodyList != nullptr ? island->bodyList->m_stateIndex : -1);
+		writer->Write(island->contactList != nullptr ? island->contactList->m_index : -1);
+		writer->Write(island->jointList != nullptr ? island->jointList->m_index : -1);
+		writer->Write(island->contactCount);
+		writer->Write(island->jointCount);
+		writer->Write(island->removeCount);
+		writer->Write(island->awakeIndex);
+	}
+
+	writer->WriteArray(m_awakeIslands, m_awakeCount, m_awakeCapacity);
+}
+
+void b2IslandManager::Restore(b2SnapshotReader* reader, b2Body* const* bodies, int32 bodyCount,
+							  b2Contact* const* contacts, int32 contactCount, b2Joint* const* joints, int32 jointCount)
+{
+	int32 capacity = reader->Read<int32>();
+	int32 islandCount = reader->Read<int32>();
+	int32 freeList = reader->Read<int32>();
+
+	// Every slot takes at least two words.
+	if (reader->invalid || capacity < 0 || capacity > (reader->size - reader->offset) / int32(2 * sizeof(int32)) ||
+		islandCount < 0 || islandCount > capacity || freeList < b2_nullIsland || freeList >= capacity)
+	{
+		reader->invalid = true;
+		return;
+	}
+
+	if (capacity != m_islandCapacity)
+	{
+		b2Free(m_islands);
+		m_islands = capacity > 0 ? (b2PersistentIsland*)b2Alloc(capacity * sizeof(b2PersistentIsland)) : nullptr;
+		m_islandCapacity = capacity;
+	}
+	m_islandCount = islandCount;
+	m_freeList = freeList;
+
+	for (int32 i = 0; i < capacity; ++i)
+	{
+		b2PersistentIsland* island = m_islands + i;
+		island->bodyCount = reader->Read<int32>();
+		island->next = reader->Read<int32>();
+		island->bodyList = nullptr;
+		island->contactList = nullptr;
+		island->jointList = nullptr;
+		island->contactCount = 0;
+		island->jointCount = 0;
+		island->removeCount = 0;
+		island->awakeIndex = b2_nullIsland;
+		if (island->next < b2_nullIsland || island->next >= capacity)
+		{
+			reader->invalid = true;
+			island->next = b2_nullIsland;
+		}
+
+		if (island->bodyCount < 0)
+		{
+			continue;
+		}
+
+		island->bodyList = reader->ReadLink(bodies, bodyCount);
+		island->contactList = reader->ReadLink(contacts, contactCount);
+		island->jointList = reader->ReadLink(joints, jointCount);
+		island->contactCount = reader->Read<int32>();
+		island->jointCount = reader->Read<int32>();
+		island->removeCount = reader->Read<int32>();
+		island->awakeIndex = reader->Read<int32>();
+	}
+
+	m_awakeCount = reader->ReadArray(&m_awakeIslands, &m_awakeCapacity);
+	for (int32 i = 0; i < m_awakeCount; ++i)
+	{
+		int32 islandId = m_awakeIslands[i];
+		if (islandId < 0 || islandId >= capacity || m_islands[islandId].awakeIndex != i)
+		{
+			reader->invalid = true;
+			m_awakeCount = 0;
+			break;
+		}
+	}
+}
+
+int32 b2IslandManager::Check(b2SnapshotReader* reader, int32 bodyCount, int32 contactCount, int32 jointCount) const
+{
+	int32 capacity = reader->Read<int32>();
+	int32 islandCount = reader->Read<int32>();
+	int32 freeList = reader->Read<int32>();
+
+	if (reader->invalid || capacity < 0 || capacity > (reader->size - reader->offset) / int32(2 * sizeof(int32)) ||
+		islandCount < 0 || islandCount > capacity || freeList < b2_nullIsland || freeList >= capacity)
+	{
+		reader->invalid = true;
+		return 0;
+	}
+
+	// The awake array must match the awake index of every island.
+	int32* awakeIndices = capacity > 0 ? (int32*)b2Alloc(capacity * sizeof(int32)) : nullptr;
+	for (int32 i = 0; i < capacity && reader->invalid == false; ++i)
+	{
+		int32 islandBodyCount = reader->Read<int32>();
+		reader->CheckLink(reader->Read<int32>(), capacity);
+		awakeIndices[i] = b2_nullIsland;
+		if (islandBodyCount < 0)
+		{
+			continue;
+		}
+
+		reader->CheckLink(reader->Read<int32>(), bodyCount);
+		reader->CheckLink(reader->Read<int32>(), contactCount);
+		reader->CheckLink(reader->Read<int32>(), jointCount);
+		reader->Skip(3 * int32(sizeof(int32)));
+		awakeIndices[i] = reader->Read<int32>();
+	}
+
+	int32 awakeCapacity;
+	int32 awakeCount = reader->ReadArrayHeader<int32>(&awakeCapacity);
+	for (int32 i = 0; i < awakeCount && reader->invalid == false; ++i)
+	{
+		int32 islandId = reader->Read<int32>();
+		if (islandId < 0 || islandId >= capacity || awakeIndices[islandId] != i)
+		{
+			reader->invalid = true;
+		}
+	}
+
+	b2Free(awakeIndices);
+	return capacity;
+}
@@ -173,52 +173,48 @@ b2Joint* b2Joint::Create(const b2JointDef* def, b2BlockAllocator* allocator)
 
 void b2Joint::Destroy(b2Joint* joint, b2BlockAllocator* allocator)
 {
+	int32 size = GetByteCount(joint->m_type);
 	joint->~b2Joint();
-	switch (joint->m_type)
+	allocator->Free(joint, size);
+}
+
+int32 b2Joint::GetByteCount(b2JointType type)
+{
+	switch (type)
 	{
 	case e_distanceJoint:
-		allocator->Free(joint, sizeof(b2DistanceJoint));
-		break;
+		return sizeof(b2DistanceJoint);
 
 	case e_mouseJoint:
-		allocator->Free(joint, sizeof(b2MouseJoint));
-		break;
+		return sizeof(b2MouseJoint);
 
 	case e_prismaticJoint:
-		allocator->Free(joint, sizeof(b2PrismaticJoint));
-		break;
+		return sizeof(b2PrismaticJoint);
 
 	case e_revoluteJoint:
-		allocator->Free(joint, sizeof(b2RevoluteJoint));
-		break;
+		return sizeof(b2RevoluteJoint);
 
 	case e_pulleyJoint:
-		allocator->Free(joint, sizeof(b2PulleyJoint));
-		break;
+		return sizeof(b2PulleyJoint);
 
 	case e_gearJoint:
-		allocator->Free(joint, sizeof(b2GearJoint));
-		break;
+		return sizeof(b2GearJoint);
 
 	case e_wheelJoint:
-		allocator->Free(joint, sizeof(b2WheelJoint));
-		break;
-    
+		return sizeof(b2WheelJoint);
+
 	case e_weldJoint:
-		allocator->Free(joint, sizeof(b2WeldJoint));
-		break;
+		return sizeof(b2WeldJoint);
 
 	case e_frictionJoint:
-		allocator->Free(joint, sizeof(b2FrictionJoint));
-		break;
+		return sizeof(b2FrictionJoint);
 
 	case e_motorJoint:
-		allocator->Free(joint, sizeof(b2MotorJoint));
-		break;
+		return sizeof(b2MotorJoint);
 
 	default:
 		b2Assert(false);
-		break;
+		return 0;
 	}
 }
 
@@ -233,7 +229,9 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_bodyB = def->bodyB;
 	m_index = 0;
 	m_collideConnected = def->collideConnected;
-	m_islandFlag = false;
+	m_islandId = b2_nullIsland;
+	m_islandPrev = nullptr;
+	m_islandNext = nullptr;
 	m_userData = def->userData;
 
 	m_edgeA.joint = nullptr;
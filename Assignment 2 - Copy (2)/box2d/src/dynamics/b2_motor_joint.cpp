@@ -24,6 +24,8 @@
 #include "box2d/b2_motor_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // Point-to-point constraint
 // Cdot = v2 - v1
 //      = v2 + cross(w2, r2) - v1 - cross(w1, r1)
@@ -69,12 +71,12 @@ void b2MotorJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	b2Vec2 cA = data.positions[m_indexA].c;
 	float aA = data.positions[m_indexA].a;
@@ -293,6 +295,56 @@ float b2MotorJoint::GetAngularOffset() const
 	return m_angularOffset;
 }
 
+void b2MotorJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_linearOffset);
+	writer->Write(m_angularOffset);
+	writer->Write(m_linearImpulse);
+	writer->Write(m_angularImpulse);
+	writer->Write(m_maxForce);
+	writer->Write(m_maxTorque);
+	writer->Write(m_correctionFactor);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_rA);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_linearError);
+	writer->Write(m_angularError);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_linearMass);
+	writer->Write(m_angularMass);
+}
+
+void b2MotorJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_linearOffset);
+	reader->Read(&m_angularOffset);
+	reader->Read(&m_linearImpulse);
+	reader->Read(&m_angularImpulse);
+	reader->Read(&m_maxForce);
+	reader->Read(&m_maxTorque);
+	reader->Read(&m_correctionFactor);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_rA);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_linearError);
+	reader->Read(&m_angularError);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_linearMass);
+	reader->Read(&m_angularMass);
+}
+
 void b2MotorJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
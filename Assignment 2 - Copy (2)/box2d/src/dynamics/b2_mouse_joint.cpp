@@ -24,6 +24,8 @@
 #include "box2d/b2_mouse_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // p = attached point, m = mouse point
 // C = p - m
 // Cdot = v
@@ -73,9 +75,9 @@ float b2MouseJoint::GetMaxForce() const
 void b2MouseJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	b2Vec2 cB = data.positions[m_indexB].c;
 	float aB = data.positions[m_indexB].a;
@@ -190,3 +192,43 @@ void b2MouseJoint::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_targetA -= newOrigin;
 }
+
+void b2MouseJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_localAnchorB);
+	writer->Write(m_targetA);
+	writer->Write(m_stiffness);
+	writer->Write(m_damping);
+	writer->Write(m_beta);
+	writer->Write(m_impulse);
+	writer->Write(m_maxForce);
+	writer->Write(m_gamma);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterB);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIB);
+	writer->Write(m_mass);
+	writer->Write(m_C);
+}
+
+void b2MouseJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_targetA);
+	reader->Read(&m_stiffness);
+	reader->Read(&m_damping);
+	reader->Read(&m_beta);
+	reader->Read(&m_impulse);
+	reader->Read(&m_maxForce);
+	reader->Read(&m_gamma);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIB);
+	reader->Read(&m_mass);
+	reader->Read(&m_C);
+}
@@ -24,6 +24,8 @@
 #include "box2d/b2_pulley_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // Pulley:
 // length1 = norm(p1 - s1)
 // length2 = norm(p2 - s2)
@@ -78,12 +80,12 @@ void b2PulleyJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	b2Vec2 cA = data.positions[m_indexA].c;
 	float aA = data.positions[m_indexA].a;
@@ -326,6 +328,58 @@ float b2PulleyJoint::GetCurrentLengthB() const
 	return d.Length();
 }
 
+void b2PulleyJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_groundAnchorA);
+	writer->Write(m_groundAnchorB);
+	writer->Write(m_lengthA);
+	writer->Write(m_lengthB);
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_constant);
+	writer->Write(m_ratio);
+	writer->Write(m_impulse);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_uA);
+	writer->Write(m_uB);
+	writer->Write(m_rA);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_mass);
+}
+
+void b2PulleyJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_groundAnchorA);
+	reader->Read(&m_groundAnchorB);
+	reader->Read(&m_lengthA);
+	reader->Read(&m_lengthB);
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_constant);
+	reader->Read(&m_ratio);
+	reader->Read(&m_impulse);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_uA);
+	reader->Read(&m_uB);
+	reader->Read(&m_rA);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_mass);
+}
+
 void b2PulleyJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
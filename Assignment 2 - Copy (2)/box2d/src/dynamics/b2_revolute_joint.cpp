@@ -25,6 +25,8 @@
 #include "box2d/b2_revolute_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // Point-to-point constraint
 // C = p2 - p1
 // Cdot = v2 - v1
@@ -74,12 +76,12 @@ void b2RevoluteJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	float aA = data.positions[m_indexA].a;
 	b2Vec2 vA = data.velocities[m_indexA].v;
@@ -345,14 +347,14 @@ float b2RevoluteJoint::GetJointAngle() const
 {
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
-	return bB->m_sweep.a - bA->m_sweep.a - m_referenceAngle;
+	return bB->GetAngle() - bA->GetAngle() - m_referenceAngle;
 }
 
 float b2RevoluteJoint::GetJointSpeed() const
 {
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
-	return bB->m_angularVelocity - bA->m_angularVelocity;
+	return bB->GetAngularVelocity() - bA->GetAngularVelocity();
 }
 
 bool b2RevoluteJoint::IsMotorEnabled() const
@@ -437,6 +439,66 @@ void b2RevoluteJoint::SetLimits(float lower, float upper)
 	}
 }
 
+void b2RevoluteJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_impulse);
+	writer->Write(m_motorImpulse);
+	writer->Write(m_lowerImpulse);
+	writer->Write(m_upperImpulse);
+	writer->Write(m_enableMotor);
+	writer->Write(m_maxMotorTorque);
+	writer->Write(m_motorSpeed);
+	writer->Write(m_enableLimit);
+	writer->Write(m_referenceAngle);
+	writer->Write(m_lowerAngle);
+	writer->Write(m_upperAngle);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_rA);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_K);
+	writer->Write(m_angle);
+	writer->Write(m_axialMass);
+}
+
+void b2RevoluteJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_impulse);
+	reader->Read(&m_motorImpulse);
+	reader->Read(&m_lowerImpulse);
+	reader->Read(&m_upperImpulse);
+	reader->Read(&m_enableMotor);
+	reader->Read(&m_maxMotorTorque);
+	reader->Read(&m_motorSpeed);
+	reader->Read(&m_enableLimit);
+	reader->Read(&m_referenceAngle);
+	reader->Read(&m_lowerAngle);
+	reader->Read(&m_upperAngle);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_rA);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_K);
+	reader->Read(&m_angle);
+	reader->Read(&m_axialMass);
+}
+
 void b2RevoluteJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
@@ -24,6 +24,8 @@
 #include "box2d/b2_time_step.h"
 #include "box2d/b2_weld_joint.h"
 
+#include "common/b2_snapshot.h"
+
 // Point-to-point constraint
 // C = p2 - p1
 // Cdot = v2 - v1
@@ -63,12 +65,12 @@ void b2WeldJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	float aA = data.positions[m_indexA].a;
 	b2Vec2 vA = data.velocities[m_indexA].v;
@@ -326,6 +328,52 @@ float b2WeldJoint::GetReactionTorque(float inv_dt) const
 	return inv_dt * m_impulse.z;
 }
 
+void b2WeldJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_stiffness);
+	writer->Write(m_damping);
+	writer->Write(m_bias);
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_referenceAngle);
+	writer->Write(m_gamma);
+	writer->Write(m_impulse);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_rA);
+	writer->Write(m_rB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_mass);
+}
+
+void b2WeldJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_stiffness);
+	reader->Read(&m_damping);
+	reader->Read(&m_bias);
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_referenceAngle);
+	reader->Read(&m_gamma);
+	reader->Read(&m_impulse);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_rA);
+	reader->Read(&m_rB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_mass);
+}
+
 void b2WeldJoint::Dump()
 {
 	int32 indexA = m_bodyA->m_islandIndex;
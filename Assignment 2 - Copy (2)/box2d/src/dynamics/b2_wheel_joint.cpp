@@ -25,6 +25,8 @@
 #include "box2d/b2_wheel_joint.h"
 #include "box2d/b2_time_step.h"
 
+#include "common/b2_snapshot.h"
+
 // Linear constraint (point-to-line)
 // d = pB - pA = xB + rB - xA - rA
 // C = dot(ay, d)
@@ -90,12 +92,12 @@ void b2WheelJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
+	m_invMassA = m_bodyA->GetInverseMass();
+	m_invMassB = m_bodyB->GetInverseMass();
+	m_invIA = m_bodyA->GetInverseInertia();
+	m_invIB = m_bodyB->GetInverseInertia();
 
 	float mA = m_invMassA, mB = m_invMassB;
 	float iA = m_invIA, iB = m_invIB;
@@ -482,17 +484,17 @@ float b2WheelJoint::GetJointLinearSpeed() const
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
 
-	b2Vec2 rA = b2Mul(bA->m_xf.q, m_localAnchorA - bA->m_sweep.localCenter);
-	b2Vec2 rB = b2Mul(bB->m_xf.q, m_localAnchorB - bB->m_sweep.localCenter);
-	b2Vec2 p1 = bA->m_sweep.c + rA;
-	b2Vec2 p2 = bB->m_sweep.c + rB;
+	b2Vec2 rA = b2Mul(bA->m_xf.q, m_localAnchorA - bA->m_localCenter);
+	b2Vec2 rB = b2Mul(bB->m_xf.q, m_localAnchorB - bB->m_localCenter);
+	b2Vec2 p1 = bA->GetWorldCenter() + rA;
+	b2Vec2 p2 = bB->GetWorldCenter() + rB;
 	b2Vec2 d = p2 - p1;
 	b2Vec2 axis = b2Mul(bA->m_xf.q, m_localXAxisA);
 
-	b2Vec2 vA = bA->m_linearVelocity;
-	b2Vec2 vB = bB->m_linearVelocity;
-	float wA = bA->m_angularVelocity;
-	float wB = bB->m_angularVelocity;
+	b2Vec2 vA = bA->GetLinearVelocity();
+	b2Vec2 vB = bB->GetLinearVelocity();
+	float wA = bA->GetAngularVelocity();
+	float wB = bB->GetAngularVelocity();
 
 	float speed = b2Dot(d, b2Cross(wA, axis)) + b2Dot(axis, vB + b2Cross(wB, rB) - vA - b2Cross(wA, rA));
 	return speed;
@@ -502,13 +504,13 @@ float b2WheelJoint::GetJointAngle() const
 {
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
-	return bB->m_sweep.a - bA->m_sweep.a;
+	return bB->GetAngle() - bA->GetAngle();
 }
 
 float b2WheelJoint::GetJointAngularSpeed() const
 {
-	float wA = m_bodyA->m_angularVelocity;
-	float wB = m_bodyB->m_angularVelocity;
+	float wA = m_bodyA->GetAngularVelocity();
+	float wB = m_bodyB->GetAngularVelocity();
 	return wB - wA;
 }
 
@@ -613,6 +615,90 @@ float b2WheelJoint::GetDamping() const
 	return m_damping;
 }
 
+void b2WheelJoint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_localXAxisA);
+	writer->Write(m_localYAxisA);
+	writer->Write(m_impulse);
+	writer->Write(m_motorImpulse);
+	writer->Write(m_springImpulse);
+	writer->Write(m_lowerImpulse);
+	writer->Write(m_upperImpulse);
+	writer->Write(m_translation);
+	writer->Write(m_lowerTranslation);
+	writer->Write(m_upperTranslation);
+	writer->Write(m_maxMotorTorque);
+	writer->Write(m_motorSpeed);
+	writer->Write(m_enableLimit);
+	writer->Write(m_enableMotor);
+	writer->Write(m_stiffness);
+	writer->Write(m_damping);
+	writer->Write(m_indexA);
+	writer->Write(m_indexB);
+	writer->Write(m_localCenterA);
+	writer->Write(m_localCenterB);
+	writer->Write(m_invMassA);
+	writer->Write(m_invMassB);
+	writer->Write(m_invIA);
+	writer->Write(m_invIB);
+	writer->Write(m_ax);
+	writer->Write(m_ay);
+	writer->Write(m_sAx);
+	writer->Write(m_sBx);
+	writer->Write(m_sAy);
+	writer->Write(m_sBy);
+	writer->Write(m_mass);
+	writer->Write(m_motorMass);
+	writer->Write(m_axialMass);
+	writer->Write(m_springMass);
+	writer->Write(m_bias);
+	writer->Write(m_gamma);
+}
+
+void b2WheelJoint::Restore(b2SnapshotReader* reader)
+{
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_localXAxisA);
+	reader->Read(&m_localYAxisA);
+	reader->Read(&m_impulse);
+	reader->Read(&m_motorImpulse);
+	reader->Read(&m_springImpulse);
+	reader->Read(&m_lowerImpulse);
+	reader->Read(&m_upperImpulse);
+	reader->Read(&m_translation);
+	reader->Read(&m_lowerTranslation);
+	reader->Read(&m_upperTranslation);
+	reader->Read(&m_maxMotorTorque);
+	reader->Read(&m_motorSpeed);
+	reader->Read(&m_enableLimit);
+	reader->Read(&m_enableMotor);
+	reader->Read(&m_stiffness);
+	reader->Read(&m_damping);
+	reader->Read(&m_indexA);
+	reader->Read(&m_indexB);
+	reader->Read(&m_localCenterA);
+	reader->Read(&m_localCenterB);
+	reader->Read(&m_invMassA);
+	reader->Read(&m_invMassB);
+	reader->Read(&m_invIA);
+	reader->Read(&m_invIB);
+	reader->Read(&m_ax);
+	reader->Read(&m_ay);
+	reader->Read(&m_sAx);
+	reader->Read(&m_sBx);
+	reader->Read(&m_sAy);
+	reader->Read(&m_sBy);
+	reader->Read(&m_mass);
+	reader->Read(&m_motorMass);
+	reader->Read(&m_axialMass);
+	reader->Read(&m_springMass);
+	reader->Read(&m_bias);
+	reader->Read(&m_gamma);
+}
+
 void b2WheelJoint::Dump()
 {
 	// FLT_DECIMAL_DIG == 9
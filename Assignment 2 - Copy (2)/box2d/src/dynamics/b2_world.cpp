@@ -29,18 +29,37 @@
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
 #include "box2d/b2_contact.h"
+#include "box2d/b2_distance.h"
 #include "box2d/b2_draw.h"
 #include "box2d/b2_edge_shape.h"
 #include "box2d/b2_fixture.h"
 #include "box2d/b2_polygon_shape.h"
 #include "box2d/b2_pulley_joint.h"
+#include "box2d/b2_thread_pool.h"
 #include "box2d/b2_time_of_impact.h"
 #include "box2d/b2_timer.h"
 #include "box2d/b2_world.h"
+#include "common/b2_simd.h"
+#include "common/b2_snapshot.h"
 
+#include <algorithm>
 #include <new>
+#include <stdio.h>
+#include <string.h>
 
-b2World::b2World(const b2Vec2& gravity)
+// A step of the profile history. Times are in milliseconds. The phase starts are
+// relative to the start of the step.
+struct b2ProfileRecord
+{
+	b2Profile profile;
+	int32 stepIndex;
+	double startTime;
+	float collideStart;
+	float solveStart;
+	float solveTOIStart;
+};
+
+b2World::b2World(const b2Vec2& gravity, b2BroadPhaseType broadPhaseType, float gridCellSize)
 {
 	m_destructionListener = nullptr;
 	m_debugDraw = nullptr;
@@ -50,10 +69,16 @@ b2World::b2World(const b2Vec2& gravity)
 
 	m_bodyCount = 0;
 	m_jointCount = 0;
+	m_creationCount = 0;
 
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_wideContactSolver = false;
+	m_graphColoring = false;
+	m_softStep = false;
+	m_softStepCount = b2_softStepCount;
+	m_batchedTOI = false;
 
 	m_stepComplete = true;
 
@@ -66,13 +91,28 @@ b2World::b2World(const b2Vec2& gravity)
 
 	m_inv_dt0 = 0.0f;
 
+	m_threadPool = nullptr;
+	m_workerStackAllocators = nullptr;
+	m_workerStackAllocatorCount = 0;
+
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_broadPhase.SetType(broadPhaseType, gridCellSize);
 
 	memset(&m_profile, 0, sizeof(b2Profile));
+
+	m_profileHistory = nullptr;
+	m_profileCapacity = 0;
+	m_profileCount = 0;
+	m_profileNext = 0;
+	m_profileTime = 0.0;
+	m_stepIndex = 0;
 }
 
 b2World::~b2World()
 {
+	SetThreadPool(nullptr);
+	SetProfileHistory(0);
+
 	// Some shapes allocate using b2Alloc.
 	b2Body* b = m_bodyList;
 	while (b)
@@ -122,6 +162,12 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 
 	void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
 	b2Body* b = new (mem) b2Body(def, this);
+	b->m_creationId = m_creationCount++;
+
+	if (b->m_type != b2_staticBody && b->IsEnabled())
+	{
+		m_islandManager.AddBody(b);
+	}
 
 	// Add to world doubly linked list.
 	b->m_prev = nullptr;
@@ -186,6 +232,7 @@ void b2World::DestroyBody(b2Body* b)
 		}
 
 		f0->DestroyProxies(&m_contactManager.m_broadPhase);
+		m_contactManager.ForgetFixture(f0);
 		f0->Destroy(&m_blockAllocator);
 		f0->~b2Fixture();
 		m_blockAllocator.Free(f0, sizeof(b2Fixture));
@@ -212,6 +259,8 @@ void b2World::DestroyBody(b2Body* b)
 		m_bodyList = b->m_next;
 	}
 
+	m_islandManager.RemoveBody(b);
+
 	--m_bodyCount;
 	b->~b2Body();
 	m_blockAllocator.Free(b, sizeof(b2Body));
@@ -226,6 +275,7 @@ b2Joint* b2World::CreateJoint(const b2JointDef* def)
 	}
 
 	b2Joint* j = b2Joint::Create(def, &m_blockAllocator);
+	j->m_creationId = m_creationCount++;
 
 	// Connect to the world list.
 	j->m_prev = nullptr;
@@ -273,6 +323,7 @@ b2Joint* b2World::CreateJoint(const b2JointDef* def)
 	}
 
 	// Note: creating a joint doesn't wake the bodies.
+	m_islandManager.LinkJoint(j);
 
 	return j;
 }
@@ -306,6 +357,7 @@ void b2World::DestroyJoint(b2Joint* j)
 	// Disconnect from island graph.
 	b2Body* bodyA = j->m_bodyA;
 	b2Body* bodyB = j->m_bodyB;
+	m_islandManager.UnlinkJoint(j);
 
 	// Wake up connected bodies.
 	bodyA->SetAwake(true);
@@ -390,208 +442,579 @@ void b2World::SetAllowSleeping(bool flag)
 	}
 }
 
-// Find islands, integrate and solve constraints, solve position constraints
-void b2World::Solve(const b2TimeStep& step)
+// An awake island collected by b2World::Solve. These index into the flat arrays.
+struct b2IslandRange
 {
-	m_profile.solveInit = 0.0f;
-	m_profile.solveVelocity = 0.0f;
-	m_profile.solvePosition = 0.0f;
+	int32 islandId;
+	bool splitPending;
+	bool sleepReady;
+	int32 bodyStart;
+	int32 bodyCount;
+	int32 staticStart;
+	int32 staticCount;
+	int32 contactStart;
+	int32 contactCount;
+	int32 jointStart;
+	int32 jointCount;
+};
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
+// Solves a range of collected islands. Each island only writes to its own bodies,
+// contacts and joints. Static bodies are shared, so they are read-only here.
+class b2SolveIslandsTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		b2StackAllocator* allocator = allocators[threadIndex];
 
-	// Clear all the island flags.
-	for (b2Body* b = m_bodyList; b; b = b->m_next)
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 islandIndex = order != nullptr ? order[i] : i;
+			b2IslandRange& range = islands[islandIndex];
+
+			b2Island island(range.bodyCount,
+							range.contactCount,
+							range.jointCount,
+							allocator,
+							listener,
+							staticSlotCount);
+			island.m_states = states;
+
+			for (int32 j = 0; j < range.staticCount; ++j)
+			{
+				island.AddStatic(staticBodies[range.staticStart + j]);
+			}
+
+			for (int32 j = 0; j < range.bodyCount; ++j)
+			{
+				island.Add(bodies[range.bodyStart + j]);
+			}
+
+			for (int32 j = 0; j < range.contactCount; ++j)
+			{
+				island.Add(contacts[range.contactStart + j]);
+			}
+
+			for (int32 j = 0; j < range.jointCount; ++j)
+			{
+				island.Add(joints[range.jointStart + j]);
+			}
+
+			if (impulses)
+			{
+				island.m_impulses = impulses + range.contactStart;
+			}
+
+			island.m_graphColoring = graphColoring && range.contactCount + range.jointCount >= b2_graphColorThreshold;
+			island.m_threadPool = threadPool;
+			island.m_splitPending = range.splitPending;
+
+			island.Solve(profiles + islandIndex, *step, gravity, allowSleep);
+			range.sleepReady = island.m_sleepReady;
+		}
+	}
+
+	const b2TimeStep* step;
+	b2Vec2 gravity;
+	bool allowSleep;
+
+	b2IslandRange* islands;
+	const int32* order;
+	b2BodyStates* states;
+	b2Body** bodies;
+	b2Body** staticBodies;
+	b2Contact** contacts;
+	b2Joint** joints;
+	int32 staticSlotCount;
+
+	b2ContactListener* listener;
+	b2ContactImpulse* impulses;
+	b2Profile* profiles;
+
+	bool graphColoring;
+	b2ThreadPool* threadPool;
+	b2StackAllocator** allocators;
+};
+
+void b2World::SetThreadPool(b2ThreadPool* threadPool)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
 	{
-		b->m_flags &= ~b2Body::e_islandFlag;
+		return;
 	}
-	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+
+	for (int32 i = 0; i < m_workerStackAllocatorCount; ++i)
 	{
-		c->m_flags &= ~b2Contact::e_islandFlag;
+		m_workerStackAllocators[i].~b2StackAllocator();
 	}
-	for (b2Joint* j = m_jointList; j; j = j->m_next)
+
+	if (m_workerStackAllocators)
+	{
+		b2Free(m_workerStackAllocators);
+		m_workerStackAllocators = nullptr;
+	}
+
+	m_workerStackAllocatorCount = 0;
+	m_threadPool = threadPool;
+	m_contactManager.SetThreadPool(threadPool);
+
+	if (m_threadPool == nullptr || m_threadPool->GetThreadCount() < 2)
+	{
+		return;
+	}
+
+	// The calling thread keeps using m_stackAllocator.
+	m_workerStackAllocatorCount = m_threadPool->GetThreadCount() - 1;
+	m_workerStackAllocators = (b2StackAllocator*)b2Alloc(m_workerStackAllocatorCount * sizeof(b2StackAllocator));
+	for (int32 i = 0; i < m_workerStackAllocatorCount; ++i)
 	{
-		j->m_islandFlag = false;
+		new (m_workerStackAllocators + i) b2StackAllocator;
 	}
+}
 
-	// Build and simulate all awake islands.
-	int32 stackSize = m_bodyCount;
-	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
-	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
+// Find islands, integrate and solve constraints, solve position constraints
+void b2World::Solve(const b2TimeStep& step)
+{
+	m_profile.solveInit = 0.0f;
+	m_profile.solveVelocity = 0.0f;
+	m_profile.solvePosition = 0.0f;
+	m_profile.colorCount = 0.0f;
+	for (int32 i = 0; i < b2_graphColorCount; ++i)
 	{
-		if (seed->m_flags & b2Body::e_islandFlag)
+		m_profile.colorSizes[i] = 0.0f;
+	}
+	m_profile.colorOverflow = 0.0f;
+	m_profile.wideBatchCount = 0;
+	m_profile.wideRemainderCount = 0;
+
+	// Collect the awake islands into flat arrays before solving any of them. The
+	// islands are kept up to date by m_islandManager, so no graph search is needed.
+	// Static bodies may appear in several islands. They get one solver slot each,
+	// shared by all islands, so that islands can be solved independently.
+	int32 contactCapacity = m_contactManager.m_contactCount;
+	int32 staticCapacity = contactCapacity + m_jointCount;
+
+	int32 awakeIslandCount = m_islandManager.GetAwakeIslandCount();
+	int32* awakeIslands = (int32*)m_stackAllocator.Allocate(awakeIslandCount * sizeof(int32));
+	memcpy(awakeIslands, m_islandManager.GetAwakeIslands(), awakeIslandCount * sizeof(int32));
+
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+	b2Body** staticBodies = (b2Body**)m_stackAllocator.Allocate(staticCapacity * sizeof(b2Body*));
+	b2Body** slotBodies = (b2Body**)m_stackAllocator.Allocate(staticCapacity * sizeof(b2Body*));
+	int32* slotIslands = (int32*)m_stackAllocator.Allocate(staticCapacity * sizeof(int32));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(contactCapacity * sizeof(b2Contact*));
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	b2IslandRange* islands = (b2IslandRange*)m_stackAllocator.Allocate(awakeIslandCount * sizeof(b2IslandRange));
+
+	int32 islandCount = 0;
+	int32 bodyCount = 0;
+	int32 staticCount = 0;
+	int32 staticSlotCount = 0;
+	int32 contactCount = 0;
+	int32 jointCount = 0;
+
+	for (int32 i = 0; i < awakeIslandCount; ++i)
+	{
+		int32 islandId = awakeIslands[i];
+		const b2PersistentIsland* persistentIsland = m_islandManager.GetIsland(islandId);
+
+		// The island stays on the awake list until it is solved. If all of its bodies
+		// were put to sleep by the user in the meantime, take it off the list.
+		bool awake = false;
+		for (b2Body* b = persistentIsland->bodyList; b; b = b->m_islandNext)
 		{
-			continue;
+			if (b->IsAwake())
+			{
+				awake = true;
+				break;
+			}
 		}
 
-		if (seed->IsAwake() == false || seed->IsEnabled() == false)
+		if (awake == false)
 		{
+			m_islandManager.SleepIsland(islandId);
 			continue;
 		}
 
-		// The seed can be dynamic or kinematic.
-		if (seed->GetType() == b2_staticBody)
+		b2IslandRange* island = islands + islandCount;
+		island->islandId = islandId;
+		island->splitPending = persistentIsland->removeCount > 0;
+		island->sleepReady = false;
+		island->bodyStart = bodyCount;
+		island->staticStart = staticCount;
+		island->contactStart = contactCount;
+		island->jointStart = jointCount;
+
+		for (b2Body* b = persistentIsland->bodyList; b; b = b->m_islandNext)
 		{
-			continue;
+			// Make sure the body is awake (without resetting sleep timer).
+			b->m_flags |= b2Body::e_awakeFlag;
+			bodies[bodyCount++] = b;
+		}
+
+		for (b2Contact* contact = persistentIsland->contactList; contact; contact = contact->m_islandNext)
+		{
+			// Contacts can be disabled by the user in PreSolve.
+			if (contact->IsEnabled() == false)
+			{
+				continue;
+			}
+
+			contacts[contactCount++] = contact;
+		}
+
+		for (b2Joint* joint = persistentIsland->jointList; joint; joint = joint->m_islandNext)
+		{
+			joints[jointCount++] = joint;
 		}
 
-		// Reset island and stack.
-		island.Clear();
-		int32 stackCount = 0;
-		stack[stackCount++] = seed;
-		seed->m_flags |= b2Body::e_islandFlag;
+		island->bodyCount = bodyCount - island->bodyStart;
+		island->contactCount = contactCount - island->contactStart;
+		island->jointCount = jointCount - island->jointStart;
 
-		// Perform a depth first search (DFS) on the constraint graph.
-		while (stackCount > 0)
+		// Find the static bodies touched by the constraints of this island.
+		for (int32 j = 0; j < island->contactCount + island->jointCount; ++j)
 		{
-			// Grab the next body off the stack and add it to the island.
-			b2Body* b = stack[--stackCount];
-			b2Assert(b->IsEnabled() == true);
-			island.Add(b);
+			b2Body* bodyA;
+			b2Body* bodyB;
+			if (j < island->contactCount)
+			{
+				b2Contact* contact = contacts[island->contactStart + j];
+				bodyA = contact->m_fixtureA->m_body;
+				bodyB = contact->m_fixtureB->m_body;
+			}
+			else
+			{
+				b2Joint* joint = joints[island->jointStart + j - island->contactCount];
+				bodyA = joint->m_bodyA;
+				bodyB = joint->m_bodyB;
+			}
 
-			// To keep islands as small as possible, we don't
-			// propagate islands across static bodies.
-			if (b->GetType() == b2_staticBody)
+			b2Body* staticBody = bodyA->m_type == b2_staticBody ? bodyA : bodyB;
+			if (staticBody->m_type != b2_staticBody)
 			{
 				continue;
 			}
 
-			// Make sure the body is awake (without resetting sleep timer).
-			b->m_flags |= b2Body::e_awakeFlag;
+			// Static bodies use the island flag to mark that they own a solver slot.
+			if ((staticBody->m_flags & b2Body::e_islandFlag) == 0)
+			{
+				staticBody->m_flags |= b2Body::e_islandFlag;
+				staticBody->m_islandIndex = staticSlotCount;
+				staticBody->m_center0 = m_bodyStates.centers[staticBody->m_stateIndex];
+				staticBody->m_angle0 = m_bodyStates.angles[staticBody->m_stateIndex];
+				slotBodies[staticSlotCount] = staticBody;
+				slotIslands[staticSlotCount] = -1;
+				++staticSlotCount;
+			}
 
-			// Search all contacts connected to this body.
-			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			// Load each static body once per island.
+			int32 slot = staticBody->m_islandIndex;
+			if (slotIslands[slot] != islandCount)
 			{
-				b2Contact* contact = ce->contact;
+				slotIslands[slot] = islandCount;
+				staticBodies[staticCount++] = staticBody;
+			}
+		}
 
-				// Has this contact already been added to an island?
-				if (contact->m_flags & b2Contact::e_islandFlag)
-				{
-					continue;
-				}
+		island->staticCount = staticCount - island->staticStart;
+		++islandCount;
+	}
 
-				// Is this contact solid and touching?
-				if (contact->IsEnabled() == false ||
-					contact->IsTouching() == false)
-				{
-					continue;
-				}
+	// Release the static slots. The slot indices stay valid until the islands are solved.
+	for (int32 i = 0; i < staticSlotCount; ++i)
+	{
+		slotBodies[i]->m_flags &= ~b2Body::e_islandFlag;
+	}
 
-				// Skip sensors.
-				bool sensorA = contact->m_fixtureA->m_isSensor;
-				bool sensorB = contact->m_fixtureB->m_isSensor;
-				if (sensorA || sensorB)
-				{
-					continue;
-				}
+	// Lay out the state of the collected bodies in island order so that each island
+	// integrates and writes back a contiguous range of slots. Islands are usually the
+	// same as last step, so few slots move.
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		int32 index = bodies[i]->m_stateIndex;
+		if (index != i)
+		{
+			b2Assert(index > i);
+			m_bodyStates.Swap(i, index);
+		}
+	}
 
-				island.Add(contact);
-				contact->m_flags |= b2Contact::e_islandFlag;
+	bool parallel = m_threadPool != nullptr && m_threadPool->GetThreadCount() > 1;
+	b2ContactListener* listener = m_contactManager.m_contactListener;
 
-				b2Body* other = ce->other;
+	b2Profile* profiles = (b2Profile*)m_stackAllocator.Allocate(islandCount * sizeof(b2Profile));
 
-				// Was the other body already added to this island?
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
+	// Worker threads cannot call the listener. Their impulses are buffered and reported below.
+	b2ContactImpulse* impulses = nullptr;
+	if (parallel && listener != nullptr)
+	{
+		impulses = (b2ContactImpulse*)m_stackAllocator.Allocate(contactCount * sizeof(b2ContactImpulse));
+	}
 
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
-			}
+	b2StackAllocator* allocatorArray[1] = { &m_stackAllocator };
+	b2StackAllocator** allocators = allocatorArray;
+	if (parallel)
+	{
+		allocators = (b2StackAllocator**)m_stackAllocator.Allocate(m_threadPool->GetThreadCount() * sizeof(b2StackAllocator*));
+		allocators[0] = &m_stackAllocator;
+		for (int32 i = 0; i < m_workerStackAllocatorCount; ++i)
+		{
+			allocators[i + 1] = m_workerStackAllocators + i;
+		}
+	}
 
-			// Search all joints connect to this body.
-			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+	b2SolveIslandsTask task;
+	task.step = &step;
+	task.gravity = m_gravity;
+	task.allowSleep = m_allowSleep;
+	task.islands = islands;
+	task.states = &m_bodyStates;
+	task.bodies = bodies;
+	task.staticBodies = staticBodies;
+	task.contacts = contacts;
+	task.joints = joints;
+	task.staticSlotCount = staticSlotCount;
+	task.listener = parallel ? nullptr : listener;
+	task.impulses = impulses;
+	task.profiles = profiles;
+	task.allocators = allocators;
+	task.order = nullptr;
+	task.graphColoring = m_graphColoring && m_softStep == false;
+	task.threadPool = nullptr;
+
+	if (parallel && task.graphColoring)
+	{
+		// The pool is not re-entrant. Islands large enough for graph coloring are solved
+		// after the others, one at a time, so each can use the whole pool.
+		int32* order = (int32*)m_stackAllocator.Allocate(islandCount * sizeof(int32));
+		int32 smallCount = 0;
+		int32 largeCount = 0;
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			if (islands[i].contactCount + islands[i].jointCount < b2_graphColorThreshold)
 			{
-				if (je->joint->m_islandFlag == true)
-				{
-					continue;
-				}
+				order[smallCount++] = i;
+			}
+		}
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			if (islands[i].contactCount + islands[i].jointCount >= b2_graphColorThreshold)
+			{
+				order[smallCount + largeCount++] = i;
+			}
+		}
 
-				b2Body* other = je->other;
+		task.order = order;
+		m_threadPool->ParallelFor(&task, smallCount, 1);
 
-				// Don't simulate joints connected to diabled bodies.
-				if (other->IsEnabled() == false)
-				{
-					continue;
-				}
+		task.threadPool = m_threadPool;
+		task.Execute(smallCount, islandCount, 0);
 
-				island.Add(je->joint);
-				je->joint->m_islandFlag = true;
+		m_stackAllocator.Free(order);
+	}
+	else if (parallel)
+	{
+		m_threadPool->ParallelFor(&task, islandCount, 1);
+	}
+	else
+	{
+		task.Execute(0, islandCount, 0);
+	}
 
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
+	// Merge in island order so the results do not depend on the thread schedule.
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		const b2Profile& p = profiles[i];
+		m_profile.solveInit += p.solveInit;
+		m_profile.solveVelocity += p.solveVelocity;
+		m_profile.solvePosition += p.solvePosition;
+		m_profile.colorCount = b2Max(m_profile.colorCount, p.colorCount);
+		for (int32 j = 0; j < b2_graphColorCount; ++j)
+		{
+			m_profile.colorSizes[j] += p.colorSizes[j];
+		}
+		m_profile.colorOverflow += p.colorOverflow;
+		m_profile.wideBatchCount += p.wideBatchCount;
+		m_profile.wideRemainderCount += p.wideRemainderCount;
+		m_profile.maxIslandSize = b2Max(m_profile.maxIslandSize, islands[i].bodyCount);
+	}
+	m_profile.islandCount = islandCount;
 
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
-			}
+	if (impulses)
+	{
+		for (int32 i = 0; i < contactCount; ++i)
+		{
+			listener->PostSolve(contacts[i], impulses + i);
 		}
+	}
+
+	if (parallel)
+	{
+		m_stackAllocator.Free(allocators);
+	}
+
+	if (impulses)
+	{
+		m_stackAllocator.Free(impulses);
+	}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+	// Islands that came to rest either fall asleep or, if they lost constraints
+	// since they were built, are split into their connected components. The
+	// components stay awake and fall asleep on their own.
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		const b2IslandRange& range = islands[i];
+		if (range.sleepReady == false)
+		{
+			continue;
+		}
 
-		// Post solve cleanup.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		if (range.splitPending)
 		{
-			// Allow static bodies to participate in other islands.
-			b2Body* b = island.m_bodies[i];
-			if (b->GetType() == b2_staticBody)
-			{
-				b->m_flags &= ~b2Body::e_islandFlag;
-			}
+			m_islandManager.SplitIsland(range.islandId);
+		}
+		else
+		{
+			m_islandManager.SleepIsland(range.islandId);
 		}
 	}
 
-	m_stackAllocator.Free(stack);
+	m_stackAllocator.Free(profiles);
+	m_stackAllocator.Free(islands);
+	m_stackAllocator.Free(joints);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(slotIslands);
+	m_stackAllocator.Free(slotBodies);
+	m_stackAllocator.Free(staticBodies);
 
 	{
 		b2Timer timer;
-		// Synchronize fixtures, check for out of range bodies.
-		for (b2Body* b = m_bodyList; b; b = b->GetNext())
+		// Synchronize fixtures of the bodies that were solved. The others did not move.
+		for (int32 i = 0; i < bodyCount; ++i)
 		{
-			// If a body was not in an island then it did not move.
-			if ((b->m_flags & b2Body::e_islandFlag) == 0)
-			{
-				continue;
-			}
-
-			if (b->GetType() == b2_staticBody)
-			{
-				continue;
-			}
-
 			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
+			bodies[i]->SynchronizeFixtures();
 		}
 
 		// Look for new contacts.
 		m_contactManager.FindNewContacts();
 		m_profile.broadphase = timer.GetMilliseconds();
 	}
+
+	m_stackAllocator.Free(bodies);
+	m_stackAllocator.Free(awakeIslands);
+
+#if defined(b2DEBUG)
+	m_islandManager.Validate();
+#endif
 }
 
 // Find TOI contacts and solve them.
+// Can this contact have a TOI event? At least one body must be active and one
+// must be a bullet, kinematic or static.
+static bool b2IsTOICandidate(const b2Contact* c)
+{
+	const b2Fixture* fA = c->GetFixtureA();
+	const b2Fixture* fB = c->GetFixtureB();
+
+	// Is there a sensor?
+	if (fA->IsSensor() || fB->IsSensor())
+	{
+		return false;
+	}
+
+	const b2Body* bA = fA->GetBody();
+	const b2Body* bB = fB->GetBody();
+
+	b2BodyType typeA = bA->GetType();
+	b2BodyType typeB = bB->GetType();
+	b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
+
+	bool activeA = bA->IsAwake() && typeA != b2_staticBody;
+	bool activeB = bB->IsAwake() && typeB != b2_staticBody;
+
+	// Is at least one body active (awake and dynamic or kinematic)?
+	if (activeA == false && activeB == false)
+	{
+		return false;
+	}
+
+	bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
+	bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
+
+	// Are these two non-bullet dynamic bodies?
+	if (collideA == false && collideB == false)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Compute the TOI of a contact as a fraction of the step. The sweeps are put onto
+// the same time interval first.
+static float b2ComputeTOI(const b2Contact* c, b2Sweep sweepA, b2Sweep sweepB)
+{
+	// A static body does not move, so its sweep holds at any time. Its alpha0 may be
+	// ahead from an earlier TOI island and must not advance the other sweep.
+	if (c->GetFixtureA()->GetBody()->GetType() == b2_staticBody)
+	{
+		sweepA.alpha0 = sweepB.alpha0;
+	}
+	else if (c->GetFixtureB()->GetBody()->GetType() == b2_staticBody)
+	{
+		sweepB.alpha0 = sweepA.alpha0;
+	}
+
+	float alpha0 = sweepA.alpha0;
+
+	if (sweepA.alpha0 < sweepB.alpha0)
+	{
+		alpha0 = sweepB.alpha0;
+		sweepA.Advance(alpha0);
+	}
+	else if (sweepB.alpha0 < sweepA.alpha0)
+	{
+		alpha0 = sweepA.alpha0;
+		sweepB.Advance(alpha0);
+	}
+
+	b2Assert(alpha0 < 1.0f);
+
+	// Compute the time of impact in interval [0, minTOI]
+	b2TOIInput input;
+	input.proxyA.Set(c->GetFixtureA()->GetShape(), c->GetChildIndexA());
+	input.proxyB.Set(c->GetFixtureB()->GetShape(), c->GetChildIndexB());
+	input.sweepA = sweepA;
+	input.sweepB = sweepB;
+	input.tMax = 1.0f;
+
+	b2TOIOutput output;
+	b2TimeOfImpact(&output, &input);
+
+	// Beta is the fraction of the remaining portion of the .
+	float beta = output.t;
+	if (output.state == b2TOIOutput::e_touching)
+	{
+		return b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
+	}
+
+	return 1.0f;
+}
+
 void b2World::SolveTOI(const b2TimeStep& step)
 {
 	b2Island island(2 * b2_maxTOIContacts, b2_maxTOIContacts, 0, &m_stackAllocator, m_contactManager.m_contactListener);
+	island.m_states = &m_bodyStates;
 
 	if (m_stepComplete)
 	{
 		for (b2Body* b = m_bodyList; b; b = b->m_next)
 		{
 			b->m_flags &= ~b2Body::e_islandFlag;
-			b->m_sweep.alpha0 = 0.0f;
+			b->m_alpha0 = 0.0f;
 		}
 
 		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
@@ -603,6 +1026,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		}
 	}
 
+	if (m_batchedTOI && m_subStepping == false)
+	{
+		SolveTOIBatched(step, &island);
+		return;
+	}
+
 	// Find TOI events and solve them.
 	for (;;)
 	{
@@ -632,82 +1061,25 @@ void b2World::SolveTOI(const b2TimeStep& step)
 			}
 			else
 			{
-				b2Fixture* fA = c->GetFixtureA();
-				b2Fixture* fB = c->GetFixtureB();
-
-				// Is there a sensor?
-				if (fA->IsSensor() || fB->IsSensor())
-				{
-					continue;
-				}
-
-				b2Body* bA = fA->GetBody();
-				b2Body* bB = fB->GetBody();
-
-				b2BodyType typeA = bA->m_type;
-				b2BodyType typeB = bB->m_type;
-				b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
-
-				bool activeA = bA->IsAwake() && typeA != b2_staticBody;
-				bool activeB = bB->IsAwake() && typeB != b2_staticBody;
-
-				// Is at least one body active (awake and dynamic or kinematic)?
-				if (activeA == false && activeB == false)
+				if (b2IsTOICandidate(c) == false)
 				{
 					continue;
 				}
 
-				bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
-				bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
-
-				// Are these two non-bullet dynamic bodies?
-				if (collideA == false && collideB == false)
-				{
-					continue;
-				}
+				b2Body* bA = c->GetFixtureA()->GetBody();
+				b2Body* bB = c->GetFixtureB()->GetBody();
 
-				// Compute the TOI for this contact.
 				// Put the sweeps onto the same time interval.
-				float alpha0 = bA->m_sweep.alpha0;
-
-				if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
-				{
-					alpha0 = bB->m_sweep.alpha0;
-					bA->m_sweep.Advance(alpha0);
-				}
-				else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
-				{
-					alpha0 = bA->m_sweep.alpha0;
-					bB->m_sweep.Advance(alpha0);
-				}
-
-				b2Assert(alpha0 < 1.0f);
-
-				int32 indexA = c->GetChildIndexA();
-				int32 indexB = c->GetChildIndexB();
-
-				// Compute the time of impact in interval [0, minTOI]
-				b2TOIInput input;
-				input.proxyA.Set(fA->GetShape(), indexA);
-				input.proxyB.Set(fB->GetShape(), indexB);
-				input.sweepA = bA->m_sweep;
-				input.sweepB = bB->m_sweep;
-				input.tMax = 1.0f;
-
-				b2TOIOutput output;
-				b2TimeOfImpact(&output, &input);
-
-				// Beta is the fraction of the remaining portion of the .
-				float beta = output.t;
-				if (output.state == b2TOIOutput::e_touching)
+				if (bA->m_alpha0 < bB->m_alpha0)
 				{
-					alpha = b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
+					bA->AdvanceSweep(bB->m_alpha0);
 				}
-				else
+				else if (bB->m_alpha0 < bA->m_alpha0)
 				{
-					alpha = 1.0f;
+					bB->AdvanceSweep(bA->m_alpha0);
 				}
 
+				alpha = b2ComputeTOI(c, bA->GetSweep(), bB->GetSweep());
 				c->m_toi = alpha;
 				c->m_flags |= b2Contact::e_toiFlag;
 			}
@@ -727,185 +1099,397 @@ void b2World::SolveTOI(const b2TimeStep& step)
 			break;
 		}
 
-		// Advance the bodies to the TOI.
-		b2Fixture* fA = minContact->GetFixtureA();
-		b2Fixture* fB = minContact->GetFixtureB();
-		b2Body* bA = fA->GetBody();
-		b2Body* bB = fB->GetBody();
+		if (SolveTOIEvent(step, &island, minContact, minAlpha) == false)
+		{
+			continue;
+		}
 
-		b2Sweep backup1 = bA->m_sweep;
-		b2Sweep backup2 = bB->m_sweep;
+		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
+		// Also, some contacts can be destroyed.
+		m_contactManager.FindNewContacts();
+
+		if (m_subStepping)
+		{
+			m_stepComplete = false;
+			break;
+		}
+	}
+}
+
+// A TOI event found by the batched solver.
+struct b2TOIEvent
+{
+	b2Contact* contact;
+	float alpha;
+	int32 order;
+};
+
+static bool b2TOIEventLessThan(const b2TOIEvent& a, const b2TOIEvent& b)
+{
+	if (a.alpha < b.alpha)
+	{
+		return true;
+	}
 
-		bA->Advance(minAlpha);
-		bB->Advance(minAlpha);
+	return a.alpha == b.alpha && a.order < b.order;
+}
 
-		// The TOI contact likely has some new contact points.
-		minContact->Update(m_contactManager.m_contactListener);
-		minContact->m_flags &= ~b2Contact::e_toiFlag;
-		++minContact->m_toiCount;
+// Computes the TOI of the candidate contacts that have none cached. The sweeps are
+// copied, so the bodies are only read.
+class b2ComputeTOITask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		B2_NOT_USED(threadIndex);
 
-		// Is the contact solid?
-		if (minContact->IsEnabled() == false || minContact->IsTouching() == false)
+		for (int32 i = begin; i < end; ++i)
 		{
-			// Restore the sweeps.
-			minContact->SetEnabled(false);
-			bA->m_sweep = backup1;
-			bB->m_sweep = backup2;
-			bA->SynchronizeTransform();
-			bB->SynchronizeTransform();
-			continue;
+			b2Contact* c = contacts[i];
+			if (c->m_flags & b2Contact::e_toiFlag)
+			{
+				continue;
+			}
+
+			const b2Body* bA = c->GetFixtureA()->GetBody();
+			const b2Body* bB = c->GetFixtureB()->GetBody();
+			c->m_toi = b2ComputeTOI(c, bA->GetSweep(), bB->GetSweep());
+			c->m_flags |= b2Contact::e_toiFlag;
 		}
+	}
 
-		bA->SetAwake(true);
-		bB->SetAwake(true);
+	b2Contact** contacts;
+};
 
-		// Build the island
-		island.Clear();
-		island.Add(bA);
-		island.Add(bB);
-		island.Add(minContact);
+void b2World::SolveTOIBatched(const b2TimeStep& step, b2Island* island)
+{
+	int32 capacity = m_contactManager.m_contactCount;
+	b2Contact** candidates = (b2Contact**)m_stackAllocator.Allocate(capacity * sizeof(b2Contact*));
+	b2TOIEvent* events = (b2TOIEvent*)m_stackAllocator.Allocate(capacity * sizeof(b2TOIEvent));
 
-		bA->m_flags |= b2Body::e_islandFlag;
-		bB->m_flags |= b2Body::e_islandFlag;
-		minContact->m_flags |= b2Contact::e_islandFlag;
+	for (;;)
+	{
+		// New contacts from the previous batch may need more room.
+		if (m_contactManager.m_contactCount > capacity)
+		{
+			m_stackAllocator.Free(events);
+			m_stackAllocator.Free(candidates);
+			capacity = 2 * m_contactManager.m_contactCount;
+			candidates = (b2Contact**)m_stackAllocator.Allocate(capacity * sizeof(b2Contact*));
+			events = (b2TOIEvent*)m_stackAllocator.Allocate(capacity * sizeof(b2TOIEvent));
+		}
 
-		// Get contacts on bodyA and bodyB.
-		b2Body* bodies[2] = {bA, bB};
-		for (int32 i = 0; i < 2; ++i)
+		int32 candidateCount = 0;
+		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
 		{
-			b2Body* body = bodies[i];
-			if (body->m_type == b2_dynamicBody)
+			// Is this contact disabled? Prevent excessive sub-stepping.
+			if (c->IsEnabled() == false || c->m_toiCount > b2_maxSubSteps)
 			{
-				for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
-				{
-					if (island.m_bodyCount == island.m_bodyCapacity)
-					{
-						break;
-					}
-
-					if (island.m_contactCount == island.m_contactCapacity)
-					{
-						break;
-					}
+				continue;
+			}
 
-					b2Contact* contact = ce->contact;
+			if ((c->m_flags & b2Contact::e_toiFlag) || b2IsTOICandidate(c))
+			{
+				candidates[candidateCount++] = c;
+			}
+		}
 
-					// Has this contact already been added to the island?
-					if (contact->m_flags & b2Contact::e_islandFlag)
-					{
-						continue;
-					}
+		b2ComputeTOITask task;
+		task.contacts = candidates;
+		if (m_threadPool)
+		{
+			m_threadPool->ParallelFor(&task, candidateCount, 16);
+		}
+		else
+		{
+			task.Execute(0, candidateCount, 0);
+		}
 
-					// Only add static, kinematic, or bullet bodies.
-					b2Body* other = ce->other;
-					if (other->m_type == b2_dynamicBody &&
-						body->IsBullet() == false && other->IsBullet() == false)
-					{
-						continue;
-					}
+		int32 eventCount = 0;
+		for (int32 i = 0; i < candidateCount; ++i)
+		{
+			b2Contact* c = candidates[i];
+			if (c->m_toi <= 1.0f - 10.0f * b2_epsilon)
+			{
+				b2TOIEvent* event = events + eventCount++;
+				event->contact = c;
+				event->alpha = c->m_toi;
+				event->order = i;
+			}
+		}
 
-					// Skip sensors.
-					bool sensorA = contact->m_fixtureA->m_isSensor;
-					bool sensorB = contact->m_fixtureB->m_isSensor;
-					if (sensorA || sensorB)
-					{
-						continue;
-					}
+		if (eventCount == 0)
+		{
+			// No more TOI events. Done!
+			m_stepComplete = true;
+			break;
+		}
 
-					// Tentatively advance the body to the TOI.
-					b2Sweep backup = other->m_sweep;
-					if ((other->m_flags & b2Body::e_islandFlag) == 0)
-					{
-						other->Advance(minAlpha);
-					}
+		std::sort(events, events + eventCount, b2TOIEventLessThan);
 
-					// Update the contact points
-					contact->Update(m_contactManager.m_contactListener);
+		// Solve the events in time order, skipping any with a body that an earlier
+		// event of this batch moved or that touches such a body. Those get a new TOI
+		// in the next batch. The bodies of a skipped event are held back too, so later
+		// events do not advance them past the skipped one.
+		int32 solvedCount = 0;
+		for (int32 i = 0; i < eventCount; ++i)
+		{
+			b2Contact* c = events[i].contact;
+			b2Body* bA = c->GetFixtureA()->GetBody();
+			b2Body* bB = c->GetFixtureB()->GetBody();
+			bool heldBack = ((bA->m_flags | bB->m_flags) & b2Body::e_toiFlag) != 0;
+			b2Body* bodies[2] = { bA, bB };
+			for (int32 j = 0; j < 2 && heldBack == false; ++j)
+			{
+				if (bodies[j]->m_type == b2_staticBody)
+				{
+					continue;
+				}
 
-					// Was the contact disabled by the user?
-					if (contact->IsEnabled() == false)
+				for (b2ContactEdge* ce = bodies[j]->m_contactList; ce; ce = ce->next)
+				{
+					if (ce->other->m_flags & b2Body::e_toiFlag)
 					{
-						other->m_sweep = backup;
-						other->SynchronizeTransform();
-						continue;
+						heldBack = true;
+						break;
 					}
+				}
+			}
 
-					// Are there contact points?
-					if (contact->IsTouching() == false)
-					{
-						other->m_sweep = backup;
-						other->SynchronizeTransform();
-						continue;
-					}
+			if (heldBack)
+			{
+				if (bA->m_type != b2_staticBody)
+				{
+					bA->m_flags |= b2Body::e_toiFlag;
+				}
 
-					// Add the contact to the island
-					contact->m_flags |= b2Contact::e_islandFlag;
-					island.Add(contact);
+				if (bB->m_type != b2_staticBody)
+				{
+					bB->m_flags |= b2Body::e_toiFlag;
+				}
 
-					// Has the other body already been added to the island?
-					if (other->m_flags & b2Body::e_islandFlag)
-					{
-						continue;
-					}
-					
-					// Add the other body to the island.
-					other->m_flags |= b2Body::e_islandFlag;
+				continue;
+			}
 
-					if (other->m_type != b2_staticBody)
-					{
-						other->SetAwake(true);
-					}
+			if (SolveTOIEvent(step, island, c, events[i].alpha) == false)
+			{
+				continue;
+			}
 
-					island.Add(other);
+			for (int32 j = 0; j < island->m_bodyCount; ++j)
+			{
+				b2Body* body = island->m_bodies[j];
+				if (body->m_type != b2_staticBody)
+				{
+					body->m_flags |= b2Body::e_toiFlag;
 				}
 			}
-		}
 
-		b2TimeStep subStep;
-		subStep.dt = (1.0f - minAlpha) * step.dt;
-		subStep.inv_dt = 1.0f / subStep.dt;
-		subStep.dtRatio = 1.0f;
-		subStep.positionIterations = 20;
-		subStep.velocityIterations = step.velocityIterations;
-		subStep.warmStarting = false;
-		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
+			++solvedCount;
+		}
 
-		// Reset island flags and synchronize broad-phase proxies.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		if (solvedCount > 0)
 		{
-			b2Body* body = island.m_bodies[i];
-			body->m_flags &= ~b2Body::e_islandFlag;
-
-			if (body->m_type != b2_dynamicBody)
+			for (b2Body* b = m_bodyList; b; b = b->m_next)
 			{
-				continue;
+				b->m_flags &= ~b2Body::e_toiFlag;
 			}
 
-			body->SynchronizeFixtures();
+			// Commit fixture proxy movements to the broad-phase so that new contacts are created.
+			// Also, some contacts can be destroyed.
+			m_contactManager.FindNewContacts();
+		}
+	}
+
+	m_stackAllocator.Free(events);
+	m_stackAllocator.Free(candidates);
+}
+
+bool b2World::SolveTOIEvent(const b2TimeStep& step, b2Island* island, b2Contact* minContact, float minAlpha)
+{
+	// Advance the bodies to the TOI.
+	b2Fixture* fA = minContact->GetFixtureA();
+	b2Fixture* fB = minContact->GetFixtureB();
+	b2Body* bA = fA->GetBody();
+	b2Body* bB = fB->GetBody();
+
+	b2Sweep backup1 = bA->GetSweep();
+	b2Sweep backup2 = bB->GetSweep();
+
+	bA->Advance(minAlpha);
+	bB->Advance(minAlpha);
+
+	// The TOI contact likely has some new contact points.
+	minContact->Update(m_contactManager.m_contactListener);
+	minContact->m_flags &= ~b2Contact::e_toiFlag;
+	++minContact->m_toiCount;
+
+	// Is the contact solid?
+	if (minContact->IsEnabled() == false || minContact->IsTouching() == false)
+	{
+		// Restore the sweeps.
+		minContact->SetEnabled(false);
+		bA->SetSweep(backup1);
+		bB->SetSweep(backup2);
+		bA->SynchronizeTransform();
+		bB->SynchronizeTransform();
+		return false;
+	}
+
+	++m_profile.toiEventCount;
+
+	bA->SetAwake(true);
+	bB->SetAwake(true);
+
+	// Build the island
+	island->Clear();
+	island->Add(bA);
+	island->Add(bB);
+	island->Add(minContact);
 
-			// Invalidate all contact TOIs on this displaced body.
+	bA->m_flags |= b2Body::e_islandFlag;
+	bB->m_flags |= b2Body::e_islandFlag;
+	minContact->m_flags |= b2Contact::e_islandFlag;
+
+	// Get contacts on bodyA and bodyB.
+	b2Body* bodies[2] = {bA, bB};
+	for (int32 i = 0; i < 2; ++i)
+	{
+		b2Body* body = bodies[i];
+		if (body->m_type == b2_dynamicBody)
+		{
 			for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
 			{
-				ce->contact->m_flags &= ~(b2Contact::e_toiFlag | b2Contact::e_islandFlag);
+				if (island->m_bodyCount == island->m_bodyCapacity)
+				{
+					break;
+				}
+
+				if (island->m_contactCount == island->m_contactCapacity)
+				{
+					break;
+				}
+
+				b2Contact* contact = ce->contact;
+
+				// Has this contact already been added to the island?
+				if (contact->m_flags & b2Contact::e_islandFlag)
+				{
+					continue;
+				}
+
+				// Only add static, kinematic, or bullet bodies.
+				b2Body* other = ce->other;
+				if (other->m_type == b2_dynamicBody &&
+					body->IsBullet() == false && other->IsBullet() == false)
+				{
+					continue;
+				}
+
+				// Skip sensors.
+				bool sensorA = contact->m_fixtureA->m_isSensor;
+				bool sensorB = contact->m_fixtureB->m_isSensor;
+				if (sensorA || sensorB)
+				{
+					continue;
+				}
+
+				// Tentatively advance the body to the TOI.
+				b2Sweep backup = other->GetSweep();
+				if ((other->m_flags & b2Body::e_islandFlag) == 0)
+				{
+					other->Advance(minAlpha);
+				}
+
+				// Update the contact points
+				contact->Update(m_contactManager.m_contactListener);
+
+				// Was the contact disabled by the user?
+				if (contact->IsEnabled() == false)
+				{
+					other->SetSweep(backup);
+					other->SynchronizeTransform();
+					continue;
+				}
+
+				// Are there contact points?
+				if (contact->IsTouching() == false)
+				{
+					other->SetSweep(backup);
+					other->SynchronizeTransform();
+					continue;
+				}
+
+				// Add the contact to the island
+				contact->m_flags |= b2Contact::e_islandFlag;
+				island->Add(contact);
+
+				// Has the other body already been added to the island?
+				if (other->m_flags & b2Body::e_islandFlag)
+				{
+					continue;
+				}
+				
+				// Add the other body to the island.
+				other->m_flags |= b2Body::e_islandFlag;
+
+				if (other->m_type != b2_staticBody)
+				{
+					other->SetAwake(true);
+				}
+
+				island->Add(other);
 			}
 		}
+	}
 
-		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
-		// Also, some contacts can be destroyed.
-		m_contactManager.FindNewContacts();
+	b2TimeStep subStep;
+	subStep.dt = (1.0f - minAlpha) * step.dt;
+	subStep.inv_dt = 1.0f / subStep.dt;
+	subStep.dtRatio = 1.0f;
+	subStep.positionIterations = 20;
+	subStep.velocityIterations = step.velocityIterations;
+	subStep.warmStarting = false;
+	subStep.wideContactSolver = false;
+	subStep.subStepCount = 0;
+	island->SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
+
+	// Reset island flags and synchronize broad-phase proxies.
+	for (int32 i = 0; i < island->m_bodyCount; ++i)
+	{
+		b2Body* body = island->m_bodies[i];
+		body->m_flags &= ~b2Body::e_islandFlag;
 
-		if (m_subStepping)
+		if (body->m_type != b2_dynamicBody)
 		{
-			m_stepComplete = false;
-			break;
+			continue;
+		}
+
+		body->SynchronizeFixtures();
+
+		// Invalidate all contact TOIs on this displaced body.
+		for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+		{
+			ce->contact->m_flags &= ~(b2Contact::e_toiFlag | b2Contact::e_islandFlag);
 		}
 	}
+
+	return true;
 }
 
 void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 {
 	b2Timer stepTimer;
 
+	// Advance the clock of the profile history in small increments, so it keeps
+	// sub-millisecond precision in long runs.
+	m_profileTime += m_profileTimer.GetMilliseconds();
+	m_profileTimer.Reset();
+
+	m_contactManager.ClearStepEvents();
+	m_contactManager.ClearCounters();
+	m_profile.toiEventCount = 0;
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_newContacts)
 	{
@@ -931,7 +1515,14 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideContactSolver = m_wideContactSolver && m_softStep == false;
+	step.subStepCount = m_softStep ? m_softStepCount : 0;
 	
+	// The start of each phase within the step, for the profile history.
+	float collideStart = stepTimer.GetMilliseconds();
+	float solveStart = collideStart;
+	float solveTOIStart = collideStart;
+
 	// Update contacts. This is where some contacts are destroyed.
 	{
 		b2Timer timer;
@@ -940,16 +1531,23 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 	}
 
 	// Integrate velocities, solve velocity constraints, and integrate positions.
+	m_profile.solve = 0.0f;
+	m_profile.broadphase = 0.0f;
+	m_profile.islandCount = 0;
+	m_profile.maxIslandSize = 0;
 	if (m_stepComplete && step.dt > 0.0f)
 	{
+		solveStart = stepTimer.GetMilliseconds();
 		b2Timer timer;
 		Solve(step);
 		m_profile.solve = timer.GetMilliseconds();
 	}
 
 	// Handle TOI events.
+	m_profile.solveTOI = 0.0f;
 	if (m_continuousPhysics && step.dt > 0.0f)
 	{
+		solveTOIStart = stepTimer.GetMilliseconds();
 		b2Timer timer;
 		SolveTOI(step);
 		m_profile.solveTOI = timer.GetMilliseconds();
@@ -965,17 +1563,176 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 		ClearForces();
 	}
 
+	// Every allocation of the step has been freed. Reset puts the stacks back on their
+	// first chunk even if a free was missed.
+	b2Assert(m_stackAllocator.GetEntryCount() == 0);
+	m_stackAllocator.Reset();
+	for (int32 i = 0; i < m_workerStackAllocatorCount; ++i)
+	{
+		b2Assert(m_workerStackAllocators[i].GetEntryCount() == 0);
+		m_workerStackAllocators[i].Reset();
+	}
+
 	m_locked = false;
 
+	const b2ContactManager& cm = m_contactManager;
+	m_profile.updatePairs = cm.m_updatePairsTime;
+	m_profile.pairCount = cm.m_pairCount;
+	m_profile.proxyMoveCount = cm.m_moveCount;
+	m_profile.contactUpdateCount = cm.m_collideCount;
+	m_profile.contactCreateCount = cm.m_createCount;
+	m_profile.contactDestroyCount = cm.m_destroyCount;
+	m_profile.treeHeight = cm.m_broadPhase.GetTreeHeight();
+
+	m_contactManager.m_stepEndEventCount = m_contactManager.m_endEventCount;
+
 	m_profile.step = stepTimer.GetMilliseconds();
+
+	if (m_profileCapacity > 0)
+	{
+		b2ProfileRecord* record = m_profileHistory + m_profileNext;
+		record->profile = m_profile;
+		record->stepIndex = m_stepIndex;
+		record->startTime = m_profileTime;
+		record->collideStart = collideStart;
+		record->solveStart = solveStart;
+		record->solveTOIStart = solveTOIStart;
+
+		m_profileNext = (m_profileNext + 1) % m_profileCapacity;
+		m_profileCount = b2Min(m_profileCount + 1, m_profileCapacity);
+	}
+
+	++m_stepIndex;
+}
+
+void b2World::SetProfileHistory(int32 capacity)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	if (m_profileHistory)
+	{
+		b2Free(m_profileHistory);
+		m_profileHistory = nullptr;
+	}
+
+	m_profileCapacity = b2Max(capacity, 0);
+	m_profileCount = 0;
+	m_profileNext = 0;
+
+	if (m_profileCapacity > 0)
+	{
+		m_profileHistory = (b2ProfileRecord*)b2Alloc(m_profileCapacity * sizeof(b2ProfileRecord));
+	}
+}
+
+int32 b2World::GetProfileHistoryCount() const
+{
+	return m_profileCount;
+}
+
+const b2Profile& b2World::GetProfileHistory(int32 index) const
+{
+	b2Assert(0 <= index && index < m_profileCount);
+	int32 first = m_profileNext - m_profileCount + m_profileCapacity;
+	return m_profileHistory[(first + index) % m_profileCapacity].profile;
+}
+
+bool b2World::WriteProfileCSV(const char* fileName) const
+{
+	FILE* file = fopen(fileName, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "index,time,step,collide,solve,solveInit,solveVelocity,solvePosition,broadphase,updatePairs,solveTOI,"
+		"pairCount,proxyMoveCount,contactUpdateCount,contactCreateCount,contactDestroyCount,"
+		"islandCount,maxIslandSize,toiEventCount,treeHeight,colorCount,colorOverflow\n");
+
+	int32 first = m_profileNext - m_profileCount + m_profileCapacity;
+	for (int32 i = 0; i < m_profileCount; ++i)
+	{
+		const b2ProfileRecord* r = m_profileHistory + (first + i) % m_profileCapacity;
+		const b2Profile& p = r->profile;
+		fprintf(file, "%d,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%g,%g\n",
+			r->stepIndex, r->startTime, p.step, p.collide, p.solve, p.solveInit, p.solveVelocity, p.solvePosition,
+			p.broadphase, p.updatePairs, p.solveTOI, p.pairCount, p.proxyMoveCount, p.contactUpdateCount,
+			p.contactCreateCount, p.contactDestroyCount, p.islandCount, p.maxIslandSize, p.toiEventCount,
+			p.treeHeight, p.colorCount, p.colorOverflow);
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Write a complete event of the Chrome trace format. Times are in microseconds.
+static void b2WriteTraceEvent(FILE* file, const char* name, double start, float duration)
+{
+	fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+		name, 1000.0 * start, 1000.0 * duration);
+}
+
+bool b2World::WriteProfileTrace(const char* fileName) const
+{
+	FILE* file = fopen(fileName, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"b2World\"}}");
+
+	int32 first = m_profileNext - m_profileCount + m_profileCapacity;
+	for (int32 i = 0; i < m_profileCount; ++i)
+	{
+		const b2ProfileRecord* r = m_profileHistory + (first + i) % m_profileCapacity;
+		const b2Profile& p = r->profile;
+
+		// The step carries the counters. Chrome shows them when the step is selected.
+		fprintf(file, ",\n{\"name\":\"step\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+			"\"index\":%d,\"updatePairs\":%.4f,\"pairCount\":%d,\"proxyMoveCount\":%d,\"contactUpdateCount\":%d,"
+			"\"contactCreateCount\":%d,\"contactDestroyCount\":%d,\"islandCount\":%d,\"maxIslandSize\":%d,"
+			"\"toiEventCount\":%d,\"treeHeight\":%d}}",
+			1000.0 * r->startTime, 1000.0 * p.step, r->stepIndex, p.updatePairs, p.pairCount, p.proxyMoveCount,
+			p.contactUpdateCount, p.contactCreateCount, p.contactDestroyCount, p.islandCount, p.maxIslandSize,
+			p.toiEventCount, p.treeHeight);
+
+		b2WriteTraceEvent(file, "collide", r->startTime + r->collideStart, p.collide);
+
+		if (p.solve > 0.0f)
+		{
+			double solveStart = r->startTime + r->solveStart;
+			b2WriteTraceEvent(file, "solve", solveStart, p.solve);
+
+			// Synchronizing the fixtures and finding new contacts ends the solve.
+			b2WriteTraceEvent(file, "broadphase", solveStart + p.solve - p.broadphase, p.broadphase);
+		}
+
+		if (p.solveTOI > 0.0f)
+		{
+			b2WriteTraceEvent(file, "solveTOI", r->startTime + r->solveTOIStart, p.solveTOI);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
 }
 
 void b2World::ClearForces()
 {
-	for (b2Body* body = m_bodyList; body; body = body->GetNext())
+	int32 count = m_bodyStates.count;
+	b2Vec2* forces = m_bodyStates.forces;
+	float* torques = m_bodyStates.torques;
+	for (int32 i = 0; i < count; ++i)
 	{
-		body->m_force.SetZero();
-		body->m_torque = 0.0f;
+		forces[i].SetZero();
+		torques[i] = 0.0f;
 	}
 }
 
@@ -999,16 +1756,48 @@ void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const
 	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
 }
 
-struct b2WorldRayCastWrapper
+int32 b2World::QueryAABBBatch(const b2AABB* aabbs, int32 count, b2FixtureQueryHit* hits, int32 hitCapacity) const
 {
-	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
-	{
-		void* userData = broadPhase->GetUserData(proxyId);
-		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
-		b2Fixture* fixture = proxy->fixture;
-		int32 index = proxy->childIndex;
-		b2RayCastOutput output;
-		bool hit = fixture->RayCast(&output, input, index);
+	const b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+
+	// The pool is not re-entrant, so queries from inside a step run on the calling thread.
+	b2ThreadPool* threadPool = IsLocked() ? nullptr : m_threadPool;
+
+	b2TreeQueryHit* treeHits = nullptr;
+	if (hitCapacity > 0)
+	{
+		treeHits = (b2TreeQueryHit*)b2Alloc(hitCapacity * sizeof(b2TreeQueryHit));
+	}
+
+	int32 hitCount = broadPhase->QueryBatch(aabbs, count, treeHits, hitCapacity, threadPool);
+
+	int32 writeCount = b2Min(hitCount, hitCapacity);
+	for (int32 i = 0; i < writeCount; ++i)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(treeHits[i].proxyId);
+		hits[i].queryIndex = treeHits[i].queryIndex;
+		hits[i].fixture = proxy->fixture;
+		hits[i].childIndex = proxy->childIndex;
+	}
+
+	if (treeHits)
+	{
+		b2Free(treeHits);
+	}
+
+	return hitCount;
+}
+
+struct b2WorldRayCastWrapper
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		void* userData = broadPhase->GetUserData(proxyId);
+		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
+		b2Fixture* fixture = proxy->fixture;
+		int32 index = proxy->childIndex;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, index);
 
 		if (hit)
 		{
@@ -1036,6 +1825,344 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
 }
 
+// Closest hit ray casts for b2World::RayCastBatch. Circles and polygons are tested
+// against all the rays of a group at once with the same math as their RayCast
+// functions. The other shapes are cast one ray at a time.
+class b2WorldRayCastBatchWrapper : public b2TreeRayCastBatchCallback
+{
+public:
+	void RayCastProxy(int32 proxyId, int32 baseIndex, uint32 laneMask, float* maxFractions) override
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		if (fixture->IsSensor())
+		{
+			return;
+		}
+
+		const b2Transform& xf = fixture->GetBody()->GetTransform();
+
+		// The rays of the group. Lanes outside the mask stay zero and are ignored.
+		b2FloatW p1X = b2ZeroW(), p1Y = b2ZeroW();
+		b2FloatW p2X = b2ZeroW(), p2Y = b2ZeroW();
+		b2FloatW maxFraction = b2ZeroW();
+
+		switch (fixture->GetType())
+		{
+		case b2Shape::e_circle:
+			{
+				const b2CircleShape* circle = (const b2CircleShape*)fixture->GetShape();
+				b2Vec2 position = xf.p + b2Mul(xf.q, circle->m_p);
+				LoadRays(baseIndex, laneMask, maxFractions, b2Vec2_zero, b2Rot(0.0f), &p1X, &p1Y, &p2X, &p2Y, &maxFraction);
+
+				b2FloatW sX = b2SubW(p1X, b2SplatW(position.x));
+				b2FloatW sY = b2SubW(p1Y, b2SplatW(position.y));
+				b2FloatW b = b2SubW(b2AddW(b2MulW(sX, sX), b2MulW(sY, sY)), b2SplatW(circle->m_radius * circle->m_radius));
+
+				// Solve quadratic equation.
+				b2FloatW rX = b2SubW(p2X, p1X);
+				b2FloatW rY = b2SubW(p2Y, p1Y);
+				b2FloatW c = b2AddW(b2MulW(sX, rX), b2MulW(sY, rY));
+				b2FloatW rr = b2AddW(b2MulW(rX, rX), b2MulW(rY, rY));
+				b2FloatW sigma = b2SubW(b2MulW(c, c), b2MulW(rr, b));
+
+				// Negative discriminant, short segment and intersection off the segment.
+				b2FloatW a = b2NegW(b2AddW(c, b2SqrtW(b2MaxW(sigma, b2ZeroW()))));
+				b2FloatW valid = b2AndW(b2GreaterEqualW(sigma, b2ZeroW()), b2GreaterEqualW(rr, b2SplatW(b2_epsilon)));
+				valid = b2AndW(valid, b2GreaterEqualW(a, b2ZeroW()));
+				valid = b2AndW(valid, b2GreaterEqualW(b2MulW(maxFraction, rr), a));
+
+				uint32 hitMask = b2MaskBitsW(valid) & laneMask;
+				for (int32 lane = 0; hitMask != 0; ++lane, hitMask >>= 1)
+				{
+					if (hitMask & 1)
+					{
+						float fraction = b2GetLaneW(a, lane) / b2GetLaneW(rr, lane);
+						b2Vec2 normal(b2GetLaneW(sX, lane) + fraction * b2GetLaneW(rX, lane),
+									  b2GetLaneW(sY, lane) + fraction * b2GetLaneW(rY, lane));
+						normal.Normalize();
+						Report(fixture, baseIndex + lane, fraction, normal, maxFractions + lane);
+					}
+				}
+			}
+			break;
+
+		case b2Shape::e_polygon:
+			{
+				// Put the rays into the polygon's frame of reference.
+				const b2PolygonShape* polygon = (const b2PolygonShape*)fixture->GetShape();
+				LoadRays(baseIndex, laneMask, maxFractions, xf.p, xf.q, &p1X, &p1Y, &p2X, &p2Y, &maxFraction);
+				b2FloatW dX = b2SubW(p2X, p1X);
+				b2FloatW dY = b2SubW(p2Y, p1Y);
+
+				b2FloatW lower = b2ZeroW();
+				b2FloatW upper = maxFraction;
+				b2FloatW normalX = b2ZeroW(), normalY = b2ZeroW();
+				b2FloatW entered = b2ZeroW();
+				b2FloatW missed = b2ZeroW();
+
+				for (int32 i = 0; i < polygon->m_count; ++i)
+				{
+					b2FloatW nX = b2SplatW(polygon->m_normals[i].x);
+					b2FloatW nY = b2SplatW(polygon->m_normals[i].y);
+					b2FloatW numerator = b2AddW(b2MulW(nX, b2SubW(b2SplatW(polygon->m_vertices[i].x), p1X)),
+												b2MulW(nY, b2SubW(b2SplatW(polygon->m_vertices[i].y), p1Y)));
+					b2FloatW denominator = b2AddW(b2MulW(nX, dX), b2MulW(nY, dY));
+					b2FloatW fraction = b2DivW(numerator, denominator);
+
+					// A ray parallel to an edge misses if it starts outside of it.
+					b2FloatW parallel = b2AndW(b2GreaterEqualW(denominator, b2ZeroW()), b2GreaterEqualW(b2ZeroW(), denominator));
+					missed = b2OrW(missed, b2AndW(parallel, b2LessW(numerator, b2ZeroW())));
+
+					// The segment enters this half-space.
+					b2FloatW enter = b2AndW(b2LessW(denominator, b2ZeroW()), b2LessW(numerator, b2MulW(lower, denominator)));
+					lower = b2BlendW(lower, fraction, enter);
+					normalX = b2BlendW(normalX, nX, enter);
+					normalY = b2BlendW(normalY, nY, enter);
+					entered = b2OrW(entered, enter);
+
+					// The segment exits this half-space.
+					b2FloatW exit = b2AndW(b2LessW(b2ZeroW(), denominator), b2LessW(numerator, b2MulW(upper, denominator)));
+					upper = b2BlendW(upper, fraction, exit);
+
+					missed = b2OrW(missed, b2LessW(upper, lower));
+				}
+
+				uint32 hitMask = b2MaskBitsW(entered) & ~b2MaskBitsW(missed) & laneMask;
+				for (int32 lane = 0; hitMask != 0; ++lane, hitMask >>= 1)
+				{
+					if (hitMask & 1)
+					{
+						b2Vec2 normal = b2Mul(xf.q, b2Vec2(b2GetLaneW(normalX, lane), b2GetLaneW(normalY, lane)));
+						Report(fixture, baseIndex + lane, b2GetLaneW(lower, lane), normal, maxFractions + lane);
+					}
+				}
+			}
+			break;
+
+		default:
+			for (int32 lane = 0; laneMask != 0; ++lane, laneMask >>= 1)
+			{
+				if ((laneMask & 1) == 0)
+				{
+					continue;
+				}
+
+				b2RayCastInput input = inputs[baseIndex + lane];
+				input.maxFraction = maxFractions[lane];
+				b2RayCastOutput output;
+				if (fixture->RayCast(&output, input, proxy->childIndex))
+				{
+					Report(fixture, baseIndex + lane, output.fraction, output.normal, maxFractions + lane);
+				}
+			}
+			break;
+		}
+	}
+
+	// Gather the masked rays of a group into SIMD lanes, in the frame of xf.
+	void LoadRays(int32 baseIndex, uint32 laneMask, const float* maxFractions, const b2Vec2& p, const b2Rot& q,
+				  b2FloatW* p1X, b2FloatW* p1Y, b2FloatW* p2X, b2FloatW* p2Y, b2FloatW* maxFraction) const
+	{
+		for (int32 lane = 0; laneMask != 0; ++lane, laneMask >>= 1)
+		{
+			if (laneMask & 1)
+			{
+				const b2RayCastInput& input = inputs[baseIndex + lane];
+				b2Vec2 p1 = b2MulT(q, input.p1 - p);
+				b2Vec2 p2 = b2MulT(q, input.p2 - p);
+				b2SetLaneW(p1X, lane, p1.x);
+				b2SetLaneW(p1Y, lane, p1.y);
+				b2SetLaneW(p2X, lane, p2.x);
+				b2SetLaneW(p2Y, lane, p2.y);
+				b2SetLaneW(maxFraction, lane, maxFractions[lane]);
+			}
+		}
+	}
+
+	// Record a hit and clip the ray to it, as a closest hit RayCast callback does.
+	void Report(b2Fixture* fixture, int32 rayIndex, float fraction, const b2Vec2& normal, float* maxFraction)
+	{
+		b2RayCastHit* hit = hits + rayIndex;
+		hit->fixture = fixture;
+		hit->normal = normal;
+		hit->fraction = fraction;
+		*maxFraction = fraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2RayCastInput* inputs;
+	b2RayCastHit* hits;
+};
+
+void b2World::RayCastBatch(const b2RayCastInput* inputs, int32 count, b2RayCastHit* hits) const
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		hits[i].fixture = nullptr;
+		hits[i].normal.SetZero();
+		hits[i].fraction = inputs[i].maxFraction;
+	}
+
+	b2WorldRayCastBatchWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.inputs = inputs;
+	wrapper.hits = hits;
+
+	// The pool is not re-entrant, so ray casts from inside a step run on the calling thread.
+	b2ThreadPool* threadPool = IsLocked() ? nullptr : m_threadPool;
+	m_contactManager.m_broadPhase.RayCastBatch(&wrapper, inputs, count, threadPool);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		float fraction = hits[i].fraction;
+		hits[i].point = (1.0f - fraction) * inputs[i].p1 + fraction * inputs[i].p2;
+	}
+}
+
+// Casts one child of a swept shape against the fixtures in the broad-phase that
+// overlap the swept box, keeping the first hit.
+struct b2WorldShapeCastWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		if (fixture->IsSensor())
+		{
+			return true;
+		}
+
+		// Clip the translation against the fat AABB grown by the extents of the shape.
+		// This rejects candidates off the sweep and behind the current hit.
+		const b2AABB& aabb = broadPhase->GetFatAABB(proxyId);
+		b2Vec2 c = aabb.GetCenter();
+		b2Vec2 h = aabb.GetExtents() + extents;
+		float lower = 0.0f;
+		float upper = hit->fraction;
+		for (int32 i = 0; i < 2; ++i)
+		{
+			float d = i == 0 ? translation.x : translation.y;
+			float p = i == 0 ? center.x - c.x : center.y - c.y;
+			float e = i == 0 ? h.x : h.y;
+			if (b2Abs(d) < b2_epsilon)
+			{
+				if (b2Abs(p) > e)
+				{
+					return true;
+				}
+			}
+			else
+			{
+				float t1 = (-e - p) / d;
+				float t2 = (e - p) / d;
+				lower = b2Max(lower, b2Min(t1, t2));
+				upper = b2Min(upper, b2Max(t1, t2));
+				if (lower > upper)
+				{
+					return true;
+				}
+			}
+		}
+
+		b2ShapeCastInput input;
+		input.proxyA.Set(fixture->GetShape(), proxy->childIndex);
+		input.proxyB = *proxyB;
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB = transform;
+		input.translationB = translation;
+
+		b2ShapeCastOutput output;
+		if (b2ShapeCast(&output, &input) && output.lambda < hit->fraction)
+		{
+			hit->fixture = fixture;
+			hit->childIndex = proxy->childIndex;
+			hit->point = output.point;
+			hit->normal = output.normal;
+			hit->fraction = output.lambda;
+		}
+
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2DistanceProxy* proxyB;
+	b2Transform transform;
+	b2Vec2 translation;
+	b2Vec2 center;
+	b2Vec2 extents;
+	b2ShapeCastHit* hit;
+};
+
+// Sweeps a range of the shapes of b2World::ShapeCastBatch. The broad-phase queries
+// only read the world, so the shapes can be swept on any thread.
+class b2ShapeCastBatchTask : public b2ThreadTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 threadIndex) override
+	{
+		B2_NOT_USED(threadIndex);
+
+		for (int32 i = begin; i < end; ++i)
+		{
+			const b2ShapeCastQuery* query = queries + i;
+			b2ShapeCastHit* hit = hits + i;
+			hit->fixture = nullptr;
+			hit->childIndex = 0;
+			hit->point.SetZero();
+			hit->normal.SetZero();
+			hit->fraction = 1.0f;
+
+			b2WorldShapeCastWrapper wrapper;
+			wrapper.broadPhase = broadPhase;
+			wrapper.transform = query->transform;
+			wrapper.translation = query->translation;
+			wrapper.hit = hit;
+
+			int32 childCount = query->shape->GetChildCount();
+			for (int32 childIndex = 0; childIndex < childCount; ++childIndex)
+			{
+				b2DistanceProxy proxy;
+				proxy.Set(query->shape, childIndex);
+				wrapper.proxyB = &proxy;
+
+				b2AABB aabb;
+				query->shape->ComputeAABB(&aabb, query->transform, childIndex);
+				wrapper.center = aabb.GetCenter();
+				wrapper.extents = aabb.GetExtents();
+
+				b2AABB sweptAABB;
+				sweptAABB.lowerBound = aabb.lowerBound + b2Min(b2Vec2_zero, query->translation);
+				sweptAABB.upperBound = aabb.upperBound + b2Max(b2Vec2_zero, query->translation);
+				broadPhase->Query(&wrapper, sweptAABB);
+			}
+		}
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2ShapeCastQuery* queries;
+	b2ShapeCastHit* hits;
+};
+
+void b2World::ShapeCastBatch(const b2ShapeCastQuery* queries, int32 count, b2ShapeCastHit* hits) const
+{
+	b2ShapeCastBatchTask task;
+	task.broadPhase = &m_contactManager.m_broadPhase;
+	task.queries = queries;
+	task.hits = hits;
+
+	// The pool is not re-entrant, so shape casts from inside a step run on the calling thread.
+	b2ThreadPool* threadPool = IsLocked() ? nullptr : m_threadPool;
+	if (threadPool)
+	{
+		threadPool->ParallelFor(&task, count, 4);
+	}
+	else
+	{
+		task.Execute(0, count, 0);
+	}
+}
+
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
 	switch (fixture->GetType())
@@ -1219,6 +2346,11 @@ int32 b2World::GetProxyCount() const
 	return m_contactManager.m_broadPhase.GetProxyCount();
 }
 
+b2BroadPhaseType b2World::GetBroadPhaseType() const
+{
+	return m_contactManager.m_broadPhase.GetType();
+}
+
 int32 b2World::GetTreeHeight() const
 {
 	return m_contactManager.m_broadPhase.GetTreeHeight();
@@ -1234,6 +2366,37 @@ float b2World::GetTreeQuality() const
 	return m_contactManager.m_broadPhase.GetTreeQuality();
 }
 
+void b2World::RebuildTree(b2TreeQuality* before, b2TreeQuality* after)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.RebuildTree(before, after);
+}
+
+void b2World::SetTreeRefitMode(bool flag)
+{
+	m_contactManager.m_broadPhase.SetTreeRefitMode(flag);
+}
+
+bool b2World::GetTreeRefitMode() const
+{
+	return m_contactManager.m_broadPhase.GetTreeRefitMode();
+}
+
+void b2World::SetTreeCompactMode(bool flag)
+{
+	m_contactManager.m_broadPhase.SetTreeCompactMode(flag);
+}
+
+bool b2World::GetTreeCompactMode() const
+{
+	return m_contactManager.m_broadPhase.GetTreeCompactMode();
+}
+
 void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	b2Assert(m_locked == false);
@@ -1245,8 +2408,22 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
 		b->m_xf.p -= newOrigin;
-		b->m_sweep.c0 -= newOrigin;
-		b->m_sweep.c -= newOrigin;
+		b->m_center0 -= newOrigin;
+
+		// Sensor contacts test the proxy AABBs, so they must follow the bodies.
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				f->m_proxies[i].aabb.lowerBound -= newOrigin;
+				f->m_proxies[i].aabb.upperBound -= newOrigin;
+			}
+		}
+	}
+
+	for (int32 i = 0; i < m_bodyStates.count; ++i)
+	{
+		m_bodyStates.centers[i] -= newOrigin;
 	}
 
 	for (b2Joint* j = m_jointList; j; j = j->m_next)
@@ -1257,6 +2434,865 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 }
 
+// FNV-1a over 32 bit words.
+static inline uint64 b2HashWord(uint64 hash, uint32 word)
+{
+	hash ^= word;
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+static inline uint64 b2HashFloat(uint64 hash, float x)
+{
+	uint32 word;
+	memcpy(&word, &x, sizeof(word));
+	return b2HashWord(hash, word);
+}
+
+uint64 b2World::ComputeStateHash() const
+{
+	uint64 hash = 14695981039346656037ull;
+
+	for (const b2Body* b = m_bodyList; b; b = b->GetNext())
+	{
+		const b2Transform& xf = b->GetTransform();
+		b2Vec2 v = b->GetLinearVelocity();
+		hash = b2HashFloat(hash, xf.p.x);
+		hash = b2HashFloat(hash, xf.p.y);
+		hash = b2HashFloat(hash, xf.q.s);
+		hash = b2HashFloat(hash, xf.q.c);
+		hash = b2HashFloat(hash, v.x);
+		hash = b2HashFloat(hash, v.y);
+		hash = b2HashFloat(hash, b->GetAngularVelocity());
+	}
+
+	for (const b2Contact* c = m_contactManager.m_contactList; c; c = c->GetNext())
+	{
+		const b2Manifold* manifold = c->GetManifold();
+		hash = b2HashWord(hash, uint32(manifold->pointCount));
+		for (int32 i = 0; i < manifold->pointCount; ++i)
+		{
+			hash = b2HashFloat(hash, manifold->points[i].normalImpulse);
+			hash = b2HashFloat(hash, manifold->points[i].tangentImpulse);
+		}
+	}
+
+	return hash;
+}
+
+#define b2_snapshotMagic 0x4e533242
+#define b2_snapshotVersion 4
+
+// Identifies the world a snapshot belongs to.
+struct b2SnapshotHeader
+{
+	uint32 magic;
+	int32 version;
+	int32 size;
+	int32 bodyCount;
+	int32 jointCount;
+	int32 fixtureCount;
+	int32 stateCount;
+	int32 proxyCount;
+	int32 broadPhaseType;
+};
+
+static b2SnapshotHeader b2MakeSnapshotHeader(const b2World* world, const b2BroadPhase* broadPhase, int32 stateCount)
+{
+	b2SnapshotHeader header;
+	header.magic = b2_snapshotMagic;
+	header.version = b2_snapshotVersion;
+	header.size = 0;
+	header.bodyCount = world->GetBodyCount();
+	header.jointCount = world->GetJointCount();
+	header.fixtureCount = 0;
+	for (const b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		for (const b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+		{
+			header.fixtureCount += 1;
+		}
+	}
+	header.stateCount = stateCount;
+	header.proxyCount = broadPhase->GetProxyCount();
+	header.broadPhaseType = broadPhase->GetType();
+	return header;
+}
+
+int32 b2World::SaveSnapshot(void* buffer, int32 capacity)
+{
+	if (m_locked)
+	{
+		return 0;
+	}
+
+	b2SnapshotWriter writer;
+	writer.buffer = (uint8*)buffer;
+	writer.capacity = buffer != nullptr ? capacity : 0;
+	writer.offset = 0;
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	const b2BodyStates& states = m_bodyStates;
+	int32 stateCount = states.count;
+	b2SnapshotHeader header = b2MakeSnapshotHeader(this, broadPhase, stateCount);
+	writer.Write(header);
+
+	// The identity of every body, fixture and joint, so a restore can reject a world
+	// that has changed before it touches anything.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		writer.Write(b->m_creationId);
+		writer.Write(b->m_fixtureCount);
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			writer.Write(f->m_creationId);
+		}
+	}
+
+	int32 jointIndex = 0;
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		writer.Write(j->m_creationId);
+		writer.Write(int32(j->m_type));
+		j->m_index = jointIndex++;
+	}
+
+	writer.Write(m_inv_dt0);
+	writer.Write(m_newContacts);
+	writer.Write(m_stepComplete);
+
+	writer.Write(states.centers, stateCount * int32(sizeof(b2Vec2)));
+	writer.Write(states.angles, stateCount * int32(sizeof(float)));
+	writer.Write(states.linearVelocities, stateCount * int32(sizeof(b2Vec2)));
+	writer.Write(states.angularVelocities, stateCount * int32(sizeof(float)));
+	writer.Write(states.forces, stateCount * int32(sizeof(b2Vec2)));
+	writer.Write(states.torques, stateCount * int32(sizeof(float)));
+	writer.Write(states.invMasses, stateCount * int32(sizeof(float)));
+	writer.Write(states.invInertias, stateCount * int32(sizeof(float)));
+
+	// Bodies, fixtures and joints are restored in place. Only their values are kept,
+	// links to other objects are written as indices and user data is left alone.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		writer.Write(int32(b->m_type));
+		writer.Write(b->m_flags);
+		writer.Write(b->m_islandId);
+		writer.Write(b->m_stateIndex);
+		writer.Write(b->m_xf);
+		writer.Write(b->m_localCenter);
+		writer.Write(b->m_center0);
+		writer.Write(b->m_angle0);
+		writer.Write(b->m_alpha0);
+		writer.Write(b->m_mass);
+		writer.Write(b->m_I);
+		writer.Write(b->m_linearDamping);
+		writer.Write(b->m_angularDamping);
+		writer.Write(b->m_gravityScale);
+		writer.Write(b->m_sleepTime);
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			writer.Write(f->m_density);
+			writer.Write(f->m_friction);
+			writer.Write(f->m_restitution);
+			writer.Write(f->m_restitutionThreshold);
+			writer.Write(f->m_filter);
+			writer.Write(f->m_isSensor);
+			writer.Write(f->m_proxyCount);
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				const b2FixtureProxy* proxy = f->m_proxies + i;
+				writer.Write(proxy->aabb);
+				writer.Write(proxy->childIndex);
+				writer.Write(proxy->proxyId);
+			}
+		}
+	}
+
+	// Island links, once every body has its state slot.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		writer.Write(b->m_islandPrev != nullptr ? b->m_islandPrev->m_stateIndex : -1);
+		writer.Write(b->m_islandNext != nullptr ? b->m_islandNext->m_stateIndex : -1);
+	}
+
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		writer.Write(j->m_collideConnected);
+		writer.Write(j->m_islandId);
+		writer.Write(j->m_islandPrev != nullptr ? j->m_islandPrev->m_index : -1);
+		writer.Write(j->m_islandNext != nullptr ? j->m_islandNext->m_index : -1);
+		j->Save(&writer);
+	}
+
+	broadPhase->Save(&writer);
+
+	// Contacts are recreated on restore, so they are stored by index.
+	int32 contactCount = 0;
+	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		c->m_index = contactCount++;
+	}
+
+	writer.Write(contactCount);
+	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		writer.Write(c->m_fixtureA->m_proxies[c->m_indexA].proxyId);
+		writer.Write(c->m_fixtureB->m_proxies[c->m_indexB].proxyId);
+		writer.Write(c->m_flags);
+		writer.Write(c->m_manifold);
+		writer.Write(c->m_simplexCache);
+		writer.Write(c->m_toiCount);
+		writer.Write(c->m_toi);
+		writer.Write(c->m_friction);
+		writer.Write(c->m_restitution);
+		writer.Write(c->m_restitutionThreshold);
+		writer.Write(c->m_tangentSpeed);
+		writer.Write(c->m_islandId);
+		writer.Write(c->m_islandPrev != nullptr ? c->m_islandPrev->m_index : -1);
+		writer.Write(c->m_islandNext != nullptr ? c->m_islandNext->m_index : -1);
+	}
+
+	// Contact edges, in list order. The low bit tells which end of the contact the edge is.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		int32 edgeCount = 0;
+		for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			++edgeCount;
+		}
+
+		writer.Write(edgeCount);
+		for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			int32 code = 2 * ce->contact->m_index + (ce == &ce->contact->m_nodeB ? 1 : 0);
+			writer.Write(code);
+		}
+	}
+
+	m_islandManager.Save(&writer);
+
+	if (writer.offset <= writer.capacity)
+	{
+		header.size = writer.offset;
+		memcpy(buffer, &header, sizeof(header));
+	}
+
+	return writer.offset;
+}
+
+// Read the whole snapshot the way RestoreSnapshot does, without changing anything. Every
+// count, index and link is checked against the array it indexes once restored, so a
+// restore that gets past this cannot stop half way.
+bool b2World::CheckSnapshot(const void* buffer, int32 size)
+{
+	if (buffer == nullptr || size < int32(sizeof(b2SnapshotHeader)))
+	{
+		return false;
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	int32 stateCount = m_bodyStates.count;
+	b2SnapshotHeader expected = b2MakeSnapshotHeader(this, broadPhase, stateCount);
+
+	b2SnapshotHeader header;
+	memcpy(&header, buffer, sizeof(header));
+	if (header.magic != expected.magic || header.version != expected.version ||
+		header.size != size || header.bodyCount != expected.bodyCount ||
+		header.jointCount != expected.jointCount || header.fixtureCount != expected.fixtureCount ||
+		header.stateCount != expected.stateCount || header.proxyCount != expected.proxyCount ||
+		header.broadPhaseType != expected.broadPhaseType)
+	{
+		return false;
+	}
+
+	b2SnapshotReader reader;
+	reader.buffer = (const uint8*)buffer;
+	reader.size = size;
+	reader.offset = int32(sizeof(header));
+	reader.invalid = false;
+
+	// Equal counts do not make equal worlds: a body destroyed and another created
+	// leave the counts as they were. Match every object.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		bool match = reader.Read<uint32>() == b->m_creationId;
+		match = match && reader.Read<int32>() == b->m_fixtureCount;
+		for (b2Fixture* f = b->m_fixtureList; f && match; f = f->m_next)
+		{
+			match = reader.Read<uint32>() == f->m_creationId;
+		}
+
+		if (match == false)
+		{
+			return false;
+		}
+	}
+
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		if (reader.Read<uint32>() != j->m_creationId || reader.Read<int32>() != int32(j->m_type))
+		{
+			return false;
+		}
+	}
+
+	reader.Skip(int32(sizeof(m_inv_dt0)));
+	reader.CheckBool();
+	reader.CheckBool();
+	reader.Skip(stateCount * int32(3 * sizeof(b2Vec2) + 5 * sizeof(float)));
+
+	// The state slots claimed so far and the proxy ids in fixture order.
+	int32 proxyCount = header.proxyCount;
+	bool* slotUsed = (bool*)m_stackAllocator.Allocate(stateCount * sizeof(bool));
+	int32* proxyIds = (int32*)m_stackAllocator.Allocate(proxyCount * sizeof(int32));
+	b2FixtureProxy** fixtureProxies = (b2FixtureProxy**)m_stackAllocator.Allocate(proxyCount * sizeof(b2FixtureProxy*));
+	for (int32 i = 0; i < stateCount; ++i)
+	{
+		slotUsed[i] = false;
+	}
+
+	int32 maxIslandId = b2_nullIsland;
+	int32 proxyIndex = 0;
+	for (b2Body* b = m_bodyList; b && reader.invalid == false; b = b->m_next)
+	{
+		int32 type = reader.Read<int32>();
+		reader.Skip(int32(sizeof(b->m_flags)));
+		int32 islandId = reader.Read<int32>();
+		int32 stateIndex = reader.Read<int32>();
+		reader.Skip(int32(sizeof(b->m_xf) + sizeof(b->m_localCenter) + sizeof(b->m_center0) + sizeof(b->m_angle0) +
+						  sizeof(b->m_alpha0) + sizeof(b->m_mass) + sizeof(b->m_I) + sizeof(b->m_linearDamping) +
+						  sizeof(b->m_angularDamping) + sizeof(b->m_gravityScale) + sizeof(b->m_sleepTime)));
+
+		if (type < b2_staticBody || type > b2_dynamicBody || islandId < b2_nullIsland ||
+			stateIndex < 0 || stateIndex >= stateCount || slotUsed[stateIndex])
+		{
+			reader.invalid = true;
+			break;
+		}
+
+		slotUsed[stateIndex] = true;
+		maxIslandId = b2Max(maxIslandId, islandId);
+
+		for (b2Fixture* f = b->m_fixtureList; f && reader.invalid == false; f = f->m_next)
+		{
+			reader.Skip(int32(sizeof(f->m_density) + sizeof(f->m_friction) + sizeof(f->m_restitution) +
+							  sizeof(f->m_restitutionThreshold) + sizeof(f->m_filter)));
+			reader.CheckBool();
+
+			// The proxy array is sized by the shape.
+			int32 fixtureProxyCount = reader.Read<int32>();
+			if (fixtureProxyCount < 0 || fixtureProxyCount > f->m_shape->GetChildCount() ||
+				fixtureProxyCount > proxyCount - proxyIndex)
+			{
+				reader.invalid = true;
+				break;
+			}
+
+			for (int32 i = 0; i < fixtureProxyCount; ++i)
+			{
+				reader.Skip(int32(sizeof(b2AABB)));
+				int32 childIndex = reader.Read<int32>();
+				int32 proxyId = reader.Read<int32>();
+				if (childIndex != i || proxyId < 0)
+				{
+					reader.invalid = true;
+				}
+
+				proxyIds[proxyIndex] = proxyId;
+				fixtureProxies[proxyIndex] = f->m_proxies + i;
+				++proxyIndex;
+			}
+		}
+	}
+
+	if (proxyIndex != proxyCount)
+	{
+		reader.invalid = true;
+	}
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		reader.CheckLink(reader.Read<int32>(), stateCount);
+		reader.CheckLink(reader.Read<int32>(), stateCount);
+	}
+
+	int32 jointCount = m_jointCount;
+	for (b2Joint* j = m_jointList; j && reader.invalid == false; j = j->m_next)
+	{
+		reader.CheckBool();
+		int32 islandId = reader.Read<int32>();
+		reader.CheckLink(reader.Read<int32>(), jointCount);
+		reader.CheckLink(reader.Read<int32>(), jointCount);
+		if (islandId < b2_nullIsland)
+		{
+			reader.invalid = true;
+		}
+		maxIslandId = b2Max(maxIslandId, islandId);
+
+		// The joint type record has the size it is saved with.
+		b2SnapshotWriter counter;
+		counter.buffer = nullptr;
+		counter.capacity = 0;
+		counter.offset = 0;
+		j->Save(&counter);
+		reader.Skip(counter.offset);
+	}
+
+	// The proxy ids must be unique and fit the broad-phase as it is restored.
+	int32 proxyCapacity = broadPhase->Check(&reader);
+	if (reader.invalid)
+	{
+		proxyCapacity = 0;
+	}
+
+	b2FixtureProxy** proxies = (b2FixtureProxy**)m_stackAllocator.Allocate(proxyCapacity * sizeof(b2FixtureProxy*));
+	for (int32 i = 0; i < proxyCapacity; ++i)
+	{
+		proxies[i] = nullptr;
+	}
+
+	for (int32 i = 0; i < proxyCount && reader.invalid == false; ++i)
+	{
+		int32 proxyId = proxyIds[i];
+		if (proxyId >= proxyCapacity || proxies[proxyId] != nullptr)
+		{
+			reader.invalid = true;
+			break;
+		}
+
+		proxies[proxyId] = fixtureProxies[i];
+	}
+
+	int32 contactCount = reader.Read<int32>();
+	if (reader.invalid || contactCount < 0 || contactCount > (size - reader.offset) / int32(2 * sizeof(int32)))
+	{
+		reader.invalid = true;
+		contactCount = 0;
+	}
+
+	// The body that owns each contact edge, in the order of the edge codes.
+	b2Body** edgeBodies = (b2Body**)m_stackAllocator.Allocate(2 * contactCount * sizeof(b2Body*));
+	bool* edgeUsed = (bool*)m_stackAllocator.Allocate(2 * contactCount * sizeof(bool));
+	for (int32 i = 0; i < contactCount && reader.invalid == false; ++i)
+	{
+		int32 proxyIdA = reader.Read<int32>();
+		int32 proxyIdB = reader.Read<int32>();
+		if (reader.invalid || proxyIdA < 0 || proxyIdA >= proxyCapacity || proxyIdB < 0 || proxyIdB >= proxyCapacity ||
+			proxies[proxyIdA] == nullptr || proxies[proxyIdB] == nullptr)
+		{
+			reader.invalid = true;
+			break;
+		}
+
+		// b2Contact::Create gives no contact for some shape pairs and swaps the fixtures
+		// of others. A saved contact has neither.
+		b2Fixture* fixtureA = proxies[proxyIdA]->fixture;
+		b2Fixture* fixtureB = proxies[proxyIdB]->fixture;
+		const b2ContactRegister& reg = b2Contact::s_registers[fixtureA->GetType()][fixtureB->GetType()];
+
+		reader.Skip(int32(sizeof(uint32)));
+		b2Manifold manifold = reader.Read<b2Manifold>();
+		b2SimplexCache cache = reader.Read<b2SimplexCache>();
+		reader.Skip(int32(sizeof(int32) + 5 * sizeof(float)));
+		int32 islandId = reader.Read<int32>();
+		reader.CheckLink(reader.Read<int32>(), contactCount);
+		reader.CheckLink(reader.Read<int32>(), contactCount);
+
+		if (reg.createFcn == nullptr || reg.primary == false || manifold.pointCount < 0 ||
+			manifold.pointCount > b2_maxManifoldPoints || cache.count > 3 || islandId < b2_nullIsland)
+		{
+			reader.invalid = true;
+		}
+
+		maxIslandId = b2Max(maxIslandId, islandId);
+		edgeBodies[2 * i + 0] = fixtureA->m_body;
+		edgeBodies[2 * i + 1] = fixtureB->m_body;
+		edgeUsed[2 * i + 0] = false;
+		edgeUsed[2 * i + 1] = false;
+	}
+
+	// Each edge is in the list of its own body, once.
+	for (b2Body* b = m_bodyList; b && reader.invalid == false; b = b->m_next)
+	{
+		int32 edgeCount = reader.Read<int32>();
+		if (edgeCount < 0 || edgeCount > 2 * contactCount)
+		{
+			reader.invalid = true;
+			break;
+		}
+
+		for (int32 i = 0; i < edgeCount; ++i)
+		{
+			int32 code = reader.Read<int32>();
+			if (reader.invalid || code < 0 || code >= 2 * contactCount || edgeUsed[code] || edgeBodies[code] != b)
+			{
+				reader.invalid = true;
+				break;
+			}
+
+			edgeUsed[code] = true;
+		}
+	}
+
+	if (reader.invalid == false)
+	{
+		int32 islandCapacity = m_islandManager.Check(&reader, stateCount, contactCount, jointCount);
+		if (maxIslandId >= islandCapacity || reader.offset != size)
+		{
+			reader.invalid = true;
+		}
+	}
+
+	m_stackAllocator.Free(edgeUsed);
+	m_stackAllocator.Free(edgeBodies);
+	m_stackAllocator.Free(proxies);
+	m_stackAllocator.Free(fixtureProxies);
+	m_stackAllocator.Free(proxyIds);
+	m_stackAllocator.Free(slotUsed);
+
+	return reader.invalid == false;
+}
+
+bool b2World::RestoreSnapshot(const void* buffer, int32 size)
+{
+	if (m_locked || CheckSnapshot(buffer, size) == false)
+	{
+		return false;
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	b2BodyStates& states = m_bodyStates;
+	int32 stateCount = states.count;
+
+	b2SnapshotReader reader;
+	reader.buffer = (const uint8*)buffer;
+	reader.size = size;
+	reader.offset = int32(sizeof(b2SnapshotHeader));
+	reader.invalid = false;
+
+	// CheckSnapshot has been through the whole buffer. The guards below only keep a
+	// bug in the check from running past the arrays.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		reader.Skip(int32(sizeof(uint32) + sizeof(int32)) + b->m_fixtureCount * int32(sizeof(uint32)));
+	}
+
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		reader.Skip(int32(sizeof(uint32) + sizeof(int32)));
+	}
+
+	// Drop the current contacts. The islands are read back below.
+	b2Contact* c = m_contactManager.m_contactList;
+	while (c)
+	{
+		b2Contact* next = c->m_next;
+		b2Contact::Destroy(c, c->m_fixtureA->GetType(), c->m_fixtureB->GetType(), &m_blockAllocator);
+		c = next;
+	}
+	m_contactManager.m_contactList = nullptr;
+	m_contactManager.m_contactCount = 0;
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_contactList = nullptr;
+	}
+
+	m_inv_dt0 = reader.Read<float>();
+	m_newContacts = reader.Read<bool>();
+	m_stepComplete = reader.Read<bool>();
+
+	reader.Read(states.centers, stateCount * int32(sizeof(b2Vec2)));
+	reader.Read(states.angles, stateCount * int32(sizeof(float)));
+	reader.Read(states.linearVelocities, stateCount * int32(sizeof(b2Vec2)));
+	reader.Read(states.angularVelocities, stateCount * int32(sizeof(float)));
+	reader.Read(states.forces, stateCount * int32(sizeof(b2Vec2)));
+	reader.Read(states.torques, stateCount * int32(sizeof(float)));
+	reader.Read(states.invMasses, stateCount * int32(sizeof(float)));
+	reader.Read(states.invInertias, stateCount * int32(sizeof(float)));
+
+	// The state slots are rebuilt from the bodies, so clear them to catch a slot
+	// claimed twice.
+	for (int32 i = 0; i < stateCount; ++i)
+	{
+		states.bodies[i] = nullptr;
+	}
+
+	int32 maxProxyId = -1;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_type = b2BodyType(reader.Read<int32>());
+		reader.Read(&b->m_flags);
+		reader.Read(&b->m_islandId);
+		reader.Read(&b->m_stateIndex);
+		reader.Read(&b->m_xf);
+		reader.Read(&b->m_localCenter);
+		reader.Read(&b->m_center0);
+		reader.Read(&b->m_angle0);
+		reader.Read(&b->m_alpha0);
+		reader.Read(&b->m_mass);
+		reader.Read(&b->m_I);
+		reader.Read(&b->m_linearDamping);
+		reader.Read(&b->m_angularDamping);
+		reader.Read(&b->m_gravityScale);
+		reader.Read(&b->m_sleepTime);
+
+		if (0 <= b->m_stateIndex && b->m_stateIndex < stateCount && states.bodies[b->m_stateIndex] == nullptr)
+		{
+			states.bodies[b->m_stateIndex] = b;
+		}
+		else
+		{
+			reader.invalid = true;
+			b->m_stateIndex = 0;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			reader.Read(&f->m_density);
+			reader.Read(&f->m_friction);
+			reader.Read(&f->m_restitution);
+			reader.Read(&f->m_restitutionThreshold);
+			reader.Read(&f->m_filter);
+			reader.Read(&f->m_isSensor);
+			reader.Read(&f->m_proxyCount);
+
+			// The proxy array is sized by the shape.
+			if (f->m_proxyCount < 0 || f->m_proxyCount > f->m_shape->GetChildCount())
+			{
+				reader.invalid = true;
+				f->m_proxyCount = 0;
+			}
+
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + i;
+				reader.Read(&proxy->aabb);
+				reader.Read(&proxy->childIndex);
+				reader.Read(&proxy->proxyId);
+				proxy->fixture = f;
+				maxProxyId = b2Max(maxProxyId, proxy->proxyId);
+				if (proxy->proxyId < 0 || proxy->childIndex != i)
+				{
+					reader.invalid = true;
+					f->m_proxyCount = i;
+				}
+			}
+		}
+	}
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_islandPrev = reader.ReadLink(states.bodies, stateCount);
+		b->m_islandNext = reader.ReadLink(states.bodies, stateCount);
+	}
+
+	int32 jointCount = m_jointCount;
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(jointCount * sizeof(b2Joint*));
+	int32 jointIndex = 0;
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		j->m_index = jointIndex;
+		joints[jointIndex++] = j;
+	}
+
+	int32* jointLinks = (int32*)m_stackAllocator.Allocate(2 * jointCount * sizeof(int32));
+	for (int32 i = 0; i < jointCount; ++i)
+	{
+		b2Joint* j = joints[i];
+		reader.Read(&j->m_collideConnected);
+		reader.Read(&j->m_islandId);
+		reader.Read(jointLinks + 2 * i + 0);
+		reader.Read(jointLinks + 2 * i + 1);
+		j->Restore(&reader);
+	}
+
+	for (int32 i = 0; i < jointCount; ++i)
+	{
+		int32 prev = jointLinks[2 * i + 0];
+		int32 next = jointLinks[2 * i + 1];
+		if (prev < -1 || prev >= jointCount || next < -1 || next >= jointCount)
+		{
+			reader.invalid = true;
+			prev = -1;
+			next = -1;
+		}
+
+		joints[i]->m_islandPrev = prev >= 0 ? joints[prev] : nullptr;
+		joints[i]->m_islandNext = next >= 0 ? joints[next] : nullptr;
+	}
+
+	// The broad-phase does not keep user data, so point its proxies back at the fixtures.
+	broadPhase->Restore(&reader);
+
+	b2FixtureProxy** proxies = (b2FixtureProxy**)m_stackAllocator.Allocate((maxProxyId + 1) * sizeof(b2FixtureProxy*));
+	for (int32 i = 0; i <= maxProxyId; ++i)
+	{
+		proxies[i] = nullptr;
+	}
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + i;
+				if (proxies[proxy->proxyId] != nullptr)
+				{
+					reader.invalid = true;
+					continue;
+				}
+
+				proxies[proxy->proxyId] = proxy;
+				broadPhase->SetUserData(proxy->proxyId, proxy);
+			}
+		}
+	}
+
+	int32 contactCount = reader.Read<int32>();
+	if (contactCount < 0 || contactCount > (size - reader.offset) / int32(2 * sizeof(int32)))
+	{
+		reader.invalid = true;
+		contactCount = 0;
+	}
+
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(contactCount * sizeof(b2Contact*));
+	int32* contactLinks = (int32*)m_stackAllocator.Allocate(2 * contactCount * sizeof(int32));
+	int32 createdCount = 0;
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		int32 proxyIdA = reader.Read<int32>();
+		int32 proxyIdB = reader.Read<int32>();
+		if (reader.invalid || proxyIdA < 0 || proxyIdA > maxProxyId || proxyIdB < 0 || proxyIdB > maxProxyId ||
+			proxies[proxyIdA] == nullptr || proxies[proxyIdB] == nullptr)
+		{
+			reader.invalid = true;
+			break;
+		}
+
+		b2FixtureProxy* proxyA = proxies[proxyIdA];
+		b2FixtureProxy* proxyB = proxies[proxyIdB];
+
+		c = b2Contact::Create(proxyA->fixture, proxyA->childIndex, proxyB->fixture, proxyB->childIndex, &m_blockAllocator);
+		if (c == nullptr || c->m_fixtureA != proxyA->fixture || c->m_fixtureB != proxyB->fixture)
+		{
+			if (c != nullptr)
+			{
+				b2Contact::Destroy(c, c->m_fixtureA->GetType(), c->m_fixtureB->GetType(), &m_blockAllocator);
+			}
+			reader.invalid = true;
+			break;
+		}
+
+		c->m_flags = reader.Read<uint32>();
+		c->m_manifold = reader.Read<b2Manifold>();
+		c->m_simplexCache = reader.Read<b2SimplexCache>();
+		c->m_toiCount = reader.Read<int32>();
+		c->m_toi = reader.Read<float>();
+		c->m_friction = reader.Read<float>();
+		c->m_restitution = reader.Read<float>();
+		c->m_restitutionThreshold = reader.Read<float>();
+		c->m_tangentSpeed = reader.Read<float>();
+		c->m_islandId = reader.Read<int32>();
+		contactLinks[2 * i + 0] = reader.Read<int32>();
+		contactLinks[2 * i + 1] = reader.Read<int32>();
+
+		if (c->m_manifold.pointCount < 0 || c->m_manifold.pointCount > b2_maxManifoldPoints ||
+			c->m_simplexCache.count > 3)
+		{
+			reader.invalid = true;
+			c->m_manifold.pointCount = 0;
+			c->m_simplexCache.count = 0;
+		}
+
+		c->m_nodeA.contact = c;
+		c->m_nodeA.other = c->m_fixtureB->m_body;
+		c->m_nodeB.contact = c;
+		c->m_nodeB.other = c->m_fixtureA->m_body;
+		c->m_index = i;
+		contacts[i] = c;
+		++createdCount;
+	}
+	contactCount = createdCount;
+
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		int32 prev = contactLinks[2 * i + 0];
+		int32 next = contactLinks[2 * i + 1];
+		if (prev < -1 || prev >= contactCount || next < -1 || next >= contactCount)
+		{
+			reader.invalid = true;
+			prev = -1;
+			next = -1;
+		}
+
+		c = contacts[i];
+		c->m_prev = i > 0 ? contacts[i - 1] : nullptr;
+		c->m_next = i + 1 < contactCount ? contacts[i + 1] : nullptr;
+		c->m_islandPrev = prev >= 0 ? contacts[prev] : nullptr;
+		c->m_islandNext = next >= 0 ? contacts[next] : nullptr;
+	}
+	m_contactManager.m_contactList = contactCount > 0 ? contacts[0] : nullptr;
+	m_contactManager.m_contactCount = contactCount;
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		int32 edgeCount = reader.Read<int32>();
+		b2ContactEdge* prev = nullptr;
+		for (int32 i = 0; i < edgeCount && reader.invalid == false; ++i)
+		{
+			int32 code = reader.Read<int32>();
+			if (code < 0 || (code >> 1) >= contactCount)
+			{
+				reader.invalid = true;
+				break;
+			}
+
+			c = contacts[code >> 1];
+			b2ContactEdge* edge = (code & 1) ? &c->m_nodeB : &c->m_nodeA;
+			edge->prev = prev;
+			edge->next = nullptr;
+			if (prev)
+			{
+				prev->next = edge;
+			}
+			else
+			{
+				b->m_contactList = edge;
+			}
+			prev = edge;
+		}
+	}
+
+	m_islandManager.Restore(&reader, states.bodies, stateCount, contacts, contactCount, joints, jointCount);
+
+	m_stackAllocator.Free(contactLinks);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(proxies);
+	m_stackAllocator.Free(jointLinks);
+	m_stackAllocator.Free(joints);
+
+	// Events belong to the step that produced them.
+	m_contactManager.ClearEvents();
+
+	// The values are restored unchecked, so the islands are validated by the next step.
+	b2Assert(reader.invalid == false && reader.offset == size);
+	return reader.invalid == false;
+}
+
+int32 b2World::TrimMemory()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return 0;
+	}
+
+	return m_blockAllocator.Trim();
+}
+
 void b2World::Dump()
 {
 	if (m_locked)
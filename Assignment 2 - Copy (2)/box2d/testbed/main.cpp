@@ -376,6 +376,9 @@ static void UpdateUI()
 				ImGui::Checkbox("Warm Starting", &s_settings.m_enableWarmStarting);
 				ImGui::Checkbox("Time of Impact", &s_settings.m_enableContinuous);
 				ImGui::Checkbox("Sub-Stepping", &s_settings.m_enableSubStepping);
+				ImGui::Checkbox("Batched TOI", &s_settings.m_enableBatchedTOI);
+				ImGui::Checkbox("Soft Step", &s_settings.m_enableSoftStep);
+				ImGui::SliderInt("Soft Sub-Steps", &s_settings.m_softStepCount, 1, 16);
 
 				ImGui::Separator();
 
@@ -50,6 +50,9 @@ struct Settings
 		m_enableWarmStarting = true;
 		m_enableContinuous = true;
 		m_enableSubStepping = false;
+		m_enableBatchedTOI = false;
+		m_enableSoftStep = false;
+		m_softStepCount = 4;
 		m_enableSleep = true;
 		m_pause = false;
 		m_singleStep = false;
@@ -77,6 +80,9 @@ struct Settings
 	bool m_enableWarmStarting;
 	bool m_enableContinuous;
 	bool m_enableSubStepping;
+	bool m_enableBatchedTOI;
+	bool m_enableSoftStep;
+	int m_softStepCount;
 	bool m_enableSleep;
 	bool m_pause;
 	bool m_singleStep;
@@ -305,6 +305,9 @@ void Test::Step(Settings& settings)
 	m_world->SetWarmStarting(settings.m_enableWarmStarting);
 	m_world->SetContinuousPhysics(settings.m_enableContinuous);
 	m_world->SetSubStepping(settings.m_enableSubStepping);
+	m_world->SetBatchedTOI(settings.m_enableBatchedTOI);
+	m_world->SetSoftStep(settings.m_enableSoftStep);
+	m_world->SetSoftStepCount(settings.m_softStepCount);
 
 	m_pointCount = 0;
 
@@ -391,6 +394,11 @@ void Test::Step(Settings& settings)
 		m_textLine += m_textIncrement;
 		g_debugDraw.DrawString(5, m_textLine, "broad-phase [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.broadphase, aveProfile.broadphase, m_maxProfile.broadphase);
 		m_textLine += m_textIncrement;
+		g_debugDraw.DrawString(5, m_textLine, "pairs/moved/updated/created/destroyed = %d/%d/%d/%d/%d",
+			p.pairCount, p.proxyMoveCount, p.contactUpdateCount, p.contactCreateCount, p.contactDestroyCount);
+		m_textLine += m_textIncrement;
+		g_debugDraw.DrawString(5, m_textLine, "islands/largest/toi events = %d/%d/%d", p.islandCount, p.maxIslandSize, p.toiEventCount);
+		m_textLine += m_textIncrement;
 	}
 
 	if (m_bombSpawning)
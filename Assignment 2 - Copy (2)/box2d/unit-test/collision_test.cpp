@@ -21,8 +21,13 @@
 // SOFTWARE.
 
 #include "box2d/box2d.h"
+#include "box2d/b2_distance.h"
 #include "doctest.h"
+#include <algorithm>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 // Unit tests for collision algorithms
 DOCTEST_TEST_CASE("collision test")
@@ -79,3 +84,576 @@ DOCTEST_TEST_CASE("collision test")
 		CHECK(b2Abs(massData2.I - inertia) < 40.0f * (absTol + relTol * inertia));
 	}
 }
+
+class TreeQueryCounter
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++count;
+		return true;
+	}
+
+	int32 count = 0;
+};
+
+DOCTEST_TEST_CASE("dynamic tree rebuild")
+{
+	const int32 count = 1000;
+	b2AABB boxes[count];
+	int32 proxyIds[count];
+
+	b2DynamicTree tree;
+	uint32 seed = 12345;
+	for (int32 i = 0; i < count; ++i)
+	{
+		seed = 1664525u * seed + 1013904223u;
+		float x = float(seed % 1000u) * 0.1f;
+		seed = 1664525u * seed + 1013904223u;
+		float y = float(seed % 1000u) * 0.1f;
+		boxes[i].lowerBound.Set(x, y);
+		boxes[i].upperBound.Set(x + 1.0f, y + 1.0f);
+		proxyIds[i] = tree.CreateProxy(boxes[i], nullptr);
+	}
+
+	TreeQueryCounter counter1;
+	for (int32 i = 0; i < count; ++i)
+	{
+		tree.Query(&counter1, boxes[i]);
+	}
+
+	b2TreeQuality before, after;
+	tree.Rebuild(&before, &after);
+	CHECK(after.areaRatio < before.areaRatio);
+	CHECK(tree.GetHeight() == after.height);
+
+	TreeQueryCounter counter2;
+	for (int32 i = 0; i < count; ++i)
+	{
+		CHECK(b2TestOverlap(tree.GetFatAABB(proxyIds[i]), boxes[i]));
+		tree.Query(&counter2, boxes[i]);
+	}
+	CHECK(counter2.count == counter1.count);
+
+	// Moves in refit mode keep the topology but must still be found by queries.
+	tree.SetRefitMode(true);
+	const b2Vec2 displacement(50.0f, 0.0f);
+	b2AABB moved = boxes[0];
+	moved.lowerBound += displacement;
+	moved.upperBound += displacement;
+	tree.MoveProxy(proxyIds[0], moved, displacement);
+	tree.Validate();
+
+	TreeQueryCounter counter3;
+	tree.Query(&counter3, moved);
+	CHECK(counter3.count >= 1);
+
+	tree.RebuildSubtree(proxyIds[0], 4);
+	tree.Validate();
+
+	TreeQueryCounter counter4;
+	tree.Query(&counter4, moved);
+	CHECK(counter4.count == counter3.count);
+}
+
+class TreeQueryCollector
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		hits[count].queryIndex = queryIndex;
+		hits[count].proxyId = proxyId;
+		++count;
+		return true;
+	}
+
+	b2TreeQueryHit* hits;
+	int32 count = 0;
+	int32 queryIndex = 0;
+};
+
+DOCTEST_TEST_CASE("dynamic tree query batch")
+{
+	const int32 proxyCount = 500;
+	const int32 queryCount = 61;
+	const int32 capacity = 4096;
+
+	b2DynamicTree tree;
+	uint32 seed = 777;
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		seed = 1664525u * seed + 1013904223u;
+		float x = float(seed % 500u) * 0.1f;
+		seed = 1664525u * seed + 1013904223u;
+		float y = float(seed % 500u) * 0.1f;
+		b2AABB aabb;
+		aabb.lowerBound.Set(x, y);
+		aabb.upperBound.Set(x + 0.5f, y + 0.5f);
+		tree.CreateProxy(aabb, nullptr);
+	}
+
+	b2AABB queries[queryCount];
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		float x = 0.8f * i;
+		queries[i].lowerBound.Set(x, x);
+		queries[i].upperBound.Set(x + 2.0f, x + 2.0f);
+	}
+
+	// Reference: one query at a time, sorted by query index.
+	static b2TreeQueryHit expected[capacity];
+	TreeQueryCollector collector;
+	collector.hits = expected;
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		collector.queryIndex = i;
+		tree.Query(&collector, queries[i]);
+	}
+
+	auto lessHit = [](const b2TreeQueryHit& a, const b2TreeQueryHit& b)
+	{
+		return a.queryIndex < b.queryIndex || (a.queryIndex == b.queryIndex && a.proxyId < b.proxyId);
+	};
+	std::sort(expected, expected + collector.count, lessHit);
+
+	static b2TreeQueryHit serial[capacity];
+	int32 serialCount = tree.QueryBatch(queries, queryCount, serial, capacity);
+	CHECK(serialCount == collector.count);
+
+	static b2TreeQueryHit sorted[capacity];
+	memcpy(sorted, serial, serialCount * sizeof(b2TreeQueryHit));
+	std::sort(sorted, sorted + serialCount, lessHit);
+	bool same = true;
+	for (int32 i = 0; i < serialCount; ++i)
+	{
+		same = same && sorted[i].queryIndex == expected[i].queryIndex && sorted[i].proxyId == expected[i].proxyId;
+	}
+	CHECK(same);
+
+	// The threaded output matches the serial output exactly.
+	b2ThreadPool threadPool(3);
+	static b2TreeQueryHit threaded[capacity];
+	int32 threadedCount = tree.QueryBatch(queries, queryCount, threaded, capacity, &threadPool);
+	CHECK(threadedCount == serialCount);
+	CHECK(memcmp(threaded, serial, serialCount * sizeof(b2TreeQueryHit)) == 0);
+
+	// Hits past the capacity are counted but not written.
+	b2TreeQueryHit small[4];
+	CHECK(tree.QueryBatch(queries, queryCount, small, 4) == serialCount);
+	CHECK(memcmp(small, serial, sizeof(small)) == 0);
+}
+
+// Records the order of the proxies reported by tree queries and ray casts. Some hits
+// clip the ray so the walk order matters.
+class TreeOrderRecorder
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		ids.push_back(proxyId);
+		return true;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		ids.push_back(proxyId);
+		return proxyId % 5 == 0 ? 0.5f * input.maxFraction : input.maxFraction;
+	}
+
+	std::vector<int32> ids;
+};
+
+static std::vector<int32> RecordTreeOrder(const b2DynamicTree& tree, const b2AABB* queries, const b2RayCastInput* rays,
+										  int32 count)
+{
+	TreeOrderRecorder recorder;
+	for (int32 i = 0; i < count; ++i)
+	{
+		tree.Query(&recorder, queries[i]);
+		tree.RayCast(&recorder, rays[i]);
+	}
+	return recorder.ids;
+}
+
+DOCTEST_TEST_CASE("dynamic tree compact layout")
+{
+	const int32 proxyCount = 2000;
+	const int32 queryCount = 200;
+
+	// Far from the origin so the 16 bit bounds of small nodes are near the float precision.
+	const b2Vec2 origin(4000.0f, -2000.0f);
+
+	b2DynamicTree tree;
+	int32 proxyIds[proxyCount];
+	uint32 seed = 4242;
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		seed = 1664525u * seed + 1013904223u;
+		float x = float(seed % 2000u) * 0.1f;
+		seed = 1664525u * seed + 1013904223u;
+		float y = float(seed % 2000u) * 0.1f;
+		float size = i % 10 == 0 ? 5.0f : 0.05f;
+		b2AABB aabb;
+		aabb.lowerBound = origin + b2Vec2(x, y);
+		aabb.upperBound = aabb.lowerBound + b2Vec2(size, size);
+		proxyIds[i] = tree.CreateProxy(aabb, nullptr);
+	}
+
+	b2AABB queries[queryCount];
+	b2RayCastInput rays[queryCount];
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		// Query with the fat AABB of a proxy to hit the exact bounds.
+		queries[i] = tree.GetFatAABB(proxyIds[(7 * i) % proxyCount]);
+
+		float t = float(i);
+		rays[i].p1 = origin + b2Vec2(t, 0.0f);
+		rays[i].p2 = origin + b2Vec2(200.0f - t, 200.0f);
+		rays[i].maxFraction = 1.0f;
+	}
+
+	std::vector<int32> expected = RecordTreeOrder(tree, queries, rays, queryCount);
+	CHECK(expected.size() > size_t(2 * queryCount));
+
+	tree.SetCompactMode(true);
+	tree.UpdateCompact();
+	CHECK(tree.GetCompactBytes() < tree.GetNodeBytes() / 2);
+	CHECK(RecordTreeOrder(tree, queries, rays, queryCount) == expected);
+
+	// A move makes the layout stale. The queries then use the regular nodes until it is rebuilt.
+	b2AABB aabb = tree.GetFatAABB(proxyIds[3]);
+	aabb.lowerBound += b2Vec2(30.0f, 0.0f);
+	aabb.upperBound += b2Vec2(30.0f, 0.0f);
+	tree.MoveProxy(proxyIds[3], aabb, b2Vec2(30.0f, 0.0f));
+	queries[0] = aabb;
+
+	expected = RecordTreeOrder(tree, queries, rays, queryCount);
+	tree.UpdateCompact();
+	CHECK(RecordTreeOrder(tree, queries, rays, queryCount) == expected);
+
+	tree.Rebuild();
+	expected = RecordTreeOrder(tree, queries, rays, queryCount);
+	tree.UpdateCompact();
+	CHECK(RecordTreeOrder(tree, queries, rays, queryCount) == expected);
+
+	tree.SetCompactMode(false);
+	CHECK(tree.GetCompactBytes() == 0);
+	CHECK(RecordTreeOrder(tree, queries, rays, queryCount) == expected);
+
+	// A lone proxy 0 is a root leaf, which must not read as an empty layout.
+	b2DynamicTree single;
+	single.CreateProxy(queries[0], nullptr);
+	single.SetCompactMode(true);
+	single.UpdateCompact();
+
+	b2RayCastInput ray;
+	ray.p1 = queries[0].GetCenter() - b2Vec2(10.0f, 0.0f);
+	ray.p2 = queries[0].GetCenter() + b2Vec2(10.0f, 0.0f);
+	ray.maxFraction = 1.0f;
+	expected = { 0, 0 };
+	CHECK(RecordTreeOrder(single, queries, &ray, 1) == expected);
+}
+
+class BroadPhaseRecorder
+{
+public:
+	void AddPair(void* userDataA, void* userDataB)
+	{
+		int32 a = int32(intptr_t(userDataA));
+		int32 b = int32(intptr_t(userDataB));
+		pairs.push_back(b2Min(a, b) * 100000 + b2Max(a, b));
+	}
+
+	bool QueryCallback(int32 proxyId)
+	{
+		hits.push_back(int32(intptr_t(broadPhase->GetUserData(proxyId))));
+		return true;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		hits.push_back(int32(intptr_t(broadPhase->GetUserData(proxyId))));
+		return input.maxFraction;
+	}
+
+	std::vector<int32> Sorted(std::vector<int32>* values)
+	{
+		std::vector<int32> result = *values;
+		std::sort(result.begin(), result.end());
+		values->clear();
+		return result;
+	}
+
+	const b2BroadPhase* broadPhase;
+	std::vector<int32> pairs;
+	std::vector<int32> hits;
+};
+
+DOCTEST_TEST_CASE("broad-phase types agree")
+{
+	const int32 proxyCount = 400;
+	const b2BroadPhaseType types[3] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+
+	b2BroadPhase broadPhases[3];
+	BroadPhaseRecorder recorders[3];
+	int32 proxyIds[3][proxyCount];
+	b2AABB boxes[proxyCount];
+
+	uint32 seed = 4242;
+	auto random = [&seed](float range)
+	{
+		seed = 1664525u * seed + 1013904223u;
+		return range * float(seed >> 8) / float(1 << 24);
+	};
+
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		b2Vec2 p(random(60.0f), random(60.0f));
+		boxes[i].lowerBound = p;
+		boxes[i].upperBound = p + b2Vec2(1.0f, 1.0f);
+	}
+
+	// A long ground proxy goes into the side lists.
+	boxes[0].lowerBound.Set(-10.0f, -1.0f);
+	boxes[0].upperBound.Set(70.0f, 0.0f);
+
+	for (int32 k = 0; k < 3; ++k)
+	{
+		broadPhases[k].SetType(types[k], 1.5f);
+		recorders[k].broadPhase = broadPhases + k;
+		for (int32 i = 0; i < proxyCount; ++i)
+		{
+			proxyIds[k][i] = broadPhases[k].CreateProxy(boxes[i], (void*)intptr_t(i));
+		}
+	}
+
+	bool samePairs = true;
+	bool sameQueries = true;
+	bool sameRays = true;
+	int32 pairCount = 0;
+
+	for (int32 step = 0; step < 20; ++step)
+	{
+		for (int32 k = 0; k < 3; ++k)
+		{
+			broadPhases[k].UpdatePairs(recorders + k);
+		}
+
+		std::vector<int32> pairs0 = recorders[0].Sorted(&recorders[0].pairs);
+		pairCount += int32(pairs0.size());
+		samePairs = samePairs && recorders[1].Sorted(&recorders[1].pairs) == pairs0;
+		samePairs = samePairs && recorders[2].Sorted(&recorders[2].pairs) == pairs0;
+
+		b2AABB query;
+		query.lowerBound.Set(random(60.0f), random(60.0f));
+		query.upperBound = query.lowerBound + b2Vec2(5.0f, 3.0f);
+
+		b2RayCastInput input;
+		input.p1.Set(random(60.0f), random(60.0f));
+		input.p2.Set(random(60.0f), random(60.0f));
+		input.maxFraction = 1.0f;
+
+		for (int32 k = 0; k < 3; ++k)
+		{
+			broadPhases[k].Query(recorders + k, query);
+		}
+
+		std::vector<int32> hits0 = recorders[0].Sorted(&recorders[0].hits);
+		sameQueries = sameQueries && recorders[1].Sorted(&recorders[1].hits) == hits0;
+		sameQueries = sameQueries && recorders[2].Sorted(&recorders[2].hits) == hits0;
+
+		for (int32 k = 0; k < 3; ++k)
+		{
+			broadPhases[k].RayCast(recorders + k, input);
+		}
+
+		hits0 = recorders[0].Sorted(&recorders[0].hits);
+		sameRays = sameRays && recorders[1].Sorted(&recorders[1].hits) == hits0;
+		sameRays = sameRays && recorders[2].Sorted(&recorders[2].hits) == hits0;
+
+		// Drift most proxies to the right and teleport a few.
+		for (int32 i = 1; i < proxyCount; ++i)
+		{
+			b2Vec2 displacement(0.3f, random(0.2f) - 0.1f);
+			if (i % 37 == step)
+			{
+				displacement.Set(random(20.0f) - 10.0f, random(20.0f) - 10.0f);
+			}
+
+			boxes[i].lowerBound += displacement;
+			boxes[i].upperBound += displacement;
+			for (int32 k = 0; k < 3; ++k)
+			{
+				broadPhases[k].MoveProxy(proxyIds[k][i], boxes[i], displacement);
+			}
+		}
+
+		// Recreate one proxy each step.
+		int32 index = 1 + step * 13;
+		for (int32 k = 0; k < 3; ++k)
+		{
+			broadPhases[k].DestroyProxy(proxyIds[k][index]);
+			proxyIds[k][index] = broadPhases[k].CreateProxy(boxes[index], (void*)intptr_t(index));
+		}
+	}
+
+	CHECK(pairCount > 0);
+	CHECK(samePairs);
+	CHECK(sameQueries);
+	CHECK(sameRays);
+
+	for (int32 k = 0; k < 3; ++k)
+	{
+		CHECK(broadPhases[k].GetProxyCount() == proxyCount);
+	}
+}
+
+DOCTEST_TEST_CASE("parallel pair finding matches serial")
+{
+	const int32 proxyCount = 1000;
+	const b2BroadPhaseType types[2] = { b2_treeBroadPhase, b2_gridBroadPhase };
+
+	b2ThreadPool threadPool(4);
+
+	for (int32 t = 0; t < 2; ++t)
+	{
+		b2BroadPhase serial, parallel;
+		serial.SetType(types[t], 1.5f);
+		parallel.SetType(types[t], 1.5f);
+
+		BroadPhaseRecorder serialRecorder, parallelRecorder;
+		serialRecorder.broadPhase = &serial;
+		parallelRecorder.broadPhase = &parallel;
+
+		uint32 seed = 99;
+		b2AABB boxes[proxyCount];
+		int32 serialIds[proxyCount], parallelIds[proxyCount];
+		for (int32 i = 0; i < proxyCount; ++i)
+		{
+			seed = 1664525u * seed + 1013904223u;
+			float x = float(seed % 4000u) * 0.01f;
+			seed = 1664525u * seed + 1013904223u;
+			float y = float(seed % 4000u) * 0.01f;
+			boxes[i].lowerBound.Set(x, y);
+			boxes[i].upperBound.Set(x + 1.0f, y + 1.0f);
+			serialIds[i] = serial.CreateProxy(boxes[i], (void*)intptr_t(i));
+			parallelIds[i] = parallel.CreateProxy(boxes[i], (void*)intptr_t(i));
+		}
+
+		bool same = true;
+		for (int32 step = 0; step < 5; ++step)
+		{
+			serial.UpdatePairs(&serialRecorder);
+			parallel.UpdatePairs(&parallelRecorder, &threadPool);
+
+			// The order must match too, not only the set of pairs.
+			same = same && serialRecorder.pairs.size() > 0 && serialRecorder.pairs == parallelRecorder.pairs;
+			serialRecorder.pairs.clear();
+			parallelRecorder.pairs.clear();
+
+			for (int32 i = 0; i < proxyCount; ++i)
+			{
+				b2Vec2 displacement(0.5f, 0.25f);
+				boxes[i].lowerBound += displacement;
+				boxes[i].upperBound += displacement;
+				serial.MoveProxy(serialIds[i], boxes[i], displacement);
+				parallel.MoveProxy(parallelIds[i], boxes[i], displacement);
+			}
+		}
+
+		CHECK(same);
+	}
+}
+
+DOCTEST_TEST_CASE("distance simplex cache")
+{
+	SUBCASE("support matches a scalar scan")
+	{
+		// Regular polygons have ties between neighbours for some directions.
+		for (int32 count = 1; count <= b2_maxPolygonVertices; ++count)
+		{
+			b2Vec2 vertices[b2_maxPolygonVertices];
+			for (int32 i = 0; i < count; ++i)
+			{
+				float angle = 2.0f * b2_pi * i / count;
+				vertices[i].Set(cosf(angle), sinf(angle));
+			}
+
+			b2DistanceProxy proxy;
+			proxy.Set(vertices, count, 0.0f);
+
+			for (int32 j = 0; j < 64; ++j)
+			{
+				float angle = 2.0f * b2_pi * j / 64;
+				b2Vec2 d(cosf(angle), sinf(angle));
+
+				int32 bestIndex = 0;
+				for (int32 i = 1; i < count; ++i)
+				{
+					if (b2Dot(vertices[i], d) > b2Dot(vertices[bestIndex], d))
+					{
+						bestIndex = i;
+					}
+				}
+
+				CHECK(proxy.GetSupport(d) == bestIndex);
+				CHECK(&proxy.GetSupportVertex(d) == vertices + bestIndex);
+			}
+
+			// All vertices tie for the zero direction, so the first one wins.
+			CHECK(proxy.GetSupport(b2Vec2_zero) == 0);
+		}
+	}
+
+	SUBCASE("warm start")
+	{
+		b2PolygonShape boxA;
+		boxA.SetAsBox(1.0f, 0.5f);
+		b2PolygonShape boxB;
+		boxB.SetAsBox(0.5f, 0.5f, b2Vec2_zero, 0.3f);
+
+		b2SimplexCache overlapCache;
+		overlapCache.count = 0;
+		b2SimplexCache distanceCache;
+		distanceCache.count = 0;
+
+		int32 coldIterations = 0;
+		int32 warmIterations = 0;
+		int32 overlapCount = 0;
+		for (int32 i = 0; i < 200; ++i)
+		{
+			// Pass B slowly over A.
+			b2Transform xfA(b2Vec2_zero, b2Rot(0.0f));
+			b2Transform xfB(b2Vec2(-3.0f + 0.03f * i, 0.8f), b2Rot(0.01f * i));
+
+			bool cold = b2TestOverlap(&boxA, 0, &boxB, 0, xfA, xfB);
+			bool warm = b2TestOverlap(&boxA, 0, &boxB, 0, xfA, xfB, &overlapCache);
+			CHECK(cold == warm);
+			overlapCount += warm ? 1 : 0;
+
+			b2DistanceInput input;
+			input.proxyA.Set(&boxA, 0);
+			input.proxyB.Set(&boxB, 0);
+			input.transformA = xfA;
+			input.transformB = xfB;
+			input.useRadii = false;
+
+			b2SimplexCache cache;
+			cache.count = 0;
+			b2DistanceOutput coldOutput;
+			b2Distance(&coldOutput, &cache, &input);
+
+			b2DistanceOutput warmOutput;
+			b2Distance(&warmOutput, &distanceCache, &input);
+
+			CHECK(b2Abs(coldOutput.distance - warmOutput.distance) < 1.0e-5f);
+			coldIterations += coldOutput.iterations;
+			warmIterations += warmOutput.iterations;
+		}
+
+		CHECK(overlapCount > 0);
+		CHECK(overlapCount < 200);
+		CHECK(warmIterations < coldIterations);
+	}
+}
@@ -42,13 +42,31 @@ DOCTEST_TEST_CASE("math test")
 		sweep.GetTransform(&transform, 0.0f);
 		DOCTEST_REQUIRE_EQ(transform.p.x, sweep.c0.x);
 		DOCTEST_REQUIRE_EQ(transform.p.y, sweep.c0.y);
-		DOCTEST_REQUIRE_EQ(transform.q.c, cosf(sweep.a0));
-		DOCTEST_REQUIRE_EQ(transform.q.s, sinf(sweep.a0));
+		DOCTEST_REQUIRE_EQ(transform.q.c, b2Cos(sweep.a0));
+		DOCTEST_REQUIRE_EQ(transform.q.s, b2Sin(sweep.a0));
 
 		sweep.GetTransform(&transform, 1.0f);
 		DOCTEST_REQUIRE_EQ(transform.p.x, sweep.c.x);
 		DOCTEST_REQUIRE_EQ(transform.p.y, sweep.c.y);
-		DOCTEST_REQUIRE_EQ(transform.q.c, cosf(sweep.a));
-		DOCTEST_REQUIRE_EQ(transform.q.s, sinf(sweep.a));
+		DOCTEST_REQUIRE_EQ(transform.q.c, b2Cos(sweep.a));
+		DOCTEST_REQUIRE_EQ(transform.q.s, b2Sin(sweep.a));
+	}
+
+	SUBCASE("trig")
+	{
+		// Deterministic builds replace the C library functions with approximations.
+		for (int32 i = -1000; i <= 1000; ++i)
+		{
+			float angle = 0.01f * i;
+			CHECK(b2Abs(b2Sin(angle) - sinf(angle)) < 1e-6f);
+			CHECK(b2Abs(b2Cos(angle) - cosf(angle)) < 1e-6f);
+
+			float x = cosf(angle);
+			float y = sinf(angle);
+			CHECK(b2Abs(b2Atan2(y, x) - atan2f(y, x)) < 2e-6f);
+			CHECK(b2Abs(b2Atan2(3.0f * y, 0.5f * x) - atan2f(3.0f * y, 0.5f * x)) < 2e-6f);
+		}
+
+		CHECK(b2Atan2(0.0f, 0.0f) == 0.0f);
 	}
 }
@@ -21,8 +21,10 @@
 // SOFTWARE.
 
 #include "box2d/box2d.h"
+#include "box2d/b2_distance.h"
 #include "doctest.h"
 #include <stdio.h>
+#include <string.h>
 
 static bool begin_contact = false;
 
@@ -71,3 +73,1561 @@ DOCTEST_TEST_CASE("begin contact")
 	CHECK(world.GetContactList() != nullptr);
 	CHECK(begin_contact == true);
 }
+
+// Separate stacks of boxes and pendulums, so the world has many islands that
+// share the static ground body.
+static void CreateIslands(b2World* world)
+{
+	b2BodyDef bodyDef;
+	b2Body* ground = world->CreateBody(&bodyDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-100.0f, 0.0f), b2Vec2(100.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	bodyDef.type = b2_dynamicBody;
+
+	for (int32 i = 0; i < 16; ++i)
+	{
+		float x = -80.0f + 10.0f * i;
+
+		for (int32 j = 0; j < 6; ++j)
+		{
+			bodyDef.position.Set(x + 0.05f * j, 0.5f + 1.05f * j);
+			bodyDef.angle = 0.01f * i;
+			bodyDef.userData.pointer = 7 * i + j + 1;
+			b2Body* body = world->CreateBody(&bodyDef);
+			body->CreateFixture(&box, 1.0f);
+		}
+
+		bodyDef.position.Set(x + 4.0f, 8.0f);
+		bodyDef.angle = 0.0f;
+		bodyDef.userData.pointer = 7 * i + 7;
+		b2Body* bob = world->CreateBody(&bodyDef);
+		bob->CreateFixture(&box, 1.0f);
+
+		b2RevoluteJointDef jointDef;
+		jointDef.Initialize(ground, bob, b2Vec2(x + 2.0f, 10.0f));
+		world->CreateJoint(&jointDef);
+	}
+}
+
+// Records an order dependent hash of the contact events.
+class ContactEventRecorder : public b2ContactListener
+{
+public:
+	ContactEventRecorder() : count(0), hash(0), normalImpulse(0.0f) {}
+
+	void Record(uint32 event, b2Contact* contact)
+	{
+		uint32 keyA = uint32(contact->GetFixtureA()->GetBody()->GetUserData().pointer);
+		uint32 keyB = uint32(contact->GetFixtureB()->GetBody()->GetUserData().pointer);
+		hash = 31 * hash + event;
+		hash = 31 * hash + keyA;
+		hash = 31 * hash + keyB;
+		count += 1;
+	}
+
+	void BeginContact(b2Contact* contact) override
+	{
+		Record(1, contact);
+	}
+
+	void EndContact(b2Contact* contact) override
+	{
+		Record(2, contact);
+	}
+
+	void PreSolve(b2Contact* contact, const b2Manifold* oldManifold) override
+	{
+		Record(3 + oldManifold->pointCount, contact);
+	}
+
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		Record(6, contact);
+		normalImpulse += impulse->normalImpulses[0];
+	}
+
+	int32 count;
+	uint32 hash;
+	float normalImpulse;
+};
+
+static bool SameBodyState(const b2World& worldA, const b2World& worldB)
+{
+	const b2Body* a = worldA.GetBodyList();
+	const b2Body* b = worldB.GetBodyList();
+	while (a && b)
+	{
+		b2Transform xfA = a->GetTransform();
+		b2Transform xfB = b->GetTransform();
+		b2Vec2 vA = a->GetLinearVelocity();
+		b2Vec2 vB = b->GetLinearVelocity();
+		float wA = a->GetAngularVelocity();
+		float wB = b->GetAngularVelocity();
+
+		if (memcmp(&xfA, &xfB, sizeof(b2Transform)) != 0 ||
+			memcmp(&vA, &vB, sizeof(b2Vec2)) != 0 ||
+			memcmp(&wA, &wB, sizeof(float)) != 0 ||
+			a->IsAwake() != b->IsAwake())
+		{
+			return false;
+		}
+
+		a = a->GetNext();
+		b = b->GetNext();
+	}
+
+	return a == nullptr && b == nullptr;
+}
+
+DOCTEST_TEST_CASE("thread pool matches serial")
+{
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f));
+	CreateIslands(&serialWorld);
+	CreateIslands(&parallelWorld);
+
+	ContactEventRecorder serialListener;
+	ContactEventRecorder parallelListener;
+	serialWorld.SetContactListener(&serialListener);
+	parallelWorld.SetContactListener(&parallelListener);
+
+	b2ThreadPool threadPool(4);
+	parallelWorld.SetThreadPool(&threadPool);
+
+	bool same = true;
+	for (int32 i = 0; i < 240 && same; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+		same = SameBodyState(serialWorld, parallelWorld);
+	}
+
+	CHECK(same);
+	CHECK(serialListener.count > 0);
+	CHECK(serialListener.count == parallelListener.count);
+	CHECK(serialListener.hash == parallelListener.hash);
+	CHECK(serialListener.normalImpulse == parallelListener.normalImpulse);
+
+	parallelWorld.SetThreadPool(nullptr);
+}
+
+static b2Body* CreatePyramid(b2World* world, int32 rowCount)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2Body* top = nullptr;
+	for (int32 i = 0; i < rowCount; ++i)
+	{
+		for (int32 j = i; j < rowCount; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-0.5f * rowCount + 0.5625f * i + 1.125f * (j - i), 0.5f + i);
+			top = world->CreateBody(&bd);
+			top->CreateFixture(&box, 5.0f);
+		}
+	}
+
+	return top;
+}
+
+DOCTEST_TEST_CASE("wide contact solver")
+{
+	b2World scalarWorld(b2Vec2(0.0f, -10.0f));
+	b2World wideWorld(b2Vec2(0.0f, -10.0f));
+	b2Body* scalarTop = CreatePyramid(&scalarWorld, 12);
+	b2Body* wideTop = CreatePyramid(&wideWorld, 12);
+
+	wideWorld.SetWideContactSolver(true);
+	CHECK(wideWorld.GetWideContactSolver());
+
+	for (int32 i = 0; i < 300; ++i)
+	{
+		scalarWorld.Step(1.0f / 60.0f, 8, 3);
+		wideWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	// The solve order differs so the results are only close, but the pyramid must come to rest.
+	CHECK(scalarTop->IsAwake() == false);
+	CHECK(wideTop->IsAwake() == false);
+	CHECK(b2Distance(scalarTop->GetPosition(), wideTop->GetPosition()) < 0.1f);
+}
+
+// Circles, boxes, a static ledge and a moving kinematic platform give circle, one point and
+// two point manifolds with bodies that can share a batch.
+static void CreateMixedScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape ledge;
+	ledge.SetAsBox(4.0f, 0.25f, b2Vec2(20.0f, 4.0f), 0.0f);
+	ground->CreateFixture(&ledge, 0.0f);
+
+	b2BodyDef platformDef;
+	platformDef.type = b2_kinematicBody;
+	platformDef.position.Set(-20.0f, 3.0f);
+	platformDef.linearVelocity.Set(0.5f, 0.0f);
+	b2Body* platform = world->CreateBody(&platformDef);
+	b2PolygonShape platformBox;
+	platformBox.SetAsBox(5.0f, 0.25f);
+	platform->CreateFixture(&platformBox, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.allowSleep = false;
+
+	// A row of touching circles on the ground.
+	for (int32 i = 0; i < 13; ++i)
+	{
+		bd.position.Set(-8.0f + 1.0f * i, 0.5f);
+		world->CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+	}
+
+	// Boxes on the ground with circles resting on top.
+	for (int32 i = 0; i < 5; ++i)
+	{
+		bd.position.Set(8.0f + 1.5f * i, 0.5f);
+		world->CreateBody(&bd)->CreateFixture(&box, 1.0f);
+		bd.position.Set(8.0f + 1.5f * i, 1.5f);
+		world->CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+	}
+
+	// A stack on the static ledge.
+	for (int32 i = 0; i < 3; ++i)
+	{
+		bd.position.Set(20.0f, 4.75f + 1.0f * i);
+		world->CreateBody(&bd)->CreateFixture(&box, 1.0f);
+	}
+
+	// Boxes and circles riding the kinematic platform.
+	for (int32 i = 0; i < 7; ++i)
+	{
+		bd.position.Set(-23.0f + 1.0f * i, 3.75f);
+		world->CreateBody(&bd)->CreateFixture(i % 2 == 0 ? static_cast<b2Shape*>(&box) : &circle, 1.0f);
+	}
+}
+
+DOCTEST_TEST_CASE("wide contact solver batches")
+{
+	b2World scalarWorld(b2Vec2(0.0f, -10.0f));
+	b2World wideWorld(b2Vec2(0.0f, -10.0f));
+	CreateMixedScene(&scalarWorld);
+	CreateMixedScene(&wideWorld);
+	wideWorld.SetWideContactSolver(true);
+
+	bool batched = false;
+	bool remainder = false;
+	bool uneven = false;
+	bool packed = true;
+	for (int32 i = 0; i < 180; ++i)
+	{
+		scalarWorld.Step(1.0f / 60.0f, 8, 3);
+		wideWorld.Step(1.0f / 60.0f, 8, 3);
+
+		// Nothing sleeps, so every touching contact goes through the solver.
+		int32 touchingCount = 0;
+		for (b2Contact* c = wideWorld.GetContactList(); c; c = c->GetNext())
+		{
+			touchingCount += c->IsTouching() && c->IsEnabled() ? 1 : 0;
+		}
+
+		const b2Profile& profile = wideWorld.GetProfile();
+		batched = batched || profile.wideBatchCount > 0;
+		remainder = remainder || profile.wideRemainderCount > 0;
+		uneven = uneven || touchingCount % 4 != 0;
+
+		// Each batch holds one SIMD width of contacts.
+		int32 batchedCount = touchingCount - profile.wideRemainderCount;
+		if (profile.wideBatchCount > 0)
+		{
+			int32 width = batchedCount / profile.wideBatchCount;
+			packed = packed && batchedCount % profile.wideBatchCount == 0 && (width == 4 || width == 8);
+		}
+		else
+		{
+			packed = packed && batchedCount == 0;
+		}
+	}
+
+	CHECK(batched);
+	CHECK(remainder);
+	CHECK(uneven);
+	CHECK(packed);
+
+	// The solve order differs so the results are only close.
+	float maxDistance = 0.0f;
+	for (b2Body* a = scalarWorld.GetBodyList(), *b = wideWorld.GetBodyList(); a && b; a = a->GetNext(), b = b->GetNext())
+	{
+		maxDistance = b2Max(maxDistance, b2Distance(a->GetPosition(), b->GetPosition()));
+		CHECK((b->GetType() != b2_dynamicBody || b->GetPosition().y > 0.0f));
+	}
+	CHECK(maxDistance < 0.1f);
+}
+
+DOCTEST_TEST_CASE("graph coloring does not depend on thread count")
+{
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f));
+	CreatePyramid(&serialWorld, 24);
+	CreatePyramid(&parallelWorld, 24);
+
+	serialWorld.SetGraphColoring(true);
+	parallelWorld.SetGraphColoring(true);
+
+	b2ThreadPool threadPool(4);
+	parallelWorld.SetThreadPool(&threadPool);
+
+	bool same = true;
+	for (int32 i = 0; i < 120 && same; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+		same = SameBodyState(serialWorld, parallelWorld);
+	}
+
+	CHECK(same);
+
+	const b2Profile& profile = parallelWorld.GetProfile();
+	CHECK(profile.colorCount > 1.0f);
+
+	float constraintCount = profile.colorOverflow;
+	for (int32 i = 0; i < b2_graphColorCount; ++i)
+	{
+		constraintCount += profile.colorSizes[i];
+	}
+	int32 touchingCount = 0;
+	for (b2Contact* c = parallelWorld.GetContactList(); c; c = c->GetNext())
+	{
+		touchingCount += c->IsTouching() ? 1 : 0;
+	}
+	CHECK(constraintCount == float(touchingCount));
+
+	parallelWorld.SetThreadPool(nullptr);
+}
+
+class FixtureCounter : public b2QueryCallback
+{
+public:
+	bool ReportFixture(b2Fixture* fixture) override
+	{
+		B2_NOT_USED(fixture);
+		++count;
+		return true;
+	}
+
+	int32 count = 0;
+};
+
+DOCTEST_TEST_CASE("query aabb batch")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	CreatePyramid(&world, 10);
+
+	const int32 queryCount = 55;
+	b2AABB aabbs[queryCount];
+	b2Fixture* fixtures[queryCount];
+	int32 count = 0;
+	FixtureCounter counter;
+	for (b2Body* body = world.GetBodyList(); body && count < queryCount; body = body->GetNext())
+	{
+		if (body->GetType() != b2_dynamicBody)
+		{
+			continue;
+		}
+
+		fixtures[count] = body->GetFixtureList();
+		aabbs[count] = fixtures[count]->GetAABB(0);
+		world.QueryAABB(&counter, aabbs[count]);
+		++count;
+	}
+
+	REQUIRE(count == queryCount);
+
+	b2ThreadPool threadPool(4);
+	world.SetThreadPool(&threadPool);
+
+	b2FixtureQueryHit hits[1024];
+	int32 hitCount = world.QueryAABBBatch(aabbs, queryCount, hits, 1024);
+	CHECK(hitCount == counter.count);
+
+	// Every box finds at least its own fixture.
+	int32 foundCount = 0;
+	for (int32 i = 0; i < hitCount; ++i)
+	{
+		if (hits[i].fixture == fixtures[hits[i].queryIndex])
+		{
+			++foundCount;
+		}
+	}
+	CHECK(foundCount == queryCount);
+
+	world.SetThreadPool(nullptr);
+}
+
+// Closest hit ray cast, skipping sensors like b2World::RayCastBatch.
+class ClosestRayCastCallback : public b2RayCastCallback
+{
+public:
+	ClosestRayCastCallback()
+	{
+		fixture = nullptr;
+		fraction = 1.0f;
+	}
+
+	float ReportFixture(b2Fixture* f, const b2Vec2& p, const b2Vec2& n, float t) override
+	{
+		if (f->IsSensor())
+		{
+			return -1.0f;
+		}
+
+		fixture = f;
+		point = p;
+		normal = n;
+		fraction = t;
+		return t;
+	}
+
+	b2Fixture* fixture;
+	b2Vec2 point;
+	b2Vec2 normal;
+	float fraction;
+};
+
+static void CreateRayCastScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2Vec2 vertices[5] = { b2Vec2(-20.0f, 5.0f), b2Vec2(-10.0f, 0.0f), b2Vec2(0.0f, 1.0f), b2Vec2(10.0f, 0.0f), b2Vec2(20.0f, 5.0f) };
+	b2ChainShape chain;
+	chain.CreateChain(vertices, 5, b2Vec2(-30.0f, 10.0f), b2Vec2(30.0f, 10.0f));
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 20.0f), b2Vec2(-5.0f, 18.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.25f);
+	b2CircleShape circle;
+	circle.m_radius = 0.4f;
+	circle.m_p.Set(0.1f, 0.0f);
+
+	for (int32 i = 0; i < 80; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-18.0f + 0.45f * i, 2.0f + 0.17f * (i % 50));
+		bd.angle = 0.3f * i;
+		b2Body* body = world->CreateBody(&bd);
+
+		b2FixtureDef fd;
+		fd.shape = i % 3 == 0 ? (const b2Shape*)&circle : (const b2Shape*)&box;
+		fd.density = 1.0f;
+		fd.isSensor = i % 7 == 0;
+		body->CreateFixture(&fd);
+	}
+}
+
+DOCTEST_TEST_CASE("ray cast batch")
+{
+	const int32 rayCount = 203;
+	b2RayCastInput inputs[rayCount];
+	for (int32 i = 0; i < rayCount; ++i)
+	{
+		float angle = 0.031f * i;
+		inputs[i].p1.Set(-15.0f + 0.15f * i, 12.0f);
+		inputs[i].p2 = inputs[i].p1 + 30.0f * b2Vec2(cosf(angle), -sinf(angle));
+		inputs[i].maxFraction = i % 5 == 0 ? 0.5f : 1.0f;
+	}
+
+	b2ThreadPool threadPool(4);
+
+	const b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+	for (b2BroadPhaseType type : types)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f), type);
+		CreateRayCastScene(&world);
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		for (int32 pass = 0; pass < 2; ++pass)
+		{
+			world.SetThreadPool(pass == 0 ? nullptr : &threadPool);
+
+			b2RayCastHit hits[rayCount];
+			world.RayCastBatch(inputs, rayCount, hits);
+
+			int32 hitCount = 0;
+			for (int32 i = 0; i < rayCount; ++i)
+			{
+				const b2RayCastInput& input = inputs[i];
+				ClosestRayCastCallback callback;
+				world.RayCast(&callback, input.p1, input.p1 + input.maxFraction * (input.p2 - input.p1));
+
+				CHECK(hits[i].fixture == callback.fixture);
+				if (callback.fixture == nullptr)
+				{
+					CHECK(hits[i].fraction == input.maxFraction);
+					continue;
+				}
+
+				// The reference ray is shortened, which scales its fraction.
+				CHECK(b2Abs(hits[i].fraction - input.maxFraction * callback.fraction) < 1.0e-5f);
+				CHECK(b2Distance(hits[i].point, callback.point) < 1.0e-4f);
+				CHECK(b2Distance(hits[i].normal, callback.normal) < 1.0e-5f);
+				++hitCount;
+			}
+
+			CHECK(hitCount > rayCount / 3);
+		}
+
+		world.SetThreadPool(nullptr);
+	}
+}
+
+DOCTEST_TEST_CASE("compact tree with one fixture")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetTreeCompactMode(true);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	b2Body* body = world.CreateBody(&bd);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	b2Fixture* fixture = body->CreateFixture(&box, 1.0f);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	ClosestRayCastCallback callback;
+	b2Vec2 p = body->GetPosition();
+	world.RayCast(&callback, p - b2Vec2(5.0f, 0.0f), p + b2Vec2(5.0f, 0.0f));
+	CHECK(callback.fixture == fixture);
+
+	FixtureCounter counter;
+	b2AABB aabb;
+	aabb.lowerBound = p - b2Vec2(1.0f, 1.0f);
+	aabb.upperBound = p + b2Vec2(1.0f, 1.0f);
+	world.QueryAABB(&counter, aabb);
+	CHECK(counter.count == 1);
+}
+
+DOCTEST_TEST_CASE("shape cast batch")
+{
+	b2CircleShape circle;
+	circle.m_radius = 0.2f;
+	b2PolygonShape box;
+	box.SetAsBox(0.3f, 0.1f, b2Vec2(0.1f, 0.0f), 0.4f);
+
+	const int32 queryCount = 151;
+	b2ShapeCastQuery queries[queryCount];
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		float angle = 0.037f * i;
+		queries[i].shape = i % 2 == 0 ? (const b2Shape*)&circle : (const b2Shape*)&box;
+		queries[i].transform.Set(b2Vec2(-15.0f + 0.2f * i, 12.0f), 0.1f * i);
+		queries[i].translation = 25.0f * b2Vec2(cosf(angle), -sinf(angle));
+	}
+
+	b2ThreadPool threadPool(4);
+
+	const b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+	for (b2BroadPhaseType type : types)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f), type);
+		CreateRayCastScene(&world);
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		b2ShapeCastHit serialHits[queryCount];
+		world.ShapeCastBatch(queries, queryCount, serialHits);
+
+		world.SetThreadPool(&threadPool);
+		b2ShapeCastHit hits[queryCount];
+		world.ShapeCastBatch(queries, queryCount, hits);
+		world.SetThreadPool(nullptr);
+
+		int32 hitCount = 0;
+		for (int32 i = 0; i < queryCount; ++i)
+		{
+			CHECK(hits[i].fixture == serialHits[i].fixture);
+			CHECK(hits[i].fraction == serialHits[i].fraction);
+
+			// Cast against every fixture for the reference.
+			b2DistanceProxy proxyB;
+			proxyB.Set(queries[i].shape, 0);
+			float fraction = 1.0f;
+			for (b2Body* b = world.GetBodyList(); b; b = b->GetNext())
+			{
+				for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+				{
+					if (f->IsSensor())
+					{
+						continue;
+					}
+
+					for (int32 childIndex = 0; childIndex < f->GetShape()->GetChildCount(); ++childIndex)
+					{
+						b2ShapeCastInput input;
+						input.proxyA.Set(f->GetShape(), childIndex);
+						input.proxyB = proxyB;
+						input.transformA = b->GetTransform();
+						input.transformB = queries[i].transform;
+						input.translationB = queries[i].translation;
+
+						b2ShapeCastOutput output;
+						if (b2ShapeCast(&output, &input))
+						{
+							fraction = b2Min(fraction, output.lambda);
+						}
+					}
+				}
+			}
+
+			CHECK(hits[i].fraction == fraction);
+			CHECK((hits[i].fixture != nullptr) == (fraction < 1.0f));
+			if (hits[i].fixture != nullptr)
+			{
+				CHECK(hits[i].fixture->IsSensor() == false);
+				++hitCount;
+			}
+		}
+
+		CHECK(hitCount > queryCount / 3);
+	}
+}
+
+static void CreateStack(b2World* world, b2Body** removed, int32 removedCapacity)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	for (int32 i = 0; i < 20; ++i)
+	{
+		// Bodies that are destroyed before the first step fill the slots in between.
+		if (removed != nullptr && i < removedCapacity)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(100.0f + i, 0.0f);
+			removed[i] = world->CreateBody(&bd);
+			removed[i]->CreateFixture(&box, 1.0f);
+		}
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(0.1f * i, 0.5f + 1.1f * i);
+		bd.angularVelocity = 0.01f * i;
+		b2Body* body = world->CreateBody(&bd);
+		body->CreateFixture(&box, 1.0f);
+	}
+}
+
+DOCTEST_TEST_CASE("body state slots")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	b2World reference(b2Vec2(0.0f, -10.0f));
+
+	const int32 removedCount = 12;
+	b2Body* removed[removedCount];
+	CreateStack(&world, removed, removedCount);
+	CreateStack(&reference, nullptr, 0);
+
+	for (int32 i = 0; i < removedCount; i += 2)
+	{
+		world.DestroyBody(removed[i]);
+	}
+
+	for (int32 i = 1; i < removedCount; i += 2)
+	{
+		world.DestroyBody(removed[i]);
+	}
+
+	CHECK(SameBodyState(world, reference));
+
+	bool same = true;
+	for (int32 i = 0; i < 120 && same; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		reference.Step(1.0f / 60.0f, 8, 3);
+		same = SameBodyState(world, reference);
+	}
+
+	CHECK(same);
+}
+
+DOCTEST_TEST_CASE("persistent islands")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(-5.0f, 0.5f);
+	b2Body* bodyA = world.CreateBody(&bd);
+	bodyA->CreateFixture(&box, 1.0f);
+
+	bd.position.Set(5.0f, 0.5f);
+	b2Body* bodyB = world.CreateBody(&bd);
+	bodyB->CreateFixture(&box, 1.0f);
+
+	// The ground does not connect islands.
+	CHECK(world.GetIslandCount() == 2);
+
+	b2DistanceJointDef jd;
+	jd.Initialize(bodyA, bodyB, bodyA->GetPosition(), bodyB->GetPosition());
+	b2Joint* joint = world.CreateJoint(&jd);
+	CHECK(world.GetIslandCount() == 1);
+
+	// Islands are only split once they come to rest.
+	world.DestroyJoint(joint);
+	CHECK(world.GetIslandCount() == 1);
+
+	for (int32 i = 0; i < 300 && (bodyA->IsAwake() || bodyB->IsAwake()); ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(bodyA->IsAwake() == false);
+	CHECK(bodyB->IsAwake() == false);
+	CHECK(world.GetIslandCount() == 2);
+
+	// A falling box joins the island of the box it lands on and wakes it.
+	bd.position.Set(-5.0f, 2.0f);
+	b2Body* bodyC = world.CreateBody(&bd);
+	bodyC->CreateFixture(&box, 1.0f);
+	CHECK(world.GetIslandCount() == 3);
+
+	for (int32 i = 0; i < 60; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(world.GetIslandCount() == 2);
+	CHECK(bodyB->IsAwake() == false);
+}
+
+DOCTEST_TEST_CASE("contact events")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetContactEvents(true);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	b2Fixture* groundFixture = ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(0.0f, 4.0f);
+	b2Body* body = world.CreateBody(&bd);
+
+	b2FixtureDef fd;
+	fd.shape = &box;
+	fd.density = 1.0f;
+	fd.userData.pointer = 7;
+	b2Fixture* boxFixture = body->CreateFixture(&fd);
+
+	int32 beginCount = 0;
+	int32 hitCount = 0;
+	float approachSpeed = 0.0f;
+	for (int32 i = 0; i < 60; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		for (int32 j = 0; j < world.GetContactBeginEventCount(); ++j)
+		{
+			const b2ContactBeginEvent& event = world.GetContactBeginEvents()[j];
+			bool boxFirst = event.fixtureA == boxFixture;
+			CHECK((boxFirst ? event.fixtureB : event.fixtureA) == groundFixture);
+			CHECK((boxFirst ? event.userDataA : event.userDataB).pointer == 7);
+			++beginCount;
+		}
+
+		for (int32 j = 0; j < world.GetContactHitEventCount(); ++j)
+		{
+			approachSpeed = world.GetContactHitEvents()[j].approachSpeed;
+			++hitCount;
+		}
+
+		CHECK(world.GetContactEndEventCount() == 0);
+	}
+
+	// Falling 3.5 meters gives about 8.4 meters per second.
+	CHECK(beginCount == 1);
+	CHECK(hitCount == 1);
+	CHECK(approachSpeed > 7.0f);
+	CHECK(approachSpeed < 10.0f);
+
+	// Jump off the ground.
+	body->SetLinearVelocity(b2Vec2(0.0f, 5.0f));
+
+	int32 endCount = 0;
+	for (int32 i = 0; i < 10; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		endCount += world.GetContactEndEventCount();
+		CHECK(world.GetContactBeginEventCount() == 0);
+	}
+
+	CHECK(endCount == 1);
+
+	// Land again and destroy the body between steps.
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+	CHECK(world.GetContactCount() == 1);
+
+	world.DestroyBody(body);
+	CHECK(world.GetContactEndEventCount() == 1);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetContactEndEventCount() == 1);
+	const b2ContactEndEvent& event = world.GetContactEndEvents()[0];
+	bool boxFirst = event.userDataA.pointer == 7;
+	CHECK((boxFirst ? event.fixtureA : event.fixtureB) == nullptr);
+	CHECK((boxFirst ? event.fixtureB : event.fixtureA) == groundFixture);
+	CHECK((boxFirst ? event.userDataA : event.userDataB).pointer == 7);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetContactEndEventCount() == 0);
+}
+
+DOCTEST_TEST_CASE("sensor overlaps")
+{
+	b2World world(b2Vec2(0.0f, 0.0f));
+	world.SetContactEvents(true);
+
+	b2CircleShape circle;
+	circle.m_radius = 1.0f;
+
+	b2BodyDef sensorDef;
+	b2Body* sensorBody = world.CreateBody(&sensorDef);
+
+	b2FixtureDef sensorFixtureDef;
+	sensorFixtureDef.shape = &circle;
+	sensorFixtureDef.isSensor = true;
+	sensorBody->CreateFixture(&sensorFixtureDef);
+
+	// A circle and a box pass through the sensor.
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.linearVelocity.Set(10.0f, 0.0f);
+	bd.position.Set(-5.0f, 0.0f);
+	world.CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+	bd.position.Set(-8.0f, 0.5f);
+	world.CreateBody(&bd)->CreateFixture(&box, 1.0f);
+
+	int32 beginCount = 0;
+	int32 endCount = 0;
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		beginCount += world.GetContactBeginEventCount();
+		endCount += world.GetContactEndEventCount();
+		CHECK(world.GetContactHitEventCount() == 0);
+	}
+
+	CHECK(beginCount == 2);
+	CHECK(endCount == 2);
+
+	// The static sensor does not move after a shift, but its bounds must follow the origin.
+	world.ShiftOrigin(b2Vec2(100.0f, 0.0f));
+
+	bd.linearVelocity.SetZero();
+	bd.position.Set(-100.5f, 0.0f);
+	world.CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetContactBeginEventCount() == 1);
+}
+
+DOCTEST_TEST_CASE("soft step")
+{
+	b2World world(b2Vec2(0.0f, -30.0f));
+	world.SetAllowSleeping(false);
+	world.SetSoftStep(true);
+	CHECK(world.GetSoftStepCount() == b2_softStepCount);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-50.0f, 0.0f), b2Vec2(50.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	// A column of boxes.
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	const int32 count = 5;
+	b2Body* boxes[count];
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(0.0f, 0.5f + 1.0f * i);
+		boxes[i] = world.CreateBody(&bd);
+		boxes[i]->CreateFixture(&box, 1.0f);
+	}
+
+	// A heavy box resting on a light box.
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(-30.0f, 0.5f);
+	b2Body* light = world.CreateBody(&bd);
+	light->CreateFixture(&box, 1.0f);
+	bd.position.Set(-30.0f, 1.5f);
+	b2Body* heavy = world.CreateBody(&bd);
+	heavy->CreateFixture(&box, 100.0f);
+
+	// A bouncing ball.
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+	bd.position.Set(30.0f, 5.0f);
+	b2Body* ball = world.CreateBody(&bd);
+
+	b2FixtureDef ballFixtureDef;
+	ballFixtureDef.shape = &circle;
+	ballFixtureDef.density = 1.0f;
+	ballFixtureDef.restitution = 0.8f;
+	ball->CreateFixture(&ballFixtureDef);
+
+	bool bounced = false;
+	for (int32 i = 0; i < 300; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		bounced = bounced || ball->GetLinearVelocity().y > 5.0f;
+	}
+
+	CHECK(bounced);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Vec2 p = boxes[i]->GetPosition();
+		CHECK(b2Abs(p.x) < 0.01f);
+		CHECK(b2Abs(p.y - (0.5f + 1.0f * i)) < 0.1f);
+		CHECK(boxes[i]->GetLinearVelocity().Length() < 0.05f);
+	}
+
+	// The soft contacts let the heavy box sink a little, but it comes to rest.
+	CHECK(light->GetPosition().y > 0.4f);
+	CHECK(heavy->GetPosition().y > 1.25f);
+	CHECK(b2Abs(heavy->GetPosition().x + 30.0f) < 0.05f);
+	CHECK(heavy->GetLinearVelocity().Length() < 0.01f);
+}
+
+static void CreateHashScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	for (int32 i = 0; i < 20; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(0.3f * (i % 5) - 0.6f, 1.0f + 1.1f * i);
+		bd.angle = 0.1f * i;
+		world->CreateBody(&bd)->CreateFixture(&box, 1.0f);
+	}
+}
+
+DOCTEST_TEST_CASE("state hash")
+{
+	b2World world1(b2Vec2(0.0f, -10.0f));
+	b2World world2(b2Vec2(0.0f, -10.0f));
+	CreateHashScene(&world1);
+	CreateHashScene(&world2);
+
+	// Bodies in a deterministic build update the same way with a thread pool.
+	b2ThreadPool threadPool(2);
+#if defined(B2_DETERMINISTIC)
+	world2.SetThreadPool(&threadPool);
+#endif
+
+	CHECK(world1.ComputeStateHash() == world2.ComputeStateHash());
+
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world1.Step(1.0f / 60.0f, 8, 3);
+		world2.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world1.ComputeStateHash() == world2.ComputeStateHash());
+	}
+
+	world2.SetThreadPool(nullptr);
+
+	b2Body* body = world2.GetBodyList();
+	body->SetAngularVelocity(body->GetAngularVelocity() + 0.001f);
+	CHECK(world1.ComputeStateHash() != world2.ComputeStateHash());
+}
+
+DOCTEST_TEST_CASE("snapshot")
+{
+	const b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+	for (b2BroadPhaseType type : types)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f), type);
+		CreateHashScene(&world);
+
+		b2Body* bodyA = world.GetBodyList();
+		b2Body* bodyB = bodyA->GetNext();
+		b2RevoluteJointDef jd;
+		jd.Initialize(bodyA, bodyB, 0.5f * (bodyA->GetPosition() + bodyB->GetPosition()));
+		world.CreateJoint(&jd);
+
+		for (int32 i = 0; i < 60; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		int32 size = world.SaveSnapshot(nullptr, 0);
+		CHECK(size > 0);
+		uint8* buffer = (uint8*)b2Alloc(size);
+		CHECK(world.SaveSnapshot(buffer, size) == size);
+
+		const int32 stepCount = 60;
+		uint64 hashes[stepCount];
+		for (int32 i = 0; i < stepCount; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+			hashes[i] = world.ComputeStateHash();
+		}
+
+		// Replaying from the snapshot gives the same steps.
+		CHECK(world.RestoreSnapshot(buffer, size));
+		for (int32 i = 0; i < stepCount; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+			CHECK(world.ComputeStateHash() == hashes[i]);
+		}
+
+		// A snapshot only fits the world it came from.
+		b2World other(b2Vec2(0.0f, -10.0f), type);
+		CreateHashScene(&other);
+		CHECK(other.RestoreSnapshot(buffer, size) == false);
+		CHECK(world.RestoreSnapshot(buffer, size - 1) == false);
+
+		// Replacing a fixture or a body keeps every count the same, but not the objects.
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+		b2Body* body = bodyB->GetNext();
+		body->DestroyFixture(body->GetFixtureList());
+		body->CreateFixture(&box, 1.0f);
+		CHECK(world.RestoreSnapshot(buffer, size) == false);
+
+		world.DestroyBody(body);
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(5.0f, 2.0f);
+		world.CreateBody(&bd)->CreateFixture(&box, 1.0f);
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(world.RestoreSnapshot(buffer, size) == false);
+
+		// The world is untouched and keeps stepping.
+		for (int32 i = 0; i < 10; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		b2Free(buffer);
+	}
+}
+
+DOCTEST_TEST_CASE("damaged snapshot")
+{
+	const b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_sortAndSweepBroadPhase, b2_gridBroadPhase };
+	for (b2BroadPhaseType type : types)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f), type);
+		CreateHashScene(&world);
+
+		b2Body* bodyA = world.GetBodyList();
+		b2Body* bodyB = bodyA->GetNext();
+		b2RevoluteJointDef jd;
+		jd.Initialize(bodyA, bodyB, 0.5f * (bodyA->GetPosition() + bodyB->GetPosition()));
+		world.CreateJoint(&jd);
+
+		for (int32 i = 0; i < 60; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		int32 size = world.SaveSnapshot(nullptr, 0);
+		uint8* buffer = (uint8*)b2Alloc(size);
+		uint8* damaged = (uint8*)b2Alloc(size);
+		CHECK(world.SaveSnapshot(buffer, size) == size);
+		uint64 hash = world.ComputeStateHash();
+
+		// Truncated, with the size in the header to match. It follows the magic and the version.
+		memcpy(damaged, buffer, size);
+		for (int32 truncatedSize = size - 1; truncatedSize > 64; truncatedSize -= 37)
+		{
+			memcpy(damaged + 2 * sizeof(int32), &truncatedSize, sizeof(int32));
+			CHECK(world.RestoreSnapshot(damaged, truncatedSize) == false);
+		}
+		CHECK(world.ComputeStateHash() == hash);
+
+		// Overwrite one word at every offset. A damaged count, index or link is rejected
+		// before the world changes. A damaged value is restored as it is.
+		int32 rejectCount = 0;
+		for (int32 offset = 0; offset + int32(sizeof(int32)) <= size; ++offset)
+		{
+			int32 word = offset % 2 == 0 ? 0x40000000 : -2;
+			memcpy(damaged, buffer, size);
+			memcpy(damaged + offset, &word, sizeof(int32));
+			if (world.RestoreSnapshot(damaged, size))
+			{
+				CHECK(world.RestoreSnapshot(buffer, size));
+				continue;
+			}
+
+			++rejectCount;
+			CHECK(world.ComputeStateHash() == hash);
+			world.Step(1.0f / 60.0f, 8, 3);
+			CHECK(world.RestoreSnapshot(buffer, size));
+		}
+		CHECK(rejectCount > 0);
+		CHECK(world.ComputeStateHash() == hash);
+
+		b2Free(damaged);
+		b2Free(buffer);
+	}
+}
+
+DOCTEST_TEST_CASE("memory stats")
+{
+	b2AllocStats before = b2GetAllocStats();
+
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		CreateHashScene(&world);
+
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+		for (int32 i = 0; i < 500; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(100.0f + 2.0f * i, 0.0f);
+			world.CreateBody(&bd)->CreateFixture(&box, 1.0f);
+		}
+
+		for (int32 i = 0; i < 10; ++i)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+
+		b2AllocStats during = b2GetAllocStats();
+		CHECK(during.liveCount > before.liveCount);
+		CHECK(during.liveBytes > before.liveBytes);
+		CHECK(during.peakBytes >= during.liveBytes);
+
+		const b2BlockAllocator& allocator = world.GetBlockAllocator();
+		int32 liveCount = 0;
+		int32 chunkBytes = 0;
+		for (int32 i = 0; i < b2_blockSizeCount; ++i)
+		{
+			b2BlockStats stats = allocator.GetStats(i);
+			CHECK(stats.peakCount >= stats.liveCount);
+			CHECK(stats.wastedBytes >= 0);
+			CHECK(stats.wastedBytes <= stats.chunkCount * (16 * 1024));
+			liveCount += stats.liveCount;
+			chunkBytes += stats.chunkCount * 16 * 1024;
+		}
+		CHECK(liveCount > 500);
+		CHECK(chunkBytes == allocator.GetChunkBytes());
+
+		// Nothing is released while the objects are alive.
+		CHECK(world.TrimMemory() == 0);
+
+		b2Body* body = world.GetBodyList();
+		while (body)
+		{
+			b2Body* next = body->GetNext();
+			world.DestroyBody(body);
+			body = next;
+		}
+
+		for (int32 i = 0; i < b2_blockSizeCount; ++i)
+		{
+			CHECK(allocator.GetStats(i).liveCount == 0);
+		}
+
+		CHECK(world.TrimMemory() == chunkBytes);
+		CHECK(allocator.GetChunkBytes() == 0);
+
+		// The allocator still works after a trim.
+		CreateHashScene(&world);
+		world.Step(1.0f / 60.0f, 8, 3);
+		CHECK(allocator.GetChunkBytes() > 0);
+	}
+
+	b2AllocStats after = b2GetAllocStats();
+	CHECK(after.liveCount == before.liveCount);
+	CHECK(after.liveBytes == before.liveBytes);
+	CHECK(after.allocCount > before.allocCount);
+}
+
+DOCTEST_TEST_CASE("stack allocator")
+{
+	b2StackAllocator allocator;
+
+	void* a = allocator.Allocate(100);
+	void* b = allocator.Allocate(b2_stackSize);
+	void* c = allocator.Allocate(3 * b2_stackSize);
+	CHECK(((uintptr_t)a & 15) == 0);
+	CHECK(((uintptr_t)b & 15) == 0);
+	CHECK(((uintptr_t)c & 15) == 0);
+	CHECK(allocator.GetGrowCount() == 2);
+	memset(c, 0, 3 * b2_stackSize);
+	allocator.Free(c);
+	allocator.Free(b);
+	allocator.Free(a);
+
+	// The chunks are kept, so the same allocations do not grow the stack again.
+	int32 capacity = allocator.GetCapacity();
+	a = allocator.Allocate(100);
+	b = allocator.Allocate(b2_stackSize);
+	c = allocator.Allocate(3 * b2_stackSize);
+	CHECK(allocator.GetGrowCount() == 2);
+	CHECK(allocator.GetCapacity() == capacity);
+	CHECK(allocator.GetMaxAllocation() >= 4 * b2_stackSize + 100);
+	allocator.Reset();
+	CHECK(allocator.GetEntryCount() == 0);
+
+	// Nesting deeper than the initial entries grows them.
+	const int32 depth = 3 * b2_maxStackEntries;
+	void* blocks[depth];
+	for (int32 i = 0; i < depth; ++i)
+	{
+		blocks[i] = allocator.Allocate(64);
+		memset(blocks[i], i, 64);
+	}
+	CHECK(allocator.GetEntryCount() == depth);
+	for (int32 i = depth - 1; i >= 0; --i)
+	{
+		CHECK(*(uint8*)blocks[i] == uint8(i));
+		allocator.Free(blocks[i]);
+	}
+	CHECK(allocator.GetEntryCount() == 0);
+
+	// A large island needs more than one chunk, then steps without growing.
+	b2World world(b2Vec2(0.0f, -10.0f));
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-200.0f, 0.0f), b2Vec2(200.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	for (int32 i = 0; i < 2000; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-150.0f + 1.0f * (i % 300), 0.5f + 1.0f * (i / 300));
+		world.CreateBody(&bd)->CreateFixture(&box, 1.0f);
+	}
+
+	for (int32 i = 0; i < 5; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	const b2StackAllocator& stack = world.GetStackAllocator();
+	int32 growCount = stack.GetGrowCount();
+	CHECK(stack.GetEntryCount() == 0);
+	CHECK(stack.GetMaxAllocation() > b2_stackSize);
+	CHECK(stack.GetCapacity() >= stack.GetMaxAllocation());
+
+	for (int32 i = 0; i < 5; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+	CHECK(stack.GetGrowCount() == growCount);
+}
+
+static void CreateBulletScene(b2World* world)
+{
+	// A closed box of thin walls.
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-10.0f, 0.0f), b2Vec2(10.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.SetTwoSided(b2Vec2(-10.0f, 20.0f), b2Vec2(10.0f, 20.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.SetTwoSided(b2Vec2(-10.0f, 0.0f), b2Vec2(-10.0f, 20.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.SetTwoSided(b2Vec2(10.0f, 0.0f), b2Vec2(10.0f, 20.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	// Small bullets fired at the walls.
+	b2CircleShape circle;
+	circle.m_radius = 0.1f;
+
+	for (int32 i = 0; i < 40; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.bullet = true;
+		bd.position.Set(-8.0f + 0.4f * i, 2.0f + 0.4f * i);
+		float angle = 0.7f * i;
+		bd.linearVelocity.Set(300.0f * cosf(angle), 300.0f * sinf(angle));
+		world->CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+	}
+}
+
+DOCTEST_TEST_CASE("batched toi")
+{
+	b2World world1(b2Vec2(0.0f, -10.0f));
+	b2World world2(b2Vec2(0.0f, -10.0f));
+	world1.SetBatchedTOI(true);
+	world2.SetBatchedTOI(true);
+	CreateBulletScene(&world1);
+	CreateBulletScene(&world2);
+
+	// The batches do not depend on the thread count.
+	b2ThreadPool threadPool(4);
+	world2.SetThreadPool(&threadPool);
+
+	for (int32 i = 0; i < 60; ++i)
+	{
+		world1.Step(1.0f / 60.0f, 8, 3);
+		world2.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	int32 escaped = 0;
+	for (b2Body* b1 = world1.GetBodyList(), *b2 = world2.GetBodyList(); b1; b1 = b1->GetNext(), b2 = b2->GetNext())
+	{
+		b2Vec2 p = b1->GetPosition();
+		CHECK(p.x == b2->GetPosition().x);
+		CHECK(p.y == b2->GetPosition().y);
+		if (p.x < -10.0f || 10.0f < p.x || p.y < 0.0f || 20.0f < p.y)
+		{
+			++escaped;
+		}
+	}
+
+	CHECK(escaped == 0);
+
+	world2.SetThreadPool(nullptr);
+}
+
+// Polygons of several vertex counts, circles, an edge and chain ground and sensors.
+static void CreateNarrowPhaseScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(0.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2Vec2 vertices[3] = { b2Vec2(20.0f, 4.0f), b2Vec2(10.0f, 0.0f), b2Vec2(0.0f, 0.0f) };
+	b2ChainShape chain;
+	chain.CreateChain(vertices, 3, b2Vec2(30.0f, 4.0f), b2Vec2(-10.0f, 0.0f));
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2PolygonShape groundBox;
+	groundBox.SetAsBox(0.5f, 5.0f, b2Vec2(-20.5f, 5.0f), 0.0f);
+	ground->CreateFixture(&groundBox, 0.0f);
+	groundBox.SetAsBox(0.5f, 5.0f, b2Vec2(20.5f, 9.0f), 0.0f);
+	ground->CreateFixture(&groundBox, 0.0f);
+
+	b2PolygonShape polygons[6];
+	for (int32 k = 0; k < 6; ++k)
+	{
+		int32 count = 3 + k;
+		b2Vec2 points[b2_maxPolygonVertices];
+		for (int32 i = 0; i < count; ++i)
+		{
+			float angle = 2.0f * b2_pi * i / count;
+			points[i].Set(0.4f * cosf(angle), 0.3f * sinf(angle));
+		}
+		polygons[k].Set(points, count);
+	}
+
+	b2PolygonShape box;
+	box.SetAsBox(0.4f, 0.25f);
+	b2CircleShape circle;
+	circle.m_radius = 0.3f;
+
+	for (int32 i = 0; i < 240; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-18.0f + 1.2f * (i % 30), 6.0f + 0.9f * (i / 30));
+		bd.angle = 0.2f * i;
+		b2Body* body = world->CreateBody(&bd);
+
+		b2FixtureDef fd;
+		fd.density = 1.0f;
+		fd.friction = 0.6f;
+		fd.shape = i % 3 == 0 ? (const b2Shape*)&circle : i % 3 == 1 ? (const b2Shape*)&box : (const b2Shape*)(polygons + i % 6);
+		fd.isSensor = i % 37 == 0;
+		body->CreateFixture(&fd);
+	}
+}
+
+DOCTEST_TEST_CASE("wide narrow phase")
+{
+	b2World world1(b2Vec2(0.0f, -10.0f));
+	b2World world2(b2Vec2(0.0f, -10.0f));
+	b2World world3(b2Vec2(0.0f, -10.0f));
+	CreateNarrowPhaseScene(&world1);
+	CreateNarrowPhaseScene(&world2);
+	CreateNarrowPhaseScene(&world3);
+
+	// A wake up changes when the contacts of the woken body are updated, so keep
+	// everything awake to compare with the default narrow phase.
+	world1.SetAllowSleeping(false);
+	world2.SetAllowSleeping(false);
+	world3.SetAllowSleeping(false);
+	world2.SetWideNarrowPhase(true);
+	world3.SetWideNarrowPhase(true);
+
+	b2ThreadPool threadPool(4);
+	world3.SetThreadPool(&threadPool);
+
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world1.Step(1.0f / 60.0f, 8, 3);
+		world2.Step(1.0f / 60.0f, 8, 3);
+		world3.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(world1.GetContactCount() > 200);
+
+	bool same = true;
+	b2Body* b2 = world2.GetBodyList();
+	b2Body* b3 = world3.GetBodyList();
+	for (b2Body* b1 = world1.GetBodyList(); b1; b1 = b1->GetNext())
+	{
+		b2Transform xf1 = b1->GetTransform();
+		b2Transform xf2 = b2->GetTransform();
+		b2Transform xf3 = b3->GetTransform();
+		same = same && memcmp(&xf1, &xf2, sizeof(b2Transform)) == 0;
+		same = same && memcmp(&xf1, &xf3, sizeof(b2Transform)) == 0;
+		b2 = b2->GetNext();
+		b3 = b3->GetNext();
+	}
+
+	CHECK(same);
+
+	world3.SetThreadPool(nullptr);
+}
+
+DOCTEST_TEST_CASE("profile history")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetProfileHistory(8);
+	CreateHashScene(&world);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	const b2Profile& first = world.GetProfile();
+	CHECK(first.pairCount > 0);
+	CHECK(first.contactCreateCount > 0);
+	CHECK(first.islandCount > 0);
+	CHECK(first.maxIslandSize > 0);
+	CHECK(first.treeHeight > 0);
+
+	for (int32 i = 0; i < 19; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(world.GetProfile().contactUpdateCount > 0);
+	CHECK(world.GetProfileHistoryCount() == 8);
+	CHECK(world.GetProfileHistory(7).step == world.GetProfile().step);
+	CHECK(world.GetProfileHistory(7).contactUpdateCount == world.GetProfile().contactUpdateCount);
+
+	const char* csvName = "profile_history.csv";
+	const char* traceName = "profile_history.json";
+	CHECK(world.WriteProfileCSV(csvName));
+	CHECK(world.WriteProfileTrace(traceName));
+
+	// A header and one row per step.
+	FILE* file = fopen(csvName, "r");
+	REQUIRE(file != nullptr);
+	int32 lineCount = 0;
+	char line[1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		++lineCount;
+	}
+	fclose(file);
+	CHECK(lineCount == 9);
+
+	file = fopen(traceName, "r");
+	REQUIRE(file != nullptr);
+	CHECK(fgets(line, sizeof(line), file) != nullptr);
+	CHECK(strncmp(line, "{\"displayTimeUnit\"", 18) == 0);
+	fclose(file);
+
+	remove(csvName);
+	remove(traceName);
+
+	world.SetProfileHistory(0);
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetProfileHistoryCount() == 0);
+}